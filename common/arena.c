@@ -0,0 +1,131 @@
+/*
+ * arena.c - bump allocator for short-lived data that is freed all at once
+ *
+ * see arena.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "arena.h"
+#include "memory.h"
+
+/************* file-local types ****************/
+
+typedef struct arenaBlock { // one chunk of memory, handed out from the front
+    struct arenaBlock* next;    // the block to use once this one is full
+    size_t size;                // bytes of data
+    size_t used;                // bytes of data already handed out
+    max_align_t data[];         // the memory itself, aligned for any type
+} arenaBlock_t;
+
+typedef struct arena {
+    arenaBlock_t* first;        // the first block, where a reset arena starts again
+    arenaBlock_t* current;      // the block allocations come from
+    size_t blockSize;           // the smallest size of a new block
+} arena_t;
+
+/************* global variables ****************/
+
+static const size_t ALIGNMENT = _Alignof(max_align_t);
+
+/************* local function prototypes ********************/
+
+static arenaBlock_t* newBlock(const size_t size);
+
+/************** newArena() ******************/
+// see arena.h for description
+arena_t* newArena(const size_t blockSize)
+{
+    arena_t* arena = count_malloc(sizeof(arena_t));
+    if (arena == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return NULL;
+    }
+    arena->blockSize = blockSize > 0 ? blockSize : 4096;
+    arena->first = arena->current = newBlock(arena->blockSize);
+    if (arena->first == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        count_free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+/************** deleteArena() ******************/
+// see arena.h for description
+void deleteArena(arena_t* arena)
+{
+    if (arena == NULL) return;
+    arenaBlock_t* block = arena->first;
+    while (block != NULL) {
+        arenaBlock_t* next = block->next;
+        count_free(block);
+        block = next;
+    }
+    count_free(arena);
+}
+
+/************** arenaAlloc() ******************/
+// see arena.h for description
+void* arenaAlloc(arena_t* arena, const size_t size)
+{
+    if (arena == NULL || size > SIZE_MAX - ALIGNMENT) return NULL;
+    size_t rounded = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    arenaBlock_t* block = arena->current;
+    if (block->size - block->used < rounded) {
+        // blocks after the current one are empty; reuse the next one if it fits
+        if (block->next != NULL && block->next->size >= rounded) {
+            block = block->next;
+        } else {
+            arenaBlock_t* added = newBlock(rounded > arena->blockSize ? rounded : arena->blockSize);
+            if (added == NULL) return NULL;
+            added->next = block->next;
+            block->next = added;
+            block = added;
+        }
+        block->used = 0;
+        arena->current = block;
+    }
+
+    void* memory = (char*) block->data + block->used;
+    block->used += rounded;
+    return memory;
+}
+
+/************** arenaCalloc() ******************/
+// see arena.h for description
+void* arenaCalloc(arena_t* arena, const size_t count, const size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void* memory = arenaAlloc(arena, count * size);
+    if (memory != NULL) memset(memory, 0, count * size);
+    return memory;
+}
+
+/************** arenaReset() ******************/
+// see arena.h for description
+void arenaReset(arena_t* arena)
+{
+    if (arena == NULL) return;
+    // later blocks are marked empty as allocation reaches them again
+    arena->current = arena->first;
+    arena->first->used = 0;
+}
+
+/************** newBlock() ******************/
+/* allocates an empty block with room for size bytes, or returns NULL */
+static arenaBlock_t* newBlock(const size_t size)
+{
+    if (size > SIZE_MAX - sizeof(arenaBlock_t)) return NULL;
+    arenaBlock_t* block = count_malloc(sizeof(arenaBlock_t) + size);
+    if (block == NULL) return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
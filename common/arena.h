@@ -0,0 +1,54 @@
+/*
+ * arena.h - header file for CS50 'arena' file in 'common' module
+ *
+ * provides a bump allocator for short-lived data that is all thrown away at once,
+ * such as the temporary state of a single query. Allocating moves a pointer forward
+ * inside a large block, and nothing is freed individually; resetting the arena
+ * makes all of its memory available again in O(1). The blocks are kept across
+ * resets, so once an arena has grown to fit a workload it stops touching the heap.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __ARENA
+#define __ARENA
+
+#include <stddef.h>
+
+/**************** global types ****************/
+typedef struct arena arena_t; // a chain of blocks that allocations are carved out of
+
+/******************* functions *******************/
+
+/******************* newArena() ********************/
+/* creates an arena that grows in blocks of (at least) blockSize bytes,
+ * returns NULL if out of memory
+*/
+arena_t* newArena(const size_t blockSize);
+
+/******************* deleteArena() ********************/
+/* frees every block of the arena, and the arena itself */
+void deleteArena(arena_t* arena);
+
+/******************* arenaAlloc() ********************/
+/* Allocates size bytes from the arena, aligned for any type
+ *
+ * Pseudocode:
+ *      1. round the size up to the alignment
+ *      2. if the current block has room, bump its pointer and return the old one
+ *      3. otherwise move on to the next kept block if it is big enough, or
+ *          allocate a new block (bigger than blockSize if need be) after the current one
+ *
+ * returns NULL if out of memory. The memory stays valid until the arena is reset or deleted
+*/
+void* arenaAlloc(arena_t* arena, const size_t size);
+
+/******************* arenaCalloc() ********************/
+/* allocates count * size zeroed bytes from the arena, returns NULL if out of memory */
+void* arenaCalloc(arena_t* arena, const size_t count, const size_t size);
+
+/******************* arenaReset() ********************/
+/* gives back everything allocated from the arena in O(1), keeping its blocks */
+void arenaReset(arena_t* arena);
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * doctable.c - library to build, write, and map document metadata tables
+ *
+ * see doctable.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L // mmap, fstat
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "doctable.h"
+#include "memory.h"
+
+/************* file-local types ****************/
+
+typedef struct docTableHeader { // the first bytes of a document table file
+    char magic[8];
+    uint32_t numDocs;
+    uint32_t stringsSize;
+} docTableHeader_t;
+
+typedef struct docEntry { // the metadata of one document
+    uint32_t urlOffset;     // offset of the URL in the string table, NO_URL if empty
+    int32_t depth;          // crawl depth of the page
+    uint32_t length;        // number of bytes of HTML
+    uint32_t numWords;      // number of words indexed from the page
+} docEntry_t;
+
+typedef struct docTable {
+    docEntry_t* entries;    // entry i holds docID i + 1
+    char* strings;          // the URLs
+    uint32_t numDocs;       // number of entries in use
+    uint32_t stringsSize;   // number of bytes of strings in use
+    uint32_t docsCapacity;  // number of entries allocated (built tables only)
+    uint32_t stringsCapacity; // number of bytes of strings allocated (built tables only)
+    void* base;             // start of the mapping, or NULL for a built table
+    size_t size;            // length of the mapping
+} docTable_t;
+
+/************* global variables ****************/
+
+static const char MAGIC[8] = {'T', 'S', 'E', 'D', 'O', 'C', 'S', '1'};
+static const uint32_t NO_URL = UINT32_MAX;
+
+/************* local function prototypes ********************/
+
+static const docEntry_t* findEntry(docTable_t* table, const int docID);
+
+/************** newDocTable() ******************/
+// see doctable.h for description
+docTable_t* newDocTable(void)
+{
+    docTable_t* table = count_calloc(1, sizeof(docTable_t));
+    if (table == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return NULL;
+    }
+    return table;
+}
+
+/************** deleteDocTable() ******************/
+// see doctable.h for description
+void deleteDocTable(docTable_t* table)
+{
+    if (table == NULL) return;
+    if (table->base != NULL) {
+        munmap(table->base, table->size);
+    } else {
+        if (table->entries != NULL) count_free(table->entries);
+        if (table->strings != NULL) count_free(table->strings);
+    }
+    count_free(table);
+}
+
+/************** docTableSet() ******************/
+// see doctable.h for description
+bool docTableSet(docTable_t* table, const int docID, const char* url,
+                 const int depth, const int length, const int numWords)
+{
+    if (table == NULL || url == NULL || docID < 1 || table->base != NULL) return false;
+
+    // grow the entries by doubling until the docID fits
+    if ((uint32_t) docID > table->docsCapacity) {
+        uint32_t capacity = table->docsCapacity > 0 ? table->docsCapacity : 64;
+        while (capacity < (uint32_t) docID) capacity *= 2;
+        docEntry_t* entries = count_malloc(capacity * sizeof(docEntry_t));
+        if (entries == NULL) return false;
+        if (table->entries != NULL) {
+            memcpy(entries, table->entries, table->numDocs * sizeof(docEntry_t));
+            count_free(table->entries);
+        }
+        table->entries = entries;
+        table->docsCapacity = capacity;
+    }
+    // documents skipped over have no entry yet
+    while (table->numDocs < (uint32_t) docID) {
+        table->entries[table->numDocs].urlOffset = NO_URL;
+        table->numDocs++;
+    }
+
+    // append the URL to the string table
+    uint32_t urlSize = strlen(url) + 1;
+    if (table->stringsSize + urlSize > table->stringsCapacity) {
+        uint32_t capacity = table->stringsCapacity > 0 ? table->stringsCapacity : 4096;
+        while (capacity < table->stringsSize + urlSize) capacity *= 2;
+        char* strings = count_malloc(capacity);
+        if (strings == NULL) return false;
+        if (table->strings != NULL) {
+            memcpy(strings, table->strings, table->stringsSize);
+            count_free(table->strings);
+        }
+        table->strings = strings;
+        table->stringsCapacity = capacity;
+    }
+    memcpy(table->strings + table->stringsSize, url, urlSize);
+
+    docEntry_t* entry = &table->entries[docID - 1];
+    entry->urlOffset = table->stringsSize;
+    entry->depth = depth;
+    entry->length = length;
+    entry->numWords = numWords;
+    table->stringsSize += urlSize;
+    return true;
+}
+
+/************** docTableGetURL() ******************/
+// see doctable.h for description
+const char* docTableGetURL(docTable_t* table, const int docID)
+{
+    const docEntry_t* entry = findEntry(table, docID);
+    return entry == NULL ? NULL : table->strings + entry->urlOffset;
+}
+
+/************** docTableGetStats() ******************/
+// see doctable.h for description
+bool docTableGetStats(docTable_t* table, const int docID, int* depth, int* length, int* numWords)
+{
+    const docEntry_t* entry = findEntry(table, docID);
+    if (entry == NULL) return false;
+    if (depth != NULL) *depth = entry->depth;
+    if (length != NULL) *length = entry->length;
+    if (numWords != NULL) *numWords = entry->numWords;
+    return true;
+}
+
+/************** docTableSize() ******************/
+// see doctable.h for description
+int docTableSize(docTable_t* table)
+{
+    return table == NULL ? 0 : table->numDocs;
+}
+
+/************** mergeDocTable() ******************/
+// see doctable.h for description
+bool mergeDocTable(docTable_t* target, docTable_t* source)
+{
+    if (target == NULL || source == NULL) return false;
+    for (uint32_t i = 0; i < source->numDocs; i++) {
+        const docEntry_t* entry = &source->entries[i];
+        if (entry->urlOffset == NO_URL) continue;
+        if (!docTableSet(target, i + 1, source->strings + entry->urlOffset,
+                         entry->depth, entry->length, entry->numWords)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/************** saveDocTable() ******************/
+// see doctable.h for description
+bool saveDocTable(char* filepath, docTable_t* table)
+{
+    if (filepath == NULL || table == NULL) return false;
+    FILE* fp = fopen(filepath, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: could not create file %s\n", filepath);
+        return false;
+    }
+
+    // the header, then the entries and strings exactly as they are in memory
+    docTableHeader_t header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.numDocs = table->numDocs;
+    header.stringsSize = table->stringsSize;
+    bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (table->numDocs > 0) {
+        success = success && fwrite(table->entries, sizeof(docEntry_t), table->numDocs, fp) == table->numDocs;
+    }
+    if (table->stringsSize > 0) {
+        success = success && fwrite(table->strings, table->stringsSize, 1, fp) == 1;
+    }
+    if (fclose(fp) != 0) success = false;
+    return success;
+}
+
+/************** loadDocTable() ******************/
+// see doctable.h for description
+docTable_t* loadDocTable(char* filepath)
+{
+    if (filepath == NULL) return NULL;
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(docTableHeader_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    // map the whole file; the mapping stays valid after the descriptor is closed
+    size_t size = info.st_size;
+    void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    // validate the header against the size of the file
+    const docTableHeader_t* header = base;
+    size_t expected = sizeof(docTableHeader_t)
+                    + (size_t) header->numDocs * sizeof(docEntry_t)
+                    + header->stringsSize;
+    const char* strings = (const char*) base + sizeof(docTableHeader_t)
+                        + (size_t) header->numDocs * sizeof(docEntry_t);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || expected != size
+        || (header->stringsSize > 0 && strings[header->stringsSize - 1] != '\0')) {
+        fprintf(stderr, "Error: %s is not a valid document table file\n", filepath);
+        munmap(base, size);
+        return NULL;
+    }
+
+    docTable_t* table = newDocTable();
+    if (table == NULL) {
+        munmap(base, size);
+        return NULL;
+    }
+    table->base = base;
+    table->size = size;
+    table->numDocs = header->numDocs;
+    table->stringsSize = header->stringsSize;
+    // the table is never written through these pointers once mapped
+    table->entries = (docEntry_t*) ((char*) base + sizeof(docTableHeader_t));
+    table->strings = (char*) strings;
+    return table;
+}
+
+/************** findEntry() ******************/
+/* returns the entry of a docID, or NULL if there is none or it is corrupt */
+static const docEntry_t* findEntry(docTable_t* table, const int docID)
+{
+    if (table == NULL || docID < 1 || (uint32_t) docID > table->numDocs) return NULL;
+    const docEntry_t* entry = &table->entries[docID - 1];
+    if (entry->urlOffset == NO_URL || entry->urlOffset >= table->stringsSize) return NULL;
+    return entry;
+}
@@ -0,0 +1,82 @@
+/*
+ * doctable.h - header file for CS50 'doctable' file in 'common' module
+ *
+ * provides a table of per-document metadata, indexed by docID: the document's
+ * URL, its crawl depth, the length of its HTML, and the number of words indexed
+ * from it. The indexer fills the table while it indexes and writes it to a binary
+ * file next to the index, and the querier maps that file into memory once, so it
+ * can print results without opening the crawler files.
+ *
+ * Layout:
+ *      header      magic "TSEDOCS1", number of documents, string table size
+ *      documents   one (URL offset, depth, HTML length, number of words) entry per docID,
+ *                  starting at docID 1
+ *      strings     the '\0'-terminated URLs themselves
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __DOC_TABLE
+#define __DOC_TABLE
+
+#include <stdbool.h>
+
+/**************** global types ****************/
+typedef struct docTable docTable_t; // per-document metadata, built in memory or mapped from a file
+
+/******************* functions *******************/
+
+/******************* newDocTable() ********************/
+/* creates an empty table to be filled with docTableSet(), returns NULL if out of memory */
+docTable_t* newDocTable(void);
+
+/******************* deleteDocTable() ********************/
+/* frees the table, or unmaps it if it was loaded from a file */
+void deleteDocTable(docTable_t* table);
+
+/******************* docTableSet() ********************/
+/* Records the metadata of a document, copying the URL
+ *
+ * Pseudocode:
+ *      1. grow the entries so docID fits, marking new entries as empty
+ *      2. append the URL to the string table
+ *      3. fill in the docID's entry
+ *
+ * returns false on error, or if the table was loaded from a file
+*/
+bool docTableSet(docTable_t* table, const int docID, const char* url,
+                 const int depth, const int length, const int numWords);
+
+/******************* docTableGetURL() ********************/
+/* returns the URL of a document, or NULL if the table has no entry for that docID.
+ * The string belongs to the table
+*/
+const char* docTableGetURL(docTable_t* table, const int docID);
+
+/******************* docTableGetStats() ********************/
+/* sets the depth, HTML length, and number of words of a document (any pointer
+ * may be NULL), returns false if the table has no entry for that docID
+*/
+bool docTableGetStats(docTable_t* table, const int docID, int* depth, int* length, int* numWords);
+
+/******************* docTableSize() ********************/
+/* returns the largest docID the table has room for (0 if empty) */
+int docTableSize(docTable_t* table);
+
+/******************* mergeDocTable() ********************/
+/* copies every entry of the source table into the target table */
+bool mergeDocTable(docTable_t* target, docTable_t* source);
+
+/******************* saveDocTable() ********************/
+/* writes the table to a binary file at the given filepath */
+bool saveDocTable(char* filepath, docTable_t* table);
+
+/******************* loadDocTable() ********************/
+/* Maps a binary document table file into memory
+ *
+ * returns NULL if the file can't be opened or isn't a valid document table.
+ * The caller must later call deleteDocTable()
+*/
+docTable_t* loadDocTable(char* filepath);
+
+#endif
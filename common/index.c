@@ -10,7 +10,9 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
 #include "index.h"
+#include "indexmap.h"
 #include "pagedir.h"
 #include "word.h"
 #include "hashtable.h"
@@ -22,16 +24,62 @@
 /************* global types ****************/
 
 typedef struct index {
-    hashtable_t* table;
+    hashtable_t* table;     // word -> counters; for a mapped or merged index, a cache of looked-up words
+    hashtable_t* postings;  // word -> postingList_t: every word of a merged index, otherwise
+                            // a cache of looked-up words of an in-memory index
+    indexMap_t* map;        // the mapped binary index file, or NULL for an in-memory index
+    bool merged;            // whether the postings hold the words, as once mergeIndex() is called
+    int tableSize;          // the number of slots of the hashtables holding the words
+    docTable_t* docs;       // metadata of the documents indexed so far, or NULL
+    wordTokenizer_t* tokenizer; // finds the words of the pages being indexed, or NULL until then
+    struct pageTerms* terms;    // counts the words of the page being indexed, or NULL until then
 } index_t;
 
+typedef struct pageTerm { // a distinct word of the page being indexed
+    uint64_t hash;          // its hashWord()
+    size_t offset;          // where it is in the pool
+    int length;
+    int count;              // times it appears on the page
+} pageTerm_t;
+
+typedef struct pageTerms { // the distinct words of a page, kept between pages so they are reused
+    pageTerm_t* terms;      // in the order they first appear
+    int numTerms;
+    int maxTerms;
+    int* slots;             // open-addressed table of term indices + 1, 0 for empty
+    int numSlots;           // a power of 2, at least twice maxTerms
+    char* pool;             // the words, each followed by '\0'
+    size_t poolLength;
+    size_t poolCapacity;
+} pageTerms_t;
+
+typedef struct listTable { // where flattenCT() and mergeList() put each word's posting list
+    hashtable_t* lists;
+    bool success;           // false once a word couldn't be put there
+} listTable_t;
+
 /************* local function prototypes ********************/
 
 static void loadWordInIndex(index_t* index, char* word, FILE* fp);
 static void printCT(void* arg, const char* key, void* item);
 static void printCTHelper(void* arg, const int key, const int count);
-static void readWordsInWebpage(webpage_t* page, index_t* index, int* id);
+static void printPostings(void* arg, const char* word, const posting_t* postings, int numPostings);
+static int readWordsInWebpage(webpage_t* page, index_t* index, int* id);
+static pageTerms_t* newPageTerms(void);
+static void deletePageTerms(pageTerms_t* terms);
+static bool addPageTerm(pageTerms_t* terms, const wordToken_t* token);
 static void deleteCT(void* item);
+static void deletePostingList(void* item);
+static void countPostings(void* arg, const int key, const int count);
+static void fillPostings(void* arg, const int key, const int count);
+static int comparePostings(const void* a, const void* b);
+static postingList_t* newPostingList(counters_t* ctrs);
+static bool appendPostings(postingList_t* list, const postingList_t* more);
+static bool flattenIndex(index_t* index);
+static void flattenCT(void* arg, const char* key, void* item);
+static void mergeList(void* arg, const char* key, void* item);
+static void printList(void* arg, const char* key, void* item);
+static void addMergedPosting(index_t* index, const char* word, const int id, const int count);
 
 /************** newIndex() ******************/
 // see index.h for description
@@ -40,6 +88,13 @@ index_t* newIndex(const int tableSize)
     // allocate memory for the index
     index_t* index = count_malloc(sizeof(index_t));
     if (index != NULL) { 
+        index->map = NULL;
+        index->merged = false;
+        index->tableSize = tableSize;
+        index->postings = NULL;
+        index->docs = NULL;
+        index->tokenizer = NULL;
+        index->terms = NULL;
         // set the inner hashtable to a new hashtable of the specified size
         if ((index->table = hashtable_new(tableSize)) != NULL) return index;
         else return NULL;
@@ -49,7 +104,7 @@ index_t* newIndex(const int tableSize)
     }
 }
 
-/************** newIndex() ******************/
+/************** deleteIndex() ******************/
 // see index.h for description
 void deleteIndex(index_t* index) 
 {
@@ -58,6 +113,13 @@ void deleteIndex(index_t* index)
             // free the hashtable
             hashtable_delete(index->table, deleteCT);
         }
+        // free the sorted posting lists
+        if (index->postings != NULL) hashtable_delete(index->postings, deletePostingList);
+        // unmap the binary index file
+        if (index->map != NULL) deleteIndexMap(index->map);
+        if (index->docs != NULL) deleteDocTable(index->docs);
+        deleteWordTokenizer(index->tokenizer);
+        deletePageTerms(index->terms);
         // free the struct
         count_free(index);
     }
@@ -70,12 +132,18 @@ bool buildIndexFromCrawler(char* pageDir, index_t* index)
     // validate parameters
     if (pageDir != NULL && index != NULL) {
 
-        // loop through as long as the file exists 
+        // loop through every id up to the last crawler file
+        int lastID = lastPageID(pageDir);
         int id = 1; 
-        // load the crawler files into webpages as long as they exist
-        webpage_t* crawlerPage;  
-        while ((crawlerPage = loadPageToWebpage(pageDir, id)) != NULL) {
-            // index them
+        while (id <= lastID) {
+            // load the crawler file into a webpage, passing over an id
+            // the crawler couldn't save a page under
+            webpage_t* crawlerPage = loadPageToWebpage(pageDir, id);
+            if (crawlerPage == NULL) {
+                id++;
+                continue;
+            }
+            // index it
             if (!indexWebpage(index, crawlerPage, &id)) {
                 fprintf(stderr, "Error: couldn't index page");
             }
@@ -87,6 +155,61 @@ bool buildIndexFromCrawler(char* pageDir, index_t* index)
     }
 }
 
+/************** buildIndexFromRange() ******************/
+// see index.h for description
+bool buildIndexFromRange(char* pageDir, index_t* index, const int firstID, const int lastID)
+{
+    if (pageDir == NULL || index == NULL || firstID < 1) return false;
+    bool success = true;
+    // indexWebpage moves id on to the next file
+    int id = firstID;
+    while (id <= lastID) {
+        webpage_t* crawlerPage = loadPageToWebpage(pageDir, id);
+        if (crawlerPage == NULL) {
+            id++;                   // the crawler couldn't save a page there
+        } else if (!indexWebpage(index, crawlerPage, &id)) {
+            fprintf(stderr, "Error: couldn't index page %d\n", id);
+            success = false;
+            id++;
+        }
+    }
+    return success;
+}
+
+/************** mergeIndex() ******************/
+// see index.h for description
+bool mergeIndex(index_t* target, index_t* source)
+{
+    // the source is deleted whatever happens, so the caller never has to
+    if (target == NULL || source == NULL || target->map != NULL || source->map != NULL) {
+        deleteIndex(source);
+        return false;
+    }
+    // turn both indexes' countersets into sorted posting lists, once
+    if ((!target->merged && !flattenIndex(target)) || (!source->merged && !flattenIndex(source))) {
+        fprintf(stderr, "Error: out of memory\n");
+        deleteIndex(source);
+        return false;
+    }
+    // the source's ids come after the target's, so its lists are appended
+    // to the target's, or moved over whole for the words new to the target
+    listTable_t merged = { target->postings, true };
+    hashtable_iterate(source->postings, &merged, mergeList);
+    bool success = merged.success;
+
+    // the document tables cover disjoint ids, so just copy the source's entries over
+    if (source->docs != NULL) {
+        if (target->docs == NULL) {
+            target->docs = source->docs;
+            source->docs = NULL;
+        } else {
+            success = mergeDocTable(target->docs, source->docs) && success;
+        }
+    }
+    deleteIndex(source);
+    return success;
+}
+
 /************** saveIndexToFile() ******************/
 // see index.h for description
 bool saveIndexToFile(char* filename, index_t* index)
@@ -99,15 +222,62 @@ bool saveIndexToFile(char* filename, index_t* index)
     FILE* fp;
     // try to open that file (should work as long as dir exists)
 	if ((fp = fopen(filepath, "w")) != NULL) {
-        // iterate through the table and print the file in the format specified
-		hashtable_iterate(index->table, fp, printCT);
+        // iterate through the table (or the mapped file) and print the file in the format specified
+        if (index->map != NULL) iterateIndexMap(index->map, fp, printPostings);
+        else if (index->merged) hashtable_iterate(index->postings, fp, printList);
+        else hashtable_iterate(index->table, fp, printCT);
         fclose(fp);
 	}
     count_free(filepath);
     return true;
 }
 
-/************** loadIndex() ******************/ // COMMENT THIS 
+/************** saveIndexToBinaryFile() ******************/
+// see index.h for description
+bool saveIndexToBinaryFile(char* filename, index_t* index)
+{
+    // build the filepath of the index file
+    if (filename == NULL || index == NULL) return false;
+    if (index->map != NULL) {
+        fprintf(stderr, "Error: index is already a binary index file\n");
+        return false;
+    }
+    char* filepath = stringBuilder(NULL, filename);
+    if (filepath == NULL) return false;
+
+    // write the sorted dictionary and packed postings
+    bool success = index->merged ? saveIndexMapLists(filepath, index->postings)
+                                 : saveIndexMap(filepath, index->table);
+    count_free(filepath);
+    return success;
+}
+
+/************** saveDocsToFile() ******************/
+// see index.h for description
+bool saveDocsToFile(char* indexFilename, index_t* index)
+{
+    if (indexFilename == NULL || index == NULL) return false;
+    if (index->docs == NULL) {
+        fprintf(stderr, "Error: no documents were indexed\n");
+        return false;
+    }
+    // build the filepath of the index file, then add the extension
+    char* indexPath = stringBuilder(NULL, indexFilename);
+    if (indexPath == NULL) return false;
+    char* filepath = count_malloc(strlen(indexPath) + strlen(".docs") + 1);
+    if (filepath == NULL) {
+        count_free(indexPath);
+        return false;
+    }
+    sprintf(filepath, "%s.docs", indexPath);
+    count_free(indexPath);
+
+    bool success = saveDocTable(filepath, index->docs);
+    count_free(filepath);
+    return success;
+}
+
+/************** loadIndexFromFile() ******************/
 // see index.h for description
 index_t* loadIndexFromFile(char* filepath)
 {
@@ -127,8 +297,19 @@ index_t* loadIndexFromFile(char* filepath)
         return NULL;
     }
 
-    // open the index file
+    // a binary index file is only mapped, words are looked up in place
     printf("Reading file %s\n", indexFilePath);
+    if (isIndexMapFile(indexFilePath)) {
+        index->map = loadIndexMap(indexFilePath);
+        count_free(indexFilePath);
+        if (index->map == NULL) {
+            deleteIndex(index);
+            return NULL;
+        }
+        return index;
+    }
+
+    // open the index file
     FILE* fp = fopen(indexFilePath, "r");
     count_free(indexFilePath);
     if (fp != NULL) {
@@ -152,12 +333,28 @@ bool indexWebpage(index_t* index, webpage_t* webpage, int* id)
 {
     if (index == NULL || webpage == NULL || *id < 0) return false;
     // read the words in the file and insert them into the index
-    readWordsInWebpage(webpage, index, id);
+    int docID = *id;
+    int numWords = readWordsInWebpage(webpage, index, id);
+
+    // remember the page's metadata so the querier never has to open its file
+    if (index->docs == NULL) index->docs = newDocTable();
+    char* html = webpage_getHTML(webpage);
+    if (!docTableSet(index->docs, docID, webpage_getURL(webpage), webpage_getDepth(webpage),
+                     html == NULL ? 0 : strlen(html), numWords)) {
+        fprintf(stderr, "Error: could not record document %d\n", docID);
+    }
     // delete the webpage and its inner hashtable
     webpage_delete(webpage);
     return true;
 }
 
+/************** getDocTable() ******************/
+// see index.h for description
+docTable_t* getDocTable(index_t* index)
+{
+    return index == NULL ? NULL : index->docs;
+}
+
 /************** getHashtable() ******************/
 // see index.h for description
 hashtable_t* getHashtable(index_t* index)
@@ -169,6 +366,60 @@ hashtable_t* getHashtable(index_t* index)
     }
 }
 
+/************** findWordCounters() ******************/
+// see index.h for description
+counters_t* findWordCounters(index_t* index, const char* word)
+{
+    if (index == NULL || word == NULL) return NULL;
+    // in-memory indexes and already-looked-up words are in the hashtable
+    counters_t* wordCounter = hashtable_find(index->table, word);
+    if (wordCounter != NULL || (index->map == NULL && !index->merged)) return wordCounter;
+
+    // otherwise copy the word's mapped or merged postings into a counterset and cache it
+    int numPostings;
+    const posting_t* postings = findWordPostings(index, word, &numPostings);
+    if (postings == NULL) return NULL;
+    wordCounter = counters_new();
+    if (wordCounter == NULL) return NULL;
+    for (int i = 0; i < numPostings; i++) {
+        counters_set(wordCounter, postings[i].docID, postings[i].count);
+    }
+    hashtable_insert(index->table, word, wordCounter);
+    return wordCounter;
+}
+
+/************** findWordPostings() ******************/
+// see index.h for description
+const posting_t* findWordPostings(index_t* index, const char* word, int* numPostings)
+{
+    if (numPostings != NULL) *numPostings = 0;
+    if (index == NULL || word == NULL || numPostings == NULL) return NULL;
+    // a mapped index already stores its postings sorted
+    if (index->map != NULL) return findInIndexMap(index->map, word, numPostings);
+
+    // a merged index keeps every word's postings sorted, and otherwise
+    // look for a sorted copy made by an earlier lookup
+    if (index->postings == NULL && (index->postings = hashtable_new(200)) == NULL) return NULL;
+    postingList_t* list = hashtable_find(index->postings, word);
+    if (list != NULL) {
+        *numPostings = list->numPostings;
+        return list->postings;
+    }
+    if (index->merged) return NULL;
+
+    // copy the word's counterset into a sorted list
+    counters_t* wordCounter = hashtable_find(index->table, word);
+    if (wordCounter == NULL) return NULL;
+    list = newPostingList(wordCounter);
+    if (list == NULL) return NULL;
+    if (!hashtable_insert(index->postings, word, list)) {
+        deletePostingList(list);
+        return NULL;
+    }
+    *numPostings = list->numPostings;
+    return list->postings;
+}
+
 /************** loadWordInIndex() ******************/
 /*
  * adds a word to the index from the index file
@@ -203,46 +454,170 @@ static void loadWordInIndex(index_t* index, char* word, FILE* fp)
 
 /************** readWordsInWebpage() ******************/
 /*
- * increments through every word in the file and inserts it into the index
+ * increments through every word in the file and inserts it into the index,
+ * returning the number of words inserted
  *
  * Pseudocode:
- *      1. loop over all of the words
- *      2. make the word lowercase
- *      3. check if the word already exists in the index
+ *      1. loop over all of the words of at least 3 letters, which the
+ *          tokenizer lowercases into its own buffer and hashes
+ *      2. count each word in the page's table of distinct words, which
+ *          copies a word only the first time it is seen on the page
+ *      3. then, for each distinct word, check if it already exists in the index
  *      4. if it doesn't create an entry with a counterset as the item
  *      5. if it does, load that counterset
- *      6. insert the id into that counterset
+ *      6. set the id's count in that counterset to the word's count
+ *
+ * Nothing is allocated per word: the tokenizer and table keep their memory
+ * from page to page, and the index is only looked up once per distinct word
 */
-static void readWordsInWebpage(webpage_t* page, index_t* index, int* id)
+static int readWordsInWebpage(webpage_t* page, index_t* index, int* id)
 {
-    if (page == NULL || index == NULL || *id < 0) return;
+    if (page == NULL || index == NULL || *id < 0) return 0;
+    if (index->tokenizer == NULL) index->tokenizer = newWordTokenizer();
+    if (index->terms == NULL) index->terms = newPageTerms();
+    pageTerms_t* terms = index->terms;
+    if (index->tokenizer == NULL || terms == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        (*id)++;
+        return 0;
+    }
 
+    // count every WORD in the webpage
+    int numWords = 0;
     int loc = 0;
-    char* word;
-    // read through every WORD in the webpage
-    while ((word = webpage_getNextWord(page, &loc)) != NULL) {
-        // make the word lowercase and check length
-        normalizeWord(word);
-        if (strlen(word) < 3) {
-            count_free(word);
+    wordToken_t token;
+    terms->numTerms = 0;
+    terms->poolLength = 0;
+    memset(terms->slots, 0, terms->numSlots * sizeof(int));
+    while (nextWordToken(index->tokenizer, page, &loc, &token)) {
+        if (addPageTerm(terms, &token)) numWords++;
+    }
+
+    // add the counts to the index, in the order the words first appeared
+    for (int i = 0; i < terms->numTerms; i++) {
+        char* word = terms->pool + terms->terms[i].offset;
+        if (index->merged) {
+            addMergedPosting(index, word, *id, terms->terms[i].count);
             continue;
         }
-        // check if the item exists in the index
-        void* item = hashtable_find(index->table, word);
-        if (item == NULL) {
-            // if it doesn't create an entry for the word in the index and insert the id
-            counters_t* wordCounter = counters_new();
-            counters_add(wordCounter, *id);
-            hashtable_insert(index->table, word, wordCounter);
-        } else {
-            // if it already exists, add the id to the counters
-            counters_t* wordCounter = (counters_t*) item;
-            counters_add(wordCounter, *id);
+        counters_t* wordCounter = hashtable_find(index->table, word);
+        if (wordCounter == NULL) {
+            // if it doesn't create an entry for the word in the index
+            wordCounter = counters_new();
+            if (wordCounter == NULL || !hashtable_insert(index->table, word, wordCounter)) {
+                fprintf(stderr, "Error: could not index %s\n", word);
+                if (wordCounter != NULL) counters_delete(wordCounter);
+                continue;
+            }
         }
-        count_free(word);
+        counters_set(wordCounter, *id, terms->terms[i].count);
     }
     // increment id
     (*id)++;
+    return numWords;
+}
+
+/************** newPageTerms() ******************/
+/* creates an empty table of a page's words, NULL if out of memory */
+static pageTerms_t* newPageTerms(void)
+{
+    pageTerms_t* terms = count_calloc(1, sizeof(pageTerms_t));
+    if (terms == NULL) return NULL;
+    // the arrays grow with realloc, so they are allocated with plain malloc
+    terms->maxTerms = 256;
+    terms->numSlots = 512;
+    terms->poolCapacity = 4096;
+    terms->terms = malloc(terms->maxTerms * sizeof(pageTerm_t));
+    terms->slots = calloc(terms->numSlots, sizeof(int));
+    terms->pool = malloc(terms->poolCapacity);
+    if (terms->terms == NULL || terms->slots == NULL || terms->pool == NULL) {
+        deletePageTerms(terms);
+        return NULL;
+    }
+    return terms;
+}
+
+/************** deletePageTerms() ******************/
+/* frees the table and its arrays */
+static void deletePageTerms(pageTerms_t* terms)
+{
+    if (terms == NULL) return;
+    free(terms->terms);
+    free(terms->slots);
+    free(terms->pool);
+    count_free(terms);
+}
+
+/************** addPageTerm() ******************/
+/* Counts a word in the page's table
+ *
+ * Pseudocode:
+ *      1. probe the slots from the word's hash until an empty slot or a
+ *          term with the same hash and letters; if found, count it again
+ *      2. otherwise, doubling whichever arrays are full, copy the word to
+ *          the pool and add a term with a count of 1 in the empty slot
+ *
+ * returns false if out of memory
+*/
+static bool addPageTerm(pageTerms_t* terms, const wordToken_t* token)
+{
+    int mask = terms->numSlots - 1;
+    int slot = token->hash & mask;
+    for (; terms->slots[slot] != 0; slot = (slot + 1) & mask) {
+        pageTerm_t* term = &terms->terms[terms->slots[slot] - 1];
+        if (term->hash == token->hash && term->length == token->length
+            && memcmp(terms->pool + term->offset, token->word, token->length) == 0) {
+            term->count++;
+            return true;
+        }
+    }
+
+    // make room for a new term, growing the slots along with the terms
+    if (terms->numTerms == terms->maxTerms) {
+        int maxTerms = terms->maxTerms * 2;
+        int numSlots = terms->numSlots * 2;
+        pageTerm_t* bigger = realloc(terms->terms, maxTerms * sizeof(pageTerm_t));
+        int* slots = calloc(numSlots, sizeof(int));
+        if (bigger != NULL) terms->terms = bigger;
+        if (bigger == NULL || slots == NULL) {
+            free(slots);
+            fprintf(stderr, "Error: out of memory\n");
+            return false;
+        }
+        // rehash the terms into the bigger table
+        free(terms->slots);
+        terms->slots = slots;
+        terms->maxTerms = maxTerms;
+        terms->numSlots = numSlots;
+        mask = numSlots - 1;
+        for (int i = 0; i < terms->numTerms; i++) {
+            for (slot = terms->terms[i].hash & mask; slots[slot] != 0; slot = (slot + 1) & mask);
+            slots[slot] = i + 1;
+        }
+        for (slot = token->hash & mask; slots[slot] != 0; slot = (slot + 1) & mask);
+    }
+    if (terms->poolLength + token->length + 1 > terms->poolCapacity) {
+        size_t capacity = terms->poolCapacity;
+        while (terms->poolLength + token->length + 1 > capacity) capacity *= 2;
+        char* pool = realloc(terms->pool, capacity);
+        if (pool == NULL) {
+            fprintf(stderr, "Error: out of memory\n");
+            return false;
+        }
+        terms->pool = pool;
+        terms->poolCapacity = capacity;
+    }
+
+    // copy the word, with its '\0', after the others
+    pageTerm_t* term = &terms->terms[terms->numTerms];
+    term->hash = token->hash;
+    term->offset = terms->poolLength;
+    term->length = token->length;
+    term->count = 1;
+    memcpy(terms->pool + terms->poolLength, token->word, token->length + 1);
+    terms->poolLength += token->length + 1;
+    terms->slots[slot] = ++terms->numTerms;
+    return true;
 }
 
 /************** printCT() ******************/
@@ -285,6 +660,223 @@ static void printCTHelper(void* arg, const int key, const int count)
     }
 }
 
+/************** printPostings() ******************/
+/* prints a word of a mapped index in the same format as printCT */
+static void printPostings(void* arg, const char* word, const posting_t* postings, int numPostings)
+{
+    if (arg == NULL || word == NULL || postings == NULL) return;
+    FILE* fp = (FILE*) arg;
+    fprintf(fp, "%s ", word);
+    for (int i = 0; i < numPostings; i++) {
+        fprintf(fp, "%d %d ", postings[i].docID, postings[i].count);
+    }
+    fprintf(fp, "\n");
+}
+
+/************** addMergedPosting() ******************/
+/* adds a page's count of a word to a merged index: to the end of the word's posting list,
+ * and to its counterset too if the word was looked up as one
+*/
+static void addMergedPosting(index_t* index, const char* word, const int id, const int count)
+{
+    posting_t posting = { id, count };
+    postingList_t page = { &posting, 1, 1 };
+    postingList_t* list = hashtable_find(index->postings, word);
+    if (list == NULL) {
+        // a new word starts out with an empty list
+        list = count_calloc(1, sizeof(postingList_t));
+        if (list == NULL || !appendPostings(list, &page)
+            || !hashtable_insert(index->postings, word, list)) {
+            fprintf(stderr, "Error: could not index %s\n", word);
+            if (list != NULL) deletePostingList(list);
+            return;
+        }
+    } else if (!appendPostings(list, &page)) {
+        fprintf(stderr, "Error: could not index %s\n", word);
+        return;
+    }
+    counters_t* wordCounter = hashtable_find(index->table, word);
+    if (wordCounter != NULL) counters_set(wordCounter, id, count);
+}
+
+/************** newPostingList() ******************/
+/* copies a counterset into a new posting list sorted by docID, NULL if out of memory */
+static postingList_t* newPostingList(counters_t* ctrs)
+{
+    postingList_t* list = count_malloc(sizeof(postingList_t));
+    if (list == NULL) return NULL;
+    list->numPostings = 0;
+    counters_iterate(ctrs, &list->numPostings, countPostings);
+    // the array grows with realloc when lists are merged, so it is allocated with plain malloc
+    list->maxPostings = list->numPostings;
+    list->postings = malloc((list->maxPostings + 1) * sizeof(posting_t));
+    if (list->postings == NULL) {
+        count_free(list);
+        return NULL;
+    }
+    posting_t* next = list->postings;
+    counters_iterate(ctrs, &next, fillPostings);
+    qsort(list->postings, list->numPostings, sizeof(posting_t), comparePostings);
+    return list;
+}
+
+/************** appendPostings() ******************/
+/* Adds the postings of another sorted list to a sorted list
+ *
+ * Pseudocode:
+ *      1. make room for them, at least doubling the array so that
+ *          appending many lists one after another takes linear time
+ *      2. if they all come after the list's last docID, copy them to the end
+ *      3. otherwise merge the two from the back, so no posting of the
+ *          list is overwritten before it is moved
+ *
+ * returns false if out of memory, leaving the list as it was
+*/
+static bool appendPostings(postingList_t* list, const postingList_t* more)
+{
+    if (more->numPostings == 0) return true;
+    int total = list->numPostings + more->numPostings;
+    if (total > list->maxPostings) {
+        int maxPostings = list->maxPostings * 2 > total ? list->maxPostings * 2 : total;
+        posting_t* postings = realloc(list->postings, maxPostings * sizeof(posting_t));
+        if (postings == NULL) return false;
+        list->postings = postings;
+        list->maxPostings = maxPostings;
+    }
+
+    posting_t* to = list->postings;
+    int i = list->numPostings - 1;
+    if (i < 0 || to[i].docID < more->postings[0].docID) {
+        memcpy(to + list->numPostings, more->postings, more->numPostings * sizeof(posting_t));
+    } else {
+        int j = more->numPostings - 1;
+        for (int k = total - 1; j >= 0; k--) {
+            if (i >= 0 && to[i].docID > more->postings[j].docID) to[k] = to[i--];
+            else to[k] = more->postings[j--];
+        }
+    }
+    list->numPostings = total;
+    return true;
+}
+
+/************** flattenIndex() ******************/
+/* Turns an in-memory index into a merged one, whose words are in sorted posting lists
+ *
+ * Pseudocode:
+ *      1. copy each word's counterset into a sorted posting list, unless
+ *          an earlier lookup already has
+ *      2. replace the countersets with an empty hashtable, which from then
+ *          on caches the words looked up as countersets
+ *
+ * returns false if out of memory, leaving the words in the countersets
+*/
+static bool flattenIndex(index_t* index)
+{
+    hashtable_t* cache = hashtable_new(200);
+    if (cache == NULL) return false;
+    if (index->postings == NULL && (index->postings = hashtable_new(index->tableSize)) == NULL) {
+        hashtable_delete(cache, NULL);
+        return false;
+    }
+    listTable_t flat = { index->postings, true };
+    hashtable_iterate(index->table, &flat, flattenCT);
+    if (!flat.success) {
+        hashtable_delete(cache, NULL);
+        return false;
+    }
+    hashtable_delete(index->table, deleteCT);
+    index->table = cache;
+    index->merged = true;
+    return true;
+}
+
+/************** flattenCT() ******************/
+/* a helper that copies one word's counterset into a posting list of the listTable (arg) */
+static void flattenCT(void* arg, const char* key, void* item)
+{
+    listTable_t* flat = arg;
+    if (hashtable_find(flat->lists, key) != NULL) return;
+    postingList_t* list = newPostingList(item);
+    if (list == NULL || !hashtable_insert(flat->lists, key, list)) {
+        if (list != NULL) deletePostingList(list);
+        flat->success = false;
+    }
+}
+
+/************** mergeList() ******************/
+/* moves one word's posting list from the source index into the listTable (arg) of the target */
+static void mergeList(void* arg, const char* key, void* item)
+{
+    listTable_t* merged = arg;
+    postingList_t* more = item;
+    postingList_t* list = hashtable_find(merged->lists, key);
+    if (list != NULL) {
+        // a known word: append the source's postings
+        if (!appendPostings(list, more)) merged->success = false;
+        return;
+    }
+    // a new word: the target takes over the source's array, leaving the source's list empty
+    list = count_malloc(sizeof(postingList_t));
+    if (list == NULL) {
+        merged->success = false;
+        return;
+    }
+    *list = *more;
+    if (!hashtable_insert(merged->lists, key, list)) {
+        count_free(list);
+        merged->success = false;
+        return;
+    }
+    more->postings = NULL;
+    more->numPostings = 0;
+    more->maxPostings = 0;
+}
+
+/************** printList() ******************/
+/* prints a word of a merged index in the same format as printCT */
+static void printList(void* arg, const char* key, void* item)
+{
+    postingList_t* list = item;
+    if (list != NULL) printPostings(arg, key, list->postings, list->numPostings);
+}
+
+/************** countPostings() ******************/
+/* a helper that counts the (id, count) pairs of a counterset */
+static void countPostings(void* arg, const int key, const int count)
+{
+    int* numPostings = arg;
+    (*numPostings)++;
+}
+
+/************** fillPostings() ******************/
+/* a helper that copies an (id, count) pair into the next slot of a posting array */
+static void fillPostings(void* arg, const int key, const int count)
+{
+    posting_t** next = arg;
+    (*next)->docID = key;
+    (*next)->count = count;
+    (*next)++;
+}
+
+/************** comparePostings() ******************/
+/* qsort comparator that orders postings by ascending docID */
+static int comparePostings(const void* a, const void* b)
+{
+    const posting_t* p1 = a;
+    const posting_t* p2 = b;
+    return (p1->docID > p2->docID) - (p1->docID < p2->docID);
+}
+
+/************** deletePostingList() ******************/
+/* a helper function to help the hashtable delete its posting lists */
+static void deletePostingList(void* item)
+{
+    postingList_t* list = item;
+    if (list == NULL) return;
+    free(list->postings);
+    count_free(list);
+}
+
 /************* deleteCT() *************/
 /* a helper function to help the hashtable delete its counter objects */
 static void deleteCT(void* item)
@@ -15,6 +15,9 @@
 #include <stdio.h>
 #include "webpage.h"
 #include "hashtable.h"
+#include "counters.h"
+#include "indexmap.h"
+#include "doctable.h"
 
 /**************** global types ****************/
 typedef struct index index_t; // holds the hashtable used for indexing
@@ -42,6 +45,26 @@ void deleteIndex(index_t* index);
 */
 bool saveIndexToFile(char* filename, index_t* index);
 
+/******************* saveIndexToBinaryFile() ********************/
+/* Function used to save an index hashtable to a binary index file (see indexmap.h)
+ * in the data directory. The text format of saveIndexToFile is unchanged
+ *
+ *  Pseudocode:
+ *      1. build the filepath
+ *      2. write the sorted words, their offsets, and the packed postings
+*/
+bool saveIndexToBinaryFile(char* filename, index_t* index);
+
+/******************* saveDocsToFile() ********************/
+/* Function used to save the metadata of the indexed documents (see doctable.h)
+ * to the file [indexFilename].docs in the data directory, next to the index file
+ *
+ *  Pseudocode:
+ *      1. build the filepath by appending .docs to the index filename
+ *      2. write the document table
+*/
+bool saveDocsToFile(char* indexFilename, index_t* index);
+
 /************** buildIndexFromCrawler() ******************/
 /* the "testing" function/main function, which takes two arguments 
  * as inputs (other than the executable call), the directory containing the
@@ -50,10 +73,41 @@ bool saveIndexToFile(char* filename, index_t* index);
  * Pseudocode:
  *      1. Given the directory, load the webpage
  *      2. Open the file if possible and index the data
- *      3. Continue until the webpage no longer exists
+ *      3. Continue up to the last crawler file (see lastPageID), passing
+ *          over any id the crawler couldn't save a page under
 */
 bool buildIndexFromCrawler(char* pageDir, index_t* index);
 
+/************** buildIndexFromRange() ******************/
+/* indexes only the crawler files firstID through lastID (inclusive) of pageDir,
+ * so several indexes can be built from disjoint ranges at once, passing over
+ * any id the crawler couldn't save a page under.
+ * Returns false if any of the pages could not be indexed
+*/
+bool buildIndexFromRange(char* pageDir, index_t* index, const int firstID, const int lastID);
+
+/************** mergeIndex() ******************/
+/* Moves every posting of the source index into the target index, then deletes the source.
+ * The source is deleted even if this returns false (a NULL or mapped index, or out of
+ * memory), so the caller must not use or delete it afterwards
+ *
+ * Pseudocode:
+ *      1. copy the countersets of both indexes into posting arrays sorted by id,
+ *          unless they have been merged before; the target keeps its words
+ *          in these arrays from then on
+ *      2. for each word of the source, find the word in the target
+ *      3. if the target doesn't have it, hand the source's array over to the target
+ *      4. otherwise append the source's postings to the target's array
+ *      5. copy the source's document table into the target's
+ *      6. delete the source
+ *
+ * Note:
+ *      the ids of the source should all be larger than those of the target,
+ *      so appending keeps each word's postings in ascending order of id and takes
+ *      linear time; otherwise the two arrays of a word are merged by id
+*/
+bool mergeIndex(index_t* target, index_t* source);
+
 /******************* loadIndexFromFile() ********************/
 /* Function used to read an index file and load the data
  * into a hashtable
@@ -61,9 +115,10 @@ bool buildIndexFromCrawler(char* pageDir, index_t* index);
  * Pseudocode:
  *      1. create a new index hashtable
  *      2. build the filepath
- *      3. read the first word of each line and add it to the index
- *      4. scan the file for pairs of ints and add it to the word's counter
- *      5. repeat until the file has been completely read
+ *      3. if it is a binary index file, map it and return without parsing anything
+ *      4. read the first word of each line and add it to the index
+ *      5. scan the file for pairs of ints and add it to the word's counter
+ *      6. repeat until the file has been completely read
 */
 index_t* loadIndexFromFile(char* filepath);
 
@@ -72,12 +127,38 @@ index_t* loadIndexFromFile(char* filepath);
  *
  * Pseudocode:
  *      1. read the words in the file if possible and load the index
- *      2. delete the webpage
+ *      2. record the page's URL, depth, HTML length, and number of words in the document table
+ *      3. delete the webpage
 */
 bool indexWebpage(index_t* index, webpage_t* webpage, int* id);
 
+/******************* findWordCounters() ********************/
+/* returns the counterset (docID -> count) of a word, or NULL if it is not indexed
+ *
+ * For a mapped binary index or a merged index, the word's postings are copied into a counterset
+ * the first time it is looked up. Either way, the counterset belongs to the
+ * index and is freed by deleteIndex()
+*/
+counters_t* findWordCounters(index_t* index, const char* word);
+
+/******************* findWordPostings() ********************/
+/* returns the postings of a word as an array sorted by docID and sets numPostings,
+ * or returns NULL (with numPostings set to 0) if the word is not indexed
+ *
+ * For a mapped binary index, this points straight into the mapped file, and a merged
+ * index already keeps its postings sorted. Otherwise the word's counterset is copied
+ * into a sorted array the first time it is looked up.
+ * Either way, the array belongs to the index and is freed by deleteIndex()
+*/
+const posting_t* findWordPostings(index_t* index, const char* word, int* numPostings);
+
+/******************* getDocTable() ********************/
+/* return the metadata of the documents indexed so far, or NULL if none were */
+docTable_t* getDocTable(index_t* index);
+
 /******************* getHashtable() ********************/
-/* return the index's hashtable */
+/* return the index's hashtable (for a mapped or merged index, only the words
+ * looked up so far with findWordCounters) */
 hashtable_t* getHashtable(index_t* index);
 
 #endif
\ No newline at end of file
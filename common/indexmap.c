@@ -0,0 +1,353 @@
+/*
+ * indexmap.c - library to write and map binary index files
+ *
+ * see indexmap.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L // mmap, fstat
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "indexmap.h"
+#include "hashtable.h"
+#include "counters.h"
+#include "memory.h"
+
+/************* file-local types ****************/
+
+typedef struct indexMapHeader { // the first bytes of a binary index file
+    char magic[8];
+    uint32_t numTerms;
+    uint32_t numPostings;
+    uint32_t stringsSize;
+    uint32_t reserved;
+} indexMapHeader_t;
+
+typedef struct indexMapTerm { // one entry of the sorted dictionary
+    uint32_t wordOffset;    // offset of the word in the string table
+    uint32_t postingsStart; // index of the word's first posting
+    uint32_t numPostings;   // number of postings of the word
+} indexMapTerm_t;
+
+typedef struct indexMap {
+    void* base;                     // start of the mapping
+    size_t size;                    // length of the mapping
+    const indexMapTerm_t* terms;    // the sorted dictionary
+    const posting_t* postings;      // the packed postings
+    const char* strings;            // the string table
+    uint32_t numTerms;
+    uint32_t numPostings;
+    uint32_t stringsSize;
+} indexMap_t;
+
+typedef struct termList { // used to collect the words of a hashtable
+    const char** words;
+    int numTerms;
+} termList_t;
+
+/************* global variables ****************/
+
+static const char MAGIC[8] = {'T', 'S', 'E', 'I', 'N', 'D', 'X', '1'};
+
+/************* local function prototypes ********************/
+
+static void countTerms(void* arg, const char* key, void* item);
+static void collectTerms(void* arg, const char* key, void* item);
+static void countPostings(void* arg, const int key, const int count);
+static void collectPostings(void* arg, const int key, const int count);
+static int compareWords(const void* a, const void* b);
+static int comparePostings(const void* a, const void* b);
+static bool writeIndexMap(char* filepath, hashtable_t* table, const bool lists);
+
+/************** saveIndexMap() ******************/
+// see indexmap.h for description
+bool saveIndexMap(char* filepath, hashtable_t* table)
+{
+    return writeIndexMap(filepath, table, false);
+}
+
+/************** saveIndexMapLists() ******************/
+// see indexmap.h for description
+bool saveIndexMapLists(char* filepath, hashtable_t* table)
+{
+    return writeIndexMap(filepath, table, true);
+}
+
+/************** writeIndexMap() ******************/
+/* writes a hashtable of countersets, or of sorted posting lists if lists is true,
+ * to a binary index file (see saveIndexMap)
+*/
+static bool writeIndexMap(char* filepath, hashtable_t* table, const bool lists)
+{
+    if (filepath == NULL || table == NULL) return false;
+
+    // collect the words and sort them so they can be binary searched
+    int numTerms = 0;
+    hashtable_iterate(table, &numTerms, countTerms);
+    termList_t list;
+    list.words = count_calloc(numTerms + 1, sizeof(char*));
+    list.numTerms = 0;
+    if (list.words == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return false;
+    }
+    hashtable_iterate(table, &list, collectTerms);
+    qsort(list.words, numTerms, sizeof(char*), compareWords);
+
+    // build the dictionary, counting the postings and string table as we go
+    indexMapTerm_t* terms = count_calloc(numTerms + 1, sizeof(indexMapTerm_t));
+    if (terms == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        count_free(list.words);
+        return false;
+    }
+    uint32_t numPostings = 0;
+    uint32_t stringsSize = 0;
+    for (int i = 0; i < numTerms; i++) {
+        int count = 0;
+        void* item = hashtable_find(table, list.words[i]);
+        if (lists) count = ((postingList_t*) item)->numPostings;
+        else counters_iterate(item, &count, countPostings);
+        terms[i].wordOffset = stringsSize;
+        terms[i].postingsStart = numPostings;
+        terms[i].numPostings = count;
+        numPostings += count;
+        stringsSize += strlen(list.words[i]) + 1;
+    }
+
+    FILE* fp = fopen(filepath, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: could not create file %s\n", filepath);
+        count_free(terms);
+        count_free(list.words);
+        return false;
+    }
+
+    // write the header and the dictionary
+    indexMapHeader_t header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.numTerms = numTerms;
+    header.numPostings = numPostings;
+    header.stringsSize = stringsSize;
+    header.reserved = 0;
+    bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (numTerms > 0) {
+        success = success && fwrite(terms, sizeof(indexMapTerm_t), numTerms, fp) == numTerms;
+    }
+
+    // write each word's postings, sorted by docID
+    postingList_t postingList;
+    for (int i = 0; success && i < numTerms; i++) {
+        if (lists) {
+            // already sorted, so written as is
+            postingList_t* sorted = hashtable_find(table, list.words[i]);
+            if (sorted->numPostings > 0) {
+                success = fwrite(sorted->postings, sizeof(posting_t),
+                                 sorted->numPostings, fp) == sorted->numPostings;
+            }
+            continue;
+        }
+        postingList.postings = count_calloc(terms[i].numPostings + 1, sizeof(posting_t));
+        postingList.numPostings = 0;
+        postingList.maxPostings = terms[i].numPostings;
+        if (postingList.postings == NULL) {
+            fprintf(stderr, "Error: out of memory\n");
+            success = false;
+            break;
+        }
+        counters_iterate(hashtable_find(table, list.words[i]), &postingList, collectPostings);
+        qsort(postingList.postings, postingList.numPostings, sizeof(posting_t), comparePostings);
+        if (postingList.numPostings > 0) {
+            success = fwrite(postingList.postings, sizeof(posting_t),
+                             postingList.numPostings, fp) == postingList.numPostings;
+        }
+        count_free(postingList.postings);
+    }
+
+    // write the string table
+    for (int i = 0; success && i < numTerms; i++) {
+        success = fwrite(list.words[i], strlen(list.words[i]) + 1, 1, fp) == 1;
+    }
+
+    if (fclose(fp) != 0) success = false;
+    count_free(terms);
+    count_free(list.words);
+    return success;
+}
+
+/************** loadIndexMap() ******************/
+// see indexmap.h for description
+indexMap_t* loadIndexMap(char* filepath)
+{
+    if (filepath == NULL) return NULL;
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(indexMapHeader_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    // map the whole file; the mapping stays valid after the descriptor is closed
+    size_t size = info.st_size;
+    void* base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    // validate the header against the size of the file
+    const indexMapHeader_t* header = base;
+    size_t expected = sizeof(indexMapHeader_t)
+                    + (size_t) header->numTerms * sizeof(indexMapTerm_t)
+                    + (size_t) header->numPostings * sizeof(posting_t)
+                    + header->stringsSize;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || expected != size) {
+        fprintf(stderr, "Error: %s is not a valid binary index file\n", filepath);
+        munmap(base, size);
+        return NULL;
+    }
+
+    indexMap_t* map = count_malloc(sizeof(indexMap_t));
+    if (map == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        munmap(base, size);
+        return NULL;
+    }
+    map->base = base;
+    map->size = size;
+    map->numTerms = header->numTerms;
+    map->numPostings = header->numPostings;
+    map->stringsSize = header->stringsSize;
+    map->terms = (const indexMapTerm_t*) ((const char*) base + sizeof(indexMapHeader_t));
+    map->postings = (const posting_t*) (map->terms + map->numTerms);
+    map->strings = (const char*) (map->postings + map->numPostings);
+    return map;
+}
+
+/************** deleteIndexMap() ******************/
+// see indexmap.h for description
+void deleteIndexMap(indexMap_t* map)
+{
+    if (map == NULL) return;
+    munmap(map->base, map->size);
+    count_free(map);
+}
+
+/************** isIndexMapFile() ******************/
+// see indexmap.h for description
+bool isIndexMapFile(char* filepath)
+{
+    if (filepath == NULL) return false;
+    FILE* fp = fopen(filepath, "r");
+    if (fp == NULL) return false;
+    char magic[sizeof(MAGIC)];
+    bool isMap = fread(magic, sizeof(magic), 1, fp) == 1
+                 && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    fclose(fp);
+    return isMap;
+}
+
+/************** findInIndexMap() ******************/
+// see indexmap.h for description
+const posting_t* findInIndexMap(indexMap_t* map, const char* word, int* numPostings)
+{
+    if (numPostings != NULL) *numPostings = 0;
+    if (map == NULL || word == NULL || numPostings == NULL) return NULL;
+
+    // binary search the sorted dictionary
+    uint32_t low = 0;
+    uint32_t high = map->numTerms;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        const indexMapTerm_t* term = &map->terms[mid];
+        if (term->wordOffset >= map->stringsSize) return NULL; // corrupt file
+        int cmp = strcmp(map->strings + term->wordOffset, word);
+        if (cmp == 0) {
+            if (term->postingsStart + term->numPostings > map->numPostings) return NULL;
+            *numPostings = term->numPostings;
+            return &map->postings[term->postingsStart];
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+/************** iterateIndexMap() ******************/
+// see indexmap.h for description
+void iterateIndexMap(indexMap_t* map, void* arg,
+                     void (*itemfunc)(void* arg, const char* word,
+                                      const posting_t* postings, int numPostings))
+{
+    if (map == NULL || itemfunc == NULL) return;
+    for (uint32_t i = 0; i < map->numTerms; i++) {
+        const indexMapTerm_t* term = &map->terms[i];
+        if (term->wordOffset >= map->stringsSize
+            || term->postingsStart + term->numPostings > map->numPostings) {
+            continue; // skip corrupt entries
+        }
+        (*itemfunc)(arg, map->strings + term->wordOffset,
+                    &map->postings[term->postingsStart], term->numPostings);
+    }
+}
+
+/************** countTerms() ******************/
+/* helper that counts the number of words in the hashtable */
+static void countTerms(void* arg, const char* key, void* item)
+{
+    int* numTerms = arg;
+    (*numTerms)++;
+}
+
+/************** collectTerms() ******************/
+/* helper that adds each word of the hashtable to the term list */
+static void collectTerms(void* arg, const char* key, void* item)
+{
+    termList_t* list = arg;
+    list->words[list->numTerms] = key;
+    list->numTerms++;
+}
+
+/************** countPostings() ******************/
+/* helper that counts the number of items in a counterset */
+static void countPostings(void* arg, const int key, const int count)
+{
+    int* numPostings = arg;
+    (*numPostings)++;
+}
+
+/************** collectPostings() ******************/
+/* helper that adds each (key, count) of a counterset to the posting list */
+static void collectPostings(void* arg, const int key, const int count)
+{
+    postingList_t* list = arg;
+    list->postings[list->numPostings].docID = key;
+    list->postings[list->numPostings].count = count;
+    list->numPostings++;
+}
+
+/************** compareWords() ******************/
+/* qsort comparator for an array of strings */
+static int compareWords(const void* a, const void* b)
+{
+    return strcmp(*(const char**) a, *(const char**) b);
+}
+
+/************** comparePostings() ******************/
+/* qsort comparator that orders postings by docID */
+static int comparePostings(const void* a, const void* b)
+{
+    const posting_t* p1 = a;
+    const posting_t* p2 = b;
+    return (p1->docID > p2->docID) - (p1->docID < p2->docID);
+}
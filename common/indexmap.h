@@ -0,0 +1,91 @@
+/*
+ * indexmap.h - header file for CS50 'indexmap' file in 'common' module
+ *
+ * provides a binary, memory-mappable format for index files. The file holds a
+ * sorted dictionary of words, the offset of each word's postings, and one packed
+ * array of (docID, count) postings sorted by docID within each word. Loading
+ * the file only maps it into memory, so nothing is parsed or allocated per word.
+ *
+ * Layout:
+ *      header      magic "TSEINDX1", number of words, number of postings, string table size
+ *      words       one (string offset, first posting, number of postings) entry per word, sorted
+ *      postings    (docID, count) pairs, grouped by word
+ *      strings     the '\0'-terminated words themselves
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __INDEX_MAP
+#define __INDEX_MAP
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hashtable.h"
+
+/**************** global types ****************/
+typedef struct indexMap indexMap_t; // a binary index file mapped into memory
+
+typedef struct posting { // a single (docID, count) pair of a word's postings
+    int32_t docID;
+    int32_t count;
+} posting_t;
+
+typedef struct postingList { // a word's postings in one array, sorted by docID
+    posting_t* postings;
+    int numPostings;
+    int maxPostings;        // the number of postings there is room for
+} postingList_t;
+
+/******************* functions *******************/
+
+/******************* saveIndexMap() ********************/
+/* Function used to write an index hashtable (word -> counters) to a binary
+ * index file at the given filepath
+ *
+ *  Pseudocode:
+ *      1. collect the words of the hashtable and sort them
+ *      2. collect each word's counters into postings sorted by docID
+ *      3. write the header, the word entries, the postings, and the strings
+*/
+bool saveIndexMap(char* filepath, hashtable_t* table);
+
+/******************* saveIndexMapLists() ********************/
+/* Function used to write a hashtable of posting lists (word -> postingList_t,
+ * each already sorted by docID) to a binary index file, the same as saveIndexMap
+*/
+bool saveIndexMapLists(char* filepath, hashtable_t* table);
+
+/******************* loadIndexMap() ********************/
+/* Function used to map a binary index file into memory
+ *
+ * returns NULL if the file can't be opened or isn't a valid binary index file.
+ * The caller must later call deleteIndexMap()
+*/
+indexMap_t* loadIndexMap(char* filepath);
+
+/******************* deleteIndexMap() ********************/
+/* unmaps the file and frees the struct */
+void deleteIndexMap(indexMap_t* map);
+
+/******************* isIndexMapFile() ********************/
+/* returns true if the file at the filepath starts with the binary index magic */
+bool isIndexMapFile(char* filepath);
+
+/******************* findInIndexMap() ********************/
+/* Binary searches the dictionary for a word
+ *
+ * returns a pointer into the mapped postings of that word and sets numPostings,
+ * or returns NULL (with numPostings set to 0) if the word is not in the index.
+ * The postings are sorted by docID and are only valid until deleteIndexMap()
+*/
+const posting_t* findInIndexMap(indexMap_t* map, const char* word, int* numPostings);
+
+/******************* iterateIndexMap() ********************/
+/* calls itemfunc once for each word in the map, in sorted order, with
+ * (arg, word, postings, numPostings)
+*/
+void iterateIndexMap(indexMap_t* map, void* arg,
+                     void (*itemfunc)(void* arg, const char* word,
+                                      const posting_t* postings, int numPostings));
+
+#endif
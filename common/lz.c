@@ -0,0 +1,396 @@
+/*
+ * lz.c - fast LZ77 block compression, with optional dictionaries
+ *
+ * see lz.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+#include "memory.h"
+
+/************* file-local types ****************/
+
+typedef struct lzDict {
+    char* data;             // the dictionary
+    size_t length;          // its length, at most LZ_MAX_DICT
+    uint32_t* table;        // the hash table of its 4-byte strings, as lzCompress() starts one
+} lzDict_t;
+
+typedef struct lzWriter { // where lzCompress() is writing
+    unsigned char* out;
+    size_t size;
+    size_t capacity;
+} lzWriter_t;
+
+typedef struct trainLine { // a line of a sample, while training a dictionary
+    uint64_t hash;
+    const char* start;
+    size_t length;
+    int sample;             // the sample it is in
+    size_t score;           // the bytes it would save, once counted
+} trainLine_t;
+
+/************* global variables ****************/
+
+#define HASH_LOG 14                     // the hash table has 2^14 entries
+static const size_t MIN_MATCH = 4;      // shortest match
+static const size_t LAST_LITERALS = 5;  // the last bytes of a block are always literals
+static const size_t MAX_OFFSET = 65535; // furthest back a match may start
+static const size_t MIN_LINE = 8;       // shortest line worth putting in a dictionary
+
+/************* local function prototypes ********************/
+
+static uint32_t read32(const unsigned char* p);
+static uint32_t hash4(const uint32_t v);
+static size_t matchLength(const unsigned char* a, const unsigned char* b, const unsigned char* limit);
+static bool writeSequence(lzWriter_t* writer, const unsigned char* literals, const size_t numLiterals,
+                          const size_t offset, const size_t length);
+static void writeLength(lzWriter_t* writer, size_t length);
+static bool readLength(const unsigned char* src, const size_t length, size_t* ip, size_t* value);
+static int compareLines(const void* a, const void* b);
+static int compareScores(const void* a, const void* b);
+
+/************** newLZDict() ******************/
+// see lz.h for description
+lzDict_t* newLZDict(const char* dict, const size_t length)
+{
+    if (dict == NULL || length == 0) return NULL;
+    lzDict_t* lzDict = count_calloc(1, sizeof(lzDict_t));
+    if (lzDict == NULL) return NULL;
+    // the end of the dictionary is closest to a block, so keep that
+    lzDict->length = length < LZ_MAX_DICT ? length : LZ_MAX_DICT;
+    lzDict->data = count_malloc(lzDict->length);
+    lzDict->table = count_calloc(1 << HASH_LOG, sizeof(uint32_t));
+    if (lzDict->data == NULL || lzDict->table == NULL) {
+        deleteLZDict(lzDict);
+        return NULL;
+    }
+    memcpy(lzDict->data, dict + length - lzDict->length, lzDict->length);
+
+    // index every position once, so each block doesn't have to
+    const unsigned char* data = (const unsigned char*) lzDict->data;
+    for (size_t i = 0; i + MIN_MATCH <= lzDict->length; i++) {
+        lzDict->table[hash4(read32(data + i))] = i + 1;
+    }
+    return lzDict;
+}
+
+/************** deleteLZDict() ******************/
+// see lz.h for description
+void deleteLZDict(lzDict_t* dict)
+{
+    if (dict == NULL) return;
+    if (dict->data != NULL) count_free(dict->data);
+    if (dict->table != NULL) count_free(dict->table);
+    count_free(dict);
+}
+
+/************** lzDictData() ******************/
+// see lz.h for description
+const char* lzDictData(lzDict_t* dict, size_t* length)
+{
+    if (dict == NULL) {
+        if (length != NULL) *length = 0;
+        return NULL;
+    }
+    if (length != NULL) *length = dict->length;
+    return dict->data;
+}
+
+/************** lzBound() ******************/
+// see lz.h for description
+size_t lzBound(const size_t length)
+{
+    return length + length / 255 + 16;
+}
+
+/************** lzCompress() ******************/
+// see lz.h for description
+size_t lzCompress(const char* src, const size_t length, char* dst, const size_t capacity, lzDict_t* dict)
+{
+    if (src == NULL || dst == NULL) return 0;
+    // matches may reach into the dictionary, so put it right before the block
+    size_t dictLength = dict != NULL ? dict->length : 0;
+    unsigned char* buf = (unsigned char*) src;
+    uint32_t* table = count_malloc((1 << HASH_LOG) * sizeof(uint32_t));
+    if (dictLength > 0) buf = count_malloc(dictLength + length);
+    if (table == NULL || buf == NULL) {
+        if (table != NULL) count_free(table);
+        if (buf != NULL && buf != (unsigned char*) src) count_free(buf);
+        return 0;
+    }
+    if (dictLength > 0) {
+        memcpy(buf, dict->data, dictLength);
+        memcpy(buf + dictLength, src, length);
+        memcpy(table, dict->table, (1 << HASH_LOG) * sizeof(uint32_t));
+    } else {
+        memset(table, 0, (1 << HASH_LOG) * sizeof(uint32_t));
+    }
+
+    // the table holds position + 1 of the last time each hash was seen, 0 for never
+    lzWriter_t writer = { (unsigned char*) dst, 0, capacity };
+    size_t end = dictLength + length;
+    size_t ip = dictLength, anchor = dictLength;
+    bool fits = true;
+    if (length >= MIN_MATCH + LAST_LITERALS) {
+        size_t limit = end - LAST_LITERALS;
+        size_t misses = 0;
+        while (fits && ip + MIN_MATCH <= limit) {
+            uint32_t sequence = read32(buf + ip);
+            uint32_t h = hash4(sequence);
+            size_t ref = table[h];
+            table[h] = ip + 1;
+            if (ref == 0 || ip - (ref - 1) > MAX_OFFSET || read32(buf + ref - 1) != sequence) {
+                // skip ahead faster through bytes that don't compress
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            ref--;
+            size_t matched = MIN_MATCH + matchLength(buf + ip + MIN_MATCH, buf + ref + MIN_MATCH, buf + limit);
+            // the match may start before where it was found
+            while (ip > anchor && ref > 0 && buf[ip - 1] == buf[ref - 1]) {
+                ip--;
+                ref--;
+                matched++;
+            }
+            fits = writeSequence(&writer, buf + anchor, ip - anchor, ip - ref, matched);
+            ip += matched;
+            anchor = ip;
+            misses = 0;
+            // index a position inside the match too, for the next one
+            table[hash4(read32(buf + ip - 2))] = ip - 2 + 1;
+        }
+    }
+    fits = fits && writeSequence(&writer, buf + anchor, end - anchor, 0, 0);
+
+    count_free(table);
+    if (buf != (unsigned char*) src) count_free(buf);
+    return fits ? writer.size : 0;
+}
+
+/************** lzDecompress() ******************/
+// see lz.h for description
+bool lzDecompress(const char* src, const size_t length, char* dst, const size_t rawLength, lzDict_t* dict)
+{
+    if (src == NULL || dst == NULL) return false;
+    const unsigned char* in = (const unsigned char*) src;
+    const char* dictData = dict != NULL ? dict->data : NULL;
+    size_t dictLength = dict != NULL ? dict->length : 0;
+    size_t ip = 0, op = 0;
+    while (ip < length) {
+        // the literals
+        unsigned token = in[ip++];
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !readLength(in, length, &ip, &numLiterals)) return false;
+        if (numLiterals > length - ip || numLiterals > rawLength - op) return false;
+        memcpy(dst + op, in + ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+        if (ip == length) return op == rawLength; // the last sequence has no match
+
+        // the match
+        if (length - ip < 2) return false;
+        size_t offset = in[ip] | (in[ip + 1] << 8);
+        ip += 2;
+        size_t matchLen = token & 15;
+        if (matchLen == 15 && !readLength(in, length, &ip, &matchLen)) return false;
+        matchLen += MIN_MATCH;
+        if (offset == 0 || matchLen > rawLength - op) return false;
+        if (offset > op) {
+            // it starts in the dictionary, and may run on into the block
+            size_t back = offset - op;
+            if (back > dictLength) return false;
+            size_t fromDict = back < matchLen ? back : matchLen;
+            memcpy(dst + op, dictData + dictLength - back, fromDict);
+            op += fromDict;
+            matchLen -= fromDict;
+        }
+        if (offset >= matchLen) {
+            memcpy(dst + op, dst + op - offset, matchLen);
+        } else {
+            // the match overlaps the bytes it is making, so copy one by one
+            for (size_t i = 0; i < matchLen; i++) dst[op + i] = dst[op + i - offset];
+        }
+        op += matchLen;
+    }
+    return false;
+}
+
+/************** lzTrainDictionary() ******************/
+// see lz.h for description
+size_t lzTrainDictionary(const char** samples, const size_t* lengths, const int numSamples,
+                         char* dict, const size_t capacity)
+{
+    if (samples == NULL || lengths == NULL || dict == NULL || numSamples < 2) return 0;
+    // count the lines, then collect them with their hashes
+    size_t numLines = 0;
+    for (int s = 0; s < numSamples; s++) {
+        for (size_t i = 0; i < lengths[s]; i++) {
+            if (samples[s][i] == '\n') numLines++;
+        }
+        numLines++;
+    }
+    trainLine_t* lines = count_malloc(numLines * sizeof(trainLine_t));
+    if (lines == NULL) return 0;
+    numLines = 0;
+    for (int s = 0; s < numSamples; s++) {
+        size_t start = 0;
+        for (size_t i = 0; i <= lengths[s]; i++) {
+            if (i < lengths[s] && samples[s][i] != '\n') continue;
+            size_t end = i < lengths[s] ? i + 1 : i; // with its newline
+            if (end - start >= MIN_LINE && end - start <= capacity) {
+                uint64_t hash = 14695981039346656037ULL;
+                for (size_t j = start; j < end; j++) {
+                    hash ^= (unsigned char) samples[s][j];
+                    hash *= 1099511628211ULL;
+                }
+                trainLine_t line = { hash, samples[s] + start, end - start, s, 0 };
+                lines[numLines++] = line;
+            }
+            start = i + 1;
+        }
+    }
+
+    // group the same lines, keeping one of each shared by at least two samples
+    qsort(lines, numLines, sizeof(trainLine_t), compareLines);
+    size_t numShared = 0;
+    for (size_t i = 0; i < numLines; ) {
+        size_t j = i + 1;
+        int numHaving = 1;
+        for (; j < numLines && lines[j].hash == lines[i].hash; j++) {
+            if (lines[j].sample != lines[j - 1].sample) numHaving++;
+        }
+        if (numHaving >= 2) {
+            lines[numShared] = lines[i];
+            lines[numShared++].score = lines[i].length * (numHaving - 1);
+        }
+        i = j;
+    }
+
+    // take the best lines that fit, then write them best last
+    qsort(lines, numShared, sizeof(trainLine_t), compareScores);
+    size_t size = 0, numTaken = 0;
+    for (size_t i = 0; i < numShared; i++) {
+        if (size + lines[i].length > capacity) continue;
+        size += lines[i].length;
+        lines[numTaken++] = lines[i];
+    }
+    size_t at = 0;
+    for (size_t i = numTaken; i > 0; i--) {
+        memcpy(dict + at, lines[i - 1].start, lines[i - 1].length);
+        at += lines[i - 1].length;
+    }
+    count_free(lines);
+    return size;
+}
+
+/************** read32() ******************/
+/* reads 4 bytes, at any alignment */
+static uint32_t read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/************** hash4() ******************/
+/* hashes 4 bytes to HASH_LOG bits (Knuth's multiplicative hash) */
+static uint32_t hash4(const uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+/************** matchLength() ******************/
+/* returns how many bytes from a and b are the same, stopping before a reaches
+ * limit; compares 8 bytes at a time while it can
+*/
+static size_t matchLength(const unsigned char* a, const unsigned char* b, const unsigned char* limit)
+{
+    const unsigned char* start = a;
+    while (a + 8 <= limit) {
+        uint64_t x, y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        if (x != y) return (a - start) + (__builtin_ctzll(x ^ y) >> 3);
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return a - start;
+}
+
+/************** writeSequence() ******************/
+/* writes a sequence of literals and a match of the given length and offset,
+ * or only literals if length is 0; returns false if it doesn't fit
+*/
+static bool writeSequence(lzWriter_t* writer, const unsigned char* literals, const size_t numLiterals,
+                          const size_t offset, const size_t length)
+{
+    size_t most = 1 + numLiterals / 255 + 1 + numLiterals + 2 + length / 255 + 1;
+    if (writer->capacity - writer->size < most) return false;
+    size_t matchCode = length > 0 ? length - MIN_MATCH : 0;
+    unsigned char* token = writer->out + writer->size++;
+    *token = ((numLiterals < 15 ? numLiterals : 15) << 4) | (matchCode < 15 ? matchCode : 15);
+    if (numLiterals >= 15) writeLength(writer, numLiterals - 15);
+    memcpy(writer->out + writer->size, literals, numLiterals);
+    writer->size += numLiterals;
+    if (length > 0) {
+        writer->out[writer->size++] = offset & 0xff;
+        writer->out[writer->size++] = offset >> 8;
+        if (matchCode >= 15) writeLength(writer, matchCode - 15);
+    }
+    return true;
+}
+
+/************** writeLength() ******************/
+/* writes the part of a length past 15, as bytes of 255 and one below 255 */
+static void writeLength(lzWriter_t* writer, size_t length)
+{
+    while (length >= 255) {
+        writer->out[writer->size++] = 255;
+        length -= 255;
+    }
+    writer->out[writer->size++] = length;
+}
+
+/************** readLength() ******************/
+/* adds the length bytes at *ip onto *value, returns false if they run off the end */
+static bool readLength(const unsigned char* src, const size_t length, size_t* ip, size_t* value)
+{
+    unsigned char byte;
+    do {
+        if (*ip >= length) return false;
+        byte = src[(*ip)++];
+        *value += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/************** compareLines() ******************/
+// qsort helper, orders lines by hash, then by sample
+static int compareLines(const void* a, const void* b)
+{
+    const trainLine_t* x = a;
+    const trainLine_t* y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->sample - y->sample;
+}
+
+/************** compareScores() ******************/
+// qsort helper, orders lines from the highest score to the lowest
+static int compareScores(const void* a, const void* b)
+{
+    const trainLine_t* x = a;
+    const trainLine_t* y = b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    return 0;
+}
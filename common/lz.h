@@ -0,0 +1,101 @@
+/*
+ * lz.h - header file for CS50 'lz' file in 'common' module
+ *
+ * provides a fast block compressor for the pages of the page store. It is an
+ * LZ77 codec in the style of LZ4: a block is a run of sequences, each some
+ * literal bytes copied as they are followed by a match, a copy of at least 4
+ * earlier bytes up to 65535 bytes back. Nothing is entropy coded, so it
+ * compresses less than gzip but decompresses at memory speed.
+ *
+ * Layout of a sequence:
+ *      token       one byte, the number of literals in the high 4 bits and the
+ *                  match length minus 4 in the low 4 bits; 15 means more
+ *                  length bytes follow, each added on until one is below 255
+ *      literals    the literal length bytes, then the literals
+ *      match       the offset back as 2 bytes (low byte first), then the match
+ *                  length bytes; the last sequence of a block has no match
+ *
+ * A block may be compressed with a dictionary, bytes that are taken to come
+ * right before it, so even a block's first bytes can be matches. Pages built
+ * from one template share most of their markup, so a dictionary of that
+ * markup, trained from a few pages, lets every page point at it.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __LZ
+#define __LZ
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**************** global types ****************/
+typedef struct lzDict lzDict_t; // a dictionary, ready to compress and decompress with
+
+/**************** global constants ****************/
+#define LZ_MAX_DICT (32 * 1024) // most bytes of dictionary used
+
+/******************* functions *******************/
+
+/******************* newLZDict() ********************/
+/* copies the last LZ_MAX_DICT bytes of a dictionary and indexes them for
+ * lzCompress(), returns NULL if out of memory or length is 0.
+ * The caller must later call deleteLZDict()
+*/
+lzDict_t* newLZDict(const char* dict, const size_t length);
+
+/******************* deleteLZDict() ********************/
+/* frees the dictionary */
+void deleteLZDict(lzDict_t* dict);
+
+/******************* lzDictData() ********************/
+/* returns the bytes of the dictionary and sets *length to their number */
+const char* lzDictData(lzDict_t* dict, size_t* length);
+
+/******************* lzBound() ********************/
+/* returns the most bytes lzCompress() can take for length bytes of input */
+size_t lzBound(const size_t length);
+
+/******************* lzCompress() ********************/
+/* Compresses length bytes of src into dst, with a dictionary or NULL
+ *
+ * Pseudocode:
+ *      1. start a hash table of 4-byte strings, holding where each was last
+ *          seen, from the dictionary's own table or empty
+ *      2. at each position, look its 4 bytes up; if the position found holds
+ *          the same bytes and is at most 65535 back, extend the match as far
+ *          as it goes, write the literals before it and the match, and move past it
+ *      3. otherwise move on, taking bigger steps the longer no match is found
+ *      4. write the bytes left at the end as literals
+ *
+ * returns the compressed size, or 0 if it would be more than capacity
+ * (capacity lzBound(length) is always enough) or on error
+*/
+size_t lzCompress(const char* src, const size_t length, char* dst, const size_t capacity, lzDict_t* dict);
+
+/******************* lzDecompress() ********************/
+/* decompresses a block of length bytes in src, which must decompress to
+ * exactly rawLength bytes, into dst, with the dictionary it was compressed
+ * with or NULL. Returns false if the block is damaged, never reading or
+ * writing out of bounds
+*/
+bool lzDecompress(const char* src, const size_t length, char* dst, const size_t rawLength, lzDict_t* dict);
+
+/******************* lzTrainDictionary() ********************/
+/* Builds a dictionary of the markup a few sample pages share
+ *
+ * Pseudocode:
+ *      1. split each sample into lines, and hash each line
+ *      2. sort the lines by hash, and count how many samples have each one
+ *      3. keep the lines at least two samples have, scored by the bytes
+ *          they'd save, i.e. their length times the samples having them
+ *      4. fill dict with the best ones up to capacity, the best last, since
+ *          bytes at the end of the dictionary are the closest to a block
+ *
+ * returns the number of bytes written to dict, 0 if there is nothing shared
+ * or out of memory
+*/
+size_t lzTrainDictionary(const char** samples, const size_t* lengths, const int numSamples,
+                         char* dict, const size_t capacity);
+
+#endif
@@ -9,12 +9,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "pagedir.h"
+#include "pagestore.h"
 #include "word.h"
 #include "memory.h"
 #include "webpage.h"
 #include "file.h"
 
+/************* global types ****************/
+
+typedef struct openDir { // a directory looked up by pageDirStore(), kept until pageDirCloseStore()
+    char* path;
+    pageStore_t* store;         // its page store, or NULL if it holds one file per page
+    struct openDir* next;
+} openDir_t;
+
+/************* global variables ****************/
+
+static openDir_t* openDirs = NULL;
+static pthread_mutex_t openDirsLock = PTHREAD_MUTEX_INITIALIZER;
+
 /************** validDirectory() ******************/
 // see pagedir.h for description
 bool validDirectory(char* directoryName) 
@@ -87,11 +102,62 @@ bool pageDirValidate(char* pageDir)
         return false;
     }
 }
+/************** countPageFiles() ******************/
+// see pagedir.h for description
+int countPageFiles(char* pageDir)
+{
+    // a directory with a page store counts the pages in its index
+    char* dirPath = stringBuilder(pageDir, "");
+    pageStore_t* store = pageDirStore(dirPath);
+    if (dirPath != NULL) count_free(dirPath);
+    if (store != NULL) return pageStoreCount(store);
+
+    int numFiles = 0;
+    // try to open each file in turn until one is missing
+    while (true) {
+        char* idString = intToString(numFiles + 1);
+        char* filepath = stringBuilder(pageDir, idString);
+        if (idString != NULL) count_free(idString);
+        if (filepath == NULL) return numFiles;
+        FILE* fp = fopen(filepath, "r");
+        count_free(filepath);
+        if (fp == NULL) return numFiles;
+        fclose(fp);
+        numFiles++;
+    }
+}
+
+/************** lastPageID() ******************/
+// see pagedir.h for description
+int lastPageID(char* pageDir)
+{
+    char* dirPath = stringBuilder(pageDir, "");
+    pageStore_t* store = pageDirStore(dirPath);
+    if (dirPath != NULL) count_free(dirPath);
+    if (store != NULL) return pageStoreLastID(store);
+    return countPageFiles(pageDir);
+}
 
 /************** loadPageToWebpage() ******************/
 // see pagedir.h for description
 webpage_t* loadPageToWebpage(char* pageDir, int id) 
 {
+    // a directory with a page store loads the page from its segments
+    char* dirPath = stringBuilder(pageDir, "");
+    pageStore_t* store = pageDirStore(dirPath);
+    if (store != NULL) {
+        printf("Reading page %d of %s\n", id, dirPath);
+        count_free(dirPath);
+        webpage_t* page = pageStoreGet(store, id);
+        if (page != NULL && !IsInternalURL(webpage_getURL(page))) {
+            fprintf(stderr, "Error: URL %s is invalid\n", webpage_getURL(page));
+            webpage_delete(page);
+            return NULL;
+        }
+        return page;
+    }
+    if (dirPath != NULL) count_free(dirPath);
+
     // turn the id int into a string
     char* idString = intToString(id);
     if (idString == NULL) {
@@ -111,21 +177,39 @@ webpage_t* loadPageToWebpage(char* pageDir, int id)
         count_free(filepath);
         // read the first line of the file as the URL
         char* URL = freadlinep(fp);
-        fclose(fp);
+        if (URL == NULL) {
+            fclose(fp);
+            return NULL;
+        }
         // check if it is normalized and internal
         if (!IsInternalURL(URL)) {
             fprintf(stderr, "Error: URL %s is invalid\n", URL);
+            free(URL);
+            fclose(fp);
             return NULL;
         }
+        // read the second line as the depth, then the rest of the file as the HTML
+        int depth;
+        char* html = NULL;
+        if (fscanf(fp, "%d", &depth) == 1 && fgetc(fp) == '\n') {
+            html = freadfilep(fp);
+        } else {
+            depth = 0;
+        }
+        fclose(fp);
+
         // build the webpage
-        webpage_t* page = webpage_new(URL, 0, NULL);
+        webpage_t* page = webpage_new(URL, depth, html);
         if (page == NULL) {
             fprintf(stderr, "Error: could not build webpage %s\n", URL);
+            free(URL);
+            if (html != NULL) free(html);
             return NULL;
         }
-        // fetch the pages HTML
-        if (!webpage_fetch(page)) {
+        // only fall back to fetching the HTML if the crawler file didn't hold any
+        if (html == NULL && !webpage_fetch(page)) {
             fprintf(stderr, "Error: page %s cannot be fetched\n", URL);
+            webpage_delete(page);
             return NULL;
         }
         return page;
@@ -136,6 +220,51 @@ webpage_t* loadPageToWebpage(char* pageDir, int id)
     }
 }
 
+/************** pageDirStore() ******************/
+// see pagedir.h for description
+pageStore_t* pageDirStore(char* dirPath)
+{
+    if (dirPath == NULL) return NULL;
+    pthread_mutex_lock(&openDirsLock);
+    openDir_t* dir = openDirs;
+    while (dir != NULL && strcmp(dir->path, dirPath) != 0) dir = dir->next;
+    if (dir == NULL) {
+        // the first lookup of this directory: open its store, or remember it has none
+        dir = count_malloc(sizeof(openDir_t));
+        char* path = count_malloc(strlen(dirPath) + 1);
+        if (dir == NULL || path == NULL) {
+            if (dir != NULL) count_free(dir);
+            if (path != NULL) count_free(path);
+            pthread_mutex_unlock(&openDirsLock);
+            fprintf(stderr, "Error: out of memory\n");
+            return NULL;
+        }
+        strcpy(path, dirPath);
+        dir->path = path;
+        dir->store = openPageStore(dirPath, false);
+        dir->next = openDirs;
+        openDirs = dir;
+    }
+    pageStore_t* store = dir->store;
+    pthread_mutex_unlock(&openDirsLock);
+    return store;
+}
+
+/************** pageDirCloseStore() ******************/
+// see pagedir.h for description
+void pageDirCloseStore(void)
+{
+    pthread_mutex_lock(&openDirsLock);
+    while (openDirs != NULL) {
+        openDir_t* next = openDirs->next;
+        if (openDirs->store != NULL) deletePageStore(openDirs->store);
+        count_free(openDirs->path);
+        count_free(openDirs);
+        openDirs = next;
+    }
+    pthread_mutex_unlock(&openDirsLock);
+}
+
 /************** stringBuilder() ******************/
 // see pagedir.h for description
 char* stringBuilder(char* pageDir, char* end) 
@@ -11,6 +11,7 @@
 
 #include <stdbool.h>
 #include "webpage.h"
+#include "pagestore.h"
 
 /******************* functions *******************/
 
@@ -39,18 +40,58 @@ bool writeToDirectory(char* filepath, webpage_t* page, int* id);
 */
 bool pageDirValidate(char* pageDir);
 
+/***************** countPageFiles() ***********************/
+/* Counts the crawler files of a pageDirectory, i.e. how many of the pages
+ * 1, 2, 3, ... exist before the first missing one, in its page store if it
+ * has one (see pagestore.h), else as the files 1, 2, 3, ...
+*/
+int countPageFiles(char* pageDir);
+
+/***************** lastPageID() ***********************/
+/* Returns the largest id of a crawler file of a pageDirectory. In a page store,
+ * the pages below it may have gaps, where the crawler couldn't save a page
+ * (see pageStoreLastID), which loadPageToWebpage() returns NULL for; without
+ * one, the files have no gaps, so this is countPageFiles()
+*/
+int lastPageID(char* pageDir);
+
 /***************** loadPageToWebpage() ***********************/
 /* Takes a pageDirectory and an ID, builds the filepath of the corresponding
  * crawler file, and loads the webpage and its HTML from this
  *
  * Pseudocode:
+ *      0. if the directory has a page store, load the page from it instead
  *      1. build the filepath of the crawler file (e.g. ../data/pageDir/1)
- *      2. increment the id
- *      3. try to open the file
- *      4. if the URL is valid, create the webpage, fetch the HTML, and return
+ *      2. try to open the file
+ *      3. read the URL from the first line and the depth from the second
+ *      4. if the URL is valid, create the webpage with the rest of the file as its HTML
+ *      5. only if the file has no saved HTML, fetch it from the web
+ *
+ * Note:
+ *      the indexer never touches the network for a complete crawler directory,
+ *      since writeToDirectory() already saved each page's HTML
 */
 webpage_t* loadPageToWebpage(char* pageDir, int id);
 
+/***************** pageDirStore() ***********************/
+/* Returns the page store of a directory path (like ../data/pageDir/), or NULL
+ * if the directory has none, i.e. holds one file per page
+ *
+ * The first call with a path opens its store, or finds it has none, and later
+ * calls with the same path return that result without touching the disk, so
+ * reading every page of a crawl opens its files only once. Every store stays
+ * open until pageDirCloseStore(), even when other paths are looked up, so
+ * threads reading different directories can't close each other's store
+*/
+pageStore_t* pageDirStore(char* dirPath);
+
+/***************** pageDirCloseStore() ***********************/
+/* closes every store opened by pageDirStore() and forgets the directories
+ * looked up, so a directory given a store since is opened again; must not be
+ * called while a store it returned is still in use
+*/
+void pageDirCloseStore(void);
+
 /***************** stringBuilder() ***********************/
 /* Function used to build the filepath of a file given
  * a directory and a suffix, automatically puts in the data directory
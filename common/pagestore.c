@@ -0,0 +1,620 @@
+/*
+ * pagestore.c - library to save and load crawled pages in segment files
+ *
+ * see pagestore.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L // pread, pwrite, fstat
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "pagestore.h"
+#include "lz.h"
+#include "webpage.h"
+#include "memory.h"
+
+/************* file-local types ****************/
+
+typedef struct pageStoreHeader { // the first bytes of the index file
+    char magic[8];
+    uint32_t segmentBytes;  // PAGESTORE_SEGMENT_BYTES of the crawler that wrote it
+    uint32_t compression;   // a pageStoreCompression_t
+} pageStoreHeader_t;
+
+typedef struct pageStoreEntry { // where the record of one id is
+    uint64_t offset;        // offset of the record in its segment
+    uint32_t segment;       // number of the segment file
+    uint32_t length;        // length of the whole record, 0 if there is none
+} pageStoreEntry_t;
+
+typedef struct pageRecordHeader { // the first bytes of a record
+    char magic[4];
+    uint32_t urlLength;
+    int32_t depth;
+    uint32_t htmlLength;
+} pageRecordHeader_t;
+
+typedef struct pageStore {
+    char* dirPath;          // the directory, ending in '/'
+    bool writable;
+    int indexFd;            // pages.idx
+    int* segmentFds;        // pages.0, pages.1, ..., -1 until first used
+    int fdCapacity;         // the length of segmentFds
+    int numSegments;        // the number of segment files that exist
+    int writeSegment;       // the segment the next record goes in
+    uint64_t writeOffset;   // where in it the next record goes
+    pageStoreCompression_t compression;
+    lzDict_t* dict;         // the dictionary, once there is one; it never changes after
+    char** samples;         // copies of the first pages' HTML, until the dictionary is trained
+    size_t* sampleLengths;
+    int numSamples;         // -1 once done sampling
+    long long htmlBytes;    // HTML saved since the store was opened
+    long long storedBytes;  // the bytes it took in the segments
+    pthread_mutex_t lock;   // guards everything above but the dictionary's bytes
+} pageStore_t;
+
+/************* global variables ****************/
+
+static const char MAGIC[8] = {'T', 'S', 'E', 'P', 'A', 'G', 'E', '1'};
+static const char RECORD_MAGIC[4] = {'P', 'A', 'G', 'E'};
+static const char LZ_MAGIC[4] = {'P', 'A', 'G', 'Z'};
+static const char DICT_MAGIC[4] = {'P', 'A', 'G', 'D'};
+
+/************* local function prototypes ********************/
+
+static pageStore_t* allocStore(const char* dirPath, const bool writable);
+static char* storePath(const char* dirPath, const char* name, const int segment);
+static int segmentFd(pageStore_t* store, const int segment);
+static bool readEntry(pageStore_t* store, const int id, pageStoreEntry_t* entry);
+static bool writeEntry(pageStore_t* store, const int id, const pageStoreEntry_t* entry);
+static int readRecord(pageStore_t* store, const int id, pageStoreEntry_t* entry, pageRecordHeader_t* header,
+                      uint32_t* rawLength);
+static lzDict_t* sampleHTML(pageStore_t* store, const char* html, const size_t length);
+static void trainDict(pageStore_t* store);
+static void freeSamples(pageStore_t* store);
+static lzDict_t* loadDict(const char* dirPath);
+static bool preadAll(int fd, void* buf, size_t length, uint64_t offset);
+static bool pwriteAll(int fd, const void* buf, size_t length, uint64_t offset);
+
+/************** newPageStore() ******************/
+// see pagestore.h for description
+pageStore_t* newPageStore(const char* dirPath, const pageStoreCompression_t compression)
+{
+    if (dirPath == NULL || compression < PAGESTORE_RAW || compression > PAGESTORE_LZ_DICT) return NULL;
+    // remove the old store's segments, so openPageStore() won't find stale ones
+    for (int segment = 0; ; segment++) {
+        char* path = storePath(dirPath, "pages", segment);
+        if (path == NULL) return NULL;
+        int removed = unlink(path);
+        count_free(path);
+        if (removed != 0) break;
+    }
+
+    char* dictPath = storePath(dirPath, "pages.dict", -1);
+    if (dictPath == NULL) return NULL;
+    unlink(dictPath);
+    count_free(dictPath);
+
+    char* indexPath = storePath(dirPath, "pages.idx", -1);
+    if (indexPath == NULL) return NULL;
+    int fd = open(indexPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: could not create page store %s\n", indexPath);
+        count_free(indexPath);
+        return NULL;
+    }
+    count_free(indexPath);
+    pageStoreHeader_t header = {{0}, PAGESTORE_SEGMENT_BYTES, compression};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    if (!pwriteAll(fd, &header, sizeof(header), 0)) {
+        fprintf(stderr, "Error: could not write page store index in %s\n", dirPath);
+        close(fd);
+        return NULL;
+    }
+
+    pageStore_t* store = allocStore(dirPath, true);
+    if (store == NULL) {
+        close(fd);
+        return NULL;
+    }
+    store->indexFd = fd;
+    store->compression = compression;
+    if (compression != PAGESTORE_LZ_DICT) store->numSamples = -1;
+    // create the first segment, so there is always one to append to
+    store->numSegments = 1;
+    if (segmentFd(store, 0) < 0) {
+        deletePageStore(store);
+        return NULL;
+    }
+    return store;
+}
+
+/************** openPageStore() ******************/
+// see pagestore.h for description
+pageStore_t* openPageStore(const char* dirPath, const bool writable)
+{
+    if (dirPath == NULL) return NULL;
+    char* indexPath = storePath(dirPath, "pages.idx", -1);
+    if (indexPath == NULL) return NULL;
+    int fd = open(indexPath, writable ? O_RDWR : O_RDONLY);
+    count_free(indexPath);
+    if (fd < 0) return NULL;
+
+    pageStoreHeader_t header;
+    if (!preadAll(fd, &header, sizeof(header), 0) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+        || header.compression > PAGESTORE_LZ_DICT) {
+        fprintf(stderr, "Error: %spages.idx is not a page store index\n", dirPath);
+        close(fd);
+        return NULL;
+    }
+    pageStore_t* store = allocStore(dirPath, writable);
+    if (store == NULL) {
+        close(fd);
+        return NULL;
+    }
+    store->indexFd = fd;
+    // a dictionary store that has no dictionary yet goes on sampling
+    store->compression = header.compression;
+    store->dict = loadDict(dirPath);
+    if (store->compression != PAGESTORE_LZ_DICT || store->dict != NULL || !writable) store->numSamples = -1;
+
+    // count the segments; new records go at the end of the last one
+    struct stat st;
+    while (true) {
+        char* path = storePath(dirPath, "pages", store->numSegments);
+        if (path == NULL) break;
+        int found = stat(path, &st);
+        count_free(path);
+        if (found != 0) break;
+        store->numSegments++;
+        store->writeSegment = store->numSegments - 1;
+        store->writeOffset = st.st_size;
+    }
+    if (writable && store->numSegments == 0) {
+        store->numSegments = 1;
+        if (segmentFd(store, 0) < 0) {
+            deletePageStore(store);
+            return NULL;
+        }
+    }
+    return store;
+}
+
+/************** deletePageStore() ******************/
+// see pagestore.h for description
+void deletePageStore(pageStore_t* store)
+{
+    if (store == NULL) return;
+    if (store->indexFd >= 0) close(store->indexFd);
+    for (int i = 0; i < store->fdCapacity; i++) {
+        if (store->segmentFds[i] >= 0) close(store->segmentFds[i]);
+    }
+    if (store->segmentFds != NULL) free(store->segmentFds);
+    freeSamples(store);
+    deleteLZDict(store->dict);
+    pthread_mutex_destroy(&store->lock);
+    count_free(store->dirPath);
+    count_free(store);
+}
+
+/************** pageStorePut() ******************/
+// see pagestore.h for description
+bool pageStorePut(pageStore_t* store, const int id, const char* URL, const int depth, const char* html)
+{
+    if (store == NULL || id < 1 || URL == NULL || !store->writable) return false;
+    pageRecordHeader_t header;
+    memcpy(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    header.urlLength = strlen(URL);
+    header.depth = depth;
+    header.htmlLength = html != NULL ? strlen(html) : 0;
+
+    // compress the HTML, keeping it as it is if that doesn't make it smaller
+    uint32_t rawLength = header.htmlLength;
+    const char* body = html;
+    char* compressed = NULL;
+    if (store->compression != PAGESTORE_RAW && rawLength > 0) {
+        lzDict_t* dict = sampleHTML(store, html, rawLength);
+        size_t capacity = lzBound(rawLength);
+        size_t size = (compressed = count_malloc(capacity)) != NULL
+                      ? lzCompress(html, rawLength, compressed, capacity, dict) : 0;
+        if (size > 0 && size + sizeof(rawLength) < rawLength) {
+            memcpy(header.magic, dict != NULL ? DICT_MAGIC : LZ_MAGIC, sizeof(header.magic));
+            header.htmlLength = size;
+            body = compressed;
+        }
+    }
+    size_t prefix = body == html ? 0 : sizeof(rawLength); // the uncompressed length, if compressed
+    uint64_t length = sizeof(header) + prefix + header.urlLength + header.htmlLength;
+
+    // reserve the record's bytes; only this part is done under the lock
+    pthread_mutex_lock(&store->lock);
+    store->htmlBytes += rawLength;
+    store->storedBytes += prefix + header.htmlLength;
+    if (store->writeOffset > 0 && store->writeOffset + length > PAGESTORE_SEGMENT_BYTES) {
+        store->writeSegment++;
+        store->writeOffset = 0;
+        if (store->writeSegment >= store->numSegments) store->numSegments = store->writeSegment + 1;
+    }
+    pageStoreEntry_t entry = {store->writeOffset, store->writeSegment, length};
+    store->writeOffset += length;
+    int fd = segmentFd(store, entry.segment);
+    pthread_mutex_unlock(&store->lock);
+
+    // the record first, so the entry never points at a partial one
+    uint64_t offset = entry.offset + sizeof(header);
+    bool saved = fd >= 0
+                 && pwriteAll(fd, &header, sizeof(header), entry.offset)
+                 && pwriteAll(fd, &rawLength, prefix, offset)
+                 && pwriteAll(fd, URL, header.urlLength, offset + prefix)
+                 && pwriteAll(fd, body, header.htmlLength, offset + prefix + header.urlLength)
+                 && writeEntry(store, id, &entry);
+    if (compressed != NULL) count_free(compressed);
+    if (!saved) {
+        fprintf(stderr, "Error: could not save page %d in %spages.%u\n", id, store->dirPath, entry.segment);
+    }
+    return saved;
+}
+
+/************** pageStoreGet() ******************/
+// see pagestore.h for description
+webpage_t* pageStoreGet(pageStore_t* store, const int id)
+{
+    pageStoreEntry_t entry;
+    pageRecordHeader_t header;
+    uint32_t rawLength;
+    int fd = readRecord(store, id, &entry, &header, &rawLength);
+    if (fd < 0) return NULL;
+
+    // webpage_delete() frees the strings with free(), so use plain malloc
+    bool isCompressed = memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0;
+    size_t prefix = isCompressed ? sizeof(rawLength) : 0;
+    char* URL = malloc(header.urlLength + 1);
+    char* html = malloc(rawLength + 1);
+    char* body = isCompressed ? count_malloc(header.htmlLength) : html;
+    uint64_t offset = entry.offset + sizeof(header) + prefix;
+    bool read = URL != NULL && html != NULL && body != NULL
+                && preadAll(fd, URL, header.urlLength, offset)
+                && preadAll(fd, body, header.htmlLength, offset + header.urlLength);
+    if (read && isCompressed) {
+        lzDict_t* dict = memcmp(header.magic, DICT_MAGIC, sizeof(header.magic)) == 0 ? store->dict : NULL;
+        read = lzDecompress(body, header.htmlLength, html, rawLength, dict);
+    }
+    if (isCompressed && body != NULL) count_free(body);
+    if (!read) {
+        fprintf(stderr, "Error: could not read page %d from %spages.%u\n", id, store->dirPath, entry.segment);
+        if (URL != NULL) free(URL);
+        if (html != NULL) free(html);
+        return NULL;
+    }
+    URL[header.urlLength] = '\0';
+    html[rawLength] = '\0';
+
+    webpage_t* page = webpage_new(URL, header.depth, html);
+    if (page == NULL) {
+        fprintf(stderr, "Error: could not build webpage %s\n", URL);
+        free(URL);
+        free(html);
+    }
+    return page;
+}
+
+/************** pageStoreGetURL() ******************/
+// see pagestore.h for description
+char* pageStoreGetURL(pageStore_t* store, const int id)
+{
+    pageStoreEntry_t entry;
+    pageRecordHeader_t header;
+    uint32_t rawLength;
+    int fd = readRecord(store, id, &entry, &header, &rawLength);
+    if (fd < 0) return NULL;
+    size_t prefix = memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0 ? sizeof(rawLength) : 0;
+    char* URL = malloc(header.urlLength + 1);
+    if (URL == NULL) return NULL;
+    if (!preadAll(fd, URL, header.urlLength, entry.offset + sizeof(header) + prefix)) {
+        free(URL);
+        return NULL;
+    }
+    URL[header.urlLength] = '\0';
+    return URL;
+}
+
+/************** pageStoreMove() ******************/
+// see pagestore.h for description
+bool pageStoreMove(pageStore_t* store, const int fromID, const int toID)
+{
+    if (store == NULL || !store->writable) return false;
+    pageStoreEntry_t entry;
+    if (!readEntry(store, fromID, &entry) || entry.length == 0) return false;
+    if (fromID == toID) return true;
+    pageStoreEntry_t empty = {0, 0, 0};
+    return writeEntry(store, toID, &entry) && writeEntry(store, fromID, &empty);
+}
+
+/************** pageStoreRemove() ******************/
+// see pagestore.h for description
+bool pageStoreRemove(pageStore_t* store, const int id)
+{
+    if (store == NULL || !store->writable || id < 1) return false;
+    if (id > pageStoreMaxID(store)) return true;
+    pageStoreEntry_t empty = {0, 0, 0};
+    return writeEntry(store, id, &empty);
+}
+
+/************** pageStoreMaxID() ******************/
+// see pagestore.h for description
+int pageStoreMaxID(pageStore_t* store)
+{
+    if (store == NULL) return 0;
+    struct stat st;
+    if (fstat(store->indexFd, &st) != 0 || st.st_size < (off_t) sizeof(pageStoreHeader_t)) return 0;
+    return (st.st_size - sizeof(pageStoreHeader_t)) / sizeof(pageStoreEntry_t);
+}
+
+/************** pageStoreLastID() ******************/
+// see pagestore.h for description
+int pageStoreLastID(pageStore_t* store)
+{
+    int id = pageStoreMaxID(store);
+    pageStoreEntry_t entry;
+    while (id > 0 && (!readEntry(store, id, &entry) || entry.length == 0)) id--;
+    return id;
+}
+
+/************** pageStoreStats() ******************/
+// see pagestore.h for description
+void pageStoreStats(pageStore_t* store, long long* htmlBytes, long long* storedBytes)
+{
+    if (store == NULL) return;
+    pthread_mutex_lock(&store->lock);
+    if (htmlBytes != NULL) *htmlBytes = store->htmlBytes;
+    if (storedBytes != NULL) *storedBytes = store->storedBytes;
+    pthread_mutex_unlock(&store->lock);
+}
+
+/************** pageStoreCount() ******************/
+// see pagestore.h for description
+int pageStoreCount(pageStore_t* store)
+{
+    int maxID = pageStoreMaxID(store);
+    if (maxID == 0) return 0;
+    // one read for the whole index rather than one per id
+    pageStoreEntry_t* entries = count_malloc(maxID * sizeof(pageStoreEntry_t));
+    if (entries == NULL) return 0;
+    int count = 0;
+    if (preadAll(store->indexFd, entries, maxID * sizeof(pageStoreEntry_t), sizeof(pageStoreHeader_t))) {
+        while (count < maxID && entries[count].length != 0) count++;
+    }
+    count_free(entries);
+    return count;
+}
+
+/************** allocStore() ******************/
+/* allocates a store with no files open yet, NULL if out of memory */
+static pageStore_t* allocStore(const char* dirPath, const bool writable)
+{
+    pageStore_t* store = count_calloc(1, sizeof(pageStore_t));
+    if (store == NULL) return NULL;
+    store->dirPath = count_malloc(strlen(dirPath) + 1);
+    if (store->dirPath == NULL) {
+        count_free(store);
+        return NULL;
+    }
+    strcpy(store->dirPath, dirPath);
+    store->writable = writable;
+    store->indexFd = -1;
+    pthread_mutex_init(&store->lock, NULL);
+    return store;
+}
+
+/************** storePath() ******************/
+/* builds the path of a file of the store, "dirPath/name.segment", or
+ * "dirPath/name" if segment is -1; NULL if out of memory
+*/
+static char* storePath(const char* dirPath, const char* name, const int segment)
+{
+    char* path = count_malloc(strlen(dirPath) + strlen(name) + 13);
+    if (path == NULL) return NULL;
+    if (segment >= 0) sprintf(path, "%s%s.%d", dirPath, name, segment);
+    else sprintf(path, "%s%s", dirPath, name);
+    return path;
+}
+
+/************** segmentFd() ******************/
+/* returns the file descriptor of a segment, opening (or for a writable store,
+ * creating) it the first time; -1 on error. Must be called with the lock held
+*/
+static int segmentFd(pageStore_t* store, const int segment)
+{
+    if (segment < 0 || segment >= store->numSegments) return -1;
+    // grow the array to cover every segment, marking the new ones unopened
+    if (segment >= store->fdCapacity) {
+        int capacity = store->fdCapacity > 0 ? store->fdCapacity : 8;
+        while (capacity <= segment) capacity *= 2;
+        int* fds = realloc(store->segmentFds, capacity * sizeof(int));
+        if (fds == NULL) return -1;
+        for (int i = store->fdCapacity; i < capacity; i++) fds[i] = -1;
+        store->segmentFds = fds;
+        store->fdCapacity = capacity;
+    }
+    if (store->segmentFds[segment] < 0) {
+        char* path = storePath(store->dirPath, "pages", segment);
+        if (path == NULL) return -1;
+        int fd = open(path, store->writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+        if (fd < 0) fprintf(stderr, "Error: could not open page store segment %s\n", path);
+        count_free(path);
+        store->segmentFds[segment] = fd;
+    }
+    return store->segmentFds[segment];
+}
+
+/************** readEntry() ******************/
+/* reads the index entry of an id, returns false if it has none */
+static bool readEntry(pageStore_t* store, const int id, pageStoreEntry_t* entry)
+{
+    if (store == NULL || id < 1) return false;
+    uint64_t offset = sizeof(pageStoreHeader_t) + (uint64_t) (id - 1) * sizeof(pageStoreEntry_t);
+    return preadAll(store->indexFd, entry, sizeof(*entry), offset);
+}
+
+/************** writeEntry() ******************/
+/* writes the index entry of an id, growing the index if needed */
+static bool writeEntry(pageStore_t* store, const int id, const pageStoreEntry_t* entry)
+{
+    if (id < 1) return false;
+    uint64_t offset = sizeof(pageStoreHeader_t) + (uint64_t) (id - 1) * sizeof(pageStoreEntry_t);
+    return pwriteAll(store->indexFd, entry, sizeof(*entry), offset);
+}
+
+/************** readRecord() ******************/
+/* reads the index entry and record header of an id, and the uncompressed
+ * length of its HTML into *rawLength; returns the descriptor of its segment,
+ * or -1 if there is no page under it or (printing an error) the entry and
+ * header don't match
+*/
+static int readRecord(pageStore_t* store, const int id, pageStoreEntry_t* entry, pageRecordHeader_t* header,
+                      uint32_t* rawLength)
+{
+    if (!readEntry(store, id, entry) || entry->length == 0) return -1;
+    pthread_mutex_lock(&store->lock);
+    // another process may have added segments since the store was opened
+    if ((int) entry->segment >= store->numSegments) store->numSegments = entry->segment + 1;
+    int fd = segmentFd(store, entry->segment);
+    pthread_mutex_unlock(&store->lock);
+
+    bool valid = fd >= 0 && preadAll(fd, header, sizeof(*header), entry->offset);
+    size_t prefix = 0;
+    if (valid && memcmp(header->magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) == 0) {
+        *rawLength = header->htmlLength;
+    } else if (valid && (memcmp(header->magic, LZ_MAGIC, sizeof(LZ_MAGIC)) == 0
+                         || (memcmp(header->magic, DICT_MAGIC, sizeof(DICT_MAGIC)) == 0 && store->dict != NULL))) {
+        prefix = sizeof(*rawLength);
+        valid = preadAll(fd, rawLength, prefix, entry->offset + sizeof(*header));
+    } else {
+        valid = false;
+    }
+    if (!valid || sizeof(*header) + prefix + (uint64_t) header->urlLength + header->htmlLength != entry->length) {
+        fprintf(stderr, "Error: page %d of %s is damaged\n", id, store->dirPath);
+        return -1;
+    }
+    return fd;
+}
+
+/************** sampleHTML() ******************/
+/* returns the dictionary to compress a page's HTML with, or NULL if there is
+ * none (yet). While the store is sampling, keeps a copy of the HTML, and
+ * trains the dictionary once there are PAGESTORE_TRAIN_PAGES copies
+*/
+static lzDict_t* sampleHTML(pageStore_t* store, const char* html, const size_t length)
+{
+    pthread_mutex_lock(&store->lock);
+    if (store->numSamples >= 0 && store->dict == NULL) {
+        if (store->samples == NULL) {
+            store->samples = count_calloc(PAGESTORE_TRAIN_PAGES, sizeof(char*));
+            store->sampleLengths = count_calloc(PAGESTORE_TRAIN_PAGES, sizeof(size_t));
+        }
+        char* copy = count_malloc(length);
+        if (store->samples == NULL || store->sampleLengths == NULL || copy == NULL) {
+            // out of memory: go on without a dictionary
+            if (copy != NULL) count_free(copy);
+            freeSamples(store);
+        } else {
+            memcpy(copy, html, length);
+            store->samples[store->numSamples] = copy;
+            store->sampleLengths[store->numSamples++] = length;
+            if (store->numSamples == PAGESTORE_TRAIN_PAGES) trainDict(store);
+        }
+    }
+    lzDict_t* dict = store->dict;
+    pthread_mutex_unlock(&store->lock);
+    return dict;
+}
+
+/************** trainDict() ******************/
+/* trains the dictionary from the samples, saves it to pages.dict, and stops
+ * sampling. Must be called with the lock held
+*/
+static void trainDict(pageStore_t* store)
+{
+    char* trained = count_malloc(LZ_MAX_DICT);
+    size_t size = trained != NULL ? lzTrainDictionary((const char**) store->samples, store->sampleLengths,
+                                                      store->numSamples, trained, LZ_MAX_DICT) : 0;
+    char* path = size > 0 ? storePath(store->dirPath, "pages.dict", -1) : NULL;
+    // the dictionary is only used once it is on disk, so every page needing it can be read
+    FILE* fp = path != NULL ? fopen(path, "w") : NULL;
+    if (fp != NULL) {
+        bool written = fwrite(trained, 1, size, fp) == size;
+        if (fclose(fp) == 0 && written) store->dict = newLZDict(trained, size);
+        else unlink(path);
+    }
+    if (path != NULL) count_free(path);
+    if (trained != NULL) count_free(trained);
+    freeSamples(store);
+}
+
+/************** freeSamples() ******************/
+/* frees the samples, and stops sampling */
+static void freeSamples(pageStore_t* store)
+{
+    for (int i = 0; i < store->numSamples; i++) count_free(store->samples[i]);
+    if (store->samples != NULL) count_free(store->samples);
+    if (store->sampleLengths != NULL) count_free(store->sampleLengths);
+    store->samples = NULL;
+    store->sampleLengths = NULL;
+    store->numSamples = -1;
+}
+
+/************** loadDict() ******************/
+/* loads the dictionary in dirPath/pages.dict, NULL if there is none */
+static lzDict_t* loadDict(const char* dirPath)
+{
+    char* path = storePath(dirPath, "pages.dict", -1);
+    if (path == NULL) return NULL;
+    FILE* fp = fopen(path, "r");
+    count_free(path);
+    if (fp == NULL) return NULL;
+    char* data = count_malloc(LZ_MAX_DICT);
+    size_t size = data != NULL ? fread(data, 1, LZ_MAX_DICT, fp) : 0;
+    fclose(fp);
+    lzDict_t* dict = size > 0 ? newLZDict(data, size) : NULL;
+    if (data != NULL) count_free(data);
+    return dict;
+}
+
+/************** preadAll() ******************/
+/* reads exactly length bytes at an offset, returns false if the file is shorter */
+static bool preadAll(int fd, void* buf, size_t length, uint64_t offset)
+{
+    char* at = buf;
+    while (length > 0) {
+        ssize_t n = pread(fd, at, length, offset);
+        if (n <= 0) return false;
+        at += n;
+        length -= n;
+        offset += n;
+    }
+    return true;
+}
+
+/************** pwriteAll() ******************/
+/* writes exactly length bytes at an offset */
+static bool pwriteAll(int fd, const void* buf, size_t length, uint64_t offset)
+{
+    const char* at = buf;
+    while (length > 0) {
+        ssize_t n = pwrite(fd, at, length, offset);
+        if (n < 0) return false;
+        at += n;
+        length -= n;
+        offset += n;
+    }
+    return true;
+}
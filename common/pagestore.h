@@ -0,0 +1,146 @@
+/*
+ * pagestore.h - header file for CS50 'pagestore' file in 'common' module
+ *
+ * provides the segmented page store the crawler saves its pages in. Instead of
+ * one file per page, the pages are appended as records to a few large segment
+ * files, and an index file gives the segment and offset of each page's record
+ * by id, so a crawl of any size is a handful of files and loading a page costs
+ * two reads of files that are already open.
+ *
+ * Layout (in the page directory):
+ *      pages.idx   magic "TSEPAGE1", the segment size and the compression,
+ *                  then one (offset, segment, record length) entry per id,
+ *                  starting with id 1; a length of 0 marks a missing page
+ *      pages.0     records, each a header (magic "PAGE", URL length, depth,
+ *      pages.1     HTML length) followed by the URL and HTML, without '\0's;
+ *      ...         a new segment is started once one passes PAGESTORE_SEGMENT_BYTES
+ *      pages.dict  the dictionary the HTML is compressed with, if any
+ *
+ * With compression, the HTML of a record is compressed with lz.h, and the
+ * record's magic is "PAGZ" (or "PAGD" if compressed with the dictionary), its
+ * HTML length is the compressed length, and the uncompressed length follows
+ * the header. The dictionary is trained from the first pages saved, which are
+ * compressed without it; a page that doesn't compress is saved as it is.
+ *
+ * A record is always complete before the index entry pointing at it is
+ * written, so a crawl stopped at any point leaves only complete pages indexed.
+ * Moving or removing a page only rewrites index entries; the old record stays
+ * in its segment as unused bytes until the directory is crawled again.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __PAGE_STORE
+#define __PAGE_STORE
+
+#include <stdbool.h>
+#include "webpage.h"
+
+/**************** global types ****************/
+typedef struct pageStore pageStore_t; // a thread-safe segmented page store
+
+typedef enum pageStoreCompression { // how a store saves the HTML of its pages
+    PAGESTORE_RAW,              // as it is
+    PAGESTORE_LZ,               // compressed
+    PAGESTORE_LZ_DICT           // compressed, with a dictionary trained from the first pages
+} pageStoreCompression_t;
+
+/**************** global constants ****************/
+#define PAGESTORE_SEGMENT_BYTES (64L << 20) // size after which a new segment is started
+#define PAGESTORE_TRAIN_PAGES 16            // pages the dictionary is trained from
+
+/******************* functions *******************/
+
+/******************* newPageStore() ********************/
+/* creates an empty store in dirPath (a path ending in '/', like ../data/x/),
+ * saving HTML with the given compression, and removing the segments, index,
+ * and dictionary of any store already there
+ *
+ * returns NULL (after printing an error) if the files can't be created.
+ * The caller must later call deletePageStore()
+*/
+pageStore_t* newPageStore(const char* dirPath, const pageStoreCompression_t compression);
+
+/******************* openPageStore() ********************/
+/* opens the store in dirPath, for appending more pages if writable is true,
+ * with the compression and dictionary it was created with
+ *
+ * returns NULL if the directory has no store (quietly, since it may be in
+ * the one-file-per-page layout) or if its index is invalid (with an error).
+ * The caller must later call deletePageStore()
+*/
+pageStore_t* openPageStore(const char* dirPath, const bool writable);
+
+/******************* deletePageStore() ********************/
+/* closes the store's files and frees the struct, leaving the files in place */
+void deletePageStore(pageStore_t* store);
+
+/******************* pageStorePut() ********************/
+/* Saves a page's URL, depth and HTML (which may be NULL) under an id
+ *
+ * Pseudocode:
+ *      0. with compression, compress the HTML, with the dictionary once
+ *          there is one; until then keep a copy of the HTML, and train the
+ *          dictionary from the copies once there are PAGESTORE_TRAIN_PAGES
+ *      1. lock the store, and reserve room for the record at the end of the
+ *          last segment, starting a new segment if this one is full
+ *      2. unlock it, so other threads can write their records at the same time
+ *      3. write the record, then the id's index entry pointing at it
+ *
+ * replaces any page already saved under the id. returns false (after
+ * printing an error) if the store isn't writable or the writes fail
+*/
+bool pageStorePut(pageStore_t* store, const int id, const char* URL, const int depth, const char* html);
+
+/******************* pageStoreGet() ********************/
+/* Loads the page saved under an id
+ *
+ * Pseudocode:
+ *      1. read the id's index entry; if it is missing or empty, return NULL
+ *      2. read the record's header and check it matches the entry
+ *      3. read the URL and HTML into new strings, decompressing the HTML
+ *          if it is compressed, and build the webpage
+ *
+ * returns NULL if there is no such page, or (after printing an error) if its
+ * record is damaged or out of memory. The caller must later call webpage_delete()
+*/
+webpage_t* pageStoreGet(pageStore_t* store, const int id);
+
+/******************* pageStoreGetURL() ********************/
+/* returns the URL of the page saved under an id as a malloc'd string (which the
+ * caller must free), without reading its HTML; NULL if there is no such page
+*/
+char* pageStoreGetURL(pageStore_t* store, const int id);
+
+/******************* pageStoreMove() ********************/
+/* saves the page under fromID under toID instead, replacing any page there,
+ * leaving fromID empty. returns false if there is no page under fromID or on error
+*/
+bool pageStoreMove(pageStore_t* store, const int fromID, const int toID);
+
+/******************* pageStoreRemove() ********************/
+/* removes the page saved under an id, if any; returns false on error */
+bool pageStoreRemove(pageStore_t* store, const int id);
+
+/******************* pageStoreMaxID() ********************/
+/* returns the largest id the index has an entry for, empty or not */
+int pageStoreMaxID(pageStore_t* store);
+
+/******************* pageStoreLastID() ********************/
+/* returns the largest id that has a page, 0 if none. Ids below it may be
+ * empty, where the crawler couldn't save the page it claimed the id for
+*/
+int pageStoreLastID(pageStore_t* store);
+
+/******************* pageStoreStats() ********************/
+/* sets *htmlBytes to the bytes of HTML saved through this store since it was
+ * opened, and *storedBytes to the bytes they took in the segments, compressed
+ * or not; either pointer may be NULL
+*/
+void pageStoreStats(pageStore_t* store, long long* htmlBytes, long long* storedBytes);
+
+/******************* pageStoreCount() ********************/
+/* returns how many of the ids 1, 2, 3, ... have a page before the first missing one */
+int pageStoreCount(pageStore_t* store);
+
+#endif
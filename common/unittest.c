@@ -6,12 +6,32 @@
 
 #ifdef UNITTEST
 
+#define _POSIX_C_SOURCE 200809L // mkdir, rmdir, opendir
+
 #include <stdio.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
 #include "index.h"
+#include "pagedir.h"
+#include "pagestore.h"
+#include "lz.h"
+#include "word.h"
+#include "doctable.h"
+#include "arena.h"
 #include "hashtable.h"
 #include "counters.h"
+#include "file.h"
+#include "html.h"
+#include "memory.h"
 
     // unit testing for the newIndex function
     int test1() 
@@ -124,6 +144,740 @@
         return numFailed;
     }
 
+    // unit testing for the saveIndexToBinaryFile and findWordCounters functions
+    int test6()
+    {
+        int numFailed = 0;
+        index_t* i6 = loadIndexFromFile("letters-index-1");
+        if (!saveIndexToBinaryFile("letters-index-1-unittest", i6)) numFailed++; // FUNCTION
+        deleteIndex(i6);
+
+        index_t* mapped = loadIndexFromFile("letters-index-1-unittest");
+        if (mapped == NULL) return numFailed + 1;
+        if (findWordCounters(mapped, "playground") == NULL) numFailed++; // FUNCTION
+        if (findWordCounters(mapped, "notaword") != NULL) numFailed++;
+        if (counters_get(findWordCounters(mapped, "home"), 1) != 2) numFailed++;
+        if (counters_get(findWordCounters(mapped, "home"), 2) != 1) numFailed++;
+        if (counters_get(findWordCounters(mapped, "algorithm"), 2) != 1) numFailed++;
+        if (counters_get(findWordCounters(mapped, "for"), 1) != 1) numFailed++;
+        if (counters_get(findWordCounters(mapped, "for"), 2) != 1) numFailed++;
+        // a mapped index can't be written as binary again
+        if (saveIndexToBinaryFile("letters-index-1-unittest", mapped)) numFailed++;
+        deleteIndex(mapped);
+        remove("../data/letters-index-1-unittest");
+        return numFailed;
+    }
+
+    // unit testing for the countPageFiles, buildIndexFromRange, and mergeIndex functions
+    int test7()
+    {
+        int numFailed = 0;
+        if (countPageFiles("letters-depth-1") != 2) numFailed++; // FUNCTION
+        if (countPageFiles("non-existent-dir") != 0) numFailed++;
+
+        // index each page into its own index, then merge them
+        index_t* first = newIndex(800);
+        index_t* second = newIndex(800);
+        if (!buildIndexFromRange("letters-depth-1", first, 1, 1)) numFailed++; // FUNCTION
+        if (!buildIndexFromRange("letters-depth-1", second, 2, 2)) numFailed++;
+        if (counters_get(findWordCounters(first, "home"), 2) != 0) numFailed++;
+        if (!mergeIndex(first, second)) numFailed++; // FUNCTION
+        if (counters_get(findWordCounters(first, "home"), 1) != 2) numFailed++;
+        if (counters_get(findWordCounters(first, "home"), 2) != 1) numFailed++;
+        if (counters_get(findWordCounters(first, "algorithm"), 2) != 1) numFailed++;
+        if (counters_get(findWordCounters(first, "for"), 1) != 1) numFailed++;
+        if (counters_get(findWordCounters(first, "for"), 2) != 1) numFailed++;
+
+        // pages indexed after a merge are added to the merged postings and the cached counterset
+        int numPostings;
+        if (!buildIndexFromRange("letters-depth-2", first, 3, 3)) numFailed++;
+        const posting_t* home = findWordPostings(first, "home", &numPostings);
+        if (home == NULL || numPostings != 3 || home[2].docID != 3 || home[2].count != 2) numFailed++;
+        if (counters_get(findWordCounters(first, "home"), 3) != 2) numFailed++;
+        deleteIndex(first);
+
+        // ranges merged out of order still come out sorted by id
+        index_t* later = newIndex(800);
+        index_t* earlier = newIndex(800);
+        if (!buildIndexFromRange("letters-depth-1", later, 2, 2)) numFailed++;
+        if (!buildIndexFromRange("letters-depth-1", earlier, 1, 1)) numFailed++;
+        if (!mergeIndex(later, earlier)) numFailed++;
+        home = findWordPostings(later, "home", &numPostings);
+        if (home == NULL || numPostings != 2 || home[0].docID != 1 || home[1].docID != 2) numFailed++;
+        deleteIndex(later);
+
+        // a merge that fails still deletes the source, so nothing is left allocated
+        int allocated = count_net();
+        index_t* orphan = newIndex(800);
+        if (!buildIndexFromRange("letters-depth-1", orphan, 1, 1)) numFailed++;
+        if (mergeIndex(NULL, orphan)) numFailed++;
+        if (count_net() != allocated) numFailed++;
+        return numFailed;
+    }
+
+    // unit testing for the findWordPostings function
+    int test8()
+    {
+        int numFailed = 0;
+        int numPostings;
+        index_t* i8 = loadIndexFromFile("letters-index-1");
+        const posting_t* home = findWordPostings(i8, "home", &numPostings); // FUNCTION
+        if (home == NULL || numPostings != 2) numFailed++;
+        else if (home[0].docID != 1 || home[0].count != 2 || home[1].docID != 2) numFailed++;
+        // the second lookup returns the same cached array
+        if (findWordPostings(i8, "home", &numPostings) != home) numFailed++;
+        if (findWordPostings(i8, "notaword", &numPostings) != NULL || numPostings != 0) numFailed++;
+        deleteIndex(i8);
+        return numFailed;
+    }
+
+    // unit testing for the document table, as written by the indexer and mapped by the querier
+    int test9()
+    {
+        int numFailed = 0;
+        int depth, length, numWords;
+        docTable_t* built = newDocTable();
+        if (!docTableSet(built, 1, "http://one/", 0, 100, 10)) numFailed++; // FUNCTION
+        if (!docTableSet(built, 3, "http://three/", 2, 300, 30)) numFailed++;
+        if (docTableSet(built, 0, "http://zero/", 0, 0, 0)) numFailed++;
+        if (docTableSize(built) != 3) numFailed++;
+        if (docTableGetURL(built, 2) != NULL) numFailed++;
+
+        // merging copies entries over, then save and map the result
+        docTable_t* other = newDocTable();
+        docTableSet(other, 2, "http://two/", 1, 200, 20);
+        if (!mergeDocTable(built, other)) numFailed++; // FUNCTION
+        deleteDocTable(other);
+        if (!saveDocTable("../data/unittest.docs", built)) numFailed++; // FUNCTION
+        deleteDocTable(built);
+
+        docTable_t* mapped = loadDocTable("../data/unittest.docs"); // FUNCTION
+        if (mapped == NULL) return numFailed + 1;
+        if (strcmp(docTableGetURL(mapped, 1), "http://one/") != 0) numFailed++;
+        if (strcmp(docTableGetURL(mapped, 2), "http://two/") != 0) numFailed++;
+        if (!docTableGetStats(mapped, 3, &depth, &length, &numWords)) numFailed++;
+        if (depth != 2 || length != 300 || numWords != 30) numFailed++;
+        if (docTableGetURL(mapped, 4) != NULL) numFailed++;
+        // a mapped table is read-only
+        if (docTableSet(mapped, 4, "http://four/", 0, 0, 0)) numFailed++;
+        deleteDocTable(mapped);
+        remove("../data/unittest.docs");
+
+        // a non-table file isn't mapped
+        if (loadDocTable("../data/letters-index-1") != NULL) numFailed++;
+        return numFailed;
+    }
+
+    // unit testing for the arena allocator
+    int test10()
+    {
+        int numFailed = 0;
+        arena_t* arena = newArena(64); // FUNCTION
+        if (arena == NULL) return 1;
+
+        // allocations are aligned, distinct, and zeroed by arenaCalloc
+        char* a = arenaAlloc(arena, 3); // FUNCTION
+        double* b = arenaAlloc(arena, sizeof(double));
+        int* c = arenaCalloc(arena, 10, sizeof(int)); // FUNCTION
+        if (a == NULL || b == NULL || c == NULL) return numFailed + 1;
+        if ((size_t) b % _Alignof(max_align_t) != 0 || (char*) b == a) numFailed++;
+        for (int i = 0; i < 10; i++) if (c[i] != 0) numFailed++;
+        strcpy(a, "hi");
+        *b = 1.5;
+
+        // bigger than a block, then more than fits in the rest of the block
+        char* big = arenaAlloc(arena, 1000);
+        if (big == NULL) numFailed++;
+        else memset(big, 'x', 1000);
+        if (arenaAlloc(arena, 48) == NULL) numFailed++;
+        if (strcmp(a, "hi") != 0 || *b != 1.5) numFailed++;
+
+        // a reset arena hands out its memory again from the start
+        arenaReset(arena); // FUNCTION
+        if (arenaAlloc(arena, 3) != a) numFailed++;
+        if (arenaCalloc(arena, SIZE_MAX, 2) != NULL) numFailed++;
+        deleteArena(arena); // FUNCTION
+        return numFailed;
+    }
+
+    // unit testing for the page store, as written by the crawler and read through pagedir
+    int test11()
+    {
+        int numFailed = 0;
+        mkdir("../data/unittest-store", 0755);
+        pageStore_t* store = newPageStore("../data/unittest-store/", PAGESTORE_RAW); // FUNCTION
+        if (store == NULL) return 1;
+        if (!pageStorePut(store, 1, "http://one/", 0, "<html>one</html>")) numFailed++; // FUNCTION
+        if (!pageStorePut(store, 2, "http://two/", 1, NULL)) numFailed++;
+        if (!pageStorePut(store, 4, "http://cs50tse.cs.dartmouth.edu/tse/four.html", 2, "four")) numFailed++;
+        if (pageStorePut(store, 0, "http://zero/", 0, "")) numFailed++;
+        if (pageStoreCount(store) != 2 || pageStoreMaxID(store) != 4) numFailed++; // FUNCTION
+
+        webpage_t* page = pageStoreGet(store, 1); // FUNCTION
+        if (page == NULL || strcmp(webpage_getHTML(page), "<html>one</html>") != 0
+            || webpage_getDepth(page) != 0) numFailed++;
+        webpage_delete(page);
+        char* URL = pageStoreGetURL(store, 2); // FUNCTION
+        if (URL == NULL || strcmp(URL, "http://two/") != 0) numFailed++;
+        if (URL != NULL) free(URL);
+        if (pageStoreGet(store, 3) != NULL || pageStoreGet(store, 5) != NULL) numFailed++;
+
+        // moving fills the gap, removing makes one
+        if (!pageStoreMove(store, 4, 3)) numFailed++; // FUNCTION
+        if (pageStoreMove(store, 4, 3)) numFailed++;
+        if (pageStoreCount(store) != 3) numFailed++;
+        if (!pageStoreRemove(store, 2)) numFailed++; // FUNCTION
+        if (pageStoreCount(store) != 1) numFailed++;
+        deletePageStore(store);
+
+        // a reopened store has the same pages, and pagedir reads them from it
+        store = openPageStore("../data/unittest-store/", false); // FUNCTION
+        if (store == NULL) return numFailed + 1;
+        if (pageStorePut(store, 2, "http://two/", 1, NULL)) numFailed++;
+        URL = pageStoreGetURL(store, 3);
+        if (URL == NULL || strcmp(URL, "http://cs50tse.cs.dartmouth.edu/tse/four.html") != 0) numFailed++;
+        if (URL != NULL) free(URL);
+        deletePageStore(store);
+        if (countPageFiles("unittest-store") != 1) numFailed++;
+        page = loadPageToWebpage("unittest-store", 3);
+        if (page == NULL || strcmp(webpage_getHTML(page), "four") != 0 || webpage_getDepth(page) != 2) numFailed++;
+        webpage_delete(page);
+
+        // looking up another directory, with or without a store, leaves this one's open
+        store = pageDirStore("../data/unittest-store/"); // FUNCTION
+        if (store == NULL) numFailed++;
+        if (pageDirStore("../data/letters-depth-1/") != NULL) numFailed++;
+        if (pageDirStore("../data/unittest-store/") != store) numFailed++;
+        URL = store == NULL ? NULL : pageStoreGetURL(store, 3);
+        if (URL == NULL) numFailed++;
+        else free(URL);
+        pageDirCloseStore();
+
+        // a directory without a store isn't opened as one
+        if (openPageStore("../data/letters-depth-1/", false) != NULL) numFailed++;
+        remove("../data/unittest-store/pages.idx");
+        remove("../data/unittest-store/pages.0");
+        rmdir("../data/unittest-store");
+        return numFailed;
+    }
+
+    // unit testing for the compressor, and for a page store that compresses with a dictionary
+    int test12()
+    {
+        int numFailed = 0;
+        char html[4096], other[4096], out[4096];
+        for (int i = 0, length = 0; length < 4000; i++) {
+            length += sprintf(html + length, "<li><a href=\"page%d.html\">Page %d</a></li>\n", i % 7, i);
+        }
+        strcpy(other, html);
+        other[100] = '#';
+
+        // a block decompresses to the bytes it was compressed from, and a damaged one is caught
+        size_t length = strlen(html);
+        char* packed = malloc(lzBound(length));
+        size_t size = lzCompress(html, length, packed, lzBound(length), NULL); // FUNCTION
+        if (size == 0 || size >= length / 2) numFailed++;
+        if (!lzDecompress(packed, size, out, length, NULL) || memcmp(out, html, length) != 0) numFailed++; // FUNCTION
+        if (lzDecompress(packed, size, out, length - 1, NULL)) numFailed++;
+        if (lzCompress(html, length, packed, 10, NULL) != 0) numFailed++;
+
+        // with a dictionary trained from similar pages, a page compresses further
+        const char* samples[] = { html, other };
+        size_t lengths[] = { length, length };
+        char trained[LZ_MAX_DICT];
+        size_t dictSize = lzTrainDictionary(samples, lengths, 2, trained, sizeof(trained)); // FUNCTION
+        lzDict_t* dict = newLZDict(trained, dictSize); // FUNCTION
+        size_t dictPacked = lzCompress(other, length, packed, lzBound(length), dict);
+        if (dict == NULL || dictPacked == 0 || dictPacked >= size) numFailed++;
+        if (!lzDecompress(packed, dictPacked, out, length, dict) || memcmp(out, other, length) != 0) numFailed++;
+        deleteLZDict(dict); // FUNCTION
+        free(packed);
+
+        // the store trains its dictionary from its first pages, and a reopened store reads them all
+        mkdir("../data/unittest-store", 0755);
+        pageStore_t* store = newPageStore("../data/unittest-store/", PAGESTORE_LZ_DICT);
+        if (store == NULL) return numFailed + 1;
+        for (int id = 1; id <= PAGESTORE_TRAIN_PAGES + 2; id++) {
+            other[200] = 'A' + id;
+            if (!pageStorePut(store, id, "http://page/", 1, id == 2 ? "x" : other)) numFailed++;
+        }
+        long long htmlBytes, storedBytes;
+        pageStoreStats(store, &htmlBytes, &storedBytes); // FUNCTION
+        if (storedBytes <= 0 || storedBytes * 4 > htmlBytes) numFailed++;
+        deletePageStore(store);
+        store = openPageStore("../data/unittest-store/", false);
+        if (store == NULL) return numFailed + 1;
+        for (int id = 1; id <= PAGESTORE_TRAIN_PAGES + 2; id++) {
+            other[200] = 'A' + id;
+            webpage_t* page = pageStoreGet(store, id);
+            if (page == NULL || strcmp(webpage_getHTML(page), id == 2 ? "x" : other) != 0) numFailed++;
+            webpage_delete(page);
+        }
+        deletePageStore(store);
+        if (access("../data/unittest-store/pages.dict", F_OK) != 0) numFailed++;
+        remove("../data/unittest-store/pages.dict");
+        remove("../data/unittest-store/pages.idx");
+        remove("../data/unittest-store/pages.0");
+        rmdir("../data/unittest-store");
+        return numFailed;
+    }
+
+    // unit testing for the tokenizer, which finds the words the indexer counts
+    int test13()
+    {
+        int numFailed = 0;
+        char* html = malloc(100);
+        strcpy(html, "<p class=\"Big\">Hello, WORLD of cs50</p> <b>ok</b>Searching");
+        char* URL = malloc(20);
+        strcpy(URL, "http://x/");
+        webpage_t* page = webpage_new(URL, 0, html);
+        wordTokenizer_t* tokenizer = newWordTokenizer(); // FUNCTION
+        if (page == NULL || tokenizer == NULL) return 1;
+
+        // words of 3 letters or more, lowercased, and outside of tags
+        const char* expected[] = { "hello", "world", "searching" };
+        int offsets[] = { 15, 22, 49 };
+        wordToken_t token;
+        int pos = 0, numTokens = 0;
+        while (nextWordToken(tokenizer, page, &pos, &token)) { // FUNCTION
+            if (numTokens >= 3 || strcmp(token.word, expected[numTokens]) != 0
+                || token.offset != offsets[numTokens] || token.length != (int) strlen(expected[numTokens])
+                || token.hash != hashWord(expected[numTokens], token.length)) numFailed++; // FUNCTION
+            numTokens++;
+        }
+        if (numTokens != 3) numFailed++;
+        if (hashWord("hello", 5) == hashWord("world", 5)) numFailed++;
+
+        // the same words as webpage_getNextWord finds, without the short ones
+        int start, length;
+        pos = 0;
+        numTokens = 0;
+        while (webpage_getNextWordSpan(page, &pos, &start, &length)) numTokens++;
+        if (numTokens != 6) numFailed++;
+        deleteWordTokenizer(tokenizer); // FUNCTION
+        webpage_delete(page);
+        return numFailed;
+    }
+
+    // the words and links of a page as one number, so scanners can be compared; 0 if out of memory
+    static unsigned long long checksumPage(char* html, const html_scanner_t scanner)
+    {
+        char* URL = malloc(10);
+        char* copy = malloc(strlen(html) + 1);
+        if (URL == NULL || copy == NULL) return 0;
+        strcpy(URL, "http://x/");
+        strcpy(copy, html);
+        webpage_t* page = webpage_new(URL, 0, copy);
+        html_setScanner(scanner);
+        unsigned long long sum = 0;
+        int pos = 0, start, length;
+        while (webpage_getNextWordSpan(page, &pos, &start, &length)) {
+            sum = sum * 1000003 + start * 1009 + length;
+        }
+        sum = sum * 1000003 + pos;
+        char* link;
+        pos = 0;
+        while ((link = webpage_getNextURL(page, &pos)) != NULL) {
+            sum = sum * 1000003 + pos * 1009 + strlen(link);
+            free(link);
+        }
+        webpage_delete(page);
+        return sum * 1000003 + pos;
+    }
+
+    // compares every vector scanner with the scalar one on a page; returns how many differ
+    static int compareScanners(char* html)
+    {
+        int numFailed = 0;
+        unsigned long long expected = checksumPage(html, HTML_SCAN_SCALAR);
+        for (html_scanner_t scanner = HTML_SCAN_SSE2; scanner <= HTML_SCAN_AVX2; scanner++) {
+            if (checksumPage(html, scanner) != expected) numFailed++;
+        }
+        return numFailed;
+    }
+
+    // compares the scanners on every file under a directory, as if it were HTML
+    static int compareScannersInDirectory(const char* dirPath, int* numFiles)
+    {
+        int numFailed = 0;
+        DIR* dir = opendir(dirPath);
+        if (dir == NULL) return 0;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", dirPath, entry->d_name);
+            struct stat st;
+            if (stat(path, &st) != 0) continue;
+            if (S_ISDIR(st.st_mode)) {
+                numFailed += compareScannersInDirectory(path, numFiles);
+                continue;
+            }
+            FILE* fp = fopen(path, "r");
+            char* html = fp != NULL ? freadfilep(fp) : NULL;
+            if (fp != NULL) fclose(fp);
+            if (html == NULL) continue;
+            // start at each offset into a block, so words and tags end at every place in one
+            for (int offset = 0; offset < 32 && offset < (int) strlen(html); offset++) {
+                numFailed += compareScanners(html + offset);
+            }
+            (*numFiles)++;
+            free(html);
+        }
+        closedir(dir);
+        return numFailed;
+    }
+
+    // differential testing of the vector scanners against the scalar one,
+    // on every file in the data directory and on random pages
+    int test14()
+    {
+        int numFailed = 0;
+        int numFiles = 0;
+        numFailed += compareScannersInDirectory("../data", &numFiles);
+        if (numFiles == 0) numFailed++;
+
+        // random pages of letters, tag brackets, links, and other bytes, of every length up to 200
+        const char alphabet[] = "aZz@[`{<>< \n\xc3\xa9\x80\xff";
+        const char* links[] = { "<a href=\"x#y\">", "<A HREF = y.html>", "<a name=z " };
+        char html[201 + 20];
+        srand(14);
+        for (int trial = 0; trial < 20000; trial++) {
+            int length = trial % 201;
+            for (int i = 0; i < length; i++) {
+                if (rand() % 16 == 0) {
+                    const char* link = links[rand() % 3];
+                    strcpy(html + i, link);
+                    i += strlen(link) - 1;
+                } else {
+                    html[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+                }
+            }
+            html[length] = '\0';
+            numFailed += compareScanners(html);
+        }
+        html_setScanner(HTML_SCAN_AVX2);
+        printf("Compared the scanners on %d files\n", numFiles);
+        return numFailed;
+    }
+
+    // the events of a lexer as one number, with adjacent runs of text joined,
+    // since a streaming lexer may split them; feeds the html chunk bytes at a time
+    // if chunk > 0. 0 if out of memory
+    static unsigned long long checksumEvents(const char* html, const int flags, const size_t chunk)
+    {
+        size_t total = strlen(html);
+        char* buf = malloc(total + 1);
+        if (buf == NULL) return 0;
+        size_t len = chunk > 0 ? 0 : total;
+        memcpy(buf, html, len);
+        buf[len] = '\0';
+        html_lexer_t lexer;
+        html_token_t token;
+        html_event_t event;
+        html_init(&lexer, buf, len, 0, chunk > 0 ? flags | HTML_STREAMING : flags);
+        unsigned long long sum = 0, text = 0;
+        while ((event = html_next(&lexer, &token)) != HTML_END) {
+            if (event == HTML_MORE) {
+                size_t more = total - len < chunk ? total - len : chunk;
+                memcpy(buf + len, html + len, more);
+                len += more;
+                buf[len] = '\0';
+                html_feed(&lexer, buf, len, len == total);
+                continue;
+            }
+            if (event == HTML_TEXT) {
+                text += token.length;
+                continue;
+            }
+            sum = sum * 1000003 + text;
+            text = 0;
+            sum = sum * 1000003 + event * 7919 + token.start * 1009 + token.length;
+            sum = sum * 1000003 + token.value * 1009 + token.valueLength * 2 + token.closing;
+        }
+        free(buf);
+        return sum * 1000003 + text;
+    }
+
+    // unit testing for the html lexer, and the links and words found with it
+    int test15()
+    {
+        int numFailed = 0;
+
+        // tags, attributes, text and words
+        const char* doc = "<p class=\"Big one\" hidden>Hi there</P><A HREF = 'a.html' >One</a>";
+        html_event_t events[] = { HTML_TAG, HTML_ATTRIBUTE, HTML_ATTRIBUTE, HTML_TEXT, HTML_TAG,
+                                  HTML_TAG, HTML_ATTRIBUTE, HTML_TEXT, HTML_TAG, HTML_END };
+        const char* names[] = { "p", "class", "hidden", "Hi there", "P", "A", "HREF", "One", "a", "" };
+        const char* values[] = { "", "Big one", "", "", "", "", "a.html", "", "", "" };
+        html_lexer_t lexer;
+        html_token_t token;
+        html_init(&lexer, doc, strlen(doc), 0, 0); // FUNCTION
+        for (int i = 0; i < 10; i++) {
+            html_event_t event = html_next(&lexer, &token); // FUNCTION
+            if (event != events[i]) {
+                numFailed++;
+                break;
+            }
+            if (event == HTML_END) break;
+            if (strlen(names[i]) != token.length || strncmp(doc + token.start, names[i], token.length) != 0
+                || strlen(values[i]) != token.valueLength
+                || strncmp(doc + token.value, values[i], token.valueLength) != 0) numFailed++;
+            if (event == HTML_TAG && token.closing != (i == 4 || i == 8)) numFailed++;
+        }
+        if (!html_isName("HrEf", 4, "href") || html_isName("hre", 3, "href")) numFailed++; // FUNCTION
+
+        // words, skipping tags and their attributes
+        html_init(&lexer, doc, strlen(doc), 0, HTML_WORDS);
+        int numWords = 0;
+        html_event_t event;
+        while ((event = html_next(&lexer, &token)) != HTML_END) {
+            if (event == HTML_TAG) html_skipTag(&lexer); // FUNCTION
+            else if (event == HTML_WORD) numWords++;
+            else numFailed++;
+        }
+        if (numWords != 3) numFailed++;
+
+        // the links a crawler follows, and those it doesn't
+        char* html = malloc(400);
+        char* URL = malloc(30);
+        strcpy(html, "<a href=\"a.html\">A</a> <A HREF=b.html>B</A> <a name=top> <a href=\"#top\">"
+                     "<a href=\"mailto:x@y.z\"> <a\n   href = \" c.html \" > <abbr href=\"no.html\">"
+                     "<!-- <a href=\"hidden.html\"> --> <a data-href=\"no.html\" href=\"/d.html#more\">"
+                     "<a href=http://y/e.html>");
+        strcpy(URL, "http://x/dir/page.html");
+        webpage_t* page = webpage_new(URL, 0, html);
+        const char* expected[] = { "http://x/dir/a.html", "http://x/dir/b.html", "http://x/dir/c.html",
+                                   "http://x/d.html", "http://y/e.html" };
+        int pos = 0, numLinks = 0;
+        char* link;
+        while ((link = webpage_getNextURL(page, &pos)) != NULL) {
+            if (numLinks >= 5 || strcmp(link, expected[numLinks]) != 0) numFailed++;
+            numLinks++;
+            free(link);
+        }
+        if (numLinks != 5) numFailed++;
+        webpage_delete(page);
+
+        // a page of many anchors, few of them links, is still read once
+        int numAnchors = 200000;
+        html = malloc(numAnchors * 12 + 40);
+        URL = malloc(30);
+        char* end = html;
+        for (int i = 0; i < numAnchors; i++) end += sprintf(end, "<a name=%d>", i % 1000);
+        strcpy(end, "<a href=\"last.html\">");
+        strcpy(URL, "http://x/");
+        page = webpage_new(URL, 0, html);
+        clock_t started = clock();
+        pos = numLinks = 0;
+        while ((link = webpage_getNextURL(page, &pos)) != NULL) {
+            if (strcmp(link, "http://x/last.html") != 0) numFailed++;
+            numLinks++;
+            free(link);
+        }
+        if (numLinks != 1 || clock() - started > CLOCKS_PER_SEC) numFailed++;
+        webpage_delete(page);
+
+        // streaming, a byte or a few at a time, finds the same events
+        doc = "<html><a href='x.html'>Some words\nhere</a><br/>and <!-- a comment --> an end";
+        for (int flags = 0; flags <= HTML_WORDS; flags += HTML_WORDS) {
+            unsigned long long expected = checksumEvents(doc, flags, 0);
+            for (size_t chunk = 1; chunk <= 9; chunk += 4) {
+                if (checksumEvents(doc, flags, chunk) != expected) numFailed++;
+            }
+        }
+        html_init(&lexer, "<a hr", 5, 0, HTML_STREAMING);
+        if (html_next(&lexer, &token) != HTML_MORE) numFailed++;
+        html_feed(&lexer, "<a href=y>", 10, true); // FUNCTION
+        if (html_next(&lexer, &token) != HTML_TAG || html_next(&lexer, &token) != HTML_ATTRIBUTE
+            || html_next(&lexer, &token) != HTML_END) numFailed++;
+        return numFailed;
+    }
+
+    // the links found so far by a streamed fetch, see test16
+    typedef struct streamedLinks {
+        html_lexer_t lexer;
+        bool started;
+        char* URL;
+        int numLinks;
+        int numBlocks;
+        unsigned long long sum;
+    } streamedLinks_t;
+
+    // takes the links in the html so far, all of them if final
+    static void takeLinks(streamedLinks_t* links, const char* html, const size_t length, const bool final)
+    {
+        if (!links->started) {
+            html_init(&links->lexer, html, length, 0, final ? 0 : HTML_STREAMING);
+            links->started = true;
+        } else {
+            html_feed(&links->lexer, html, length, final);
+        }
+        links->numBlocks++;
+        char* link;
+        while ((link = webpage_nextLink(&links->lexer, links->URL)) != NULL) {
+            links->sum = links->sum * 1000003 + strlen(link) * 31 + link[strlen(link) - 1];
+            links->numLinks++;
+            free(link);
+        }
+    }
+
+    // a sink for webpage_fetchStreaming
+    static void streamLinks(void* arg, const char* html, const size_t length)
+    {
+        takeLinks(arg, html, length, false);
+    }
+
+    // unit testing for streamed fetches, and the largest page size
+    int test16()
+    {
+        int numFailed = 0;
+
+        // a page arriving a few bytes at a time has the same links
+        const char* doc = "<p>See <a href=\"a.html\">A</a>, <A\nHREF=b.html>B</A> and <a href='/c.html'>";
+        char* URL = "http://x/dir/";
+        streamedLinks_t whole = { .URL = URL }, streamed = { .URL = URL };
+        takeLinks(&whole, doc, strlen(doc), true);
+        for (size_t len = 1; len < strlen(doc); len += 3) {
+            takeLinks(&streamed, doc, len, false); // FUNCTION
+        }
+        takeLinks(&streamed, doc, strlen(doc), true);
+        if (whole.numLinks != 3 || streamed.numLinks != 3 || whole.sum != streamed.sum) numFailed++;
+
+        // a fetched page goes to the sink as it arrives, and ends up whole
+        URL = "http://cs50tse.cs.dartmouth.edu/tse/wikipedia/";
+        char* URLCopy = malloc(strlen(URL) + 1);
+        strcpy(URLCopy, URL);
+        webpage_t* page = webpage_new(URLCopy, 0, NULL);
+        streamedLinks_t links = { .URL = URL };
+        if (webpage_fetchStreaming(page, streamLinks, &links)) { // FUNCTION
+            char* html = webpage_getHTML(page);
+            takeLinks(&links, html, strlen(html), true);
+            streamedLinks_t after = { .URL = URL };
+            takeLinks(&after, html, strlen(html), true);
+            if (links.numLinks == 0 || links.numBlocks < 2 || links.numLinks != after.numLinks
+                || links.sum != after.sum) numFailed++;
+            if (webpage_fetchTruncated()) numFailed++; // FUNCTION
+        } else {
+            numFailed++;
+        }
+        webpage_delete(page);
+
+        // a page longer than the largest page size is cut off there
+        webpage_setMaxPageSize(1000); // FUNCTION
+        URLCopy = malloc(strlen(URL) + 1);
+        strcpy(URLCopy, URL);
+        page = webpage_new(URLCopy, 0, NULL);
+        if (!webpage_fetch(page) || strlen(webpage_getHTML(page)) != 1000 || !webpage_fetchTruncated()) {
+            numFailed++;
+        }
+        webpage_delete(page);
+        webpage_setMaxPageSize(0);
+        return numFailed;
+    }
+
+    // unit testing for the read deadlines of a fetch
+    int test17()
+    {
+        int numFailed = 0;
+
+        // a local server that answers, then sends its body a byte every 100 ms
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+        socklen_t size = sizeof(address);
+        if (listener < 0 || bind(listener, (struct sockaddr*) &address, size) < 0
+            || listen(listener, 4) < 0 || getsockname(listener, (struct sockaddr*) &address, &size) < 0) {
+            return 1;
+        }
+        pid_t server = fork();
+        if (server == 0) {
+            int client;
+            while ((client = accept(listener, NULL, NULL)) >= 0) {
+                const char* header = "HTTP/1.1 200 OK\r\nContent-Length: 100000\r\n\r\n";
+                if (write(client, header, strlen(header)) < 0) _exit(0);
+                struct timespec pause = { 0, 100000000L };
+                while (write(client, "x", 1) == 1) {
+                    nanosleep(&pause, NULL);
+                }
+                close(client);
+            }
+            _exit(0);
+        }
+        close(listener);
+
+        // the whole response is due in 1 second, however often bytes come
+        char URL[64];
+        snprintf(URL, sizeof(URL), "http://127.0.0.1:%d/slow.html", ntohs(address.sin_port));
+        char* URLCopy = malloc(strlen(URL) + 1);
+        strcpy(URLCopy, URL);
+        webpage_t* page = webpage_new(URLCopy, 0, NULL);
+        webpage_setFetchDelay(0);
+        webpage_setTimeouts(1000, 1000, 1000); // FUNCTION
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        bool fetched = webpage_fetch(page);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (fetched || !webpage_fetchTimedOut() || seconds > 2) numFailed++; // FUNCTION
+        webpage_setTimeouts(5000, 10000, 30000);
+        webpage_setFetchDelay(1000);
+        webpage_delete(page);
+
+        kill(server, SIGKILL);
+        waitpid(server, NULL, 0);
+        return numFailed;
+    }
+
+    // unit testing for a page that can't be saved, and the gap it leaves
+    int test18()
+    {
+        int numFailed = 0;
+        mkdir("../data/unittest-gap", 0755);
+        pageStore_t* store = newPageStore("../data/unittest-gap/", PAGESTORE_RAW);
+        if (store == NULL) return 1;
+        const char* URL = "http://cs50tse.cs.dartmouth.edu/tse/alpha.html";
+        if (!pageStorePut(store, 1, URL, 0, "<p>alpha alpha, and more alpha</p>")) numFailed++;
+
+        // no file may grow, so the next page fails to save, as the crawler leaves it
+        struct rlimit unlimited, limit;
+        struct stat segment;
+        getrlimit(RLIMIT_FSIZE, &unlimited);
+        limit = unlimited;
+        if (stat("../data/unittest-gap/pages.0", &segment) == 0) limit.rlim_cur = segment.st_size;
+        void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        bool saved = pageStorePut(store, 2, URL, 1, "<p>beta beta beta beta beta beta beta</p>");
+        setrlimit(RLIMIT_FSIZE, &unlimited);
+        signal(SIGXFSZ, handler);
+        if (saved || !pageStoreRemove(store, 2)) numFailed++;
+        if (!pageStorePut(store, 3, URL, 1, "<p>gamma</p>")) numFailed++;
+        if (pageStoreCount(store) != 1 || pageStoreLastID(store) != 3) numFailed++; // FUNCTION
+        if (!pageStoreRemove(store, 4) || pageStoreLastID(store) != 3) numFailed++;
+        deletePageStore(store);
+
+        // the indexer passes over the gap, one thread or several
+        if (lastPageID("unittest-gap") != 3) numFailed++; // FUNCTION
+        index_t* whole = newIndex(800);
+        buildIndexFromCrawler("unittest-gap", whole);
+        if (counters_get(findWordCounters(whole, "alpha"), 1) != 3) numFailed++;
+        if (counters_get(findWordCounters(whole, "gamma"), 3) != 1) numFailed++;
+        if (findWordCounters(whole, "beta") != NULL) numFailed++;
+        deleteIndex(whole);
+        index_t* first = newIndex(800);
+        index_t* second = newIndex(800);
+        if (!buildIndexFromRange("unittest-gap", first, 1, 2)) numFailed++;
+        if (!buildIndexFromRange("unittest-gap", second, 3, 3)) numFailed++;
+        if (!mergeIndex(first, second)) numFailed++;
+        if (counters_get(findWordCounters(first, "gamma"), 3) != 1) numFailed++;
+        deleteIndex(first);
+        pageDirCloseStore();
+
+        remove("../data/unittest-gap/pages.idx");
+        remove("../data/unittest-gap/pages.0");
+        rmdir("../data/unittest-gap");
+        return numFailed;
+    }
+
     // the main method for the unittesting
     int main() 
     {
@@ -180,6 +934,136 @@
             totalFailed++;
         }
 
+        // test 6
+        failed = 0;
+        failed += test6();
+        if (failed == 0) {
+            printf("Test 6 passed!\n");
+        } else {
+            printf("Test 6 failed!\n");
+            totalFailed++;
+        }
+
+        // test 7
+        failed = 0;
+        failed += test7();
+        if (failed == 0) {
+            printf("Test 7 passed!\n");
+        } else {
+            printf("Test 7 failed!\n");
+            totalFailed++;
+        }
+
+        // test 8
+        failed = 0;
+        failed += test8();
+        if (failed == 0) {
+            printf("Test 8 passed!\n");
+        } else {
+            printf("Test 8 failed!\n");
+            totalFailed++;
+        }
+
+        // test 9
+        failed = 0;
+        failed += test9();
+        if (failed == 0) {
+            printf("Test 9 passed!\n");
+        } else {
+            printf("Test 9 failed!\n");
+            totalFailed++;
+        }
+
+        // test 10
+        failed = 0;
+        failed += test10();
+        if (failed == 0) {
+            printf("Test 10 passed!\n");
+        } else {
+            printf("Test 10 failed!\n");
+            totalFailed++;
+        }
+
+        // test 11
+        failed = 0;
+        failed += test11();
+        if (failed == 0) {
+            printf("Test 11 passed!\n");
+        } else {
+            printf("Test 11 failed!\n");
+            totalFailed++;
+        }
+
+        // test 12
+        failed = 0;
+        failed += test12();
+        if (failed == 0) {
+            printf("Test 12 passed!\n");
+        } else {
+            printf("Test 12 failed!\n");
+            totalFailed++;
+        }
+
+        // test 13
+        failed = 0;
+        failed += test13();
+        if (failed == 0) {
+            printf("Test 13 passed!\n");
+        } else {
+            printf("Test 13 failed!\n");
+            totalFailed++;
+        }
+
+        // test 14
+        failed = 0;
+        failed += test14();
+        if (failed == 0) {
+            printf("Test 14 passed!\n");
+        } else {
+            printf("Test 14 failed!\n");
+            totalFailed++;
+        }
+
+        // test 15
+        failed = 0;
+        failed += test15();
+        if (failed == 0) {
+            printf("Test 15 passed!\n");
+        } else {
+            printf("Test 15 failed!\n");
+            totalFailed++;
+        }
+
+        // test 16
+        failed = 0;
+        failed += test16();
+        if (failed == 0) {
+            printf("Test 16 passed!\n");
+        } else {
+            printf("Test 16 failed!\n");
+            totalFailed++;
+        }
+
+        // test 17
+        failed = 0;
+        failed += test17();
+        if (failed == 0) {
+            printf("Test 17 passed!\n");
+        } else {
+            printf("Test 17 failed!\n");
+            totalFailed++;
+        }
+
+        // test 18
+        failed = 0;
+        failed += test18();
+        if (failed == 0) {
+            printf("Test 18 passed!\n");
+        } else {
+            printf("Test 18 failed!\n");
+            totalFailed++;
+        }
+
         // end results
         if (totalFailed == 0) {
             printf("All tests passed!\n");
@@ -9,11 +9,25 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 #include "word.h"
+#include "webpage.h"
 #include "memory.h"
 
+/************* global types ****************/
+
+typedef struct wordTokenizer {
+    char* buffer;           // the last word found, lowercased
+    size_t capacity;        // bytes allocated for it
+} wordTokenizer_t;
+
+/************* global variables ****************/
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
 /************** normalizeWord() ******************/
 // see word.h for description
 void normalizeWord(char* word)
@@ -47,4 +61,78 @@ char* intToString(int x)
     // write the int as a string
     sprintf(xString, "%d", x);
     return xString;
-}
\ No newline at end of file
+}
+
+/************** hashWord() ******************/
+// see word.h for description
+uint64_t hashWord(const char* word, const size_t length)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) word[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/************** newWordTokenizer() ******************/
+// see word.h for description
+wordTokenizer_t* newWordTokenizer(void)
+{
+    wordTokenizer_t* tokenizer = count_malloc(sizeof(wordTokenizer_t));
+    if (tokenizer == NULL) return NULL;
+    tokenizer->capacity = 64;
+    // the buffer grows with realloc, so it is allocated with plain malloc
+    if ((tokenizer->buffer = malloc(tokenizer->capacity)) == NULL) {
+        count_free(tokenizer);
+        return NULL;
+    }
+    return tokenizer;
+}
+
+/************** deleteWordTokenizer() ******************/
+// see word.h for description
+void deleteWordTokenizer(wordTokenizer_t* tokenizer)
+{
+    if (tokenizer == NULL) return;
+    free(tokenizer->buffer);
+    count_free(tokenizer);
+}
+
+/************** nextWordToken() ******************/
+// see word.h for description
+bool nextWordToken(wordTokenizer_t* tokenizer, webpage_t* page, int* pos, wordToken_t* token)
+{
+    if (tokenizer == NULL || token == NULL) return false;
+    int start, length;
+    while (webpage_getNextWordSpan(page, pos, &start, &length)) {
+        if (length < WORD_MIN_LENGTH) continue;
+        // double the buffer until the word fits
+        if ((size_t) length >= tokenizer->capacity) {
+            size_t capacity = tokenizer->capacity;
+            while ((size_t) length >= capacity) capacity *= 2;
+            char* buffer = realloc(tokenizer->buffer, capacity);
+            if (buffer == NULL) {
+                fprintf(stderr, "Error: out of memory\n");
+                return false;
+            }
+            tokenizer->buffer = buffer;
+            tokenizer->capacity = capacity;
+        }
+
+        // lowercase and hash in one pass
+        const char* html = webpage_getHTML(page) + start;
+        uint64_t hash = FNV_OFFSET;
+        for (int i = 0; i < length; i++) {
+            char c = tolower((unsigned char) html[i]);
+            tokenizer->buffer[i] = c;
+            hash = (hash ^ (unsigned char) c) * FNV_PRIME;
+        }
+        tokenizer->buffer[length] = '\0';
+        token->offset = start;
+        token->length = length;
+        token->word = tokenizer->buffer;
+        token->hash = hash;
+        return true;
+    }
+    return false;
+}
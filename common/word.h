@@ -10,6 +10,21 @@
 #define __WORD
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "webpage.h"
+
+/**************** global types ****************/
+typedef struct wordTokenizer wordTokenizer_t; // finds the words of pages, reusing one buffer
+
+typedef struct wordToken { // a word found by nextWordToken()
+    int offset;             // where the word starts in the page's HTML
+    int length;             // its number of characters
+    const char* word;       // the word in lowercase, in the tokenizer's buffer until the next call
+    uint64_t hash;          // hashWord() of the lowercase word
+} wordToken_t;
+
+/**************** global constants ****************/
+#define WORD_MIN_LENGTH 3 // shorter words aren't indexed
 
 /******************* functions *******************/
 
@@ -25,4 +40,33 @@ void normalizeWord(char* word);
 char* intToString(int x);
 
 
+/***************** hashWord() ***********************/
+/* returns the 64-bit FNV-1a hash of length characters of word */
+uint64_t hashWord(const char* word, const size_t length);
+
+/***************** newWordTokenizer() ***********************/
+/* creates a tokenizer, returns NULL if out of memory.
+ * The caller must later call deleteWordTokenizer()
+*/
+wordTokenizer_t* newWordTokenizer(void);
+
+/***************** deleteWordTokenizer() ***********************/
+/* frees the tokenizer and its buffer */
+void deleteWordTokenizer(wordTokenizer_t* tokenizer);
+
+/***************** nextWordToken() ***********************/
+/* Finds the next word of at least WORD_MIN_LENGTH letters in a page's HTML
+ *
+ * Pseudocode:
+ *      1. find the next word's span with webpage_getNextWordSpan, moving *pos
+ *          past it (start *pos at 0)
+ *      2. skip it if it is shorter than WORD_MIN_LENGTH
+ *      3. otherwise copy it lowercased into the tokenizer's buffer, growing
+ *          the buffer if it is too small, and hash it in the same loop
+ *
+ * returns false when the page has no more words (or out of memory). Once its
+ * buffer fits the longest word, the tokenizer doesn't allocate anything
+*/
+bool nextWordToken(wordTokenizer_t* tokenizer, webpage_t* page, int* pos, wordToken_t* token);
+
 #endif
\ No newline at end of file
@@ -3,45 +3,169 @@
  *
  * starting at a "seed" URL, the crawler crawls the link for other links,
  * retrieving and crawling webpages that it finds up to a certain "depth"
- * from the seed. Each URL crawled is saved in its own file with a unique
- * ID number in a given directory name. Each file contains the URL, the 
- * depth, and the webpage's HTML.
+ * from the seed. Each page crawled is saved under a unique ID number in the
+ * page store of a given directory name (see pagestore.h): its URL, depth,
+ * and HTML are appended as one record to the segment files pages.0,
+ * pages.1, ..., and the index pages.idx gives the segment and offset of
+ * each ID.
  *
  * Ethan Chen, Oct. 2021
  */
 
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
 #include "webpage.h"
+#include "resolver.h"
 #include "memory.h"
-#include "bag.h"
-#include "hashtable.h"
 #include "pagedir.h"
+#include "pagestore.h"
 #include "word.h"
+#include "frontier.h"
+#include "visited.h"
+#include "politeness.h"
+#include "fetchengine.h"
+#include "journal.h"
+#include "dedup.h"
+
+/************* local types ********************/
+
+typedef struct crawlOptions { // how the pages are fetched, see main()
+    int numWorkers;             // worker threads
+    int hostDelay;              // milliseconds between fetches to one host
+    int idleConns;              // keep-alive connections kept open per host
+    int maxFetches;             // fetches in flight on the fetch engine, 0 for none
+    int connectTimeout;         // milliseconds for each connect, 0 for no limit
+    int firstByteTimeout;       // milliseconds from the request to the status line
+    int totalTimeout;           // milliseconds from the request to the end of the body
+    bool resume;                // carry on with the crawl recorded in the page directory
+    int frontierMemory;         // kilobytes of URLs the frontier keeps in memory, 0 for no limit
+    int bloomBits;              // bits per URL of Bloom filter in front of the visited set, 0 for none
+    int nearBits;               // simhash bits a near-duplicate page may differ in, -1 for exact only
+    int compression;            // a pageStoreCompression_t, for a new page store
+    bool stream;                // find each page's links while its HTML arrives
+    int maxPageKB;              // kilobytes of HTML kept from each page, 0 for no limit
+} crawlOptions_t;
+
+typedef struct crawlState { // everything shared by the crawler workers
+    visitedSet_t* visitedURLs;
+    frontier_t* toCrawl;
+    politeness_t* scheduler;
+    fetchEngine_t* engine;      // fetches every page from one thread, or NULL to fetch blocking
+    atomic_int* idCounter;
+    char* pageDir;
+    pageStore_t* store;         // where the pages are saved
+    int maxDepth;
+    FILE* timedOutFile;         // lists the URLs whose fetch timed out, or NULL
+    atomic_int* numTimedOut;
+    journal_t* journal;         // records the crawl so it can be resumed
+    dedup_t* dedup;             // the fingerprints of the saved pages
+    FILE* aliasFile;            // lists the duplicate pages and the ids they are aliases of, or NULL
+    bool stream;                // find the links of blocking fetches while the HTML arrives
+    atomic_int* numTruncated;   // pages cut off at the largest page size by blocking fetches
+    atomic_llong* firstLinkNanos; // from the start of each page's fetch to its first link, summed
+    atomic_llong* fetchNanos;   // from the start to the end of the same pages' fetches, summed
+    atomic_int* numFirstLinks;  // pages in those sums
+} crawlState_t;
+
+typedef struct pageScan { // finds the links of one page, see scanPage()
+    crawlState_t* state;
+    webpage_t* page;
+    long long fetchStart;       // when its fetch started, in nanoseconds, 0 if it wasn't fetched
+    long long fetchEnd;         // when its fetch ended, 0 while its HTML is still arriving
+    bool foundLink;             // its first link has been found
+    bool streamed;              // its links are found by the lexer below, as the HTML arrives
+    bool lexing;                // the lexer has been started on the HTML
+    html_lexer_t lexer;
+} pageScan_t;
+
+typedef struct resumeState { // what resumeURL() rebuilds from the journal
+    crawlState_t* state;
+    int* rescan;                // ids of saved pages whose links must be scanned again
+    int numRescan;
+    int maxRescan;
+    int numPending;             // pages put back in the frontier
+} resumeState_t;
+
+/************* global variables ********************/
+
+static const int MAX_WORKERS = 64; // most worker threads a crawl may use
+static const int DEFAULT_HOST_DELAY = 1000; // milliseconds between fetches to one host
+static const int DEFAULT_IDLE_CONNS = 2; // keep-alive connections kept open per host
+static const int MAX_FETCHES = 1024; // most fetches the fetch engine may keep in flight
+static const int DEFAULT_CONNECT_TIMEOUT = 5000; // milliseconds for each connect
+static const int DEFAULT_FIRST_BYTE_TIMEOUT = 10000; // milliseconds to the start of the response
+static const int DEFAULT_TOTAL_TIMEOUT = 30000; // milliseconds to the end of the response
+static const int DEFAULT_FRONTIER_MEMORY = 65536; // kilobytes of URLs before the frontier spills to disk
+static const int DEFAULT_VISITED_URLS = 1024;     // URLs the visited set holds before it first grows
+static const int MAX_BLOOM_BITS = 64;             // most Bloom filter bits per visited URL
+static const char* USAGE = "Usage: %s [-j numWorkers] [-d hostDelay] [-c idleConns] [-e maxFetches] "
+                           "[-t connectMs,firstByteMs,totalMs] [-f frontierKB] [-b bloomBits] [-n nearBits] "
+                           "[-z compression] [-s] [-m maxPageKB] [--resume] seedURL pageDirectory maxDepth\n";
 
 /************* function prototypes ********************/
 
-bool crawler(char* seedURL, char* pageDir, int depth);
-void processWebpages(hashtable_t* visitedURLs, bag_t* toCrawl, int* idCounter, char* pageDir, int maxDepth);
-bool pageFetcher(webpage_t* page);
+bool crawler(char* seedURL, char* pageDir, int depth, crawlOptions_t* options);
+void processWebpages(crawlState_t* state);
+bool pageFetcher(webpage_t* page, webpage_sink_t sink, void* arg);
 char* pageScanner(webpage_t* page, int* pos);
-bool pageSaver(webpage_t* page, int* id, char* pageDir);
+bool pageSaver(webpage_t* page, const int id, pageStore_t* store);
 
 /************* local function prototypes ********************/
 
-static void delete(void* item);
-static void freeStructs(hashtable_t* ht, bag_t* bag);
+static void* crawlWorker(void* arg);
+static void crawlPage(webpage_t* newPage, crawlState_t* state);
+static webpage_t* nextFetchedPage(crawlState_t* state, fetchResult_t* result, long long* fetchStart);
+static void storePage(pageScan_t* scan);
+static void scanPage(pageScan_t* scan, const int id, const bool aliased);
+static void streamLinks(void* arg, const char* html, const size_t length);
+static void scanLinks(pageScan_t* scan, const char* html, const size_t length, const bool final);
+static void insertLink(pageScan_t* scan, char* nextURL);
+static long long nowNanos(void);
+static void resumeURL(void* arg, const char* URL, const int depth, const int id,
+                      const journalState_t state);
+static void recordTimeout(webpage_t* page, crawlState_t* state);
+static void recordAlias(const char* URL, const int depth, const int id, crawlState_t* state);
+static void freeStructs(visitedSet_t* set, frontier_t* frontier, politeness_t* scheduler, dedup_t* dedup,
+                        pageStore_t* store);
 
 /************** main() ******************/
 /* the "testing" function/main function, which takes three arguments 
  * as inputs (other than the executable call), the URL of the "seed", 
  * the directory in which all of the created files will be stored, 
- * and the maximum depth of the crawl 
+ * and the maximum depth of the crawl. They may be preceded by any of the flags below
+ *
+ * Flags:
+ *      -j [numWorkers]     crawl with that many worker threads (1 by default)
+ *      -d [hostDelay]      milliseconds between fetches to the same host (1000 by default)
+ *      -c [idleConns]      connections kept open to each host between fetches
+ *                          (2 by default, 0 for a new connection for every page)
+ *      -e [maxFetches]     fetches in flight from a single thread with the event-driven
+ *                          fetch engine, instead of fetching one page at a time
+ *      -t [connectMs,firstByteMs,totalMs]
+ *                          most time a fetch may take to connect, to get the start of
+ *                          the response, and to get all of it (5000,10000,30000 by
+ *                          default, 0 for no limit)
+ *      -f [frontierKB]     kilobytes of pending URLs kept in memory before spilling them
+ *                          to disk (65536 by default, 0 for no limit)
+ *      -b [bloomBits]      bits per URL of a Bloom filter checked before the visited set,
+ *                          reporting how often it was wrong (0, no filter, by default)
+ *      -n [nearBits]       also skip pages whose simhash is within that many bits of a saved
+ *                          page's (0 to 3, or -1, the default, for byte-identical pages only)
+ *      -z [compression]    compress the HTML of the saved pages (0, the default, for none,
+ *                          1 for each page on its own, 2 to also use a trained dictionary)
+ *      -s                  find the links of each page while its HTML is still arriving
+ *      -m [maxPageKB]      most kilobytes kept of each page (0, the default, for no limit)
+ *      --resume            carry on with a crawl of the same pageDirectory that was cut short
  * 
  * Pseudocode:
- *      1. make sure there are exactly 3 other arguments
+ *      1. parse the flags, then make sure there are exactly 3 other arguments
  *      2. copy the pageDirectory and seedURL into malloc'd strings
  *      3. store the maxDepth as an int
  *      4. call the crawler method
@@ -53,14 +177,114 @@ static void freeStructs(hashtable_t* ht, bag_t* bag);
 int main(int argc, char* argv[]) 
 {
     char* program = argv[0];
+    // parse the flags that come before the positional arguments
+    crawlOptions_t options = { 1, DEFAULT_HOST_DELAY, DEFAULT_IDLE_CONNS, 0, DEFAULT_CONNECT_TIMEOUT,
+                               DEFAULT_FIRST_BYTE_TIMEOUT, DEFAULT_TOTAL_TIMEOUT, false,
+                               DEFAULT_FRONTIER_MEMORY, 0, -1, PAGESTORE_RAW, false, 0 };
+    int argIndex = 1;
+    while (argIndex < argc && argv[argIndex][0] == '-') {
+        char ignore;
+        if (strcmp(argv[argIndex], "-j") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.numWorkers, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-d") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.hostDelay, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-c") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.idleConns, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-e") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.maxFetches, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-t") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d,%d,%d%c", &options.connectTimeout,
+                      &options.firstByteTimeout, &options.totalTimeout, &ignore) == 3) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-f") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.frontierMemory, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-b") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.bloomBits, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-n") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.nearBits, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-z") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.compression, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "-s") == 0) {
+            options.stream = true;
+            argIndex++;
+        } else if (strcmp(argv[argIndex], "-m") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &options.maxPageKB, &ignore) == 1) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "--resume") == 0) {
+            options.resume = true;
+            argIndex++;
+        } else {
+            fprintf(stderr, USAGE, program);
+            return 1;
+        }
+    }
+    int numWorkers = options.numWorkers;
+    int maxFetches = options.maxFetches;
+    if (numWorkers < 1 || numWorkers > MAX_WORKERS) {
+        fprintf(stderr, "Error: numWorkers must be between 1 and %d\n", MAX_WORKERS);
+        return 1;
+    }
+    if (options.hostDelay < 0) {
+        fprintf(stderr, "Error: hostDelay must be non-negative\n");
+        return 1;
+    }
+    if (options.idleConns < 0) {
+        fprintf(stderr, "Error: idleConns must be non-negative\n");
+        return 1;
+    }
+    if (maxFetches < 0 || maxFetches > MAX_FETCHES) {
+        fprintf(stderr, "Error: maxFetches must be between 0 and %d\n", MAX_FETCHES);
+        return 1;
+    }
+    if (maxFetches > 0 && numWorkers > 1) {
+        fprintf(stderr, "Error: the fetch engine runs on one thread, so -e and -j can't be combined\n");
+        return 1;
+    }
+    if (maxFetches > 0 && options.stream) {
+        fprintf(stderr, "Error: only blocking fetches are streamed, so -e and -s can't be combined\n");
+        return 1;
+    }
+    if (options.connectTimeout < 0 || options.firstByteTimeout < 0 || options.totalTimeout < 0) {
+        fprintf(stderr, "Error: timeouts must be non-negative\n");
+        return 1;
+    }
+    if (options.frontierMemory < 0) {
+        fprintf(stderr, "Error: frontierKB must be non-negative\n");
+        return 1;
+    }
+    if (options.bloomBits < 0 || options.bloomBits > MAX_BLOOM_BITS) {
+        fprintf(stderr, "Error: bloomBits must be between 0 and %d\n", MAX_BLOOM_BITS);
+        return 1;
+    }
+    if (options.nearBits < -1 || options.nearBits > DEDUP_MAX_DISTANCE) {
+        fprintf(stderr, "Error: nearBits must be between -1 and %d\n", DEDUP_MAX_DISTANCE);
+        return 1;
+    }
+    if (options.compression < PAGESTORE_RAW || options.compression > PAGESTORE_LZ_DICT) {
+        fprintf(stderr, "Error: compression must be between %d and %d\n", PAGESTORE_RAW, PAGESTORE_LZ_DICT);
+        return 1;
+    }
+    if (options.maxPageKB < 0) {
+        fprintf(stderr, "Error: maxPageKB must be non-negative\n");
+        return 1;
+    }
+
     // check for the appropriate number of arguments
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s [seedURL] [pageDirectory] [maxDepth]\n", program);
+    if (argc - argIndex != 3) {
+        fprintf(stderr, USAGE, program);
         return 1;
     }
 
     // allocate memory and copy string for seedURL
-    char* seedURLArg = argv[1];
+    char* seedURLArg = argv[argIndex];
     char* seedURL = count_malloc(strlen(seedURLArg) + 1);
     if (seedURL == NULL) {
         fprintf(stderr, "Error: out of memory\n");
@@ -69,12 +293,12 @@ int main(int argc, char* argv[])
     strcpy(seedURL, seedURLArg);
 
     // NOTE: don't copy string for pageDir since pageDir is constant throughout program
-    char* pageDir = argv[2];
+    char* pageDir = argv[argIndex + 1];
 
     // turn the 3rd input [depth] into an int, if not return error
     int maxDepth;
     char ignore;
-    if (sscanf(argv[3], "%d%c", &maxDepth, &ignore) != 1) {
+    if (sscanf(argv[argIndex + 2], "%d%c", &maxDepth, &ignore) != 1) {
         fprintf(stderr, "Error: maxDepth must be an integer\n");
         return 1;
     }
@@ -92,7 +316,7 @@ int main(int argc, char* argv[])
 
     // call the crawler function, return successful if so, otherwise
     // free the seedURL and exit unsuccessful 
-    if (crawler(seedURL, pageDir, maxDepth)) {
+    if (crawler(seedURL, pageDir, maxDepth, &options)) {
         // testing
         #ifdef TEST
             printf("SUCCESS\n");
@@ -111,43 +335,270 @@ int main(int argc, char* argv[])
 /************** crawler() ******************/
 /* the skeleton code for the crawler, creating necessary variables. 
  * For the actual algorithm code, see processWebpages
+ *
+ * With more than one worker, each worker thread runs processWebpages on the
+ * same frontier, visited set, id counter, and politeness scheduler. The scheduler
+ * replaces the fixed pause inside webpage_fetch, so only fetches to the same host
+ * are spaced hostDelay milliseconds apart. Up to idleConns connections to each
+ * host are kept open between fetches and reused, so consecutive pages from one
+ * host don't each pay for a new TCP handshake
+ *
+ * With maxFetches > 0, this thread runs processWebpages with a fetch engine
+ * instead, which keeps up to maxFetches fetches in flight on non-blocking
+ * sockets. If the engine can't be created, the crawl falls back to blocking fetches
+ *
+ * Either way, every fetch is limited by the options' timeouts. The URLs whose
+ * fetch timed out are listed, one "depth URL" per line, in the file .timedout
+ * in pageDir, so they can be crawled again later; the file is removed if
+ * no fetch timed out
+ *
+ * Every page discovered, saved, scanned, or given up on is recorded in the
+ * journal in pageDir. With options->resume, the crawl starts from the journal
+ * instead: the pages it saved are kept, the pages it only discovered go back
+ * in the frontier, and saved pages whose links weren't all recorded are
+ * scanned again from the page store. No saved page is fetched again
+ *
+ * The pages are saved to the page store in pageDir (see pagestore.h), a few
+ * segment files of records and an index of them by id, rather than one file
+ * per page; pageexport writes a store out as one file per page again
+ *
+ * A fetched page with the same HTML as a saved one (or, with options->nearBits
+ * of 0 or more, a simhash that close to one's) isn't saved again. Its links are
+ * still followed, and it is listed as "id depth URL" in the file .aliases in
+ * pageDir, with the id of the saved page; the file is removed if there are none
+ *
+ * With options->stream, a blocking fetch hands each block of HTML to the html
+ * lexer as it arrives, and the links found so far go into the frontier at once,
+ * so idle workers can start on them before the page is all in. The page is only
+ * fingerprinted and saved once it is complete. Either way, the crawl reports how
+ * long after the start of its fetch a page's first link was found, on average.
+ * With options->maxPageKB, every page is cut off after that many kilobytes
  * 
  * Assumptions:
  *      1. the user puts in valid inputs, otherwise throws errors
 */
-bool crawler(char* seedURL, char* pageDir, int maxDepth) 
+bool crawler(char* seedURL, char* pageDir, int maxDepth, crawlOptions_t* options) 
 {
-    if (seedURL != NULL && pageDir != NULL) {
+    if (seedURL != NULL && pageDir != NULL && options != NULL && options->numWorkers > 0
+        && options->hostDelay >= 0 && options->idleConns >= 0 && options->maxFetches >= 0) {
+        int numWorkers = options->numWorkers;
         // check if the directory is valid by creating a file labeled .crawler
         if (!validDirectory(pageDir)) {
             return false;
         }
 
-        // initialize the id counter, bag, and table
-        int idCounter = 1;
-        bag_t* toCrawl = bag_new();
-        hashtable_t* visitedURLs = hashtable_new(100);
-        if (toCrawl == NULL || visitedURLs == NULL) {
+        // initialize the id counter, frontier, visited set, scheduler, and dedup index
+        atomic_int idCounter;
+        atomic_init(&idCounter, 1);
+        atomic_int numTimedOut;
+        atomic_init(&numTimedOut, 0);
+        atomic_int numTruncated, numFirstLinks;
+        atomic_init(&numTruncated, 0);
+        atomic_init(&numFirstLinks, 0);
+        atomic_llong firstLinkNanos, fetchNanos;
+        atomic_init(&firstLinkNanos, 0);
+        atomic_init(&fetchNanos, 0);
+        frontier_t* toCrawl = newFrontier((size_t) options->frontierMemory * 1024);
+        visitedSet_t* visitedURLs = newVisitedSet(DEFAULT_VISITED_URLS, options->bloomBits);
+        politeness_t* scheduler = newPoliteness(options->hostDelay);
+        dedup_t* dedup = newDedup(options->nearBits);
+        pageStore_t* store = NULL;
+        if (toCrawl == NULL || visitedURLs == NULL || scheduler == NULL || dedup == NULL) {
             // make sure the items are created, handle errors
             fprintf(stderr, "Error: Out of memory\n");
+            freeStructs(visitedURLs, toCrawl, scheduler, dedup, store);
+            return false;
+        }
+
+        // save the pages to a new page store, or keep adding to the old one (with
+        // the compression it was created with) when resuming
+        char* dirPath = stringBuilder(pageDir, "");
+        if (dirPath != NULL) {
+            if (options->resume) store = openPageStore(dirPath, true);
+            if (store == NULL) store = newPageStore(dirPath, options->compression);
+            count_free(dirPath);
+        }
+        if (store == NULL) {
+            freeStructs(visitedURLs, toCrawl, scheduler, dedup, store);
             return false;
         }
         
-        // insert into the hashtable, otherwise end the function
-        if (!hashtable_insert(visitedURLs, seedURL, "")) {
-            freeStructs(visitedURLs, toCrawl);
-            count_free(pageDir);
+        // the aliases are listed again from the journal when the crawl is resumed
+        char* aliasName = stringBuilder(pageDir, ".aliases");
+        FILE* aliasFile = NULL;
+        if (aliasName != NULL) aliasFile = fopen(aliasName, "w");
+        crawlState_t state = { visitedURLs, toCrawl, scheduler, NULL, &idCounter, pageDir, store, maxDepth,
+                               NULL, &numTimedOut, NULL, dedup, aliasFile, options->stream, &numTruncated,
+                               &firstLinkNanos, &fetchNanos, &numFirstLinks };
+
+        // start a new journal, or rebuild the crawl from the old one
+        resumeState_t resumed = { &state, NULL, 0, 0, 0 };
+        int numSaved = 0;
+        if (options->resume) {
+            state.journal = resumeJournal(pageDir, store, &numSaved, &resumed, resumeURL);
+        } else {
+            state.journal = newJournal(pageDir);
+        }
+        if (state.journal == NULL) {
+            if (resumed.rescan != NULL) free(resumed.rescan);
+            if (aliasFile != NULL) fclose(aliasFile);
+            if (aliasName != NULL) count_free(aliasName);
+            freeStructs(visitedURLs, toCrawl, scheduler, dedup, store);
             return false;
         }
+        atomic_store(&idCounter, numSaved + 1);
+
+        // insert the seed into the visited set, unless the journal already has it
+        if (visitedSetInsert(visitedURLs, seedURL)) {
+            // initialize the seed page and add it to the frontier
+            journalRecord(state.journal, JOURNAL_DISCOVERED, seedURL, 0, 0);
+            frontierInsert(toCrawl, seedURL, 0);
+        } else if (!options->resume) {
+            deleteJournal(state.journal);
+            if (aliasFile != NULL) fclose(aliasFile);
+            if (aliasName != NULL) count_free(aliasName);
+            freeStructs(visitedURLs, toCrawl, scheduler, dedup, store);
+            return false;
+        }
+        count_free(seedURL);
+
+        // scan the links of the pages saved just before the crawl was cut short
+        for (int i = 0; i < resumed.numRescan; i++) {
+            pageScan_t scan = { &state, pageStoreGet(store, resumed.rescan[i]) };
+            if (scan.page != NULL) scanPage(&scan, resumed.rescan[i], false);
+        }
+        if (resumed.rescan != NULL) free(resumed.rescan);
+        if (options->resume) {
+            printf("Resumed the crawl with %d pages saved, %d left to crawl, and %d scanned again\n",
+                   numSaved, resumed.numPending, resumed.numRescan);
+        }
+
+        // the scheduler does the waiting, so webpage_fetch should not pause
+        webpage_setFetchDelay(0);
+        webpage_setConnectionPool(options->idleConns);
+        webpage_setTimeouts(options->connectTimeout, options->firstByteTimeout, options->totalTimeout);
+        webpage_setMaxPageSize((size_t) options->maxPageKB * 1024);
+        // a resumed crawl adds to the URLs that timed out before
+        char* timedOutName = stringBuilder(pageDir, ".timedout");
+        FILE* timedOutFile = NULL;
+        if (timedOutName != NULL) timedOutFile = fopen(timedOutName, options->resume ? "a" : "w");
+        state.timedOutFile = timedOutFile;
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
 
-        // initialize the seed page and add it to the bag
-        webpage_t* seedPage = webpage_new(seedURL, 0, NULL);
-        bag_insert(toCrawl, seedPage);
+        // run crawl algorithm, on this thread or on the worker threads
+        fetchEngine_t* engine = NULL;
+        if (options->maxFetches > 0
+            && (engine = newFetchEngine(options->maxFetches, options->idleConns)) == NULL) {
+            fprintf(stderr, "Error: falling back to blocking fetches\n");
+        }
+        fetchEngineSetTimeouts(engine, options->connectTimeout, options->firstByteTimeout,
+                               options->totalTimeout);
+        fetchEngineSetMaxPageSize(engine, (size_t) options->maxPageKB * 1024);
+        state.engine = engine;
+        if (numWorkers == 1) {
+            processWebpages(&state);
+        } else {
+            pthread_t* workers = count_calloc(numWorkers, sizeof(pthread_t));
+            int numStarted = 0;
+            while (workers != NULL && numStarted < numWorkers
+                   && pthread_create(&workers[numStarted], NULL, crawlWorker, &state) == 0) {
+                numStarted++;
+            }
+            // if no thread could start, crawl on this one instead
+            if (numStarted == 0) {
+                processWebpages(&state);
+            }
+            for (int i = 0; i < numStarted; i++) {
+                pthread_join(workers[i], NULL);
+            }
+            if (workers != NULL) count_free(workers);
+        }
+
+        // report how much of the crawl was spent fetching versus waiting,
+        // how fast pages came in over how many connections, and how often
+        // a host name had to be looked up
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        webpage_closeConnections();
+        politenessReport(scheduler, stdout);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        int numPages = atomic_load(&idCounter) - 1 - numSaved;
+        int opened, reused, truncated = atomic_load(&numTruncated);
+        if (engine != NULL) {
+            fetchEngineStats(engine, &opened, &reused, &truncated);
+            deleteFetchEngine(engine);
+        } else {
+            webpage_getConnectionStats(&opened, &reused);
+        }
+        printf("Crawled %d pages in %.3f seconds (%.1f pages/sec) over %d connections, %d fetches reused one\n",
+               numPages, seconds, seconds > 0 ? numPages / seconds : 0, opened, reused);
+        if (truncated > 0) {
+            printf("Cut off %d pages at %d KB\n", truncated, options->maxPageKB);
+        }
+        int timedPages = atomic_load(&numFirstLinks);
+        if (timedPages > 0) {
+            printf("Found the first link of a page %.1f ms after its fetch started, which took %.1f ms, "
+                   "on average over %d pages%s\n", atomic_load(&firstLinkNanos) / 1e6 / timedPages,
+                   atomic_load(&fetchNanos) / 1e6 / timedPages, timedPages, options->stream ? " (streamed)" : "");
+        }
+        int hits, misses;
+        double resolveSeconds;
+        resolver_getStats(&hits, &misses, &resolveSeconds);
+        printf("Resolved host names %d times (%.3f seconds), answered %d lookups from the cache\n",
+               misses, resolveSeconds, hits);
+        resolver_clear();
+        size_t frontierPeak;
+        int numSpilled, numRuns;
+        frontierStats(toCrawl, &frontierPeak, &numSpilled, &numRuns);
+        printf("The frontier kept at most %zu KB of URLs in memory, and spilled %d URLs to %d runs on disk\n",
+               frontierPeak / 1024, numSpilled, numRuns);
+        int numVisited, falsePositives;
+        size_t visitedMemory;
+        visitedSetStats(visitedURLs, &numVisited, &visitedMemory, &falsePositives);
+        printf("The visited set holds %d URLs in %zu KB (%.1f bytes per URL)\n", numVisited,
+               visitedMemory / 1024, numVisited > 0 ? (double) visitedMemory / numVisited : 0);
+        if (options->bloomBits > 0) {
+            printf("The Bloom filter (%d bits per URL) wrongly claimed %d of %d new URLs were seen (%.3f%%)\n",
+                   options->bloomBits, falsePositives, numVisited,
+                   numVisited > 0 ? 100.0 * falsePositives / numVisited : 0);
+        }
 
-        // run crawl algorithm
-        processWebpages(visitedURLs, toCrawl, &idCounter, pageDir, maxDepth);
+        // keep the list of timed-out URLs only if there are any, counting
+        // those listed before the crawl was resumed
+        int timedOut = atomic_load(&numTimedOut);
+        bool anyListed = timedOutFile != NULL && fseek(timedOutFile, 0, SEEK_END) == 0
+                         && ftell(timedOutFile) > 0;
+        if (timedOutFile != NULL) fclose(timedOutFile);
+        if (timedOut > 0) {
+            printf("%d fetches timed out, listed in ../data/%s/.timedout\n", timedOut, pageDir);
+        }
+        if (!anyListed && timedOutName != NULL) {
+            remove(timedOutName);
+        }
+        if (timedOutName != NULL) count_free(timedOutName);
 
-        freeStructs(visitedURLs, toCrawl);
+        // the same for the aliases, counting only the duplicates found by this run
+        int numExact, numNear;
+        long long bytesSkipped;
+        dedupStats(dedup, &numExact, &numNear, &bytesSkipped);
+        bool anyAliases = aliasFile != NULL && fseek(aliasFile, 0, SEEK_END) == 0 && ftell(aliasFile) > 0;
+        if (aliasFile != NULL) fclose(aliasFile);
+        if (numExact + numNear > 0) {
+            printf("Skipped saving %d duplicate pages (%d exact, %d near), %lld KB of HTML, listed in ../data/%s/.aliases\n",
+                   numExact + numNear, numExact, numNear, bytesSkipped / 1024, pageDir);
+        }
+        if (!anyAliases && aliasName != NULL) {
+            remove(aliasName);
+        }
+        if (aliasName != NULL) count_free(aliasName);
+        long long htmlBytes, storedBytes;
+        pageStoreStats(store, &htmlBytes, &storedBytes);
+        if (storedBytes < htmlBytes) {
+            printf("Saved %lld KB of HTML in %lld KB (%.1fx smaller)\n", htmlBytes / 1024, storedBytes / 1024,
+                   storedBytes > 0 ? (double) htmlBytes / storedBytes : 0);
+        }
+        deleteJournal(state.journal);
+        freeStructs(visitedURLs, toCrawl, scheduler, dedup, store);
         return true;
     } else {
         // if it fails, free the seedURL
@@ -158,88 +609,71 @@ bool crawler(char* seedURL, char* pageDir, int maxDepth)
 
 /************** processWebpages() ******************/
 /* performs the actual "crawl". As long as there are webpages left
- * to search inside the bag, it will go through each, extract URLs, 
- * and create webpages to be added back to the bag. It will also keep
+ * to search inside the frontier, it will go through each, extract URLs, 
+ * and create webpages to be added back to the frontier. It will also keep
  * track of previously used URLs
  * 
  * Pseudocode:
- *      1. get a webpage from the bag, fetch its HTML, and save its data to a file
+ *      1. get a webpage from the frontier, fetch its HTML, and save its data to a file
  *      2. if still less than the current depth, get all of the URLs embedded in the HTML
  *      3. for each URL, check if it is internal (within cs50tse domain), normalized, and not 
  *              already checked
- *      4. create a new webpage for that URL and insert it into the bag
+ *      4. create a new webpage for that URL and insert it into the frontier
  *      5. delete each webpage before getting another webpage
+ *      6. stop once the frontier is empty and no other worker is still crawling a page
+ *
+ * With a fetch engine, the pages are not fetched one at a time: the engine is kept
+ * full of pages from the frontier, each fetch starting at its host's slot, and step 1
+ * takes whichever page the engine finishes next, already fetched
  * 
  * Assumptions:
  *      1. the user puts in valid inputs, otherwise throws errors
- *      2. the bag is not empty by default, otherwise nothingn happens
+ *      2. the frontier is not empty by default, otherwise nothingn happens
 */
-void processWebpages(hashtable_t* visitedURLs, bag_t* toCrawl, int* idCounter, char* pageDir, int maxDepth) 
+void processWebpages(crawlState_t* state) 
 {
-    // go through as long as still webpages in the bag
+    // go through as long as still webpages in the frontier
     webpage_t* newPage;
-    while ((newPage = bag_extract(toCrawl)) != NULL) {
-        // fetch the HTML of the page
-        if (!pageFetcher(newPage)) {
-            // if unable to, delete the webpage to free memory and continue to next loop
-            webpage_delete(newPage);
-            continue;
+    if (state->engine == NULL) {
+        while ((newPage = frontierExtract(state->toCrawl)) != NULL) {
+            crawlPage(newPage, state);
+            // let waiting workers know this page's links are all in the frontier
+            frontierDone(state->toCrawl);
         }
-        
-        // save the page's data to a file in the directory
-        if (!pageSaver(newPage, idCounter, pageDir)) {
-            // if unable, delete webpage to free memory and continue to next loop
-            webpage_delete(newPage);
-            continue;
-        }
-           
-        // continue if not already at maxDepth
-        int currDepth = webpage_getDepth(newPage);
-        if (currDepth < maxDepth) {
-             // int to represent the position of the stream in the HTML
-             // so that it can pick up where it left off in subsequent loops
-            int pos = 0;
+        return;
+    }
 
-            // get all of the URLs embedded in the webpage
-            char* nextURL;
-            while ((nextURL = pageScanner(newPage, &pos)) != NULL) {
-                // check if within cs50tse domain and normalized
-                if (!IsInternalURL(nextURL)) {
-                    // testing print statement when URL can't be normalized
-                    // or is not within cs50tse domain
-                    #ifdef TEST
-                        printf("URL %s is invalid!\n", nextURL);  
-                    #endif
-                    count_free(nextURL);
-                    continue;
-                }
-                // insert the URL into the hashtable
-                if (hashtable_insert(visitedURLs, nextURL, "")) {
-                    // create a new webpage (without HTML), increment depth, and insert into bag
-                    webpage_t* newWebpage = webpage_new(nextURL, currDepth + 1, NULL);
-                    bag_insert(toCrawl, newWebpage);
-                } else {
-                    // if here, the URL already exists, so free it
-                    count_free(nextURL);
-                }
-            }
+    // or as long as the engine still has pages in flight
+    fetchResult_t result;
+    long long fetchStart;
+    while ((newPage = nextFetchedPage(state, &result, &fetchStart)) != NULL) {
+        if (result == FETCH_OK) {
+            pageScan_t scan = { state, newPage, fetchStart, nowNanos() };
+            storePage(&scan);
+        } else {
+            journalRecord(state->journal, JOURNAL_FAILED, webpage_getURL(newPage),
+                          webpage_getDepth(newPage), 0);
+            if (result == FETCH_TIMED_OUT) recordTimeout(newPage, state);
+            webpage_delete(newPage);
         }
-        webpage_delete(newPage);
+        frontierDone(state->toCrawl);
     }
 }
 
 /************** pageFetcher() ******************/
 /* from the URL stored inside a webpage, fetches the content of 
- * that webpage from the web and adds it to that webpage's URL
+ * that webpage from the web and adds it to that webpage's URL.
+ * If sink isn't NULL, it is passed arg and the HTML so far as each
+ * block of it arrives (see webpage_fetchStreaming)
  * 
  * Assumptions:
  *      1. the user puts in valid inputs, otherwise throws errors
 */
-bool pageFetcher(webpage_t* page) 
+bool pageFetcher(webpage_t* page, webpage_sink_t sink, void* arg) 
 {
     if (page != NULL) {
         // fetch the HTML from the webpage
-        if (!webpage_fetch(page)) {
+        if (!webpage_fetchStreaming(page, sink, arg)) {
             char* URL = webpage_getURL(page);
             fprintf(stderr, "Error: URL %s was not reachable\n", URL);
             return false;
@@ -273,33 +707,28 @@ char* pageScanner(webpage_t* page, int* pos)
 }
 
 /************** pageSaver() ******************/
-/* takes a webpage and saves it to a file in the given directory
- * the file prints the URL on the first line, then the depth, and then
- * the webpage's HTML.
+/* takes a webpage and saves its URL, depth, and HTML to the page store under
+ * the given id. The id was claimed from the dedup index, so no two workers
+ * save under the same one
  * 
  * Pseudocode:
  *      1. check if inputs are valid
- *      2. build the string
- *      3. write the file to the directory
+ *      2. append the page to the store
+ *
+ * returns true if the page was saved
  * 
  * Assumptions:
  *      1. inputs are valid, otherwise throw errors  
 */
-bool pageSaver(webpage_t* page, int* id, char* pageDir) 
+bool pageSaver(webpage_t* page, const int id, pageStore_t* store) 
 {
-    if (page != NULL && id != NULL && pageDir != NULL) {
-        // build the string and open the file
-        char* idString = intToString(*id);
-        char* fname = stringBuilder(pageDir, idString);
-        free(idString);
-        if (writeToDirectory(fname, page, id)) {
-            if (fname != NULL) count_free(fname); // free the memory from the filename 
+    if (page != NULL && id > 0 && store != NULL) {
+        if (pageStorePut(store, id, webpage_getURL(page), webpage_getDepth(page), webpage_getHTML(page))) {
             #ifdef TEST
-                printf("Saved ../data/%s/%d\n", pageDir, *id-1);
+                printf("Saved %s as page %d\n", webpage_getURL(page), id);
             #endif
             return true;
         } else {
-            if (fname != NULL) count_free(fname);
             return false;
         }
     } else {
@@ -308,22 +737,303 @@ bool pageSaver(webpage_t* page, int* id, char* pageDir)
     }
 }
 
-/************** delete() ******************/
-// frees up the item, specifically of bag
-void delete(void* item)
+/************** crawlWorker() ******************/
+/* the start routine of a worker thread, runs processWebpages on the shared structs */
+static void* crawlWorker(void* arg)
+{
+    processWebpages(arg);
+    return NULL;
+}
+
+/************** crawlPage() ******************/
+/* fetches, saves, and scans a single webpage extracted by processWebpages.
+ * The fetch waits for its turn on the page's host first. When streaming,
+ * the links are scanned while the HTML arrives, if the page isn't at maxDepth.
+ * Deletes the webpage when done
+*/
+static void crawlPage(webpage_t* newPage, crawlState_t* state)
 {
-    // delete the item if it exists
-    if (item != NULL) {
-        count_free(item);   
+    // fetch the HTML of the page once its host is free
+    long long fetchStart = politenessWait(state->scheduler, webpage_getURL(newPage));
+    pageScan_t scan = { state, newPage, fetchStart, 0, false,
+                        state->stream && webpage_getDepth(newPage) < state->maxDepth };
+    bool fetched = pageFetcher(newPage, scan.streamed ? streamLinks : NULL, &scan);
+    scan.fetchEnd = nowNanos();
+    politenessDone(state->scheduler, fetchStart);
+    if (!fetched) {
+        // if unable to, delete the webpage to free memory and move on,
+        // remembering it if a later crawl might get it
+        journalRecord(state->journal, JOURNAL_FAILED, webpage_getURL(newPage),
+                      webpage_getDepth(newPage), 0);
+        if (webpage_fetchTimedOut()) recordTimeout(newPage, state);
+        webpage_delete(newPage);
+        return;
     }
+    if (webpage_fetchTruncated()) atomic_fetch_add(state->numTruncated, 1);
+    storePage(&scan);
+}
+
+/************** nextFetchedPage() ******************/
+/* Gets the next page the fetch engine finishes
+ *
+ * Pseudocode:
+ *      1. while the engine has room, move pages from the frontier into it,
+ *          each to start at the next slot of its host
+ *      2. wait for the engine to finish a fetch, and record it with the scheduler
+ *
+ * returns NULL once the frontier is empty and nothing is in flight. Otherwise
+ * sets *result to how its fetch ended (the page has its HTML if FETCH_OK) and
+ * *fetchStart to when it started; either way the caller must delete the page
+ * and call frontierDone()
+*/
+static webpage_t* nextFetchedPage(crawlState_t* state, fetchResult_t* result, long long* fetchStart)
+{
+    webpage_t* page;
+    while (!fetchEngineFull(state->engine) && (page = frontierTryExtract(state->toCrawl)) != NULL) {
+        long long slot = politenessReserve(state->scheduler, webpage_getURL(page));
+        if (!fetchEngineAdd(state->engine, page, slot)) {
+            webpage_delete(page);
+            frontierDone(state->toCrawl);
+        }
+    }
+
+    page = fetchEngineNext(state->engine, result, fetchStart);
+    if (page == NULL) return NULL;
+    politenessDone(state->scheduler, *fetchStart);
+    if (*result != FETCH_OK) {
+        fprintf(stderr, "Error: URL %s was not reachable\n", webpage_getURL(page));
+    }
+    return page;
+}
+
+/************** storePage() ******************/
+/* saves and scans a fetched webpage, inserting every new internal URL it
+ * links to into the frontier. A duplicate of a saved page isn't saved again,
+ * only scanned and listed as an alias of it. A page that can't be saved leaves
+ * the id it claimed empty. Deletes the webpage when done
+*/
+static void storePage(pageScan_t* scan)
+{
+    webpage_t* newPage = scan->page;
+    crawlState_t* state = scan->state;
+
+    // claim an id for the page, unless it duplicates a saved one
+    bool duplicate = false;
+    int id = dedupClaim(state->dedup, webpage_getHTML(newPage), state->idCounter, &duplicate);
+    if (duplicate) {
+        #ifdef TEST
+            printf("Aliased %s to page %d\n", webpage_getURL(newPage), id);
+        #endif
+        scanPage(scan, id, true);
+        return;
+    }
+
+    // save the page's data to the page store
+    if (!pageSaver(newPage, id, state->store)) {
+        // if unable, leave its id empty, so the indexer passes over it,
+        // and let a copy of the page be saved under another id;
+        // then delete webpage to free memory and move on
+        dedupRelease(state->dedup, id);
+        pageStoreRemove(state->store, id);
+        journalRecord(state->journal, JOURNAL_FAILED, webpage_getURL(newPage),
+                      webpage_getDepth(newPage), 0);
+        webpage_delete(newPage);
+        return;
+    }
+    journalRecord(state->journal, JOURNAL_SAVED, webpage_getURL(newPage),
+                  webpage_getDepth(newPage), id);
+    scanPage(scan, id, false);
+}
+
+/************** scanPage() ******************/
+/* inserts every new internal URL a saved webpage (or an alias of the saved
+ * page with that id) links to into the frontier, recording each in the
+ * journal before it can be crawled, then records the page as scanned.
+ * A streamed page only has the links after the last block of HTML left to
+ * scan. Deletes the webpage when done
+*/
+static void scanPage(pageScan_t* scan, const int id, const bool aliased)
+{
+    webpage_t* newPage = scan->page;
+    crawlState_t* state = scan->state;
+
+    // continue if not already at maxDepth
+    int currDepth = webpage_getDepth(newPage);
+    if (currDepth < state->maxDepth) {
+        if (scan->streamed) {
+            // the rest of the links, now that all of the HTML is in
+            char* html = webpage_getHTML(newPage);
+            scanLinks(scan, html, strlen(html), true);
+        } else {
+            // int to represent the position of the stream in the HTML
+            // so that it can pick up where it left off in subsequent loops
+            int pos = 0;
+
+            // get all of the URLs embedded in the webpage
+            char* nextURL;
+            while ((nextURL = pageScanner(newPage, &pos)) != NULL) {
+                insertLink(scan, nextURL);
+            }
+        }
+        // time the fetch of a page whose first link was timed
+        if (scan->foundLink && scan->fetchStart > 0) {
+            atomic_fetch_add(state->fetchNanos, scan->fetchEnd - scan->fetchStart);
+            atomic_fetch_add(state->numFirstLinks, 1);
+        }
+        // a page at maxDepth stays unscanned, in case a later crawl goes deeper
+        if (!aliased) {
+            journalRecord(state->journal, JOURNAL_EXPANDED, webpage_getURL(newPage), currDepth, id);
+        }
+    }
+    // an alias has no saved page to scan again later, so it is done either way
+    if (aliased) {
+        journalRecord(state->journal, JOURNAL_ALIASED, webpage_getURL(newPage), currDepth, id);
+        recordAlias(webpage_getURL(newPage), currDepth, id, state);
+    }
+    webpage_delete(newPage);
+}
+
+/************** streamLinks() ******************/
+/* the sink of a streamed fetch, scans the links in the HTML that has arrived */
+static void streamLinks(void* arg, const char* html, const size_t length)
+{
+    scanLinks(arg, html, length, false);
+}
+
+/************** scanLinks() ******************/
+/* Gives the lexer of a streamed page the HTML so far, and inserts the links it
+ * finds, up to the first one that may not be all there yet
+ *
+ * Pseudocode:
+ *      1. start the lexer on the first call, or tell it the HTML has grown
+ *      2. insert every link it can find so far; unless final, the lexer stops
+ *          at a tag that may go on past the end of the HTML, and picks it up
+ *          again on the next call
+*/
+static void scanLinks(pageScan_t* scan, const char* html, const size_t length, const bool final)
+{
+    if (!scan->lexing) {
+        html_init(&scan->lexer, html, length, 0, final ? 0 : HTML_STREAMING);
+        scan->lexing = true;
+    } else {
+        html_feed(&scan->lexer, html, length, final);
+    }
+    char* nextURL;
+    while ((nextURL = webpage_nextLink(&scan->lexer, webpage_getURL(scan->page))) != NULL) {
+        insertLink(scan, nextURL);
+    }
+}
+
+/************** insertLink() ******************/
+/* inserts a URL a page links to into the frontier, one level deeper than the page,
+ * if it is internal and not yet visited, recording it in the journal first. The
+ * first link of a fetched page is timed from the start of its fetch. Frees the URL
+*/
+static void insertLink(pageScan_t* scan, char* nextURL)
+{
+    crawlState_t* state = scan->state;
+    if (!scan->foundLink) {
+        scan->foundLink = true;
+        if (scan->fetchStart > 0) atomic_fetch_add(state->firstLinkNanos, nowNanos() - scan->fetchStart);
+    }
+
+    // check if within cs50tse domain and normalized
+    if (!IsInternalURL(nextURL)) {
+        // testing print statement when URL can't be normalized
+        // or is not within cs50tse domain
+        #ifdef TEST
+            printf("URL %s is invalid!\n", nextURL);  
+        #endif
+        count_free(nextURL);
+        return;
+    }
+    // insert the URL into the visited set
+    int depth = webpage_getDepth(scan->page) + 1;
+    if (visitedSetInsert(state->visitedURLs, nextURL)) {
+        // increment depth, and insert the URL into the frontier
+        journalRecord(state->journal, JOURNAL_DISCOVERED, nextURL, depth, 0);
+        frontierInsert(state->toCrawl, nextURL, depth);
+    }
+    count_free(nextURL);
+}
+
+/************** resumeURL() ******************/
+/* resumeJournal helper, puts one URL of the journal back into the crawl in
+ * arg: every URL is visited, discovered ones within maxDepth go back in the
+ * frontier, saved ones are fingerprinted again and those that weren't
+ * scanned are listed to scan again, and aliased ones are listed again
+*/
+static void resumeURL(void* arg, const char* URL, const int depth, const int id,
+                      const journalState_t state)
+{
+    resumeState_t* resumed = arg;
+    crawlState_t* crawl = resumed->state;
+    visitedSetInsert(crawl->visitedURLs, URL);
+    if (state == JOURNAL_SAVED || state == JOURNAL_EXPANDED) {
+        webpage_t* page = pageStoreGet(crawl->store, id);
+        if (page != NULL) {
+            dedupAdd(crawl->dedup, webpage_getHTML(page), id);
+            webpage_delete(page);
+        }
+    } else if (state == JOURNAL_ALIASED) {
+        recordAlias(URL, depth, id, crawl);
+    }
+    if (state == JOURNAL_DISCOVERED && depth <= crawl->maxDepth) {
+        frontierInsert(crawl->toCrawl, URL, depth);
+        resumed->numPending++;
+    } else if (state == JOURNAL_SAVED && depth < crawl->maxDepth) {
+        if (resumed->numRescan == resumed->maxRescan) {
+            int maxRescan = resumed->maxRescan > 0 ? resumed->maxRescan * 2 : 16;
+            int* bigger = realloc(resumed->rescan, maxRescan * sizeof(int));
+            if (bigger == NULL) return;
+            resumed->rescan = bigger;
+            resumed->maxRescan = maxRescan;
+        }
+        resumed->rescan[resumed->numRescan++] = id;
+    }
+}
+
+/************** recordTimeout() ******************/
+/* counts a page whose fetch timed out, and lists it in the crawl's .timedout file */
+static void recordTimeout(webpage_t* page, crawlState_t* state)
+{
+    atomic_fetch_add(state->numTimedOut, 1);
+    if (state->timedOutFile != NULL) {
+        // one call per line, so lines from different workers don't mix
+        fprintf(state->timedOutFile, "%d %s\n", webpage_getDepth(page), webpage_getURL(page));
+    }
+}
+
+/************** recordAlias() ******************/
+/* lists a duplicate page in the crawl's .aliases file, as the id of the saved
+ * page it duplicates, its depth, and its URL
+*/
+static void recordAlias(const char* URL, const int depth, const int id, crawlState_t* state)
+{
+    if (state->aliasFile != NULL) {
+        // one call per line, so lines from different workers don't mix
+        fprintf(state->aliasFile, "%d %d %s\n", id, depth, URL);
+    }
+}
+
+/************** nowNanos() ******************/
+// returns the current monotonic time in nanoseconds, like the politeness scheduler's
+static long long nowNanos(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
 }
 
 /************** freeStructs() ******************/
-// calls the delete functions on the hashtable and bag structs
- 
-void freeStructs(hashtable_t* ht, bag_t* bag) 
+// calls the delete functions on the visited set, frontier, scheduler, dedup, and page store structs
+static void freeStructs(visitedSet_t* set, frontier_t* frontier, politeness_t* scheduler, dedup_t* dedup,
+                        pageStore_t* store) 
 {
     // call the delete items on each struct
-    if (ht != NULL) hashtable_delete(ht, NULL);
-    if (bag != NULL) bag_delete(bag, delete);
-}
\ No newline at end of file
+    if (set != NULL) deleteVisitedSet(set);
+    if (frontier != NULL) deleteFrontier(frontier);
+    if (scheduler != NULL) deletePoliteness(scheduler);
+    if (dedup != NULL) deleteDedup(dedup);
+    if (store != NULL) deletePageStore(store);
+}
@@ -0,0 +1,359 @@
+/*
+ * dedup.c - thread-safe index of the fingerprints of saved pages
+ *
+ * see dedup.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "dedup.h"
+#include "memory.h"
+
+/************* global types ****************/
+
+// with at most 3 bits differing, one of 4 blocks of 16 bits is the same
+#define NUM_BLOCKS (DEDUP_MAX_DISTANCE + 1)
+#define BLOCK_BITS (64 / NUM_BLOCKS)
+
+typedef struct fingerprint { // what a page is matched by
+    uint64_t exact;             // hash of the whole HTML
+    size_t length;              // length of the HTML
+    uint64_t simhash;           // simhash of the text's three-word shingles
+    bool hasSimhash;            // false if the text has fewer than three words
+} fingerprint_t;
+
+typedef struct dedupEntry { // a saved page
+    fingerprint_t print;
+    int id;                     // 0 once released, so it matches no page
+    int next[NUM_BLOCKS];       // next entry with the same value of each block, or -1
+} dedupEntry_t;
+
+typedef struct dedup {
+    dedupEntry_t* entries;
+    int numEntries;
+    int maxEntries;
+    int* exactSlots;            // entry index + 1 by exact hash, 0 for an empty slot
+    size_t exactCapacity;       // a power of 2
+    int* blockHeads[NUM_BLOCKS]; // first entry with each value of a block, or -1; NULL for exact only
+    int maxDistance;
+    int numExact;
+    int numNear;
+    long long bytesSkipped;
+    pthread_mutex_t lock;       // guards everything above
+} dedup_t;
+
+/************* local function prototypes ****************/
+
+static void fingerprintPage(const char* html, fingerprint_t* print);
+static uint64_t mix(uint64_t hash);
+static int compareHashes(const void* a, const void* b);
+static int findDuplicate(dedup_t* dedup, const fingerprint_t* print, bool* near);
+static bool addEntry(dedup_t* dedup, const fingerprint_t* print, const int id);
+static bool growExactSlots(dedup_t* dedup);
+
+/************** newDedup() ******************/
+// see dedup.h for description
+dedup_t* newDedup(const int maxDistance)
+{
+    if (maxDistance < -1 || maxDistance > DEDUP_MAX_DISTANCE) return NULL;
+    dedup_t* dedup = count_calloc(1, sizeof(dedup_t));
+    if (dedup == NULL) return NULL;
+    pthread_mutex_init(&dedup->lock, NULL);
+    dedup->maxDistance = maxDistance;
+    bool created = growExactSlots(dedup);
+    for (int b = 0; created && maxDistance >= 0 && b < NUM_BLOCKS; b++) {
+        dedup->blockHeads[b] = count_malloc(((size_t) 1 << BLOCK_BITS) * sizeof(int));
+        if (dedup->blockHeads[b] == NULL) {
+            created = false;
+        } else {
+            for (size_t v = 0; v < (size_t) 1 << BLOCK_BITS; v++) dedup->blockHeads[b][v] = -1;
+        }
+    }
+    if (!created) {
+        deleteDedup(dedup);
+        return NULL;
+    }
+    return dedup;
+}
+
+/************** deleteDedup() ******************/
+// see dedup.h for description
+void deleteDedup(dedup_t* dedup)
+{
+    if (dedup == NULL) return;
+    if (dedup->entries != NULL) free(dedup->entries);
+    if (dedup->exactSlots != NULL) count_free(dedup->exactSlots);
+    for (int b = 0; b < NUM_BLOCKS; b++) {
+        if (dedup->blockHeads[b] != NULL) count_free(dedup->blockHeads[b]);
+    }
+    pthread_mutex_destroy(&dedup->lock);
+    count_free(dedup);
+}
+
+/************** dedupClaim() ******************/
+// see dedup.h for description
+int dedupClaim(dedup_t* dedup, const char* html, atomic_int* idCounter, bool* duplicate)
+{
+    if (dedup == NULL || html == NULL || idCounter == NULL || duplicate == NULL) return 0;
+    // hash outside the lock, it's the slow part
+    fingerprint_t print;
+    fingerprintPage(html, &print);
+
+    pthread_mutex_lock(&dedup->lock);
+    bool near;
+    int found = findDuplicate(dedup, &print, &near);
+    int id;
+    if (found >= 0) {
+        *duplicate = true;
+        id = dedup->entries[found].id;
+        if (near) {
+            dedup->numNear++;
+        } else {
+            dedup->numExact++;
+        }
+        dedup->bytesSkipped += print.length;
+    } else {
+        // out of memory only means later copies of this page get saved too
+        *duplicate = false;
+        id = atomic_fetch_add(idCounter, 1);
+        addEntry(dedup, &print, id);
+    }
+    pthread_mutex_unlock(&dedup->lock);
+    return id;
+}
+
+/************** dedupAdd() ******************/
+// see dedup.h for description
+bool dedupAdd(dedup_t* dedup, const char* html, const int id)
+{
+    if (dedup == NULL || html == NULL) return false;
+    fingerprint_t print;
+    fingerprintPage(html, &print);
+    pthread_mutex_lock(&dedup->lock);
+    bool added = addEntry(dedup, &print, id);
+    pthread_mutex_unlock(&dedup->lock);
+    return added;
+}
+
+/************** dedupRelease() ******************/
+// see dedup.h for description
+void dedupRelease(dedup_t* dedup, const int id)
+{
+    if (dedup == NULL || id < 1) return;
+    pthread_mutex_lock(&dedup->lock);
+    // the entry was just added, so look from the newest one back;
+    // it stays in the tables, since open addressing can't drop a slot
+    for (int i = dedup->numEntries - 1; i >= 0; i--) {
+        if (dedup->entries[i].id == id) {
+            dedup->entries[i].id = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&dedup->lock);
+}
+
+/************** dedupStats() ******************/
+// see dedup.h for description
+void dedupStats(dedup_t* dedup, int* numExact, int* numNear, long long* bytesSkipped)
+{
+    if (dedup == NULL) return;
+    pthread_mutex_lock(&dedup->lock);
+    if (numExact != NULL) *numExact = dedup->numExact;
+    if (numNear != NULL) *numNear = dedup->numNear;
+    if (bytesSkipped != NULL) *bytesSkipped = dedup->bytesSkipped;
+    pthread_mutex_unlock(&dedup->lock);
+}
+
+/************** fingerprintPage() ******************/
+/* Computes the fingerprints of a page's HTML
+ *
+ * Pseudocode:
+ *      1. hash every byte of the HTML with FNV-1a for the exact hash
+ *      2. outside of tags, hash each word of at least 3 letters, lowercased,
+ *          like the indexer's words
+ *      3. hash each run of three words in a row (a shingle)
+ *      4. for each different shingle, and each bit, count +1 if the shingle's
+ *          hash has the bit set, -1 if not; the simhash has the bits whose
+ *          count came out positive
+ *
+ * Counting a shingle once however often it repeats keeps a template's
+ * repeated parts (like an "add to basket" under every item of a listing)
+ * from outweighing the text that differs
+*/
+static void fingerprintPage(const char* html, fingerprint_t* print)
+{
+    uint64_t exact = 14695981039346656037ULL;
+    int counts[64] = { 0 };
+    uint64_t words[3] = { 0, 0, 0 }; // the last three words' hashes, newest last
+    int numWords = 0;
+    uint64_t* shingles = NULL;
+    int numShingles = 0, maxShingles = 0;
+    bool inTag = false;
+    const unsigned char* c = (const unsigned char*) html;
+    while (*c != '\0') {
+        if (inTag || *c == '<' || !isalpha(*c)) {
+            if (*c == '<') inTag = true;
+            if (*c == '>') inTag = false;
+            exact = (exact ^ *c) * 1099511628211ULL;
+            c++;
+            continue;
+        }
+        // hash one word, feeding the exact hash as it goes
+        uint64_t word = 14695981039346656037ULL;
+        int length = 0;
+        for (; isalpha(*c); c++, length++) {
+            exact = (exact ^ *c) * 1099511628211ULL;
+            word = (word ^ tolower(*c)) * 1099511628211ULL;
+        }
+        if (length < 3) continue;
+        words[0] = words[1];
+        words[1] = words[2];
+        words[2] = mix(word);
+        if (++numWords < 3) continue;
+
+        if (numShingles == maxShingles) {
+            int bigger = maxShingles > 0 ? maxShingles * 2 : 1024;
+            uint64_t* more = realloc(shingles, bigger * sizeof(uint64_t));
+            if (more == NULL) continue; // the simhash just leaves the rest out
+            shingles = more;
+            maxShingles = bigger;
+        }
+        // rotating keeps the shingle's hash sensitive to the words' order
+        shingles[numShingles++] = mix(words[0] ^ (words[1] << 21 | words[1] >> 43)
+                                      ^ (words[2] << 42 | words[2] >> 22));
+    }
+
+    // sorting brings the repeats of a shingle together, to count it once
+    if (numShingles > 0) qsort(shingles, numShingles, sizeof(uint64_t), compareHashes);
+    for (int i = 0; i < numShingles; i++) {
+        if (i > 0 && shingles[i] == shingles[i - 1]) continue;
+        for (int bit = 0; bit < 64; bit++) {
+            counts[bit] += (shingles[i] >> bit & 1) ? 1 : -1;
+        }
+    }
+    if (shingles != NULL) free(shingles);
+
+    print->exact = mix(exact);
+    print->length = (const char*) c - html;
+    print->simhash = 0;
+    for (int bit = 0; bit < 64; bit++) {
+        if (counts[bit] > 0) print->simhash |= 1ULL << bit;
+    }
+    print->hasSimhash = numWords >= 3;
+}
+
+/************** mix() ******************/
+/* mixes the bits of a hash (as in MurmurHash3), so that every bit depends on every other */
+static uint64_t mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/************** compareHashes() ******************/
+// qsort helper, orders 64-bit hashes
+static int compareHashes(const void* a, const void* b)
+{
+    uint64_t hashA = *(const uint64_t*) a;
+    uint64_t hashB = *(const uint64_t*) b;
+    return (hashA > hashB) - (hashA < hashB);
+}
+
+/************** findDuplicate() ******************/
+/* returns the index of the entry with the same exact fingerprint, or else of
+ * one whose simhash is within maxDistance bits (setting *near to true), or -1,
+ * passing over released entries.
+ * Any simhash within maxDistance bits has one of its blocks equal to the
+ * page's, so only the entries listed under the page's blocks are compared
+*/
+static int findDuplicate(dedup_t* dedup, const fingerprint_t* print, bool* near)
+{
+    *near = false;
+    size_t mask = dedup->exactCapacity - 1;
+    for (size_t slot = print->exact & mask; dedup->exactSlots[slot] != 0; slot = (slot + 1) & mask) {
+        dedupEntry_t* entry = &dedup->entries[dedup->exactSlots[slot] - 1];
+        if (entry->id != 0 && entry->print.exact == print->exact && entry->print.length == print->length) {
+            return dedup->exactSlots[slot] - 1;
+        }
+    }
+
+    if (dedup->maxDistance < 0 || !print->hasSimhash) return -1;
+    for (int b = 0; b < NUM_BLOCKS; b++) {
+        size_t value = print->simhash >> (b * BLOCK_BITS) & (((uint64_t) 1 << BLOCK_BITS) - 1);
+        for (int e = dedup->blockHeads[b][value]; e != -1; e = dedup->entries[e].next[b]) {
+            if (dedup->entries[e].id != 0
+                && __builtin_popcountll(dedup->entries[e].print.simhash ^ print->simhash) <= dedup->maxDistance) {
+                *near = true;
+                return e;
+            }
+        }
+    }
+    return -1;
+}
+
+/************** addEntry() ******************/
+/* indexes a page's fingerprints under its id, with the lock held;
+ * returns false if out of memory
+*/
+static bool addEntry(dedup_t* dedup, const fingerprint_t* print, const int id)
+{
+    if (dedup->numEntries == dedup->maxEntries) {
+        int maxEntries = dedup->maxEntries > 0 ? dedup->maxEntries * 2 : 64;
+        dedupEntry_t* bigger = realloc(dedup->entries, maxEntries * sizeof(dedupEntry_t));
+        if (bigger == NULL) return false;
+        dedup->entries = bigger;
+        dedup->maxEntries = maxEntries;
+    }
+    // keep the exact slots at most half full
+    if ((size_t) dedup->numEntries + 1 > dedup->exactCapacity / 2 && !growExactSlots(dedup)) {
+        return false;
+    }
+
+    int index = dedup->numEntries++;
+    dedupEntry_t* entry = &dedup->entries[index];
+    entry->print = *print;
+    entry->id = id;
+    size_t mask = dedup->exactCapacity - 1;
+    size_t slot = print->exact & mask;
+    while (dedup->exactSlots[slot] != 0) slot = (slot + 1) & mask;
+    dedup->exactSlots[slot] = index + 1;
+
+    for (int b = 0; b < NUM_BLOCKS; b++) {
+        entry->next[b] = -1;
+        if (dedup->blockHeads[b] != NULL && print->hasSimhash) {
+            size_t value = print->simhash >> (b * BLOCK_BITS) & (((uint64_t) 1 << BLOCK_BITS) - 1);
+            entry->next[b] = dedup->blockHeads[b][value];
+            dedup->blockHeads[b][value] = index;
+        }
+    }
+    return true;
+}
+
+/************** growExactSlots() ******************/
+/* doubles the exact hash slots (or creates the first 64), moving the entries
+ * over; returns false, leaving them as they were, if out of memory
+*/
+static bool growExactSlots(dedup_t* dedup)
+{
+    size_t capacity = dedup->exactCapacity > 0 ? dedup->exactCapacity * 2 : 64;
+    int* slots = count_calloc(capacity, sizeof(int));
+    if (slots == NULL) return false;
+    for (int i = 0; i < dedup->numEntries; i++) {
+        size_t slot = dedup->entries[i].print.exact & (capacity - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = i + 1;
+    }
+    if (dedup->exactSlots != NULL) count_free(dedup->exactSlots);
+    dedup->exactSlots = slots;
+    dedup->exactCapacity = capacity;
+    return true;
+}
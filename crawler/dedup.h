@@ -0,0 +1,82 @@
+/*
+ * dedup.h - header file for the 'dedup' file in the 'crawler' module
+ *
+ * the dedup index keeps the crawler from saving the same page twice under
+ * different URLs, like a directory and its index.html. It fingerprints the
+ * HTML of every saved page twice:
+ *      an exact hash of the whole HTML and its length, which only a
+ *          byte-identical page matches
+ *      a 64-bit simhash of the text's three-word shingles, which pages
+ *          differing in a few words or only in their markup share most bits of
+ * A fetched page matching a saved one is a duplicate, and is recorded as an
+ * alias of the saved page's id instead of being saved and indexed again.
+ * Matching simhashes is optional, since pages built from one template
+ * (like two category listings of a store) can be a few bits apart too.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __DEDUP
+#define __DEDUP
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/**************** global types ****************/
+typedef struct dedup dedup_t; // a thread-safe index of saved pages' fingerprints
+
+/**************** global constants ****************/
+#define DEDUP_MAX_DISTANCE 3 // most simhash bits a near-duplicate may differ in
+
+/******************* functions *******************/
+
+/******************* newDedup() ******************/
+/* creates an empty index that treats pages whose simhashes differ in at most
+ * maxDistance bits as duplicates, or only byte-identical pages if maxDistance
+ * is -1. Returns NULL if out of memory or maxDistance is above DEDUP_MAX_DISTANCE
+*/
+dedup_t* newDedup(const int maxDistance);
+
+/******************* deleteDedup() ******************/
+/* deletes the index */
+void deleteDedup(dedup_t* dedup);
+
+/******************* dedupClaim() ******************/
+/* Finds the saved page a fetched page duplicates, or claims an id to save it under
+ *
+ * Pseudocode:
+ *      1. fingerprint the HTML, then lock the index
+ *      2. look the exact hash up; if no page has it and simhashes are
+ *          matched, look for a page whose simhash is within maxDistance bits
+ *      3. if one is found, set *duplicate to true and return its id
+ *      4. otherwise claim the next id from idCounter, index the fingerprints
+ *          under it, set *duplicate to false, and return it
+ *
+ * Claiming the id under the same lock as the lookup means two workers
+ * fetching the same page at once can't both save it. If out of memory, the
+ * page still gets an id, but later copies of it won't be found.
+ * returns 0 on invalid arguments
+*/
+int dedupClaim(dedup_t* dedup, const char* html, atomic_int* idCounter, bool* duplicate);
+
+/******************* dedupAdd() ******************/
+/* indexes the fingerprints of a page already saved under id, like the pages
+ * of a resumed crawl; returns false if out of memory
+*/
+bool dedupAdd(dedup_t* dedup, const char* html, const int id);
+
+/******************* dedupRelease() ******************/
+/* forgets the fingerprints dedupClaim indexed under id, for a page that then
+ * couldn't be saved, so a later copy of it is saved instead of being aliased
+ * to an id with no page. The id isn't given back: it stays empty
+*/
+void dedupRelease(dedup_t* dedup, const int id);
+
+/******************* dedupStats() ******************/
+/* sets *numExact and *numNear to the number of fetched pages found to be
+ * byte-identical or near duplicates, and *bytesSkipped to the bytes of HTML
+ * they would have taken; any pointer may be NULL
+*/
+void dedupStats(dedup_t* dedup, int* numExact, int* numNear, long long* bytesSkipped);
+
+#endif
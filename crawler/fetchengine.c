@@ -0,0 +1,851 @@
+/*
+ * fetchengine.c - event-driven engine that keeps many fetches in flight on one thread
+ *
+ * see fetchengine.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L // strncasecmp, rand_r
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include "fetchengine.h"
+#include "resolver.h"
+#include "memory.h"
+
+/************* file-local types ****************/
+
+typedef enum fetchPhase {
+    PHASE_FREE,             // the slot holds no fetch
+    PHASE_WAITING,          // waiting for its start time
+    PHASE_CONNECTING,       // a non-blocking connect is in progress
+    PHASE_SENDING,          // writing the request
+    PHASE_READING,          // reading the response
+    PHASE_DONE              // finished, waiting to be handed back
+} fetchPhase_t;
+
+typedef struct idleConn { // an open connection with no fetch on it
+    int sock;
+    char* host;
+    int port;
+    struct idleConn* next;
+} idleConn_t;
+
+typedef struct fetch {
+    fetchPhase_t phase;
+    webpage_t* page;            // the page being fetched
+    long long startTime;        // earliest time to start, in nanoseconds
+    char* host;                 // split from the page's URL
+    int port;
+    char* path;
+    int sock;                   // -1 when there is no connection
+    bool reused;                // the connection was idle before this fetch
+    bool retried;               // already retried once on a new connection
+    int connects;               // attempts to connect so far
+    long long deadline;         // when the current phase times out, 0 for never
+    long long totalDeadline;    // when the whole response must be in, 0 for never
+    bool timedOut;              // a connect or read ran out of time
+    size_t sent;                // bytes of the request written so far
+
+    char* buf;                  // the raw response, always '\0'-terminated
+    size_t length;              // bytes of the response read so far
+    size_t capacity;            // bytes allocated for buf
+    size_t scanned;             // where the next status or header line starts
+    bool answered;              // the status line has been read
+    bool headersDone;           // the blank line after the headers has been read
+    int code;                   // the response code
+    bool keepAlive;             // the connection may carry another request
+    bool chunked;               // the body uses chunked encoding
+    long long contentLength;    // length of the body, -1 if not given
+    size_t bodyStart;           // where the body starts in buf
+    size_t bodyEnd;             // where the (decoded) body ends in buf
+    size_t chunkPos;            // where the next chunk size line starts in buf
+    bool inTrailers;            // past the last chunk, skipping trailer headers
+    bool truncated;             // the body was cut off at maxPageSize
+
+    char* html;                 // the body of a 200 response, once done
+    struct fetch* nextDone;     // the next finished fetch to hand back
+} fetch_t;
+
+typedef struct fetchEngine {
+    int epfd;                   // the epoll instance
+    fetch_t* fetches;           // maxFetches slots
+    int maxFetches;
+    int numFetches;             // slots not free
+    fetch_t* doneHead;          // finished fetches, oldest first
+    fetch_t* doneTail;
+    idleConn_t* idle;           // idle connections, most recently used first
+    int idlePerHost;
+    int opened;                 // connections opened
+    int reused;                 // fetches that reused an idle connection
+    long long connectTimeout;   // nanoseconds for each connect, 0 for no limit
+    long long firstByteTimeout; // nanoseconds from the request to the status line
+    long long totalTimeout;     // nanoseconds from the request to the end of the body
+    size_t maxPageSize;         // most bytes of HTML kept from a response, 0 for no limit
+    int truncated;              // pages cut off at maxPageSize
+    unsigned int jitterSeed;    // random state for the backoff
+} fetchEngine_t;
+
+/************* global variables ****************/
+
+static const int MAX_EVENTS = 64;           // socket events handled per epoll_wait
+static const size_t READ_CHUNK = 16384;     // least room to read into at once
+static const int MAX_CONNECTS = 3;          // attempts to connect, like webpage_fetch
+static const long long BACKOFF_BASE = 250;  // milliseconds before the first retry
+static const long long BACKOFF_MAX = 4000;  // most milliseconds before any retry
+static const char* REQUEST_FORMAT = "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n";
+
+/************* local function prototypes ****************/
+
+static long long now(void);
+static bool splitURL(const char* url, char** host, int* port, char** path);
+static void startFetch(fetchEngine_t* engine, fetch_t* fetch);
+static bool connectFetch(fetchEngine_t* engine, fetch_t* fetch);
+static void retryConnect(fetchEngine_t* engine, fetch_t* fetch, const bool timedOut);
+static void startSending(fetchEngine_t* engine, fetch_t* fetch);
+static void advanceFetch(fetchEngine_t* engine, fetch_t* fetch);
+static bool sendRequest(fetchEngine_t* engine, fetch_t* fetch);
+static void readResponse(fetchEngine_t* engine, fetch_t* fetch);
+static int parseResponse(fetch_t* fetch);
+static void parseHeader(fetch_t* fetch, const char* line, const size_t length);
+static int decodeChunks(fetch_t* fetch);
+static int cutBody(fetch_t* fetch, const size_t maxPageSize, const int status);
+static void failFetch(fetchEngine_t* engine, fetch_t* fetch);
+static void finishFetch(fetchEngine_t* engine, fetch_t* fetch, const bool complete);
+static void resetResponse(fetch_t* fetch);
+static void releaseFetch(fetch_t* fetch);
+
+/************** newFetchEngine() ******************/
+// see fetchengine.h for description
+fetchEngine_t* newFetchEngine(const int maxFetches, const int idlePerHost)
+{
+    if (maxFetches < 1) return NULL;
+    fetchEngine_t* engine = count_calloc(1, sizeof(fetchEngine_t));
+    if (engine == NULL) return NULL;
+    engine->fetches = count_calloc(maxFetches, sizeof(fetch_t));
+    engine->epfd = epoll_create1(0);
+    if (engine->fetches == NULL || engine->epfd < 0) {
+        fprintf(stderr, "Error: could not create the fetch engine\n");
+        if (engine->epfd >= 0) close(engine->epfd);
+        if (engine->fetches != NULL) count_free(engine->fetches);
+        count_free(engine);
+        return NULL;
+    }
+    for (int i = 0; i < maxFetches; i++) {
+        engine->fetches[i].phase = PHASE_FREE;
+        engine->fetches[i].sock = -1;
+    }
+    engine->maxFetches = maxFetches;
+    engine->idlePerHost = idlePerHost > 0 ? idlePerHost : 0;
+    engine->jitterSeed = now() ^ (uintptr_t) engine;
+    fetchEngineSetTimeouts(engine, 5000, 10000, 30000);
+    return engine;
+}
+
+/************** deleteFetchEngine() ******************/
+// see fetchengine.h for description
+void deleteFetchEngine(fetchEngine_t* engine)
+{
+    if (engine == NULL) return;
+    for (int i = 0; i < engine->maxFetches; i++) {
+        fetch_t* fetch = &engine->fetches[i];
+        if (fetch->phase == PHASE_FREE) continue;
+        if (fetch->sock >= 0) close(fetch->sock);
+        webpage_delete(fetch->page);
+        free(fetch->html);
+        releaseFetch(fetch);
+    }
+    while (engine->idle != NULL) {
+        idleConn_t* conn = engine->idle;
+        engine->idle = conn->next;
+        close(conn->sock);
+        count_free(conn->host);
+        count_free(conn);
+    }
+    close(engine->epfd);
+    count_free(engine->fetches);
+    count_free(engine);
+}
+
+/************** fetchEngineSetTimeouts() ******************/
+// see fetchengine.h for description
+void fetchEngineSetTimeouts(fetchEngine_t* engine, const int connectMs, const int firstByteMs,
+                            const int totalMs)
+{
+    if (engine == NULL) return;
+    engine->connectTimeout = connectMs > 0 ? connectMs * 1000000LL : 0;
+    engine->firstByteTimeout = firstByteMs > 0 ? firstByteMs * 1000000LL : 0;
+    engine->totalTimeout = totalMs > 0 ? totalMs * 1000000LL : 0;
+}
+
+/************** fetchEngineSetMaxPageSize() ******************/
+// see fetchengine.h for description
+void fetchEngineSetMaxPageSize(fetchEngine_t* engine, const size_t bytes)
+{
+    if (engine != NULL) engine->maxPageSize = bytes;
+}
+
+/************** fetchEngineAdd() ******************/
+// see fetchengine.h for description
+bool fetchEngineAdd(fetchEngine_t* engine, webpage_t* page, const long long startTime)
+{
+    if (engine == NULL || page == NULL || engine->numFetches == engine->maxFetches) return false;
+    fetch_t* fetch = engine->fetches;
+    while (fetch->phase != PHASE_FREE) fetch++;
+
+    fetch->page = page;
+    fetch->startTime = startTime;
+    fetch->sock = -1;
+    fetch->reused = false;
+    fetch->retried = false;
+    fetch->connects = 0;
+    fetch->deadline = fetch->totalDeadline = 0;
+    fetch->timedOut = false;
+    fetch->html = NULL;
+    fetch->nextDone = NULL;
+    fetch->host = fetch->path = NULL;
+    fetch->buf = NULL;
+    resetResponse(fetch);
+    engine->numFetches++;
+
+    // a URL we can't fetch finishes right away, without HTML
+    if (!splitURL(webpage_getURL(page), &fetch->host, &fetch->port, &fetch->path)) {
+        finishFetch(engine, fetch, false);
+        return true;
+    }
+    fetch->phase = PHASE_WAITING;
+    return true;
+}
+
+/************** fetchEngineCount() ******************/
+// see fetchengine.h for description
+int fetchEngineCount(fetchEngine_t* engine)
+{
+    return engine == NULL ? 0 : engine->numFetches;
+}
+
+/************** fetchEngineFull() ******************/
+// see fetchengine.h for description
+bool fetchEngineFull(fetchEngine_t* engine)
+{
+    return engine == NULL || engine->numFetches == engine->maxFetches;
+}
+
+/************** fetchEngineNext() ******************/
+// see fetchengine.h for description
+webpage_t* fetchEngineNext(fetchEngine_t* engine, fetchResult_t* result, long long* startTime)
+{
+    if (engine == NULL || engine->numFetches == 0) return NULL;
+
+    struct epoll_event events[MAX_EVENTS];
+    while (engine->doneHead == NULL) {
+        // start the fetches whose time has come, time out those whose deadline
+        // has passed, and find when the next start or deadline will come
+        long long current = now();
+        long long nextWake = -1;
+        for (int i = 0; i < engine->maxFetches; i++) {
+            fetch_t* fetch = &engine->fetches[i];
+            long long wake;
+            if (fetch->phase == PHASE_WAITING) {
+                if (fetch->startTime <= current) startFetch(engine, fetch);
+            } else if (fetch->phase == PHASE_CONNECTING && fetch->deadline > 0
+                       && fetch->deadline <= current) {
+                retryConnect(engine, fetch, true);
+            } else if ((fetch->phase == PHASE_SENDING || fetch->phase == PHASE_READING)
+                       && fetch->deadline > 0 && fetch->deadline <= current) {
+                fetch->timedOut = true;
+                finishFetch(engine, fetch, false);
+            }
+            // a fetch that just started or retried may be due to wake up later
+            if (fetch->phase == PHASE_WAITING) {
+                wake = fetch->startTime;
+            } else if (fetch->phase == PHASE_CONNECTING || fetch->phase == PHASE_SENDING
+                       || fetch->phase == PHASE_READING) {
+                wake = fetch->deadline > 0 ? fetch->deadline : -1;
+            } else {
+                wake = -1;
+            }
+            if (wake >= 0 && (nextWake < 0 || wake < nextWake)) nextWake = wake;
+        }
+        if (engine->doneHead != NULL) break;
+
+        // sleep until a socket is ready, or the next start or deadline
+        int timeout = -1;
+        if (nextWake >= 0) timeout = nextWake > current ? (nextWake - current + 999999) / 1000000 : 0;
+        int numEvents = epoll_wait(engine->epfd, events, MAX_EVENTS, timeout);
+        if (numEvents < 0) {
+            if (errno == EINTR) continue;
+            // the engine can't make progress: fail everything still in flight
+            fprintf(stderr, "Error: epoll_wait failed\n");
+            for (int i = 0; i < engine->maxFetches; i++) {
+                fetch_t* fetch = &engine->fetches[i];
+                if (fetch->phase != PHASE_FREE && fetch->phase != PHASE_DONE) {
+                    finishFetch(engine, fetch, false);
+                }
+            }
+            break;
+        }
+        for (int i = 0; i < numEvents; i++) {
+            advanceFetch(engine, events[i].data.ptr);
+        }
+    }
+
+    // hand back the oldest finished fetch
+    fetch_t* fetch = engine->doneHead;
+    engine->doneHead = fetch->nextDone;
+    if (engine->doneHead == NULL) engine->doneTail = NULL;
+
+    webpage_t* page = fetch->page;
+    *result = fetch->timedOut ? FETCH_TIMED_OUT : FETCH_FAILED;
+    if (fetch->html != NULL) {
+        // the page's HTML can only be set by webpage_new, so make a copy with it
+        char* url = webpage_getURL(page);
+        char* copy = count_malloc(strlen(url) + 1);
+        if (copy != NULL) {
+            strcpy(copy, url);
+            webpage_t* withHTML = webpage_new(copy, webpage_getDepth(page), fetch->html);
+            webpage_delete(page);
+            page = withHTML;
+            *result = FETCH_OK;
+        } else {
+            free(fetch->html);
+        }
+    }
+    if (startTime != NULL) *startTime = fetch->startTime;
+    releaseFetch(fetch);
+    engine->numFetches--;
+    return page;
+}
+
+/************** fetchEngineStats() ******************/
+// see fetchengine.h for description
+void fetchEngineStats(fetchEngine_t* engine, int* opened, int* reused, int* truncated)
+{
+    if (opened != NULL) *opened = engine == NULL ? 0 : engine->opened;
+    if (reused != NULL) *reused = engine == NULL ? 0 : engine->reused;
+    if (truncated != NULL) *truncated = engine == NULL ? 0 : engine->truncated;
+}
+
+/************** now() ******************/
+// returns the current monotonic time in nanoseconds
+static long long now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/************** splitURL() ******************/
+/* splits an "http://host[:port][/path]" URL into a malloc'd host and path
+ * (at least "/") and the port (80 if not given), returns false if the URL has
+ * another scheme or is malformed, or if out of memory
+*/
+static bool splitURL(const char* url, char** host, int* port, char** path)
+{
+    if (url == NULL || strncasecmp(url, "http://", 7) != 0) return false;
+    const char* start = url + 7;
+    size_t hostLength = strcspn(start, ":/");
+    if (hostLength == 0) return false;
+
+    const char* rest = start + hostLength;
+    *port = 80;
+    if (*rest == ':') {
+        char* end;
+        long value = strtol(rest + 1, &end, 10);
+        if (end == rest + 1 || value < 1 || value > 65535 || (*end != '/' && *end != '\0')) {
+            return false;
+        }
+        *port = value;
+        rest = end;
+    }
+    if (*rest == '\0') rest = "/";
+
+    *host = count_malloc(hostLength + 1);
+    *path = count_malloc(strlen(rest) + 1);
+    if (*host == NULL || *path == NULL) {
+        if (*host != NULL) count_free(*host);
+        if (*path != NULL) count_free(*path);
+        *host = *path = NULL;
+        return false;
+    }
+    memcpy(*host, start, hostLength);
+    (*host)[hostLength] = '\0';
+    strcpy(*path, rest);
+    return true;
+}
+
+/************** startFetch() ******************/
+/* starts a waiting fetch on an idle connection to its host if there is one,
+ * otherwise on a new connection; finishes it without HTML if neither works
+*/
+static void startFetch(fetchEngine_t* engine, fetch_t* fetch)
+{
+    for (idleConn_t** link = &engine->idle; *link != NULL; link = &(*link)->next) {
+        idleConn_t* conn = *link;
+        if (conn->port == fetch->port && strcmp(conn->host, fetch->host) == 0) {
+            *link = conn->next;
+            fetch->sock = conn->sock;
+            count_free(conn->host);
+            count_free(conn);
+
+            fetch->reused = true;
+            engine->reused++;
+            struct epoll_event event = { .events = EPOLLOUT, .data.ptr = fetch };
+            if (epoll_ctl(engine->epfd, EPOLL_CTL_ADD, fetch->sock, &event) != 0) {
+                finishFetch(engine, fetch, false);
+                return;
+            }
+            startSending(engine, fetch);
+            return;
+        }
+    }
+    if (!connectFetch(engine, fetch)) {
+        retryConnect(engine, fetch, false);
+    }
+}
+
+/************** connectFetch() ******************/
+/* Starts a non-blocking connect to the fetch's host
+ *
+ * Pseudocode:
+ *      1. find the host's address in the resolver's cache, or look it up
+ *          (only a lookup that misses the cache blocks)
+ *      2. open a non-blocking socket and start connecting
+ *      3. register the socket with epoll; it becomes writable once the
+ *          connect is over
+ *
+ * returns false if the host has no address or the connect failed right away
+*/
+static bool connectFetch(fetchEngine_t* engine, fetch_t* fetch)
+{
+    fetch->connects++;
+    struct sockaddr_in address;
+    if (!resolver_lookup(fetch->host, fetch->port, &address)) return false;
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return false;
+    if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) != 0
+        || (connect(sock, (struct sockaddr*) &address, sizeof(address)) != 0 && errno != EINPROGRESS)) {
+        close(sock);
+        return false;
+    }
+
+    fetch->sock = sock;
+    fetch->phase = PHASE_CONNECTING;
+    fetch->deadline = engine->connectTimeout > 0 ? now() + engine->connectTimeout : 0;
+    struct epoll_event event = { .events = EPOLLOUT, .data.ptr = fetch };
+    if (epoll_ctl(engine->epfd, EPOLL_CTL_ADD, sock, &event) != 0) {
+        close(sock);
+        fetch->sock = -1;
+        return false;
+    }
+    engine->opened++;
+    return true;
+}
+
+/************** retryConnect() ******************/
+/* after a failed or timed-out connect, puts the fetch back to wait for a
+ * backoff that doubles with each attempt (with a random half taken off, so
+ * fetches failing together don't retry together), or finishes it without
+ * HTML after MAX_CONNECTS attempts
+*/
+static void retryConnect(fetchEngine_t* engine, fetch_t* fetch, const bool timedOut)
+{
+    if (fetch->sock >= 0) {
+        close(fetch->sock);
+        fetch->sock = -1;
+    }
+    if (fetch->connects >= MAX_CONNECTS) {
+        fprintf(stderr, "Error: could not connect to %s\n", fetch->host);
+        fetch->timedOut = timedOut;
+        finishFetch(engine, fetch, false);
+        return;
+    }
+    long long delay = BACKOFF_BASE;
+    for (int i = 1; i < fetch->connects && delay < BACKOFF_MAX; i++) delay *= 2;
+    if (delay > BACKOFF_MAX) delay = BACKOFF_MAX;
+    delay -= rand_r(&engine->jitterSeed) % (delay / 2 + 1);
+    fetch->startTime = now() + delay * 1000000LL;
+    fetch->phase = PHASE_WAITING;
+}
+
+/************** startSending() ******************/
+/* starts the deadlines of a fetch whose connection is ready, and sends the request */
+static void startSending(fetchEngine_t* engine, fetch_t* fetch)
+{
+    long long current = now();
+    fetch->phase = PHASE_SENDING;
+    fetch->totalDeadline = engine->totalTimeout > 0 ? current + engine->totalTimeout : 0;
+    fetch->deadline = fetch->totalDeadline;
+    if (engine->firstByteTimeout > 0
+        && (fetch->deadline == 0 || current + engine->firstByteTimeout < fetch->deadline)) {
+        fetch->deadline = current + engine->firstByteTimeout;
+    }
+    if (!sendRequest(engine, fetch)) {
+        failFetch(engine, fetch);
+    }
+}
+
+/************** advanceFetch() ******************/
+/* moves a fetch along after epoll reports its socket is ready */
+static void advanceFetch(fetchEngine_t* engine, fetch_t* fetch)
+{
+    if (fetch->phase == PHASE_CONNECTING) {
+        // the connect is over; find out whether it worked
+        int error = 0;
+        socklen_t size = sizeof(error);
+        if (getsockopt(fetch->sock, SOL_SOCKET, SO_ERROR, &error, &size) != 0 || error != 0) {
+            retryConnect(engine, fetch, false);
+            return;
+        }
+        startSending(engine, fetch);
+    } else if (fetch->phase == PHASE_SENDING) {
+        if (!sendRequest(engine, fetch)) {
+            failFetch(engine, fetch);
+        }
+    } else if (fetch->phase == PHASE_READING) {
+        readResponse(engine, fetch);
+    }
+}
+
+/************** sendRequest() ******************/
+/* writes as much of the request as the socket takes, then waits for the response
+ * once all of it is sent; returns false if the connection failed
+*/
+static bool sendRequest(fetchEngine_t* engine, fetch_t* fetch)
+{
+    // the request is small, so rebuild it rather than keep it around
+    const char* connection = engine->idlePerHost > 0 ? "keep-alive" : "close";
+    int length = snprintf(NULL, 0, REQUEST_FORMAT, fetch->path, fetch->host, connection);
+    char* request = count_malloc(length + 1);
+    if (request == NULL) return false;
+    snprintf(request, length + 1, REQUEST_FORMAT, fetch->path, fetch->host, connection);
+
+    while (fetch->sent < (size_t) length) {
+        ssize_t n = send(fetch->sock, request + fetch->sent, length - fetch->sent, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            count_free(request);
+            return true;
+        }
+        if (n <= 0) {
+            count_free(request);
+            return false;
+        }
+        fetch->sent += n;
+    }
+    count_free(request);
+
+    fetch->phase = PHASE_READING;
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = fetch };
+    return epoll_ctl(engine->epfd, EPOLL_CTL_MOD, fetch->sock, &event) == 0;
+}
+
+/************** readResponse() ******************/
+/* reads whatever the socket has, and finishes the fetch once the response is
+ * complete, malformed, or the connection ends
+*/
+static void readResponse(fetchEngine_t* engine, fetch_t* fetch)
+{
+    while (true) {
+        // keep room to read into, doubling to keep appends cheap
+        if (fetch->capacity - fetch->length < READ_CHUNK + 1) {
+            size_t capacity = fetch->capacity > 0 ? fetch->capacity * 2 : READ_CHUNK * 2;
+            char* bigger = realloc(fetch->buf, capacity);
+            if (bigger == NULL) {
+                finishFetch(engine, fetch, false);
+                return;
+            }
+            fetch->buf = bigger;
+            fetch->capacity = capacity;
+        }
+
+        ssize_t n = recv(fetch->sock, fetch->buf + fetch->length,
+                         fetch->capacity - fetch->length - 1, 0);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            failFetch(engine, fetch);
+            return;
+        }
+        if (n == 0) {
+            // an unframed body ends when the server closes the connection
+            if (fetch->headersDone && !fetch->chunked && fetch->contentLength < 0) {
+                fetch->bodyEnd = fetch->length;
+                fetch->keepAlive = false;
+                finishFetch(engine, fetch, true);
+            } else {
+                failFetch(engine, fetch);
+            }
+            return;
+        }
+        fetch->length += n;
+        fetch->buf[fetch->length] = '\0';
+
+        int status = cutBody(fetch, engine->maxPageSize, parseResponse(fetch));
+        // once the status line is in, only the total deadline is left
+        if (fetch->answered) fetch->deadline = fetch->totalDeadline;
+        if (status != 0) {
+            finishFetch(engine, fetch, status > 0);
+            return;
+        }
+    }
+}
+
+/************** parseResponse() ******************/
+/* parses the status line and headers as they arrive, then checks whether
+ * the whole body is in, returns 1 if the response is complete, 0 if more
+ * is needed, and -1 if it is malformed
+*/
+static int parseResponse(fetch_t* fetch)
+{
+    while (!fetch->headersDone) {
+        char* line = fetch->buf + fetch->scanned;
+        char* newline = memchr(line, '\n', fetch->length - fetch->scanned);
+        if (newline == NULL) return 0;
+        size_t lineLength = newline - line;
+        if (lineLength > 0 && line[lineLength - 1] == '\r') lineLength--;
+        fetch->scanned = newline + 1 - fetch->buf;
+
+        if (!fetch->answered) {
+            // the status line, e.g., "HTTP/1.1 200 OK"
+            int minor = 0;
+            fetch->answered = true;
+            if (sscanf(line, "HTTP/1.%d %d", &minor, &fetch->code) != 2) return -1;
+            // HTTP/1.1 connections stay open unless the server says otherwise
+            fetch->keepAlive = minor >= 1;
+        } else if (lineLength == 0) {
+            fetch->headersDone = true;
+            fetch->bodyStart = fetch->bodyEnd = fetch->chunkPos = fetch->scanned;
+        } else {
+            parseHeader(fetch, line, lineLength);
+        }
+    }
+
+    if (fetch->chunked) return decodeChunks(fetch);
+    if (fetch->contentLength >= 0) {
+        if ((long long) (fetch->length - fetch->bodyStart) < fetch->contentLength) return 0;
+        fetch->bodyEnd = fetch->bodyStart + fetch->contentLength;
+        // bytes past the end of the response would confuse the next one
+        if (fetch->length > fetch->bodyEnd) fetch->keepAlive = false;
+        return 1;
+    }
+    return 0;
+}
+
+/************** parseHeader() ******************/
+/* notes the framing and the connection header, ignores the rest */
+static void parseHeader(fetch_t* fetch, const char* line, const size_t length)
+{
+    // only the start of a header matters, in lower case
+    char header[256];
+    size_t copied = length < sizeof(header) - 1 ? length : sizeof(header) - 1;
+    for (size_t i = 0; i < copied; i++) {
+        header[i] = tolower((unsigned char) line[i]);
+    }
+    header[copied] = '\0';
+
+    if (strncmp(header, "content-length:", 15) == 0) {
+        fetch->contentLength = strtoll(header + 15, NULL, 10);
+        if (fetch->contentLength < 0) fetch->contentLength = -1;
+    } else if (strncmp(header, "transfer-encoding:", 18) == 0) {
+        fetch->chunked = strstr(header + 18, "chunked") != NULL;
+    } else if (strncmp(header, "connection:", 11) == 0) {
+        if (strstr(header + 11, "close") != NULL) {
+            fetch->keepAlive = false;
+        } else if (strstr(header + 11, "keep-alive") != NULL) {
+            fetch->keepAlive = true;
+        }
+    }
+}
+
+/************** decodeChunks() ******************/
+/* Decodes the chunks of a chunked body that have fully arrived, in place
+ *
+ * Pseudocode:
+ *      1. find the next chunk size line; wait for more if it isn't all here
+ *      2. once the chunk and the CRLF after it are here, move its bytes down
+ *          to the end of the decoded body
+ *      3. after the chunk of size zero, skip trailer headers up to a blank line
+ *
+ * returns 1 if the body is complete, 0 if more is needed, and -1 if malformed
+*/
+static int decodeChunks(fetch_t* fetch)
+{
+    char* buf = fetch->buf;
+    while (true) {
+        char* line = buf + fetch->chunkPos;
+        char* newline = memchr(line, '\n', fetch->length - fetch->chunkPos);
+        if (newline == NULL) return 0;
+        size_t next = newline + 1 - buf;
+
+        if (fetch->inTrailers) {
+            fetch->chunkPos = next;
+            if (line == newline || (line[0] == '\r' && line + 1 == newline)) {
+                if (fetch->length > next) fetch->keepAlive = false;
+                return 1;
+            }
+            continue;
+        }
+
+        // the chunk size, possibly followed by ";extensions"
+        char* end;
+        unsigned long long size = strtoull(line, &end, 16);
+        if (end == line || size > SIZE_MAX / 2) return -1;
+        if (size == 0) {
+            fetch->inTrailers = true;
+            fetch->chunkPos = next;
+            continue;
+        }
+        if (size > fetch->length - next) return 0;
+
+        // each chunk ends with a CRLF
+        size_t dataEnd = next + size;
+        char* crlf = memchr(buf + dataEnd, '\n', fetch->length - dataEnd);
+        if (crlf == NULL) return 0;
+        size_t gap = crlf - (buf + dataEnd);
+        if (gap > 1 || (gap == 1 && buf[dataEnd] != '\r')) return -1;
+
+        memmove(buf + fetch->bodyEnd, buf + next, size);
+        fetch->bodyEnd += size;
+        fetch->chunkPos = crlf + 1 - buf;
+    }
+}
+
+/************** cutBody() ******************/
+/* ends the body at maxPageSize bytes (0 for no limit) once more than that has
+ * arrived, leaving the rest unread, and returns the response's status, which is
+ * then complete; otherwise returns the status from parseResponse unchanged
+*/
+static int cutBody(fetch_t* fetch, const size_t maxPageSize, const int status)
+{
+    if (status < 0 || maxPageSize == 0 || !fetch->headersDone) return status;
+    // a chunked body is decoded up to bodyEnd; any other runs to what has arrived
+    size_t arrived = (status > 0 || fetch->chunked ? fetch->bodyEnd : fetch->length) - fetch->bodyStart;
+    if (arrived < maxPageSize || (status > 0 && arrived == maxPageSize)) return status;
+    fetch->bodyEnd = fetch->bodyStart + maxPageSize;
+    fetch->truncated = true;
+    // the rest of the response would confuse the next one
+    fetch->keepAlive = false;
+    return 1;
+}
+
+/************** failFetch() ******************/
+/* ends a fetch whose connection failed; an idle connection the server already
+ * closed gets no answer at all, so such a fetch is retried once on a new one
+*/
+static void failFetch(fetchEngine_t* engine, fetch_t* fetch)
+{
+    if (fetch->reused && !fetch->retried && fetch->length == 0) {
+        close(fetch->sock);
+        fetch->sock = -1;
+        fetch->reused = false;
+        fetch->retried = true;
+        resetResponse(fetch);
+        if (!connectFetch(engine, fetch)) retryConnect(engine, fetch, false);
+        return;
+    }
+    finishFetch(engine, fetch, false);
+}
+
+/************** finishFetch() ******************/
+/* Marks a fetch as finished and queues it to be handed back
+ *
+ * Pseudocode:
+ *      1. if the response is complete and the server keeps the connection open,
+ *          keep it idle for the host (up to idlePerHost), otherwise close it
+ *      2. if the response is complete with code 200, move the body to the
+ *          front of the buffer and keep it as the HTML
+ *      3. append the fetch to the finished fetches
+*/
+static void finishFetch(fetchEngine_t* engine, fetch_t* fetch, const bool complete)
+{
+    if (fetch->sock >= 0) {
+        epoll_ctl(engine->epfd, EPOLL_CTL_DEL, fetch->sock, NULL);
+        int idle = 0;
+        for (idleConn_t* conn = engine->idle; conn != NULL; conn = conn->next) {
+            if (conn->port == fetch->port && strcmp(conn->host, fetch->host) == 0) idle++;
+        }
+        idleConn_t* conn = NULL;
+        if (complete && fetch->keepAlive && idle < engine->idlePerHost) {
+            conn = count_malloc(sizeof(idleConn_t));
+            char* host = count_malloc(strlen(fetch->host) + 1);
+            if (conn != NULL && host != NULL) {
+                strcpy(host, fetch->host);
+                conn->sock = fetch->sock;
+                conn->host = host;
+                conn->port = fetch->port;
+                conn->next = engine->idle;
+                engine->idle = conn;
+            } else {
+                if (conn != NULL) count_free(conn);
+                if (host != NULL) count_free(host);
+                conn = NULL;
+            }
+        }
+        if (conn == NULL) close(fetch->sock);
+        fetch->sock = -1;
+    }
+
+    if (complete && fetch->code == 200) {
+        if (fetch->truncated) engine->truncated++;
+        size_t bodyLength = fetch->bodyEnd - fetch->bodyStart;
+        memmove(fetch->buf, fetch->buf + fetch->bodyStart, bodyLength);
+        fetch->buf[bodyLength] = '\0';
+        fetch->html = fetch->buf;
+        fetch->buf = NULL;
+    }
+
+    fetch->phase = PHASE_DONE;
+    fetch->nextDone = NULL;
+    if (engine->doneTail != NULL) {
+        engine->doneTail->nextDone = fetch;
+    } else {
+        engine->doneHead = fetch;
+    }
+    engine->doneTail = fetch;
+}
+
+/************** resetResponse() ******************/
+/* forgets any response read so far, keeping the buffer */
+static void resetResponse(fetch_t* fetch)
+{
+    fetch->sent = 0;
+    fetch->length = 0;
+    if (fetch->buf != NULL) fetch->buf[0] = '\0';
+    fetch->scanned = 0;
+    fetch->answered = false;
+    fetch->headersDone = false;
+    fetch->code = 0;
+    fetch->keepAlive = false;
+    fetch->chunked = false;
+    fetch->contentLength = -1;
+    fetch->bodyStart = fetch->bodyEnd = fetch->chunkPos = 0;
+    fetch->inTrailers = false;
+    fetch->truncated = false;
+}
+
+/************** releaseFetch() ******************/
+/* frees what a fetch owns (but not its page or HTML) and frees its slot */
+static void releaseFetch(fetch_t* fetch)
+{
+    if (fetch->host != NULL) count_free(fetch->host);
+    if (fetch->path != NULL) count_free(fetch->path);
+    free(fetch->buf);
+    fetch->host = fetch->path = NULL;
+    fetch->buf = NULL;
+    fetch->capacity = 0;
+    fetch->html = NULL;
+    fetch->page = NULL;
+    fetch->phase = PHASE_FREE;
+}
@@ -0,0 +1,114 @@
+/*
+ * fetchengine.h - header file for the 'fetchengine' file in the 'crawler' module
+ *
+ * the fetch engine keeps many page fetches in flight from a single thread.
+ * Instead of one blocking connect and read per thread, every fetch has a
+ * non-blocking socket registered with epoll, and the engine moves each one
+ * along (connecting, sending the request, reading the response) whenever its
+ * socket is ready. A fetch may be given a start time, e.g. a slot from the
+ * politeness scheduler, and is not started before then. Finished fetches are
+ * handed back one at a time, in the order they finish.
+ *
+ * Like webpage_fetch, the engine speaks HTTP/1.1, keeps up to a given number
+ * of idle connections to each host open for later fetches, limits how long
+ * connecting and reading may take, and retries failed connects with backoff.
+ * Not thread-safe: an engine belongs to the thread that created it.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __FETCH_ENGINE
+#define __FETCH_ENGINE
+
+#include <stdbool.h>
+#include "webpage.h"
+
+/**************** global types ****************/
+typedef struct fetchEngine fetchEngine_t; // an epoll instance and the fetches it drives
+
+typedef enum fetchResult { // how a fetch ended
+    FETCH_OK,               // the HTML arrived with a 200 response
+    FETCH_FAILED,           // the page can't be fetched
+    FETCH_TIMED_OUT         // a connect or read ran out of time; worth retrying later
+} fetchResult_t;
+
+/******************* functions *******************/
+
+/******************* newFetchEngine() ******************/
+/* creates an engine that keeps up to maxFetches fetches in flight and up to
+ * idlePerHost idle connections to each host, returns NULL on error
+*/
+fetchEngine_t* newFetchEngine(const int maxFetches, const int idlePerHost);
+
+/******************* deleteFetchEngine() ******************/
+/* closes every connection and deletes the engine, along with any webpage
+ * whose fetch had not been handed back yet
+*/
+void deleteFetchEngine(fetchEngine_t* engine);
+
+/******************* fetchEngineSetTimeouts() ******************/
+/* limits, in milliseconds (0 for no limit), each attempt to connect (5000 by
+ * default), the wait from sending the request to the status line (10000), and
+ * the whole response (30000), like webpage_setTimeouts()
+*/
+void fetchEngineSetTimeouts(fetchEngine_t* engine, const int connectMs, const int firstByteMs,
+                            const int totalMs);
+
+/******************* fetchEngineSetMaxPageSize() ******************/
+/* keeps at most bytes of the HTML of each page (0, the default, for no limit),
+ * like webpage_setMaxPageSize(): a longer page is cut off there and still handed
+ * back as FETCH_OK, and its connection is closed rather than kept idle
+*/
+void fetchEngineSetMaxPageSize(fetchEngine_t* engine, const size_t bytes);
+
+/******************* fetchEngineAdd() ******************/
+/* Adds a fetch of the page's URL, to start no earlier than startTime
+ *
+ * Pseudocode:
+ *      1. take a free fetch slot, or return false if all are in flight
+ *      2. split the URL into its host, port, and path; if it can't be fetched,
+ *          mark the fetch as finished without HTML
+ *      3. otherwise leave it waiting until startTime, when it takes an idle
+ *          connection to the host or starts a non-blocking connect
+ *
+ * startTime is in nanoseconds of the monotonic clock, as returned by
+ * politenessReserve(); 0 starts the fetch right away. The engine owns the page
+ * until fetchEngineNext() hands it back
+*/
+bool fetchEngineAdd(fetchEngine_t* engine, webpage_t* page, const long long startTime);
+
+/******************* fetchEngineCount() ******************/
+/* returns the number of fetches added but not yet handed back */
+int fetchEngineCount(fetchEngine_t* engine);
+
+/******************* fetchEngineFull() ******************/
+/* returns true if no more fetches can be added until one is handed back */
+bool fetchEngineFull(fetchEngine_t* engine);
+
+/******************* fetchEngineNext() ******************/
+/* Waits until a fetch finishes and hands it back
+ *
+ * Pseudocode:
+ *      1. if a fetch has already finished, hand it back
+ *      2. otherwise start every fetch whose start time has come, and time out
+ *          every fetch whose deadline has passed: a connect is retried after a
+ *          backoff (up to 3 attempts), anything else finishes without HTML
+ *      3. wait on epoll until a socket is ready, or the next start time or deadline
+ *      4. for every ready socket, finish connecting, send more of the request,
+ *          or read more of the response, and mark finished fetches
+ *
+ * returns NULL if there are no fetches at all. Otherwise returns the page, which
+ * the caller must later delete, and sets *result to how the fetch ended (if FETCH_OK,
+ * the page is a new webpage with the same URL and depth, holding the HTML) and
+ * *startTime to the start time the fetch was added with
+*/
+webpage_t* fetchEngineNext(fetchEngine_t* engine, fetchResult_t* result, long long* startTime);
+
+/******************* fetchEngineStats() ******************/
+/* sets *opened to the number of connections the engine opened, *reused to
+ * the number of fetches that reused an idle one, and *truncated to the number
+ * of pages cut off at the largest page size; any pointer may be NULL
+*/
+void fetchEngineStats(fetchEngine_t* engine, int* opened, int* reused, int* truncated);
+
+#endif
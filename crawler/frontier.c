@@ -0,0 +1,532 @@
+/*
+ * frontier.c - thread-safe, breadth-first queue of URLs to crawl
+ *
+ * see frontier.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L // getline
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "frontier.h"
+#include "memory.h"
+
+/************* global types ****************/
+
+typedef struct block { // URLs waiting at one depth, in the order they came
+    struct block* next;
+    size_t size;                // bytes of data
+    size_t used;                // bytes written
+    size_t read;                // bytes already extracted
+    char data[];                // '\0'-terminated URLs, one after another
+} block_t;
+
+typedef struct depthQueue { // the URLs in memory at one depth
+    block_t* head;              // the oldest block, extracted from
+    block_t* tail;              // the newest block, appended to
+    int numURLs;
+} depthQueue_t;
+
+typedef struct run { // URLs spilled to disk, one "depth URL" line each
+    FILE* fp;                   // a temporary file, sorted by depth then URL
+    char* line;                 // the next line, read ahead
+    size_t capacity;            // bytes allocated for line
+    int depth;                  // the depth of the next line
+    char* URL;                  // the URL of the next line, inside line
+    long offset;                // where the next line starts in fp
+} run_t;
+
+typedef struct spilledURL { // a URL in memory, while the URLs are sorted for a run
+    int depth;
+    const char* URL;
+} spilledURL_t;
+
+typedef struct frontier {
+    depthQueue_t* queues;       // the URLs in memory, one queue per depth
+    int numDepths;              // the number of queues
+    int numInMemory;            // the number of URLs in the queues
+    size_t memoryUsed;          // bytes of blocks in the queues
+    size_t memoryBudget;        // most bytes of blocks before spilling, 0 for no limit
+    size_t blockSize;           // bytes of URLs in a new block
+    size_t peakMemory;          // most bytes of blocks at once
+    run_t* runs;                // the runs with URLs left
+    int numRuns;
+    int numSpilled;             // URLs written to runs
+    int runsWritten;            // runs written, merged ones included
+    int numPages;               // the number of URLs in the frontier
+    int numBusy;                // the number of workers crawling a page
+    pthread_mutex_t lock;       // guards everything above
+    pthread_cond_t changed;     // signalled when a page is inserted or a worker finishes
+} frontier_t;
+
+/************* global variables ****************/
+
+static const size_t BLOCK_SIZE = 65536;  // most bytes of URLs in a block
+static const size_t MIN_BLOCK_SIZE = 256; // fewest bytes of URLs in a block
+static const int MAX_RUNS = 16;          // runs before they are merged into one
+static const long RETRY_NANOS = 100000000; // wait before taking a page again when out of memory
+
+/************* local function prototypes ****************/
+
+static webpage_t* takePageRetrying(frontier_t* frontier);
+static webpage_t* takePage(frontier_t* frontier);
+static void removeFromMemory(frontier_t* frontier, const int depth);
+static void removeFromRun(frontier_t* frontier, const int index);
+static bool spillToDisk(frontier_t* frontier);
+static bool mergeRuns(frontier_t* frontier);
+static bool addRun(frontier_t* frontier, FILE* fp);
+static bool advanceRun(run_t* run);
+static int compareSpilled(const void* a, const void* b);
+
+/************** newFrontier() ******************/
+// see frontier.h for description
+frontier_t* newFrontier(const size_t memoryBudget)
+{
+    frontier_t* frontier = count_calloc(1, sizeof(frontier_t));
+    if (frontier == NULL) return NULL;
+    frontier->memoryBudget = memoryBudget;
+    // a small budget gets small blocks, so a run holds more than a few URLs
+    frontier->blockSize = BLOCK_SIZE;
+    if (memoryBudget > 0 && memoryBudget / 16 < BLOCK_SIZE) {
+        frontier->blockSize = memoryBudget / 16 > MIN_BLOCK_SIZE ? memoryBudget / 16 : MIN_BLOCK_SIZE;
+    }
+    pthread_mutex_init(&frontier->lock, NULL);
+    pthread_cond_init(&frontier->changed, NULL);
+    return frontier;
+}
+
+/************** deleteFrontier() ******************/
+// see frontier.h for description
+void deleteFrontier(frontier_t* frontier)
+{
+    if (frontier == NULL) return;
+    for (int depth = 0; depth < frontier->numDepths; depth++) {
+        block_t* block = frontier->queues[depth].head;
+        while (block != NULL) {
+            block_t* next = block->next;
+            count_free(block);
+            block = next;
+        }
+    }
+    if (frontier->queues != NULL) free(frontier->queues);
+    // a temporary file is removed once it is closed
+    for (int i = 0; i < frontier->numRuns; i++) {
+        fclose(frontier->runs[i].fp);
+        free(frontier->runs[i].line);
+    }
+    if (frontier->runs != NULL) free(frontier->runs);
+    pthread_mutex_destroy(&frontier->lock);
+    pthread_cond_destroy(&frontier->changed);
+    count_free(frontier);
+}
+
+/************** frontierInsert() ******************/
+// see frontier.h for description
+void frontierInsert(frontier_t* frontier, const char* URL, const int depth)
+{
+    if (frontier == NULL || URL == NULL || depth < 0) return;
+    size_t length = strlen(URL) + 1;
+    pthread_mutex_lock(&frontier->lock);
+
+    // make sure there is a queue for the depth
+    if (depth >= frontier->numDepths) {
+        int numDepths = depth + 1;
+        depthQueue_t* queues = realloc(frontier->queues, numDepths * sizeof(depthQueue_t));
+        if (queues == NULL) {
+            pthread_mutex_unlock(&frontier->lock);
+            return;
+        }
+        memset(&queues[frontier->numDepths], 0, (numDepths - frontier->numDepths) * sizeof(depthQueue_t));
+        frontier->queues = queues;
+        frontier->numDepths = numDepths;
+    }
+
+    // append the URL to the newest block, or to a new one if it doesn't fit
+    depthQueue_t* queue = &frontier->queues[depth];
+    block_t* block = queue->tail;
+    if (block == NULL || block->size - block->used < length) {
+        size_t size = length > frontier->blockSize ? length : frontier->blockSize;
+        block = count_malloc(sizeof(block_t) + size);
+        if (block == NULL) {
+            pthread_mutex_unlock(&frontier->lock);
+            return;
+        }
+        block->next = NULL;
+        block->size = size;
+        block->used = block->read = 0;
+        if (queue->tail != NULL) queue->tail->next = block;
+        else queue->head = block;
+        queue->tail = block;
+        frontier->memoryUsed += sizeof(block_t) + size;
+        if (frontier->memoryUsed > frontier->peakMemory) frontier->peakMemory = frontier->memoryUsed;
+    }
+    memcpy(block->data + block->used, URL, length);
+    block->used += length;
+    queue->numURLs++;
+    frontier->numInMemory++;
+    frontier->numPages++;
+
+    // past the budget, move everything in memory to a run on disk
+    if (frontier->memoryBudget > 0 && frontier->memoryUsed > frontier->memoryBudget
+        && !spillToDisk(frontier)) {
+        fprintf(stderr, "Error: could not spill the frontier to disk, keeping it in memory\n");
+        frontier->memoryBudget = 0;
+    }
+    pthread_cond_signal(&frontier->changed);
+    pthread_mutex_unlock(&frontier->lock);
+}
+
+/************** frontierExtract() ******************/
+// see frontier.h for description
+webpage_t* frontierExtract(frontier_t* frontier)
+{
+    if (frontier == NULL) return NULL;
+    pthread_mutex_lock(&frontier->lock);
+    // a busy worker may still find more pages, so wait for it
+    while (frontier->numPages == 0 && frontier->numBusy > 0) {
+        pthread_cond_wait(&frontier->changed, &frontier->lock);
+    }
+
+    webpage_t* page = takePageRetrying(frontier);
+    if (page == NULL) {
+        // nothing left and nobody busy: wake the other workers so they finish too
+        pthread_cond_broadcast(&frontier->changed);
+    }
+    pthread_mutex_unlock(&frontier->lock);
+    return page;
+}
+
+/************** frontierTryExtract() ******************/
+// see frontier.h for description
+webpage_t* frontierTryExtract(frontier_t* frontier)
+{
+    if (frontier == NULL) return NULL;
+    pthread_mutex_lock(&frontier->lock);
+    webpage_t* page = takePageRetrying(frontier);
+    pthread_mutex_unlock(&frontier->lock);
+    return page;
+}
+
+/************** frontierDone() ******************/
+// see frontier.h for description
+void frontierDone(frontier_t* frontier)
+{
+    if (frontier == NULL) return;
+    pthread_mutex_lock(&frontier->lock);
+    frontier->numBusy--;
+    if (frontier->numBusy == 0) pthread_cond_broadcast(&frontier->changed);
+    pthread_mutex_unlock(&frontier->lock);
+}
+
+/************** frontierStats() ******************/
+// see frontier.h for description
+void frontierStats(frontier_t* frontier, size_t* peakMemory, int* spilled, int* runs)
+{
+    if (frontier == NULL) return;
+    pthread_mutex_lock(&frontier->lock);
+    if (peakMemory != NULL) *peakMemory = frontier->peakMemory;
+    if (spilled != NULL) *spilled = frontier->numSpilled;
+    if (runs != NULL) *runs = frontier->runsWritten;
+    pthread_mutex_unlock(&frontier->lock);
+}
+
+/************** takePageRetrying() ******************/
+/* takes a page with takePage() while the frontier isn't empty, with the lock
+ * held. If out of memory, the URL stays in the frontier, so this waits a
+ * little, letting other workers free some, and tries again instead of
+ * passing the NULL up, where it would read as an empty frontier.
+ * Returns NULL only once the frontier is empty
+*/
+static webpage_t* takePageRetrying(frontier_t* frontier)
+{
+    webpage_t* page = NULL;
+    while (frontier->numPages > 0 && (page = takePage(frontier)) == NULL && frontier->numPages > 0) {
+        struct timespec retry;
+        clock_gettime(CLOCK_REALTIME, &retry);
+        retry.tv_nsec += RETRY_NANOS;
+        if (retry.tv_nsec >= 1000000000) {
+            retry.tv_sec++;
+            retry.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&frontier->changed, &frontier->lock, &retry);
+    }
+    return page;
+}
+
+/************** takePage() ******************/
+/* takes the shallowest URL, from a run if one holds a URL as shallow as any
+ * in memory, since the runs hold the older URLs; with the lock held and the
+ * frontier not empty. Marks the caller as busy. Returns NULL, leaving the URL
+ * in the frontier, if out of memory
+*/
+static webpage_t* takePage(frontier_t* frontier)
+{
+    int memoryDepth = 0;
+    while (memoryDepth < frontier->numDepths && frontier->queues[memoryDepth].numURLs == 0) {
+        memoryDepth++;
+    }
+    int shallowestRun = -1;
+    for (int i = 0; i < frontier->numRuns; i++) {
+        if (shallowestRun < 0 || frontier->runs[i].depth < frontier->runs[shallowestRun].depth) {
+            shallowestRun = i;
+        }
+    }
+
+    if (shallowestRun < 0 && memoryDepth == frontier->numDepths) {
+        // a run that couldn't be read lost its URLs
+        frontier->numPages = 0;
+        return NULL;
+    }
+    bool fromRun = shallowestRun >= 0 && frontier->runs[shallowestRun].depth <= memoryDepth;
+    int depth = fromRun ? frontier->runs[shallowestRun].depth : memoryDepth;
+    const char* next;
+    if (fromRun) {
+        next = frontier->runs[shallowestRun].URL;
+    } else {
+        block_t* block = frontier->queues[memoryDepth].head;
+        next = block->data + block->read;
+    }
+
+    // make the page before removing its URL, so the URL isn't lost if that fails
+    char* URL = count_malloc(strlen(next) + 1);
+    webpage_t* page = NULL;
+    if (URL != NULL) {
+        strcpy(URL, next);
+        page = webpage_new(URL, depth, NULL);
+    }
+    if (page == NULL) {
+        if (URL != NULL) count_free(URL);
+        fprintf(stderr, "Error: out of memory taking %s from the frontier\n", next);
+        return NULL;
+    }
+    if (fromRun) removeFromRun(frontier, shallowestRun);
+    else removeFromMemory(frontier, memoryDepth);
+    frontier->numPages--;
+    frontier->numBusy++;
+    return page;
+}
+
+/************** removeFromMemory() ******************/
+/* removes the oldest URL of a depth's queue, freeing its block once it is used up */
+static void removeFromMemory(frontier_t* frontier, const int depth)
+{
+    depthQueue_t* queue = &frontier->queues[depth];
+    block_t* block = queue->head;
+    block->read += strlen(block->data + block->read) + 1;
+    queue->numURLs--;
+    frontier->numInMemory--;
+
+    if (block->read == block->used) {
+        queue->head = block->next;
+        if (queue->head == NULL) queue->tail = NULL;
+        frontier->memoryUsed -= sizeof(block_t) + block->size;
+        count_free(block);
+    }
+}
+
+/************** removeFromRun() ******************/
+/* removes the next URL of a run, closing the run once it is used up */
+static void removeFromRun(frontier_t* frontier, const int index)
+{
+    run_t* run = &frontier->runs[index];
+    if (!advanceRun(run)) {
+        fclose(run->fp);
+        free(run->line);
+        frontier->runs[index] = frontier->runs[--frontier->numRuns];
+    }
+}
+
+/************** spillToDisk() ******************/
+/* Moves every URL in memory to a new run
+ *
+ * Pseudocode:
+ *      1. list the URLs of every block, with their depths
+ *      2. sort them by depth, then URL, so each run can be merged with the others
+ *      3. write them to a temporary file, one "depth URL" line each
+ *      4. free the blocks, and merge the runs if there are too many
+ *
+ * returns false, leaving the URLs in memory, if the run can't be written
+*/
+static bool spillToDisk(frontier_t* frontier)
+{
+    spilledURL_t* spilled = malloc(frontier->numInMemory * sizeof(spilledURL_t));
+    FILE* fp = tmpfile();
+    if (spilled == NULL || fp == NULL) {
+        if (spilled != NULL) free(spilled);
+        if (fp != NULL) fclose(fp);
+        return false;
+    }
+    int numSpilled = 0;
+    for (int depth = 0; depth < frontier->numDepths; depth++) {
+        for (block_t* block = frontier->queues[depth].head; block != NULL; block = block->next) {
+            for (size_t pos = block->read; pos < block->used; pos += strlen(block->data + pos) + 1) {
+                spilled[numSpilled].depth = depth;
+                spilled[numSpilled].URL = block->data + pos;
+                numSpilled++;
+            }
+        }
+    }
+    qsort(spilled, numSpilled, sizeof(spilledURL_t), compareSpilled);
+    for (int i = 0; i < numSpilled; i++) {
+        fprintf(fp, "%d %s\n", spilled[i].depth, spilled[i].URL);
+    }
+    free(spilled);
+    if (fflush(fp) != 0 || !addRun(frontier, fp)) {
+        fclose(fp);
+        return false;
+    }
+
+    // the URLs are on disk now
+    for (int depth = 0; depth < frontier->numDepths; depth++) {
+        depthQueue_t* queue = &frontier->queues[depth];
+        while (queue->head != NULL) {
+            block_t* next = queue->head->next;
+            count_free(queue->head);
+            queue->head = next;
+        }
+        queue->tail = NULL;
+        queue->numURLs = 0;
+    }
+    frontier->numInMemory = 0;
+    frontier->memoryUsed = 0;
+    frontier->numSpilled += numSpilled;
+
+    if (frontier->numRuns >= MAX_RUNS && !mergeRuns(frontier)) {
+        fprintf(stderr, "Error: could not merge the frontier's runs\n");
+    }
+    return true;
+}
+
+/************** mergeRuns() ******************/
+/* Merges what is left of every run into one new run
+ *
+ * Pseudocode:
+ *      1. note where each run's next line starts
+ *      2. write the smallest next line of the runs to a temporary file
+ *          until every run is used up
+ *      3. read the first line of the new run back
+ *      4. if that all worked, close the old runs and keep only the new one
+ *      5. otherwise seek each old run back to the line it had read ahead
+ *
+ * returns false, leaving the runs as they were, if the new run can't be
+ * written or read
+*/
+static bool mergeRuns(frontier_t* frontier)
+{
+    long* offsets = malloc(frontier->numRuns * sizeof(long));
+    FILE* fp = tmpfile();
+    if (offsets == NULL || fp == NULL) {
+        if (offsets != NULL) free(offsets);
+        if (fp != NULL) fclose(fp);
+        return false;
+    }
+    for (int i = 0; i < frontier->numRuns; i++) offsets[i] = frontier->runs[i].offset;
+
+    // a run that is used up has no URL until the runs are closed or put back
+    bool written = true;
+    while (written) {
+        int smallest = -1;
+        for (int i = 0; i < frontier->numRuns; i++) {
+            if (frontier->runs[i].URL == NULL) continue;
+            if (smallest >= 0) {
+                spilledURL_t a = { frontier->runs[i].depth, frontier->runs[i].URL };
+                spilledURL_t b = { frontier->runs[smallest].depth, frontier->runs[smallest].URL };
+                if (compareSpilled(&a, &b) >= 0) continue;
+            }
+            smallest = i;
+        }
+        if (smallest < 0) break;
+        run_t* run = &frontier->runs[smallest];
+        written = fprintf(fp, "%d %s\n", run->depth, run->URL) > 0;
+        if (!advanceRun(run)) run->URL = NULL;
+    }
+    run_t merged = { fp, NULL, 0, 0, NULL, 0 };
+    if (written && fflush(fp) == 0) {
+        rewind(fp);
+        written = advanceRun(&merged);
+    } else {
+        written = false;
+    }
+
+    if (!written) {
+        // put every old run back, dropping only one that can't be read again
+        for (int i = frontier->numRuns - 1; i >= 0; i--) {
+            run_t* run = &frontier->runs[i];
+            if (fseek(run->fp, offsets[i], SEEK_SET) != 0 || !advanceRun(run)) {
+                fclose(run->fp);
+                free(run->line);
+                frontier->runs[i] = frontier->runs[--frontier->numRuns];
+            }
+        }
+        free(merged.line);
+        fclose(fp);
+        free(offsets);
+        return false;
+    }
+
+    // every URL left is in the new run
+    for (int i = 0; i < frontier->numRuns; i++) {
+        fclose(frontier->runs[i].fp);
+        free(frontier->runs[i].line);
+    }
+    frontier->runs[0] = merged;
+    frontier->numRuns = 1;
+    frontier->runsWritten++;
+    free(offsets);
+    return true;
+}
+
+/************** addRun() ******************/
+/* adds a written run to the frontier, rewound to its first line; returns
+ * false if it can't be added. An empty run is closed instead
+*/
+static bool addRun(frontier_t* frontier, FILE* fp)
+{
+    run_t* runs = realloc(frontier->runs, (frontier->numRuns + 1) * sizeof(run_t));
+    if (runs == NULL) return false;
+    frontier->runs = runs;
+    run_t* run = &runs[frontier->numRuns];
+    run->fp = fp;
+    run->line = NULL;
+    run->capacity = 0;
+    rewind(fp);
+    frontier->runsWritten++;
+    if (!advanceRun(run)) {
+        fclose(fp);
+        free(run->line);
+        return true;
+    }
+    frontier->numRuns++;
+    return true;
+}
+
+/************** advanceRun() ******************/
+/* reads the next line of a run, returns false at its end */
+static bool advanceRun(run_t* run)
+{
+    run->offset = ftell(run->fp);
+    ssize_t length = getline(&run->line, &run->capacity, run->fp);
+    if (length <= 0) return false;
+    if (run->line[length - 1] == '\n') run->line[length - 1] = '\0';
+    char* space = strchr(run->line, ' ');
+    if (space == NULL) return false;
+    *space = '\0';
+    run->depth = atoi(run->line);
+    run->URL = space + 1;
+    return true;
+}
+
+/************** compareSpilled() ******************/
+// qsort helper, orders spilledURL_t by depth, then URL
+static int compareSpilled(const void* a, const void* b)
+{
+    const spilledURL_t* urlA = a;
+    const spilledURL_t* urlB = b;
+    if (urlA->depth != urlB->depth) return urlA->depth < urlB->depth ? -1 : 1;
+    return strcmp(urlA->URL, urlB->URL);
+}
@@ -0,0 +1,95 @@
+/*
+ * frontier.h - header file for the 'frontier' file in the 'crawler' module
+ *
+ * the frontier holds the URLs that still need to be crawled, and hands them
+ * out breadth-first: no URL is extracted while a shallower one is waiting.
+ * Only the URLs themselves are kept, packed one after another into large
+ * blocks, one queue per depth. Once they take more memory than the frontier's
+ * budget, they are sorted by depth and URL and written to a temporary file,
+ * a "run"; URLs are then extracted from the runs and memory alike, always
+ * the shallowest first, so a crawl with millions of pending URLs only keeps
+ * the budget's worth of them in memory.
+ *
+ * The frontier is guarded by a lock, so several crawler workers can insert and
+ * extract URLs at once. It also tracks how many pages are being worked on, so
+ * that a worker waiting for more pages knows the crawl is over once the
+ * frontier is empty and nobody is busy.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __FRONTIER
+#define __FRONTIER
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "webpage.h"
+
+/**************** global types ****************/
+typedef struct frontier frontier_t; // a thread-safe, breadth-first queue of URLs to crawl
+
+/******************* functions *******************/
+
+/******************* newFrontier() ******************/
+/* creates an empty frontier that keeps up to memoryBudget bytes of URLs in
+ * memory before spilling them to disk (0 for no limit), returns NULL if out of memory
+*/
+frontier_t* newFrontier(const size_t memoryBudget);
+
+/******************* deleteFrontier() ******************/
+/* deletes the frontier, its runs, and any URLs still inside it */
+void deleteFrontier(frontier_t* frontier);
+
+/******************* frontierInsert() ******************/
+/* Adds a copy of the URL, found at the given depth, to the frontier and
+ * wakes up a waiting worker
+ *
+ * Pseudocode:
+ *      1. append the URL to the newest block of its depth's queue,
+ *          starting a new block if it doesn't fit
+ *      2. if the blocks now take more than the memory budget, sort all of
+ *          the URLs in memory by depth and URL, write them to a new run,
+ *          and free the blocks
+ *      3. once there are 16 runs, merge them into one, so that few files are open
+*/
+void frontierInsert(frontier_t* frontier, const char* URL, const int depth);
+
+/******************* frontierExtract() ******************/
+/* Takes a webpage out of the frontier to be crawled
+ *
+ * Pseudocode:
+ *      1. wait while the frontier is empty but some worker is still busy,
+ *          since that worker may insert more pages
+ *      2. if the frontier is empty and nobody is busy, the crawl is over: return NULL
+ *      3. otherwise take the shallowest URL, from the oldest block of its
+ *          depth's queue or from the run that holds it, make a webpage
+ *          (without HTML) for it, and mark the caller as busy
+ *      4. if out of memory, leave the URL where it is, wait a little, and try again
+ *
+ * Every page returned must be followed by a call to frontierDone()
+*/
+webpage_t* frontierExtract(frontier_t* frontier);
+
+/******************* frontierTryExtract() ******************/
+/* like frontierExtract(), but never waits for workers: returns NULL right away
+ * if the frontier is empty, even if a busy worker may still insert more pages.
+ * Meant for a caller that has fetches of its own in flight, like the
+ * event-driven fetch engine. Every page returned must be followed by a
+ * call to frontierDone()
+*/
+webpage_t* frontierTryExtract(frontier_t* frontier);
+
+/******************* frontierDone() ******************/
+/* marks that a worker finished the page it last extracted,
+ * including inserting all of the pages it links to
+*/
+void frontierDone(frontier_t* frontier);
+
+/******************* frontierStats() ******************/
+/* sets *peakMemory to the most bytes of URL blocks held in memory at once,
+ * *spilled to the number of URLs written to disk, and *runs to the number of
+ * runs written (merged ones included); any pointer may be NULL
+*/
+void frontierStats(frontier_t* frontier, size_t* peakMemory, int* spilled, int* runs);
+
+#endif
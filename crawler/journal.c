@@ -0,0 +1,416 @@
+/*
+ * journal.c - append-only record of a crawl, so it can be resumed
+ *
+ * see journal.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L // fsync, fileno
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "journal.h"
+#include "hashtable.h"
+#include "file.h"
+#include "memory.h"
+#include "pagedir.h"
+#include "pagestore.h"
+#include "word.h"
+
+/************* global types ****************/
+
+typedef struct journalEntry { // the latest state of one URL
+    journalState_t state;
+    int depth;
+    int id;                         // the id it was saved under, or 0
+} journalEntry_t;
+
+typedef struct journal {
+    FILE* fp;                       // the journal, open for appending
+    char* path;                     // ../data/pageDir/.journal
+    char* snapshotPath;             // where a snapshot is written before it replaces the journal
+    int numRecords;                 // lines appended since the last snapshot
+    int snapshotSize;               // lines in the last snapshot
+    pthread_mutex_t lock;           // guards everything above
+} journal_t;
+
+typedef struct savedPage { // a saved URL, while the pages are renumbered
+    const char* URL;
+    journalEntry_t* entry;
+} savedPage_t;
+
+typedef struct pageList { // the saved URLs of a replayed journal
+    savedPage_t* pages;
+    int numPages;
+} pageList_t;
+
+typedef struct itemCall { // the caller's function, passed through hashtable_iterate
+    void* arg;
+    void (*itemfunc)(void* arg, const char* URL, const int depth, const int id,
+                     const journalState_t state);
+} itemCall_t;
+
+/************* global variables ****************/
+
+static const char STATES[] = "DSEFA";    // the letter of each journalState_t
+static const int COMPACT_MIN = 10000;   // fewest lines appended before a compaction
+
+/************* local function prototypes ****************/
+
+static journal_t* allocJournal(char* pageDir);
+static hashtable_t* loadEntries(journal_t* journal, int* numEntries);
+static bool writeSnapshot(journal_t* journal, hashtable_t* entries, const int numEntries);
+static void compactJournal(journal_t* journal);
+static void renumberPages(pageStore_t* store, hashtable_t* entries, const int numEntries, int* numSaved);
+static void removeUnownedPages(pageStore_t* store, pageList_t* owned);
+static bool pageStartsWith(pageStore_t* store, const int id, const char* URL);
+static void writeEntry(void* arg, const char* key, void* item);
+static int moveAliases(pageList_t* aliases, int next, const int oldID, const int newID);
+static void collectSaved(void* arg, const char* key, void* item);
+static void collectAliases(void* arg, const char* key, void* item);
+static void callItem(void* arg, const char* key, void* item);
+static int compareIDs(const void* a, const void* b);
+
+/************** newJournal() ******************/
+// see journal.h for description
+journal_t* newJournal(char* pageDir)
+{
+    journal_t* journal = allocJournal(pageDir);
+    if (journal == NULL) return NULL;
+    if ((journal->fp = fopen(journal->path, "w")) == NULL) {
+        fprintf(stderr, "Error: could not create the journal %s\n", journal->path);
+        deleteJournal(journal);
+        return NULL;
+    }
+    return journal;
+}
+
+/************** resumeJournal() ******************/
+// see journal.h for description
+journal_t* resumeJournal(char* pageDir, pageStore_t* store, int* numSaved, void* arg,
+                         void (*itemfunc)(void* arg, const char* URL, const int depth,
+                                          const int id, const journalState_t state))
+{
+    if (store == NULL || numSaved == NULL || itemfunc == NULL) return NULL;
+    journal_t* journal = allocJournal(pageDir);
+    if (journal == NULL) return NULL;
+
+    // replay the journal
+    int numEntries;
+    hashtable_t* entries = loadEntries(journal, &numEntries);
+    if (entries == NULL) {
+        fprintf(stderr, "Error: there is no journal to resume in %s\n", journal->path);
+        deleteJournal(journal);
+        return NULL;
+    }
+
+    // make the saved pages match the journal, then start a fresh snapshot from it
+    renumberPages(store, entries, numEntries, numSaved);
+    if (!writeSnapshot(journal, entries, numEntries)) {
+        fprintf(stderr, "Error: could not rewrite the journal %s\n", journal->path);
+        hashtable_delete(entries, count_free);
+        deleteJournal(journal);
+        return NULL;
+    }
+
+    itemCall_t call = { arg, itemfunc };
+    hashtable_iterate(entries, &call, callItem);
+    hashtable_delete(entries, count_free);
+    return journal;
+}
+
+/************** journalRecord() ******************/
+// see journal.h for description
+void journalRecord(journal_t* journal, const journalState_t state, const char* URL,
+                   const int depth, const int id)
+{
+    if (journal == NULL || URL == NULL) return;
+    pthread_mutex_lock(&journal->lock);
+    if (journal->fp != NULL) {
+        // one line per record, flushed so a killed crawl keeps it
+        fprintf(journal->fp, "%c %d %d %s\n", STATES[state], depth, id, URL);
+        fflush(journal->fp);
+        journal->numRecords++;
+        if (journal->numRecords >= COMPACT_MIN && journal->numRecords > journal->snapshotSize) {
+            compactJournal(journal);
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+}
+
+/************** deleteJournal() ******************/
+// see journal.h for description
+void deleteJournal(journal_t* journal)
+{
+    if (journal == NULL) return;
+    if (journal->fp != NULL) fclose(journal->fp);
+    if (journal->path != NULL) count_free(journal->path);
+    if (journal->snapshotPath != NULL) count_free(journal->snapshotPath);
+    pthread_mutex_destroy(&journal->lock);
+    count_free(journal);
+}
+
+/************** allocJournal() ******************/
+/* creates a journal for pageDir with its file not open yet */
+static journal_t* allocJournal(char* pageDir)
+{
+    journal_t* journal = count_calloc(1, sizeof(journal_t));
+    if (journal == NULL) return NULL;
+    pthread_mutex_init(&journal->lock, NULL);
+    journal->path = stringBuilder(pageDir, ".journal");
+    journal->snapshotPath = stringBuilder(pageDir, ".journal.snapshot");
+    if (journal->path == NULL || journal->snapshotPath == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        deleteJournal(journal);
+        return NULL;
+    }
+    return journal;
+}
+
+/************** loadEntries() ******************/
+/* replays the journal into a table from URL to its latest journalEntry_t,
+ * setting *numEntries to the number of URLs. A last line without its newline
+ * was cut off by the crash, and is skipped. Returns NULL if there is no journal
+*/
+static hashtable_t* loadEntries(journal_t* journal, int* numEntries)
+{
+    FILE* fp = fopen(journal->path, "r");
+    if (fp == NULL) return NULL;
+    int numLines = lines_in_file(fp);
+    hashtable_t* entries = hashtable_new(numLines / 2 + 1);
+    *numEntries = 0;
+
+    char* line;
+    for (int i = 0; entries != NULL && i < numLines && (line = freadlinep(fp)) != NULL; i++) {
+        char letter;
+        int depth, id, start = 0;
+        const char* state;
+        if (sscanf(line, "%c %d %d %n", &letter, &depth, &id, &start) == 3 && start > 0
+            && line[start] != '\0' && letter != '\0' && (state = strchr(STATES, letter)) != NULL) {
+            const char* URL = line + start;
+            journalEntry_t* entry = hashtable_find(entries, URL);
+            if (entry == NULL) {
+                entry = count_malloc(sizeof(journalEntry_t));
+                if (entry != NULL && hashtable_insert(entries, URL, entry)) {
+                    (*numEntries)++;
+                } else if (entry != NULL) {
+                    count_free(entry);
+                    entry = NULL;
+                }
+            }
+            // the latest line about a URL wins
+            if (entry != NULL) {
+                entry->state = state - STATES;
+                entry->depth = depth;
+                entry->id = id;
+            }
+        }
+        free(line);
+    }
+    fclose(fp);
+    return entries;
+}
+
+/************** writeSnapshot() ******************/
+/* writes one line per URL to a new file, syncs it, and moves it over the
+ * journal, which is reopened for appending; returns false on error
+*/
+static bool writeSnapshot(journal_t* journal, hashtable_t* entries, const int numEntries)
+{
+    FILE* fp = fopen(journal->snapshotPath, "w");
+    if (fp == NULL) return false;
+    hashtable_iterate(entries, fp, writeEntry);
+    bool written = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    written = fclose(fp) == 0 && written;
+    if (!written || rename(journal->snapshotPath, journal->path) != 0) {
+        remove(journal->snapshotPath);
+        return false;
+    }
+
+    if (journal->fp != NULL) fclose(journal->fp);
+    journal->fp = fopen(journal->path, "a");
+    journal->numRecords = 0;
+    journal->snapshotSize = numEntries;
+    return journal->fp != NULL;
+}
+
+/************** compactJournal() ******************/
+/* replaces the journal with a snapshot of it, with the lock held. If that
+ * fails, the journal keeps growing as it was
+*/
+static void compactJournal(journal_t* journal)
+{
+    int numEntries;
+    hashtable_t* entries = loadEntries(journal, &numEntries);
+    if (entries == NULL) return;
+    if (!writeSnapshot(journal, entries, numEntries)) {
+        // try again only after as many more lines
+        journal->numRecords = 0;
+    }
+    hashtable_delete(entries, count_free);
+}
+
+/************** renumberPages() ******************/
+/* Makes the pages of the store match the replayed entries
+ *
+ * Pseudocode:
+ *      1. collect the saved URLs whose page in the store still has the URL;
+ *          the others go back to discovered
+ *      2. remove every page of the store none of them owns
+ *      3. in order of id, move their pages to 1, 2, 3, ..., and give the
+ *          aliases of each page its new id
+*/
+static void renumberPages(pageStore_t* store, hashtable_t* entries, const int numEntries, int* numSaved)
+{
+    *numSaved = 0;
+    pageList_t saved = { count_calloc(numEntries + 1, sizeof(savedPage_t)), 0 };
+    pageList_t aliases = { count_calloc(numEntries + 1, sizeof(savedPage_t)), 0 };
+    if (saved.pages == NULL || aliases.pages == NULL) {
+        if (saved.pages != NULL) count_free(saved.pages);
+        if (aliases.pages != NULL) count_free(aliases.pages);
+        return;
+    }
+    hashtable_iterate(entries, &saved, collectSaved);
+    hashtable_iterate(entries, &aliases, collectAliases);
+    qsort(aliases.pages, aliases.numPages, sizeof(savedPage_t), compareIDs);
+
+    // keep only the pages that are really theirs
+    int numOwned = 0;
+    for (int i = 0; i < saved.numPages; i++) {
+        journalEntry_t* entry = saved.pages[i].entry;
+        if (pageStartsWith(store, entry->id, saved.pages[i].URL)) {
+            saved.pages[numOwned++] = saved.pages[i];
+        } else {
+            entry->state = JOURNAL_DISCOVERED;
+            entry->id = 0;
+        }
+    }
+    saved.numPages = numOwned;
+    qsort(saved.pages, saved.numPages, sizeof(savedPage_t), compareIDs);
+    removeUnownedPages(store, &saved);
+
+    // every new id is at most the old one, so no page is overwritten
+    int nextAlias = 0;
+    for (int i = 0; i < saved.numPages; i++) {
+        journalEntry_t* entry = saved.pages[i].entry;
+        int oldID = entry->id;
+        int newID = *numSaved + 1;
+        if (oldID != newID) {
+            if (!pageStoreMove(store, oldID, newID)) {
+                entry->state = JOURNAL_DISCOVERED;
+                entry->id = 0;
+                nextAlias = moveAliases(&aliases, nextAlias, oldID, 0);
+                continue;
+            }
+            entry->id = newID;
+        }
+        nextAlias = moveAliases(&aliases, nextAlias, oldID, newID);
+        (*numSaved)++;
+    }
+    moveAliases(&aliases, nextAlias, INT_MAX, 0);
+    count_free(saved.pages);
+    count_free(aliases.pages);
+}
+
+/************** removeUnownedPages() ******************/
+/* removes the pages of the store whose id isn't the id of an owned page */
+static void removeUnownedPages(pageStore_t* store, pageList_t* owned)
+{
+    int maxID = pageStoreMaxID(store);
+    for (int id = 1; id <= maxID; id++) {
+        journalEntry_t key = { JOURNAL_SAVED, 0, id };
+        savedPage_t wanted = { NULL, &key };
+        if (bsearch(&wanted, owned->pages, owned->numPages, sizeof(savedPage_t), compareIDs) == NULL) {
+            pageStoreRemove(store, id);
+        }
+    }
+}
+
+/************** pageStartsWith() ******************/
+/* returns true if the store has a page with the given id and its URL is URL */
+static bool pageStartsWith(pageStore_t* store, const int id, const char* URL)
+{
+    if (id < 1) return false;
+    char* pageURL = pageStoreGetURL(store, id);
+    bool matches = pageURL != NULL && strcmp(pageURL, URL) == 0;
+    if (pageURL != NULL) free(pageURL);
+    return matches;
+}
+
+/************** writeEntry() ******************/
+// hashtable_iterate helper, writes one URL's snapshot line to the file in arg
+static void writeEntry(void* arg, const char* key, void* item)
+{
+    journalEntry_t* entry = item;
+    fprintf(arg, "%c %d %d %s\n", STATES[entry->state], entry->depth, entry->id, key);
+}
+
+/************** moveAliases() ******************/
+/* walks the aliases, sorted by id, from index next up to those of the page
+ * that had oldID, which now has newID: those get newID, and those of a lower
+ * id, whose page is gone, go back to discovered, as do those of oldID if
+ * newID is 0. Returns the index of the first alias after them
+*/
+static int moveAliases(pageList_t* aliases, int next, const int oldID, const int newID)
+{
+    for (; next < aliases->numPages && aliases->pages[next].entry->id <= oldID; next++) {
+        journalEntry_t* entry = aliases->pages[next].entry;
+        if (entry->id == oldID && newID > 0) {
+            entry->id = newID;
+        } else {
+            entry->state = JOURNAL_DISCOVERED;
+            entry->id = 0;
+        }
+    }
+    return next;
+}
+
+/************** collectSaved() ******************/
+// hashtable_iterate helper, adds each saved URL to the pageList_t in arg
+static void collectSaved(void* arg, const char* key, void* item)
+{
+    pageList_t* saved = arg;
+    journalEntry_t* entry = item;
+    if (entry->state == JOURNAL_SAVED || entry->state == JOURNAL_EXPANDED) {
+        saved->pages[saved->numPages].URL = key;
+        saved->pages[saved->numPages].entry = entry;
+        saved->numPages++;
+    }
+}
+
+/************** collectAliases() ******************/
+// hashtable_iterate helper, adds each aliased URL to the pageList_t in arg
+static void collectAliases(void* arg, const char* key, void* item)
+{
+    pageList_t* aliases = arg;
+    journalEntry_t* entry = item;
+    if (entry->state == JOURNAL_ALIASED) {
+        aliases->pages[aliases->numPages].URL = key;
+        aliases->pages[aliases->numPages].entry = entry;
+        aliases->numPages++;
+    }
+}
+
+/************** callItem() ******************/
+// hashtable_iterate helper, passes each URL to the itemCall_t in arg
+static void callItem(void* arg, const char* key, void* item)
+{
+    itemCall_t* call = arg;
+    journalEntry_t* entry = item;
+    call->itemfunc(call->arg, key, entry->depth, entry->id, entry->state);
+}
+
+/************** compareIDs() ******************/
+// qsort and bsearch helper, orders savedPage_t by id
+static int compareIDs(const void* a, const void* b)
+{
+    int idA = ((const savedPage_t*) a)->entry->id;
+    int idB = ((const savedPage_t*) b)->entry->id;
+    return (idA > idB) - (idA < idB);
+}
@@ -0,0 +1,82 @@
+/*
+ * journal.h - header file for the 'journal' file in the 'crawler' module
+ *
+ * the journal lets a crawl that died halfway be resumed. Every URL the
+ * crawler discovers, saves, finishes scanning, or gives up on is appended as
+ * one line to the file .journal in the page directory, and flushed right
+ * away, so a crawl that is killed loses at most the line it was writing.
+ * Every so often the journal is compacted into a snapshot holding one line
+ * per URL, its latest state, so it stays about as long as the crawl is big.
+ *
+ * Each line is "state depth id URL", where the state is one of
+ *      D   discovered, waiting in the frontier (id 0)
+ *      S   saved under that id in the page store, but its links not all recorded
+ *      E   saved, and every link it has was recorded as discovered
+ *      F   could not be fetched or saved (id 0)
+ *      A   a duplicate of the page saved under that id, not
+ *          saved itself, and every link it has was recorded
+ * and the latest line about a URL wins.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __JOURNAL
+#define __JOURNAL
+
+#include <stdbool.h>
+#include "pagestore.h"
+
+/**************** global types ****************/
+typedef struct journal journal_t; // a thread-safe, append-only record of a crawl
+
+typedef enum journalState { // how far the crawl got with a URL
+    JOURNAL_DISCOVERED,         // in the frontier, not fetched yet
+    JOURNAL_SAVED,              // saved to the page store, links not all recorded yet
+    JOURNAL_EXPANDED,           // saved, and every link it has was recorded
+    JOURNAL_FAILED,             // could not be fetched or saved
+    JOURNAL_ALIASED             // a duplicate of a saved page, every link it has was recorded
+} journalState_t;
+
+/******************* functions *******************/
+
+/******************* newJournal() ******************/
+/* starts an empty journal in pageDir, replacing any old one,
+ * returns NULL if the file can't be created
+*/
+journal_t* newJournal(char* pageDir);
+
+/******************* resumeJournal() ******************/
+/* Reopens the journal of a crawl in pageDir to carry on with it, whose pages
+ * are in the (writable) store
+ *
+ * Pseudocode:
+ *      1. replay the journal, keeping the latest state of each URL
+ *      2. check that the store's page of every saved URL still has that URL;
+ *          if not, the URL goes back to discovered, to be fetched again
+ *      3. remove the pages no saved URL owns, i.e. those saved just
+ *          before the crawl died, and renumber the rest 1, 2, 3, ...
+ *          in order, so the directory has no gaps; aliases of a page follow
+ *          its new id, and those of a page that is gone go back to discovered
+ *      4. write the result as a fresh snapshot and reopen it for appending
+ *      5. call itemfunc(arg, URL, depth, id, state) on every URL
+ *
+ * sets *numSaved to the number of saved pages, so the next page is saved
+ * as *numSaved + 1. Returns NULL if there is no journal to resume
+*/
+journal_t* resumeJournal(char* pageDir, pageStore_t* store, int* numSaved, void* arg,
+                         void (*itemfunc)(void* arg, const char* URL, const int depth,
+                                          const int id, const journalState_t state));
+
+/******************* journalRecord() ******************/
+/* appends the state of a URL to the journal and flushes it; id is the page
+ * it was saved under, or 0. Once more lines were appended than the last snapshot
+ * has, and at least 10000, the journal is compacted into a new snapshot
+*/
+void journalRecord(journal_t* journal, const journalState_t state, const char* URL,
+                   const int depth, const int id);
+
+/******************* deleteJournal() ******************/
+/* closes the journal, leaving its file in place */
+void deleteJournal(journal_t* journal);
+
+#endif
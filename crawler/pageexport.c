@@ -0,0 +1,99 @@
+/*
+ * pageexport.c - page store exporter for tiny search engine
+ *
+ * takes the name of a page directory written by the crawler, which saves its
+ * pages to a page store (see pagestore.h), and writes every page to a file of
+ * its own in another directory, named by its id, in the layout the crawler
+ * used to write. Like the crawler, both directories are relative to the data directory
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "pagedir.h"
+#include "pagestore.h"
+#include "webpage.h"
+#include "word.h"
+#include "memory.h"
+
+/************* function prototypes ********************/
+
+bool pageExport(char* pageDir, char* legacyDir);
+
+/************** main() ******************/
+/* the main function, which takes two directory names as inputs (other than
+ * the executable call): the page directory to read, and an existing directory
+ * to write the files to
+ *
+ * Pseudocode:
+ *      1. Make sure there are exactly 2 arguments
+ *      2. call the pageExport method
+ *
+ * Assumptions:
+ *      1. the user puts in valid inputs, otherwise throws errors
+ *      2. both directories are located within the data directory
+*/
+int main(const int argc, char* argv[])
+{
+    // validate arguments
+    char* program = argv[0];
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s [pageDirectory] [legacyDirectory]\n", program);
+        return 1;
+    }
+
+    // run the export
+    if (pageExport(argv[1], argv[2])) return 0;
+    else return 1;
+}
+
+/************** pageExport() ******************/
+/* opens the page store of pageDir and writes each of its pages to the file
+ * named by its id in legacyDir
+ *
+ * Pseudocode:
+ *      1. open the page store, and check legacyDir is a directory (which
+ *          marks it as a crawler directory)
+ *      2. for every id the store's index has, load the page, if there is one
+ *      3. write it to legacyDir/id with writeToDirectory
+ *
+ * returns false if there is no page store or a file can't be written
+*/
+bool pageExport(char* pageDir, char* legacyDir)
+{
+    char* dirPath = stringBuilder(pageDir, "");
+    if (dirPath == NULL) return false;
+    pageStore_t* store = openPageStore(dirPath, false);
+    count_free(dirPath);
+    if (store == NULL) {
+        fprintf(stderr, "Error: directory %s has no page store\n", pageDir);
+        return false;
+    }
+    if (!validDirectory(legacyDir)) {
+        deletePageStore(store);
+        return false;
+    }
+
+    // write each page under its own id, so aliases still point at the right file
+    bool exported = true;
+    int numPages = 0;
+    int maxID = pageStoreMaxID(store);
+    for (int id = 1; id <= maxID && exported; id++) {
+        webpage_t* page = pageStoreGet(store, id);
+        if (page == NULL) continue;
+        char* idString = intToString(id);
+        char* filepath = stringBuilder(legacyDir, idString);
+        if (idString != NULL) count_free(idString);
+        int nextID = numPages;
+        exported = filepath != NULL && writeToDirectory(filepath, page, &nextID);
+        numPages = nextID;
+        if (filepath != NULL) count_free(filepath);
+        webpage_delete(page);
+    }
+    deletePageStore(store);
+    printf("Exported %d pages from ../data/%s to ../data/%s\n", numPages, pageDir, legacyDir);
+    return exported;
+}
@@ -0,0 +1,160 @@
+/*
+ * politeness.c - per-host schedule that spaces out fetches to each server
+ *
+ * see politeness.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "politeness.h"
+#include "hashtable.h"
+#include "memory.h"
+
+/************* global types ****************/
+
+typedef struct hostEntry {
+    long long nextStart;            // earliest time the host's next fetch may start
+} hostEntry_t;
+
+typedef struct politeness {
+    hashtable_t* hosts;             // host name -> hostEntry_t
+    long long hostDelay;            // nanoseconds between fetches to one host
+    long long waitTime;             // total nanoseconds spent waiting for a slot
+    long long fetchTime;            // total nanoseconds spent fetching
+    int numFetches;                 // number of fetches finished
+    pthread_mutex_t lock;           // guards everything above
+} politeness_t;
+
+/************* local function prototypes ****************/
+
+static long long now(void);
+static char* hostOf(const char* url);
+
+/************** newPoliteness() ******************/
+// see politeness.h for description
+politeness_t* newPoliteness(const int hostDelay)
+{
+    politeness_t* scheduler = count_malloc(sizeof(politeness_t));
+    if (scheduler == NULL) return NULL;
+    if ((scheduler->hosts = hashtable_new(20)) == NULL) {
+        count_free(scheduler);
+        return NULL;
+    }
+    scheduler->hostDelay = hostDelay > 0 ? hostDelay * 1000000LL : 0;
+    scheduler->waitTime = 0;
+    scheduler->fetchTime = 0;
+    scheduler->numFetches = 0;
+    pthread_mutex_init(&scheduler->lock, NULL);
+    return scheduler;
+}
+
+/************** deletePoliteness() ******************/
+// see politeness.h for description
+void deletePoliteness(politeness_t* scheduler)
+{
+    if (scheduler == NULL) return;
+    hashtable_delete(scheduler->hosts, count_free);
+    pthread_mutex_destroy(&scheduler->lock);
+    count_free(scheduler);
+}
+
+/************** politenessWait() ******************/
+// see politeness.h for description
+long long politenessWait(politeness_t* scheduler, const char* url)
+{
+    long long slot = politenessReserve(scheduler, url);
+
+    // sleep until the reserved slot
+    long long wait = slot - now();
+    if (wait > 0) {
+        struct timespec delay = { wait / 1000000000LL, wait % 1000000000LL };
+        while (nanosleep(&delay, &delay) != 0) { }
+    }
+    return slot;
+}
+
+/************** politenessReserve() ******************/
+// see politeness.h for description
+long long politenessReserve(politeness_t* scheduler, const char* url)
+{
+    long long start = now();
+    if (scheduler == NULL || url == NULL) return start;
+    char* host = hostOf(url);
+    if (host == NULL) return start;
+
+    // reserve a slot for this fetch; the caller waits for it without
+    // holding the lock, so fetches to other hosts are never held up
+    long long slot = start;
+    pthread_mutex_lock(&scheduler->lock);
+    hostEntry_t* entry = hashtable_find(scheduler->hosts, host);
+    if (entry == NULL) {
+        entry = count_malloc(sizeof(hostEntry_t));
+        if (entry != NULL && !hashtable_insert(scheduler->hosts, host, entry)) {
+            count_free(entry);
+            entry = NULL;
+        }
+    } else if (entry->nextStart > slot) {
+        slot = entry->nextStart;
+    }
+    if (entry != NULL) entry->nextStart = slot + scheduler->hostDelay;
+    scheduler->waitTime += slot - start;
+    pthread_mutex_unlock(&scheduler->lock);
+    count_free(host);
+    return slot;
+}
+
+/************** politenessDone() ******************/
+// see politeness.h for description
+void politenessDone(politeness_t* scheduler, const long long fetchStart)
+{
+    if (scheduler == NULL) return;
+    long long elapsed = now() - fetchStart;
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->fetchTime += elapsed > 0 ? elapsed : 0;
+    scheduler->numFetches++;
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+/************** politenessReport() ******************/
+// see politeness.h for description
+void politenessReport(politeness_t* scheduler, FILE* fp)
+{
+    if (scheduler == NULL || fp == NULL) return;
+    pthread_mutex_lock(&scheduler->lock);
+    fprintf(fp, "Fetched %d pages: %.3f seconds fetching, %.3f seconds waiting on host delays\n",
+            scheduler->numFetches, scheduler->fetchTime / 1e9, scheduler->waitTime / 1e9);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+/************** now() ******************/
+// returns the current monotonic time in nanoseconds
+static long long now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/************** hostOf() ******************/
+/* returns a malloc'd copy of the host (and port) part of a URL,
+ * e.g. "cs50tse.cs.dartmouth.edu" for "http://cs50tse.cs.dartmouth.edu/tse/",
+ * or NULL if out of memory
+*/
+static char* hostOf(const char* url)
+{
+    const char* start = strstr(url, "://");
+    start = (start == NULL) ? url : start + 3;
+    size_t len = strcspn(start, "/");
+    char* host = count_malloc(len + 1);
+    if (host == NULL) return NULL;
+    memcpy(host, start, len);
+    host[len] = '\0';
+    return host;
+}
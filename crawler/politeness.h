@@ -0,0 +1,62 @@
+/*
+ * politeness.h - header file for the 'politeness' file in the 'crawler' module
+ *
+ * the politeness scheduler keeps the crawler from overloading any one server.
+ * It spaces the starts of successive fetches to the same host by a minimum delay,
+ * while fetches to different hosts never wait on each other. It also keeps track
+ * of how long the crawl spent waiting on the schedule versus fetching pages.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __POLITENESS
+#define __POLITENESS
+
+#include <stdio.h>
+
+/**************** global types ****************/
+typedef struct politeness politeness_t; // a thread-safe per-host fetch schedule
+
+/******************* functions *******************/
+
+/******************* newPoliteness() ******************/
+/* creates a scheduler that keeps hostDelay milliseconds between the starts
+ * of fetches to the same host, returns NULL if out of memory
+*/
+politeness_t* newPoliteness(const int hostDelay);
+
+/******************* deletePoliteness() ******************/
+/* deletes the scheduler and its table of hosts */
+void deletePoliteness(politeness_t* scheduler);
+
+/******************* politenessWait() ******************/
+/* Waits until the host of the URL may be fetched again
+ *
+ * Pseudocode:
+ *      1. find the host's entry, creating it on the first visit
+ *      2. reserve the host's next free slot, no earlier than now, and move
+ *          the next free slot hostDelay milliseconds after it
+ *      3. sleep until the reserved slot, without holding the lock
+ *
+ * returns the time the fetch may start, in nanoseconds, which must be passed to
+ * politenessDone() once the fetch is over
+*/
+long long politenessWait(politeness_t* scheduler, const char* url);
+
+/******************* politenessReserve() ******************/
+/* reserves the next slot of the URL's host like politenessWait(), but returns
+ * the time of the slot, in nanoseconds, instead of sleeping until it. For a
+ * caller that waits on its own, like the event-driven fetch engine. The time
+ * must still be passed to politenessDone() once the fetch is over
+*/
+long long politenessReserve(politeness_t* scheduler, const char* url);
+
+/******************* politenessDone() ******************/
+/* records that the fetch which started at fetchStart is over */
+void politenessDone(politeness_t* scheduler, const long long fetchStart);
+
+/******************* politenessReport() ******************/
+/* prints the number of fetches and the total time spent waiting and fetching */
+void politenessReport(politeness_t* scheduler, FILE* fp);
+
+#endif
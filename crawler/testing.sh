@@ -12,6 +12,16 @@ mkdir ../data/letters-depth-{0..6}
 mkdir ../data/toscrape-depth-{0..1}
 mkdir ../data/wikipedia-depth-{0..1}
 
+# the crawler saves the pages of a directory to its page store; pageexport
+# writes them back out one file per page, which is how these tests read them.
+# pages DIR [N] prints the first N lines (URL, depth) of each page of DIR
+pages() {
+    mkdir ../data/$1-export
+    ./pageexport $1 $1-export > /dev/null
+    head -qn${2:-1} ../data/$1-export/[0-9]*
+    rm -rf ../data/$1-export
+}
+
 # LETTERS TESTS
 # -------------
 ./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-0 0
@@ -42,6 +52,138 @@ mkdir ../data/wikipedia-depth-{0..1}
 
 ./crawler http://cs50tse.cs.dartmouth.edu/tse/wikipedia/ wikipedia-depth-1 1
 
+# WORKER THREADS
+# --------------
+mkdir ../data/toscrape-depth-1-workers
+./crawler -j 8 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-1-workers 1
+
+# the same pages should be saved as by a single worker, under different ids
+diff <(pages toscrape-depth-1 | sort) <(pages toscrape-depth-1-workers | sort) && echo "same pages"
+rm -rf ../data/toscrape-depth-1-workers
+
+# INVALID NUMBER OF WORKERS
+./crawler -j 0 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# HOST DELAY
+mkdir ../data/letters-depth-6-delay
+./crawler -d 100 http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-6-delay 6
+diff <(pages letters-depth-6 | sort) <(pages letters-depth-6-delay | sort) && echo "same pages"
+rm -rf ../data/letters-depth-6-delay
+
+# INVALID HOST DELAY
+./crawler -d -5 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# KEEP-ALIVE CONNECTIONS: compare the pages/sec of both crawls
+mkdir ../data/letters-depth-6-pool ../data/letters-depth-6-nopool
+./crawler -d 0 -c 2 http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-6-pool 6
+./crawler -d 0 -c 0 http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-6-nopool 6
+diff <(pages letters-depth-6-pool | sort) <(pages letters-depth-6-nopool | sort) && echo "same pages"
+rm -rf ../data/letters-depth-6-pool ../data/letters-depth-6-nopool
+
+# FETCH ENGINE: the same pages as a blocking crawl, fetched from one thread
+mkdir ../data/letters-depth-6-engine
+./crawler -d 0 -e 64 http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-6-engine 6
+diff <(pages letters-depth-6 | sort) <(pages letters-depth-6-engine | sort) && echo "same pages"
+rm -rf ../data/letters-depth-6-engine
+
+# STREAMING: the same pages when each page's links are found while it arrives,
+# by one worker and by several, and the first links are found sooner
+mkdir ../data/letters-depth-6-stream ../data/toscrape-depth-1-stream
+./crawler -d 0 -s http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-6-stream 6 | grep "first link"
+./crawler -d 0 -s -j 8 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-1-stream 1 | grep "first link"
+diff <(pages letters-depth-6 | sort) <(pages letters-depth-6-stream | sort) && echo "same pages"
+diff <(pages toscrape-depth-1 | sort) <(pages toscrape-depth-1-stream | sort) && echo "same pages"
+rm -rf ../data/letters-depth-6-stream ../data/toscrape-depth-1-stream
+
+# LARGEST PAGE SIZE: pages cut off after 4 KB, streamed or not
+mkdir ../data/toscrape-depth-0-cut ../data/toscrape-depth-0-cut-engine
+./crawler -d 0 -s -m 4 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-0-cut 0 | grep "Cut off"
+./crawler -d 0 -e 8 -m 4 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-0-cut-engine 0 | grep "Cut off"
+mkdir ../data/toscrape-depth-0-cut-export
+./pageexport toscrape-depth-0-cut toscrape-depth-0-cut-export > /dev/null
+tail -n +3 ../data/toscrape-depth-0-cut-export/1 | wc -c
+rm -rf ../data/toscrape-depth-0-cut ../data/toscrape-depth-0-cut-engine ../data/toscrape-depth-0-cut-export
+
+# INVALID LARGEST PAGE SIZE, AND STREAMING WITH THE ENGINE
+./crawler -m -1 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+./crawler -s -e 8 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# SPILLING FRONTIER: a 1 KB budget writes the pending URLs to disk, which
+# must not change the pages or their depths
+mkdir ../data/toscrape-depth-1-memory ../data/toscrape-depth-1-spill
+./crawler -d 0 -f 0 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-1-memory 1 | grep frontier
+./crawler -d 0 -f 1 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-1-spill 1 | grep frontier
+diff <(pages toscrape-depth-1-memory 2 | paste - - | sort) <(pages toscrape-depth-1-spill 2 | paste - - | sort) && echo "same pages and depths"
+rm -rf ../data/toscrape-depth-1-memory ../data/toscrape-depth-1-spill
+
+# INVALID FRONTIER BUDGET
+./crawler -f -1 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# BLOOM FILTER: checking a filter before the visited set must not change the
+# pages, and the crawler reports how often the filter was wrong
+mkdir ../data/toscrape-depth-1-bloom
+./crawler -d 0 -b 8 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-1-bloom 1 | grep -i "visited set\|bloom"
+diff <(pages toscrape-depth-1 | sort) <(pages toscrape-depth-1-bloom | sort) && echo "same pages"
+rm -rf ../data/toscrape-depth-1-bloom
+
+# INVALID BLOOM FILTER SIZE
+./crawler -b 65 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# DUPLICATES: toscrape/index.html is the same page as toscrape/, so it is
+# listed as an alias of page 1 instead of being saved
+cat ../data/toscrape-depth-1/.aliases
+pages toscrape-depth-1 | wc -l
+
+# PAGE EXPORT: a page store written out one file per page, in the layout the
+# indexer and querier also read
+mkdir ../data/letters-depth-2-export
+./pageexport letters-depth-2 letters-depth-2-export
+ls ../data/letters-depth-2 ../data/letters-depth-2-export
+head -n 2 ../data/letters-depth-2-export/1
+rm -rf ../data/letters-depth-2-export
+
+# COMPRESSION: the same pages, in a store a fraction of the size
+mkdir ../data/toscrape-depth-1-compressed
+./crawler -d 0 -z 2 http://cs50tse.cs.dartmouth.edu/tse/toscrape/ toscrape-depth-1-compressed 1 | grep "KB of HTML"
+diff <(pages toscrape-depth-1 | sort) <(pages toscrape-depth-1-compressed | sort) && echo "same pages"
+ls -l ../data/toscrape-depth-1 ../data/toscrape-depth-1-compressed | grep pages
+rm -rf ../data/toscrape-depth-1-compressed
+
+# INVALID COMPRESSION
+./crawler -z 3 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# EXPORT WITHOUT A PAGE STORE
+./pageexport default letters-depth-2
+
+# INVALID NEAR-DUPLICATE DISTANCE
+./crawler -n 4 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# RESUME: cut a crawl short by keeping only the start of its journal, then
+# resume it; the pages saved before are kept, and the rest are crawled
+mkdir ../data/letters-depth-6-resume
+./crawler -d 0 http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-6-resume 6
+head -n 8 ../data/letters-depth-6-resume/.journal > ../data/letters-depth-6-resume/.journal.cut
+mv ../data/letters-depth-6-resume/.journal.cut ../data/letters-depth-6-resume/.journal
+./crawler -d 0 --resume http://cs50tse.cs.dartmouth.edu/tse/letters/ letters-depth-6-resume 6
+diff <(pages letters-depth-6 | sort) <(pages letters-depth-6-resume | sort) && echo "same pages"
+rm -rf ../data/letters-depth-6-resume
+
+# RESUME WITHOUT A JOURNAL
+mkdir ../data/no-journal
+./crawler --resume http://cs50tse.cs.dartmouth.edu/tse/letters/ no-journal 0
+rm -rf ../data/no-journal
+
+# INVALID NUMBER OF FETCHES, AND THE ENGINE WITH WORKER THREADS
+./crawler -e -1 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+./crawler -e 8 -j 4 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# INVALID TIMEOUTS: a negative one, and too few of them
+./crawler -t 5000,-1,30000 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+./crawler -t 5000,10000 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
+# INVALID NUMBER OF IDLE CONNECTIONS
+./crawler -c -1 http://cs50tse.cs.dartmouth.edu/tse/letters/ default 0
+
 # NONEXISTENT DIRECTORY TEST
 ./crawler http://cs50tse.cs.dartmouth.edu/tse/letters/ non-existent-dir 0
 
@@ -0,0 +1,239 @@
+/*
+ * visited.c - thread-safe set of URLs seen by the crawler
+ *
+ * see visited.h for more information.
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "visited.h"
+#include "memory.h"
+
+/************* global types ****************/
+
+#define NUM_STRIPES 16 // number of independently locked tables
+
+typedef struct stripe { // the fingerprints whose top bits pick this table
+    uint64_t* slots;            // the fingerprints, 0 for an empty slot
+    size_t capacity;            // the number of slots, a power of 2
+    size_t numURLs;             // the number of fingerprints stored
+    uint64_t* bloom;            // the Bloom filter's bits, or NULL
+    size_t bloomBits;           // the number of bits, a power of 2
+    int falsePositives;         // new URLs the filter claimed were seen
+    pthread_mutex_t lock;       // guards everything above
+} stripe_t;
+
+typedef struct visitedSet {
+    stripe_t stripes[NUM_STRIPES];
+    int bloomBits;              // bits of filter per URL, 0 for no filter
+    int bloomHashes;            // bits set for each URL
+} visitedSet_t;
+
+/************* global variables ****************/
+
+static const size_t MIN_CAPACITY = 64;   // fewest slots in a table
+
+/************* local function prototypes ****************/
+
+static uint64_t fingerprint(const char* url);
+static bool growStripe(visitedSet_t* set, stripe_t* stripe, const size_t capacity);
+static bool bloomCheck(visitedSet_t* set, stripe_t* stripe, const uint64_t print);
+static void bloomAdd(visitedSet_t* set, stripe_t* stripe, const uint64_t print);
+
+/************** newVisitedSet() ******************/
+// see visited.h for description
+visitedSet_t* newVisitedSet(const int expectedURLs, const int bloomBits)
+{
+    if (expectedURLs < 0 || bloomBits < 0) return NULL;
+    visitedSet_t* set = count_calloc(1, sizeof(visitedSet_t));
+    if (set == NULL) return NULL;
+    set->bloomBits = bloomBits;
+    // k = bits per URL * ln 2 hashes keeps the false positive rate lowest
+    set->bloomHashes = (int) (bloomBits * 0.693 + 0.5);
+    if (set->bloomHashes < 1) set->bloomHashes = 1;
+    if (set->bloomHashes > 16) set->bloomHashes = 16;
+
+    // give each stripe room for its share of the URLs before it grows
+    size_t capacity = MIN_CAPACITY;
+    while (capacity * 7 / 10 < (size_t) expectedURLs / NUM_STRIPES + 1) capacity *= 2;
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        pthread_mutex_init(&set->stripes[i].lock, NULL);
+        if (!growStripe(set, &set->stripes[i], capacity)) {
+            deleteVisitedSet(set);
+            return NULL;
+        }
+    }
+    return set;
+}
+
+/************** deleteVisitedSet() ******************/
+// see visited.h for description
+void deleteVisitedSet(visitedSet_t* set)
+{
+    if (set == NULL) return;
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        if (set->stripes[i].slots != NULL) count_free(set->stripes[i].slots);
+        if (set->stripes[i].bloom != NULL) count_free(set->stripes[i].bloom);
+        pthread_mutex_destroy(&set->stripes[i].lock);
+    }
+    count_free(set);
+}
+
+/************** visitedSetInsert() ******************/
+// see visited.h for description
+bool visitedSetInsert(visitedSet_t* set, const char* url)
+{
+    if (set == NULL || url == NULL) return false;
+    // the top bits pick the stripe, the bottom bits the slot
+    uint64_t print = fingerprint(url);
+    stripe_t* stripe = &set->stripes[print >> 60];
+    pthread_mutex_lock(&stripe->lock);
+    bool maybeSeen = stripe->bloom == NULL || bloomCheck(set, stripe, print);
+
+    // linear probing: the fingerprint is in the run of full slots from its own
+    size_t mask = stripe->capacity - 1;
+    size_t slot = print & mask;
+    if (maybeSeen) {
+        while (stripe->slots[slot] != 0 && stripe->slots[slot] != print) slot = (slot + 1) & mask;
+        if (stripe->slots[slot] == print) {
+            pthread_mutex_unlock(&stripe->lock);
+            return false;
+        }
+        if (stripe->bloom != NULL) stripe->falsePositives++;
+    } else {
+        // the filter is sure it's new, so just find an empty slot
+        while (stripe->slots[slot] != 0) slot = (slot + 1) & mask;
+    }
+
+    stripe->slots[slot] = print;
+    stripe->numURLs++;
+    if (stripe->bloom != NULL) bloomAdd(set, stripe, print);
+    bool inserted = true;
+    if (stripe->numURLs > stripe->capacity * 7 / 10 && !growStripe(set, stripe, stripe->capacity * 2)) {
+        // out of memory: keep the URL, but take no more once the table is almost full
+        if (stripe->numURLs > stripe->capacity - stripe->capacity / 16) {
+            stripe->slots[slot] = 0;
+            stripe->numURLs--;
+            inserted = false;
+        }
+    }
+    pthread_mutex_unlock(&stripe->lock);
+    return inserted;
+}
+
+/************** visitedSetStats() ******************/
+// see visited.h for description
+void visitedSetStats(visitedSet_t* set, int* numURLs, size_t* memory, int* falsePositives)
+{
+    if (set == NULL) return;
+    size_t urls = 0, bytes = sizeof(visitedSet_t);
+    int wrong = 0;
+    for (int i = 0; i < NUM_STRIPES; i++) {
+        stripe_t* stripe = &set->stripes[i];
+        pthread_mutex_lock(&stripe->lock);
+        urls += stripe->numURLs;
+        bytes += stripe->capacity * sizeof(uint64_t);
+        if (stripe->bloom != NULL) bytes += stripe->bloomBits / 8;
+        wrong += stripe->falsePositives;
+        pthread_mutex_unlock(&stripe->lock);
+    }
+    if (numURLs != NULL) *numURLs = urls;
+    if (memory != NULL) *memory = bytes;
+    if (falsePositives != NULL) *falsePositives = wrong;
+}
+
+/************** fingerprint() ******************/
+/* hashes a URL to 64 bits with FNV-1a, then mixes the bits (as in MurmurHash3)
+ * so that every bit depends on every character; never returns 0, which marks
+ * an empty slot
+*/
+static uint64_t fingerprint(const char* url)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char* c = (const unsigned char*) url; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash != 0 ? hash : 1;
+}
+
+/************** growStripe() ******************/
+/* moves a stripe's fingerprints to a table with the given number of slots,
+ * and rebuilds its filter to fit, returns false (leaving the stripe as it was)
+ * if out of memory
+*/
+static bool growStripe(visitedSet_t* set, stripe_t* stripe, const size_t capacity)
+{
+    uint64_t* slots = count_calloc(capacity, sizeof(uint64_t));
+    if (slots == NULL) return false;
+    uint64_t* bloom = NULL;
+    size_t bloomBits = 0;
+    if (set->bloomBits > 0) {
+        // enough bits per URL for a table as full as it gets
+        bloomBits = 64;
+        while (bloomBits < (capacity * 7 / 10) * set->bloomBits) bloomBits *= 2;
+        if ((bloom = count_calloc(bloomBits / 64, sizeof(uint64_t))) == NULL) {
+            count_free(slots);
+            return false;
+        }
+    }
+
+    uint64_t* oldSlots = stripe->slots;
+    size_t oldCapacity = stripe->capacity;
+    if (stripe->bloom != NULL) count_free(stripe->bloom);
+    stripe->slots = slots;
+    stripe->capacity = capacity;
+    stripe->bloom = bloom;
+    stripe->bloomBits = bloomBits;
+    for (size_t i = 0; i < oldCapacity; i++) {
+        uint64_t print = oldSlots[i];
+        if (print == 0) continue;
+        size_t slot = print & (capacity - 1);
+        while (slots[slot] != 0) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = print;
+        if (bloom != NULL) bloomAdd(set, stripe, print);
+    }
+    if (oldSlots != NULL) count_free(oldSlots);
+    return true;
+}
+
+/************** bloomCheck() ******************/
+/* returns true if every filter bit of the fingerprint is set. The bits are
+ * h1 + i * h2 for the i-th hash, with h1 and h2 taken from a remix of the
+ * fingerprint, so they don't follow the slot it lands in
+*/
+static bool bloomCheck(visitedSet_t* set, stripe_t* stripe, const uint64_t print)
+{
+    uint64_t mixed = (print ^ (print >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    uint64_t h1 = mixed ^ (mixed >> 32);
+    uint64_t h2 = (mixed >> 17) | 1;
+    size_t mask = stripe->bloomBits - 1;
+    for (int i = 0; i < set->bloomHashes; i++) {
+        size_t bit = (h1 + i * h2) & mask;
+        if ((stripe->bloom[bit / 64] & (1ULL << (bit % 64))) == 0) return false;
+    }
+    return true;
+}
+
+/************** bloomAdd() ******************/
+/* sets every filter bit of the fingerprint, see bloomCheck() */
+static void bloomAdd(visitedSet_t* set, stripe_t* stripe, const uint64_t print)
+{
+    uint64_t mixed = (print ^ (print >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    uint64_t h1 = mixed ^ (mixed >> 32);
+    uint64_t h2 = (mixed >> 17) | 1;
+    size_t mask = stripe->bloomBits - 1;
+    for (int i = 0; i < set->bloomHashes; i++) {
+        size_t bit = (h1 + i * h2) & mask;
+        stripe->bloom[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
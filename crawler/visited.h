@@ -0,0 +1,65 @@
+/*
+ * visited.h - header file for the 'visited' file in the 'crawler' module
+ *
+ * the visited set remembers every URL the crawler has seen, so that no URL is
+ * crawled twice. It doesn't keep the URLs themselves, only a 64-bit fingerprint
+ * (hash) of each, in open-addressed tables that double in size as they fill,
+ * so a lookup costs a few probes and a URL costs 12 to 23 bytes. Two URLs with
+ * the same fingerprint would count as one; with a million URLs the chance of
+ * that happening at all is about 1 in 37 million.
+ *
+ * The fingerprints are split over several tables, each with its own lock, so
+ * crawler workers inserting different URLs rarely wait on each other. Each
+ * table may have a Bloom filter in front of it, which is checked first and
+ * counts how often it claims a new URL was already seen, i.e. how many URLs a
+ * crawler keeping only the filter, at that many bits per URL, would miss.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __VISITED
+#define __VISITED
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**************** global types ****************/
+typedef struct visitedSet visitedSet_t; // a thread-safe set of URL fingerprints
+
+/******************* functions *******************/
+
+/******************* newVisitedSet() ******************/
+/* creates an empty set with room for about expectedURLs URLs before it grows,
+ * and a Bloom filter of bloomBits bits per URL in front of it (0 for none),
+ * returns NULL if out of memory
+*/
+visitedSet_t* newVisitedSet(const int expectedURLs, const int bloomBits);
+
+/******************* deleteVisitedSet() ******************/
+/* deletes the set and its tables */
+void deleteVisitedSet(visitedSet_t* set);
+
+/******************* visitedSetInsert() ******************/
+/* Inserts the fingerprint of a URL into the set
+ *
+ * Pseudocode:
+ *      1. hash the URL to its fingerprint, and lock the table it belongs to
+ *      2. if there is a Bloom filter, check the URL's bits in it
+ *      3. probe the table from the fingerprint's slot until finding it or an empty slot
+ *      4. if it wasn't there, count a false positive if the filter claimed it
+ *          was, store it, set its bits in the filter, and double the table
+ *          (rebuilding the filter at twice the size) once it is 70% full
+ *
+ * returns true if the URL was not in the set yet (so the caller should crawl it),
+ * false if it was already there or on error
+*/
+bool visitedSetInsert(visitedSet_t* set, const char* url);
+
+/******************* visitedSetStats() ******************/
+/* sets *numURLs to the number of URLs in the set, *memory to the bytes its
+ * tables and filters take, and *falsePositives to the number of new URLs the
+ * Bloom filter claimed were already seen; any pointer may be NULL
+*/
+void visitedSetStats(visitedSet_t* set, int* numURLs, size_t* memory, int* falsePositives);
+
+#endif
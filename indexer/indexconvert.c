@@ -0,0 +1,77 @@
+/*
+ * indexconvert.c - index file converter for tiny search engine
+ *
+ * takes the name of an index file, in either the text format or the binary format
+ * (see indexmap.h), and writes the same index to another file in the requested format.
+ * Like the indexer, both filenames are relative to the data directory
+ *
+ * Ethan Chen, Oct. 2021
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "index.h"
+#include "memory.h"
+
+/************* function prototypes ********************/
+
+bool indexConvert(char* oldFile, char* newFile, bool binary);
+
+/************** main() ******************/
+/* the main function, which takes a format flag and two filenames
+ * as inputs (other than the executable call): -b to write a binary index file
+ * or -t to write a text index file, the filename of an existing index file,
+ * and the filename of the index file to be created
+ *
+ * Pseudocode:
+ *      1. Make sure there are exactly 3 arguments and the flag is valid
+ *      2. call the indexConvert method
+ *
+ * Assumptions:
+ *      1. the user puts in valid inputs, otherwise throws errors
+ *      2. the index file is located within the data directory
+*/
+int main(const int argc, char* argv[])
+{
+    // validate arguments
+    char* program = argv[0];
+    if (argc != 4 || (strcmp(argv[1], "-b") != 0 && strcmp(argv[1], "-t") != 0)) {
+        fprintf(stderr, "Usage: %s [-b|-t] [oldIndexFilename] [newIndexFilename]\n", program);
+        return 1;
+    }
+    bool binary = strcmp(argv[1], "-b") == 0;
+
+    // run the conversion
+    if (indexConvert(argv[2], argv[3], binary)) return 0;
+    else return 1;
+}
+
+/************** indexConvert() ******************/
+/* loads the index file, whichever format it is in, and saves it
+ * in the requested format
+ *
+ * Pseudocode:
+ *      1. load the index with loadIndexFromFile, which detects the format
+ *      2. save it with saveIndexToBinaryFile or saveIndexToFile
+ *      3. free the index
+*/
+bool indexConvert(char* oldFile, char* newFile, bool binary)
+{
+    // load the index from the file
+    index_t* index = loadIndexFromFile(oldFile);
+    if (index == NULL) {
+        fprintf(stderr, "Error: could not load index file %s\n", oldFile);
+        return false;
+    }
+
+    // save the index in the other format
+    bool saved = binary ? saveIndexToBinaryFile(newFile, index)
+                        : saveIndexToFile(newFile, index);
+    if (!saved) {
+        fprintf(stderr, "Error: could not save index file %s\n", newFile);
+    }
+    deleteIndex(index);
+    return saved;
+}
@@ -13,22 +13,44 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include "string.h"
 #include "memory.h"
 #include "pagedir.h"
 #include "index.h"
 
+/************* local types ********************/
+
+typedef struct indexShard { // one worker's range of crawler files and its private index
+    char* pageDir;
+    int firstID;
+    int lastID;
+    index_t* index;
+    bool success;
+} indexShard_t;
+
+/************* global variables ********************/
+
+static const int MAX_WORKERS = 64; // most worker threads an indexer may use
+
 /************* function prototypes ********************/
 
-bool indexer(char* pageDir, char* indexFilename);
+bool indexer(char* pageDir, char* indexFilename, bool binary, int numWorkers);
+bool buildIndexInParallel(char* pageDir, index_t* index, int numWorkers);
+
+/************* local function prototypes ********************/
+
+static void* indexWorker(void* arg);
 
 /************** main() ******************/
 /* the "testing" function/main function, which takes two arguments 
  * as inputs (other than the executable call), the directory containing the
- * files to index and the name of the index file to write
+ * files to index and the name of the index file to write. They may be preceded
+ * by -b to write a binary index file (see indexmap.h) instead of a text one,
+ * and by -j [numWorkers] to index with that many worker threads
  * 
  * Pseudocode:
- *      1. Make sure there are exactly 2 arguments
+ *      1. parse the flags, then make sure there are exactly 2 arguments left
  *      2. copy the pageDirectory and indexFilename into malloc'd strings
  *      3. call the indexer method
  * 
@@ -39,14 +61,37 @@ bool indexer(char* pageDir, char* indexFilename);
 int main(const int argc, char* argv[])
 {
     char* program = argv[0];
+    // parse the flags that come before the positional arguments
+    bool binary = false;
+    int numWorkers = 1;
+    int argIndex = 1;
+    while (argIndex < argc && argv[argIndex][0] == '-') {
+        char ignore;
+        if (strcmp(argv[argIndex], "-b") == 0) {
+            binary = true;
+        } else if (strcmp(argv[argIndex], "-j") == 0 && argIndex + 1 < argc
+                   && sscanf(argv[argIndex + 1], "%d%c", &numWorkers, &ignore) == 1) {
+            argIndex++;
+        } else {
+            fprintf(stderr, "Error: unknown flag %s\n", argv[argIndex]);
+            fprintf(stderr, "Usage: %s [-b] [-j numWorkers] [pageDirectory] [indexFilename]\n", program);
+            return 1;
+        }
+        argIndex++;
+    }
+    if (numWorkers < 1 || numWorkers > MAX_WORKERS) {
+        fprintf(stderr, "Error: numWorkers must be between 1 and %d\n", MAX_WORKERS);
+        return 1;
+    }
+
     // check for the appropriate number of arguments
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s [pageDirectory] [indexFilename]\n", program);
+    if (argc - argIndex != 2) {
+        fprintf(stderr, "Usage: %s [-b] [-j numWorkers] [pageDirectory] [indexFilename]\n", program);
         return 1;
     }
 
     // allocate memory and copy string for pageDir
-    char* pageDirArg = argv[1];
+    char* pageDirArg = argv[argIndex];
     char* pageDir = count_malloc(strlen(pageDirArg) + 1);
     if (pageDir == NULL) {
         fprintf(stderr, "Error: out of memory\n");
@@ -55,7 +100,7 @@ int main(const int argc, char* argv[])
     strcpy(pageDir, pageDirArg);
 
     // allocate memory and copy string for indexFilename
-    char* indexFnameArg = argv[2];
+    char* indexFnameArg = argv[argIndex + 1];
     char* indexFilename = count_malloc(strlen(indexFnameArg) + 1);
     if (indexFilename == NULL) {
         fprintf(stderr, "Error: out of memory\n");
@@ -71,7 +116,7 @@ int main(const int argc, char* argv[])
     }
 
     // run the indexer
-    if (indexer(pageDir, indexFilename)) {
+    if (indexer(pageDir, indexFilename, binary, numWorkers)) {
         printf("SUCCESS!\n\n");
         return 0;
     } else {
@@ -85,29 +130,37 @@ int main(const int argc, char* argv[])
  * 
  * Pseudocode:
  *      1. create the index
- *      2. call buildIndex and saveIndex
- *      3. appropriately free memory
+ *      2. call buildIndex (or buildIndexInParallel) and saveIndex (or saveIndexToBinaryFile)
+ *      3. save the document table next to the index with saveDocsToFile
+ *      4. appropriately free memory
  * 
  * Assumptions:
  *      1. the user puts in valid inputs, otherwise throws errors
 */
-bool indexer(char* pageDir, char* indexFilename) 
+bool indexer(char* pageDir, char* indexFilename, bool binary, int numWorkers) 
 {
     // check validity of arguments
-    if (pageDir != NULL && indexFilename != NULL) {
+    if (pageDir != NULL && indexFilename != NULL && numWorkers > 0) {
         // initialize the index
         index_t* index = newIndex(800);
         if (index == NULL) {
             return false;
         }
         // build the index from the crawler files
-        if (!buildIndexFromCrawler(pageDir, index)) {
+        bool built = numWorkers == 1 ? buildIndexFromCrawler(pageDir, index)
+                                     : buildIndexInParallel(pageDir, index, numWorkers);
+        pageDirCloseStore(); // done reading the pages
+        if (!built) {
+            deleteIndex(index);
             count_free(indexFilename);
             count_free(pageDir);
             return false;
         }
         // save the index to the given filename
-        if (!saveIndexToFile(indexFilename, index)) {
+        bool saved = binary ? saveIndexToBinaryFile(indexFilename, index)
+                            : saveIndexToFile(indexFilename, index);
+        if (!saved || !saveDocsToFile(indexFilename, index)) {
+            deleteIndex(index);
             count_free(indexFilename);
             count_free(pageDir);
             return false;
@@ -123,4 +176,81 @@ bool indexer(char* pageDir, char* indexFilename)
         fprintf(stderr, "Error: Null-Pointer Exception");
         return false;
     }
-}
\ No newline at end of file
+}
+
+/************** buildIndexInParallel() ******************/
+/* builds the same index as buildIndexFromCrawler with several worker threads
+ *
+ * Pseudocode:
+ *      1. find the last crawler file and split the ids up to it into numWorkers
+ *          contiguous ranges
+ *      2. start one thread per range, each indexing its range into a private index
+ *      3. wait for the threads, then merge the private indexes into the index
+ *          in order of their ranges, so each word's ids stay in ascending order
+ *
+ * Assumptions:
+ *      1. the crawler files are numbered 1 to N, with gaps only where the
+ *          crawler couldn't save a page, which every range passes over
+*/
+bool buildIndexInParallel(char* pageDir, index_t* index, int numWorkers)
+{
+    if (pageDir == NULL || index == NULL || numWorkers < 1) return false;
+    int numFiles = lastPageID(pageDir);
+    if (numWorkers > numFiles) numWorkers = numFiles;
+    if (numWorkers <= 1) return buildIndexFromCrawler(pageDir, index);
+
+    indexShard_t* shards = count_calloc(numWorkers, sizeof(indexShard_t));
+    pthread_t* workers = count_calloc(numWorkers, sizeof(pthread_t));
+    bool* started = count_calloc(numWorkers, sizeof(bool));
+    if (shards == NULL || workers == NULL || started == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        if (shards != NULL) count_free(shards);
+        if (workers != NULL) count_free(workers);
+        if (started != NULL) count_free(started);
+        return false;
+    }
+
+    // give each worker an even share of the ids, the first ones one extra if uneven
+    int firstID = 1;
+    for (int i = 0; i < numWorkers; i++) {
+        int numIDs = numFiles / numWorkers + (i < numFiles % numWorkers ? 1 : 0);
+        shards[i].pageDir = pageDir;
+        shards[i].firstID = firstID;
+        shards[i].lastID = firstID + numIDs - 1;
+        shards[i].index = newIndex(800);
+        shards[i].success = false;
+        firstID += numIDs;
+    }
+
+    // start the workers, indexing a shard on this thread if its thread can't start
+    for (int i = 0; i < numWorkers; i++) {
+        started[i] = pthread_create(&workers[i], NULL, indexWorker, &shards[i]) == 0;
+        if (!started[i]) indexWorker(&shards[i]);
+    }
+
+    // wait for every worker, then merge the shards in order
+    bool success = true;
+    for (int i = 0; i < numWorkers; i++) {
+        if (started[i]) pthread_join(workers[i], NULL);
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        success = shards[i].success && success;
+        // mergeIndex deletes the shard's index, even if it fails
+        if (shards[i].index == NULL || !mergeIndex(index, shards[i].index)) success = false;
+    }
+    count_free(started);
+    count_free(workers);
+    count_free(shards);
+    return success;
+}
+
+/************** indexWorker() ******************/
+/* the start routine of a worker thread, indexes one shard into its private index */
+static void* indexWorker(void* arg)
+{
+    indexShard_t* shard = arg;
+    if (shard->index != NULL) {
+        shard->success = buildIndexFromRange(shard->pageDir, shard->index, shard->firstID, shard->lastID);
+    }
+    return NULL;
+}
@@ -83,4 +83,38 @@ make valgrind
 ./indextest sdfjkldsj sdfjkldjs 23 vdsjlkj thislabiskillingme
 
 # VALGRIND
-make valgrind2
\ No newline at end of file
+make valgrind2
+
+########### BINARY INDEX #############
+######################################
+
+# WRITE A BINARY INDEX
+# --------------------
+./indexer -b toscrape-depth-1 toscrape-index-1-bin
+
+# CONVERT BETWEEN FORMATS, THE ROUND TRIP SHOULD MATCH THE TEXT INDEX
+# -------------------------------------------------------------------
+./indexconvert -b letters-index-6 letters-index-6-bin
+
+./indexconvert -t toscrape-index-1-bin toscrape-index-1-bin-test
+
+sort ../data/toscrape-index-1 | diff - <(sort ../data/toscrape-index-1-bin-test) && echo "round trip matches"
+
+# UNKNOWN FLAG
+./indexer -x toscrape-depth-1 toscrape-index-1-bin
+
+# WRONG NUMBER OF ARGUMENTS
+./indexconvert toscrape-index-1-bin toscrape-index-1-bin-test
+
+########### WORKER THREADS #############
+########################################
+
+# THE SAME LINES SHOULD BE WRITTEN AS BY A SINGLE THREAD
+# ------------------------------------------------------
+./indexer -j 4 wikipedia-depth-1 wikipedia-index-1-workers
+
+sort ../data/wikipedia-index-1 | diff - <(sort ../data/wikipedia-index-1-workers) && echo "same index"
+rm -f ../data/wikipedia-index-1-workers
+
+# INVALID NUMBER OF WORKERS
+./indexer -j 0 wikipedia-depth-1 wikipedia-index-1-workers
@@ -6,11 +6,31 @@
  * David Kotz - 2016, 2017, 2019
  */
 
+#define _POSIX_C_SOURCE 200809L // getline, fileno, flockfile, getc_unlocked
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "file.h"
 
+/**************** local types ****************/
+// a string that grows by doubling, so reading n characters copies each
+// one a constant number of times on average, not once per character read
+typedef struct growbuf {
+  char *buf;
+  size_t len;        // characters in buf, not counting the terminating null
+  size_t cap;        // bytes allocated
+} growbuf_t;
+
+static const size_t READ_CHUNK = 65536;  // bytes asked of fread at a time
+
+/**************** local functions ****************/
+static bool growbuf_reserve(growbuf_t *gb, const size_t more);
+static char *growbuf_finish(growbuf_t *gb, const bool any);
 
 /**************** lines_in_file ****************/
 int
@@ -22,10 +42,12 @@ lines_in_file(FILE *fp)
 
   rewind(fp);
 
+  // count the newlines a chunk at a time
   int nlines = 0;
-  char c = '\0';
-  while ( (c = fgetc(fp)) != EOF) {
-    if (c == '\n') {
+  char chunk[4096];
+  size_t n;
+  while ( (n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+    for (char *p = chunk; (p = memchr(p, '\n', chunk + n - p)) != NULL; p++) {
       nlines++;
     }
   }
@@ -38,15 +60,59 @@ lines_in_file(FILE *fp)
 /**************** utility stopfuncs ****************/
 // for use with readuntil()
 static int never(int c) { return (0); }
-static int isnewline(int c) { return (c == '\n'); }
 
 /**************** freadfilep ****************/
 /* See file.h for documentation. */
-char *freadfilep(FILE *fp) { return freaduntil(fp, never); }
+char *
+freadfilep(FILE *fp)
+{
+  if (fp == NULL) {
+    return NULL;
+  }
+  growbuf_t gb = { NULL, 0, 0 };
+
+  // a regular file says how much is left, so the buffer is allocated once
+  struct stat st;
+  off_t pos = ftello(fp);
+  size_t want = READ_CHUNK;
+  if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && pos >= 0 && st.st_size > pos) {
+    want = st.st_size - pos + 1;   // +1 to see the end of file without growing
+  }
+
+  // read in bulk, doubling the buffer whenever it fills
+  while (growbuf_reserve(&gb, want)) {
+    size_t n = fread(gb.buf + gb.len, 1, gb.cap - gb.len - 1, fp);
+    gb.len += n;
+    if (n == 0) {
+      return growbuf_finish(&gb, gb.len > 0);
+    }
+    want = READ_CHUNK;
+  }
+  return NULL;
+}
 
 /**************** readline ****************/
 /* See file.h for documentation. */
-char *freadlinep(FILE *fp) { return freaduntil(fp, isnewline); }
+char *
+freadlinep(FILE *fp)
+{
+  if (fp == NULL) {
+    return NULL;
+  }
+  // getline searches the stream's buffer for the newline with memchr
+  // and copies up to it in one go, doubling the line as it grows
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len = getline(&line, &cap, fp);
+  if (len <= 0) {
+    free(line);
+    return NULL;
+  }
+  if (line[len - 1] == '\n') {
+    line[len - 1] = '\0';
+  }
+  return line;
+}
 
 /**************** readword ****************/
 /* See file.h for documentation. */
@@ -57,46 +123,92 @@ char *freadwordp(FILE *fp) { return freaduntil(fp, isspace); }
 char *
 freaduntil(FILE *fp, int (*stopfunc)(int c))
 {
+  if (fp == NULL) {
+    return NULL;
+  }
   if (stopfunc == NULL) {
     stopfunc = never;
   }
+  growbuf_t gb = { NULL, 0, 0 };
 
-  // allocate buffer big enough for "typical" words/lines
-  int len = 81;
-  char *buf = calloc(len, sizeof(char));
-  if (buf == NULL) {
-    return NULL;
+  // Read characters from file until stop-character or EOF, locking the
+  // stream once rather than once per character. Most words and lines
+  // fit on the stack; longer ones go to a buffer that doubles as needed.
+  char local[128];
+  size_t nlocal = 0;
+  int c = EOF;
+  bool ok = true;
+  flockfile(fp);
+  while ( (c = getc_unlocked(fp)) != EOF && !(*stopfunc)(c)) {
+    if (nlocal < sizeof(local)) {
+      local[nlocal++] = c;
+    } else if (gb.len + 1 < gb.cap || (ok = growbuf_reserve(&gb, 1))) {
+      gb.buf[gb.len++] = c;
+    } else {
+      break;
+    }
   }
+  funlockfile(fp);
 
-  // Read characters from file until stop-character or EOF, 
-  // expanding the buffer when needed to hold more.
-  int pos;
-  char c;
-  for (pos = 0; (c = fgetc(fp)) != EOF && !(*stopfunc)(c); pos++) {
-    // We need to save buf[pos+1] for the terminating null
-    // and buf[len-1] is the last usable slot, 
-    // so if pos+1 is past that slot, we need to grow the buffer.
-    if (pos+1 > len-1) {
-      char *newbuf = realloc(buf, ++len);
-      if (newbuf == NULL) {
-        free(buf);
-        return NULL;
-      } else {
-        buf = newbuf;
-      }
+  if (!ok) {
+    return NULL;
+  }
+  if (nlocal == 0 && c == EOF) {
+    // no characters were read and we reached EOF
+    return NULL;
+  }
+  // put the characters on the stack in front of the rest
+  char *str = malloc(nlocal + gb.len + 1);
+  if (str != NULL) {
+    memcpy(str, local, nlocal);
+    if (gb.len > 0) {
+      memcpy(str + nlocal, gb.buf, gb.len);
     }
-    buf[pos] = c;
+    str[nlocal + gb.len] = '\0';
   }
+  free(gb.buf);
+  return str;
+}
 
-  if (pos == 0 && c == EOF) {
-    // no characters were read and we reached EOF
-    free(buf);
+/**************** growbuf_reserve ****************/
+/* Make room for at least 'more' characters after the gb->len there
+ * are, plus the terminating null, growing to at least twice the size.
+ * Returns false, freeing the buffer, if out of memory.
+ */
+static bool
+growbuf_reserve(growbuf_t *gb, const size_t more)
+{
+  if (gb->len + more < gb->cap) {
+    return true;
+  }
+  size_t cap = gb->cap > 0 ? gb->cap * 2 : 81;  // big enough for "typical" words/lines
+  if (cap < gb->len + more + 1) {
+    cap = gb->len + more + 1;
+  }
+  char *newbuf = realloc(gb->buf, cap);
+  if (newbuf == NULL) {
+    free(gb->buf);
+    gb->buf = NULL;
+    return false;
+  }
+  gb->buf = newbuf;
+  gb->cap = cap;
+  return true;
+}
+
+/**************** growbuf_finish ****************/
+/* Terminate the string and return it, or free it and return NULL
+ * if 'any' is false (nothing was read before EOF) or out of memory.
+ */
+static char *
+growbuf_finish(growbuf_t *gb, const bool any)
+{
+  if (!any || !growbuf_reserve(gb, 0)) {
+    free(gb->buf);
     return NULL;
-  } else {
-    // pos characters were read into buf[0]..buf[pos-1].
-    buf[pos] = '\0'; // terminate string
-    return buf;
   }
+  gb->buf[gb->len] = '\0';
+  return gb->buf;
 }
 
 /* ********************************************************** */
@@ -147,3 +259,95 @@ int main(int argc, char *argv[])
   }
 }
 #endif
+
+/* ********************************************************** */
+/* a microbenchmark of the code above against the reader it replaced,
+ * which grew its buffer by one byte per character past 80
+ */
+#ifdef READBENCH
+#include <time.h>
+
+static char *
+oldreaduntil(FILE *fp, int (*stopfunc)(int c))
+{
+  int len = 81;
+  char *buf = calloc(len, sizeof(char));
+  if (buf == NULL) {
+    return NULL;
+  }
+  int pos;
+  char c;
+  for (pos = 0; (c = fgetc(fp)) != EOF && !(*stopfunc)(c); pos++) {
+    if (pos+1 > len-1) {
+      char *newbuf = realloc(buf, ++len);
+      if (newbuf == NULL) {
+        free(buf);
+        return NULL;
+      }
+      buf = newbuf;
+    }
+    buf[pos] = c;
+  }
+  if (pos == 0 && c == EOF) {
+    free(buf);
+    return NULL;
+  }
+  buf[pos] = '\0';
+  return buf;
+}
+static int oldnewline(int c) { return (c == '\n'); }
+static char *oldfilep(FILE *fp) { return oldreaduntil(fp, never); }
+static char *oldlinep(FILE *fp) { return oldreaduntil(fp, oldnewline); }
+static char *oldwordp(FILE *fp) { return oldreaduntil(fp, isspace); }
+
+// read the whole file with 'reader' 'rounds' times; return MB per second
+static double
+timereader(FILE *fp, char *(*reader)(FILE *fp), const int rounds, size_t *bytes)
+{
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  *bytes = 0;
+  for (int i = 0; i < rounds; i++) {
+    rewind(fp);
+    char *s;
+    while ( (s = (*reader)(fp)) != NULL) {
+      *bytes += strlen(s) + 1;
+      free(s);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  return seconds > 0 ? *bytes / seconds / 1e6 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file...\n", argv[0]);
+    exit(1);
+  }
+  const int rounds = 20;
+  char *(*readers[][2])(FILE *fp) = {
+    { oldfilep, freadfilep }, { oldlinep, freadlinep }, { oldwordp, freadwordp },
+  };
+  const char *names[] = { "file", "line", "word" };
+
+  for (int f = 1; f < argc; f++) {
+    FILE *fp = fopen(argv[f], "r");
+    if (fp == NULL) {
+      printf("can't open %s\n", argv[f]);
+      continue;
+    }
+    for (int r = 0; r < 3; r++) {
+      size_t oldbytes, newbytes;
+      double oldrate = timereader(fp, readers[r][0], rounds, &oldbytes);
+      double newrate = timereader(fp, readers[r][1], rounds, &newbytes);
+      printf("%s: read%sp %8.1f MB/s before, %8.1f MB/s now (%.1fx)%s\n", argv[f], names[r],
+             oldrate, newrate, oldrate > 0 ? newrate / oldrate : 0,
+             oldbytes == newbytes ? "" : " DIFFERENT");
+    }
+    fclose(fp);
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,456 @@
+/*
+ * html - a single-pass lexer for the html of web pages
+ *        See html.h for usage.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SCANNERS
+#endif
+#include "html.h"
+
+/* ***************************************** */
+/* Private types */
+
+/* scanclass_t: the bytes a scanner looks for; '\0' is in every class,
+ * so a scan never runs past the end of the html.
+ */
+typedef enum scanclass {
+  SCAN_WORD_OR_TAG,                        // a letter, or '<'
+  SCAN_TAG_START,                          // '<'
+  SCAN_TAG_END,                            // '>'
+  SCAN_NOT_ALPHA                           // anything but a letter
+} scanclass_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+static bool NextAttribute(html_lexer_t *lexer, html_token_t *token);
+static void PickScanner(void);
+static size_t ScanFrom(const char *doc, const size_t pos, const size_t len,
+                       const scanclass_t cls);
+static size_t ScanScalar(const char *str, const size_t len, const scanclass_t cls);
+#ifdef HAVE_X86_SCANNERS
+static size_t ScanSSE2(const char *str, const size_t len, const scanclass_t cls);
+static size_t ScanAVX2(const char *str, const size_t len, const scanclass_t cls);
+#endif
+
+/* *********************************************************************** */
+/* Private global variables */
+static html_scanner_t scanner = HTML_SCAN_SCALAR;
+static size_t (*scan)(const char *str, const size_t len, const scanclass_t cls) = ScanScalar;
+static pthread_once_t scannerPicked = PTHREAD_ONCE_INIT;
+
+/**************** html_init ****************/
+/* see html.h for documentation */
+void
+html_init(html_lexer_t *lexer, const char *doc, const size_t len,
+          const size_t pos, const int flags)
+{
+  if (lexer == NULL) {
+    return;
+  }
+  lexer->doc = doc;
+  lexer->len = len;
+  lexer->pos = pos;
+  lexer->final = (flags & HTML_STREAMING) == 0;
+  lexer->words = (flags & HTML_WORDS) != 0;
+  lexer->skipTags = (flags & HTML_NO_TAGS) != 0;
+  lexer->inTag = false;
+  lexer->tagEnd = 0;
+  lexer->attribute = 0;
+}
+
+/**************** html_feed ****************/
+/* see html.h for documentation */
+void
+html_feed(html_lexer_t *lexer, const char *doc, const size_t len,
+          const bool final)
+{
+  if (lexer != NULL) {
+    lexer->doc = doc;
+    lexer->len = len;
+    lexer->final = final;
+  }
+}
+
+/**************** html_next ****************/
+/* see html.h for usage documentation.
+ *
+ * Pseudocode:
+ *     1. if the last event was in a tag, return its next attribute,
+ *        or else move past the tag
+ *     2. scan for the next '<' (and, for words, the next letter);
+ *        return the text before it, if any
+ *     3. at a letter, scan for the end of the word and return it
+ *     4. at a '<', scan for the '>' that ends the tag; skip it if tags
+ *        aren't wanted, or else find its name and return the tag,
+ *        staying at the '<' for its attributes
+ *     5. if the html ran out first, return HTML_END, or HTML_MORE if
+ *        more is coming and what was found may not be complete
+ *
+ * Each scan looks at a byte once, 16 or 32 bytes at a time if the CPU
+ * can (see ScanFrom); only the names and attributes of tags are looked at
+ * again, and only for the tags whose attributes the caller wants.
+ */
+html_event_t
+html_next(html_lexer_t *lexer, html_token_t *token)
+{
+  if (lexer == NULL || lexer->doc == NULL || token == NULL) {
+    return HTML_END;
+  }
+  pthread_once(&scannerPicked, PickScanner);
+
+  const char *doc = lexer->doc;            // the html so far
+  const size_t len = lexer->len;           // bytes of it
+  token->value = token->valueLength = 0;
+  token->closing = false;
+
+  // the attributes of the last tag, then the html after it
+  if (lexer->inTag) {
+    if (NextAttribute(lexer, token)) {
+      return HTML_ATTRIBUTE;
+    }
+    html_skipTag(lexer);
+  }
+
+  for (;;) {
+    // text runs to the next tag; words start at the next letter
+    const size_t pos = lexer->pos;
+    size_t next = ScanFrom(doc, pos, len, lexer->words ? SCAN_WORD_OR_TAG : SCAN_TAG_START);
+    if (!lexer->words && next > pos) {
+      token->start = pos;
+      token->length = next - pos;
+      lexer->pos = next;
+      return HTML_TEXT;
+    }
+    lexer->pos = next;
+
+    // ran out of html
+    if (doc[next] == '\0') {
+      return (next >= len && !lexer->final) ? HTML_MORE : HTML_END;
+    }
+
+    // doc[next] is the first letter of a word
+    if (doc[next] != '<') {
+      size_t end = ScanFrom(doc, next, len, SCAN_NOT_ALPHA);
+      if (end >= len && !lexer->final) {
+        return HTML_MORE;                  // the word may go on
+      }
+      token->start = next;
+      token->length = end - next;
+      lexer->pos = end;
+      return HTML_WORD;
+    }
+
+    // doc[next] starts a tag; if the html is malformed, we don't care:
+    // match '<' with next '>'
+    size_t end = ScanFrom(doc, next, len, SCAN_TAG_END);
+    if (doc[end] == '\0') {
+      if (end >= len && !lexer->final) {
+        return HTML_MORE;                  // the tag may end later
+      }
+      lexer->pos = end;                    // an unclosed tag takes the rest
+      return HTML_END;
+    }
+    if (lexer->skipTags) {
+      lexer->pos = end + 1;
+      continue;
+    }
+
+    // its name runs to the first space, '/' or the '>'
+    size_t name = next + 1;
+    if (doc[name] == '/') {
+      token->closing = true;
+      name++;
+    }
+    size_t nameEnd = name;
+    while (nameEnd < end && doc[nameEnd] != '/' && !isspace((unsigned char) doc[nameEnd])) {
+      nameEnd++;
+    }
+    token->start = name;
+    token->length = nameEnd - name;
+
+    lexer->inTag = true;
+    lexer->tagEnd = end;
+    lexer->attribute = nameEnd;
+    return HTML_TAG;
+  }
+}
+
+/**************** html_skipTag ****************/
+/* see html.h for documentation */
+void
+html_skipTag(html_lexer_t *lexer)
+{
+  if (lexer != NULL && lexer->inTag) {
+    lexer->pos = lexer->tagEnd + 1;
+    lexer->inTag = false;
+  }
+}
+
+/**************** html_isName ****************/
+/* see html.h for documentation */
+bool
+html_isName(const char *str, const size_t length, const char *name)
+{
+  if (str == NULL || name == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    if (name[i] == '\0' || tolower((unsigned char) str[i]) != tolower((unsigned char) name[i])) {
+      return false;
+    }
+  }
+  return name[length] == '\0';
+}
+
+/**************** html_setScanner ****************/
+/* see html.h for documentation */
+html_scanner_t
+html_setScanner(const html_scanner_t wanted)
+{
+  pthread_once(&scannerPicked, PickScanner);
+  scanner = HTML_SCAN_SCALAR;
+  scan = ScanScalar;
+#ifdef HAVE_X86_SCANNERS
+  __builtin_cpu_init();
+  if (wanted >= HTML_SCAN_AVX2 && __builtin_cpu_supports("avx2")) {
+    scanner = HTML_SCAN_AVX2;
+    scan = ScanAVX2;
+  } else if (wanted >= HTML_SCAN_SSE2 && __builtin_cpu_supports("sse2")) {
+    scanner = HTML_SCAN_SSE2;
+    scan = ScanSSE2;
+  }
+#endif
+  return scanner;
+}
+
+/* ***************************************************************** */
+/*
+ * NextAttribute - find the next attribute of the tag the lexer is in
+ * @lexer: the lexer, whose last event was in a tag
+ * @token: filled in with the attribute's name and value
+ *
+ * Attributes look like name, name=value, name='value' or name="value",
+ * with any space around the '=', and end at the tag's '>' whatever
+ * their quotes. Returns false if the tag has no more attributes.
+ */
+static bool
+NextAttribute(html_lexer_t *lexer, html_token_t *token)
+{
+  const char *doc = lexer->doc;
+  const size_t end = lexer->tagEnd;        // the tag's '>'
+  size_t p = lexer->attribute;
+
+  // skip the space (and any '/') before the name
+  while (p < end && (doc[p] == '/' || isspace((unsigned char) doc[p]))) {
+    p++;
+  }
+  if (p >= end) {
+    return false;
+  }
+
+  // the name; an '=' can only start one
+  token->start = p++;
+  while (p < end && doc[p] != '/' && doc[p] != '=' && !isspace((unsigned char) doc[p])) {
+    p++;
+  }
+  token->length = p - token->start;
+
+  // the value, if there is an '='
+  size_t q = p;
+  while (q < end && isspace((unsigned char) doc[q])) {
+    q++;
+  }
+  if (q < end && doc[q] == '=') {
+    q++;
+    while (q < end && isspace((unsigned char) doc[q])) {
+      q++;
+    }
+    if (q < end && (doc[q] == '"' || doc[q] == '\'')) {
+      const char quote = doc[q++];
+      token->value = q;
+      while (q < end && doc[q] != quote) {
+        q++;
+      }
+      token->valueLength = q - token->value;
+      if (q < end) {
+        q++;                               // past the closing quote
+      }
+    } else {
+      token->value = q;
+      while (q < end && !isspace((unsigned char) doc[q])) {
+        q++;
+      }
+      token->valueLength = q - token->value;
+    }
+    p = q;
+  }
+
+  lexer->attribute = p;
+  return true;
+}
+
+/* ***************************************************************** */
+/*
+ * PickScanner - use the fastest scanner the CPU has, once,
+ * before the first scan (see html_setScanner)
+ */
+static void
+PickScanner(void)
+{
+#ifdef HAVE_X86_SCANNERS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    scanner = HTML_SCAN_AVX2;
+    scan = ScanAVX2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    scanner = HTML_SCAN_SSE2;
+    scan = ScanSSE2;
+  }
+#endif
+}
+
+/* ***************************************************************** */
+/*
+ * ScanFrom - find the first byte of a class in the html
+ * @doc: the html, terminated by '\0'
+ * @pos: where to start
+ * @len: how many bytes of doc may be read in bulk, i.e., its length;
+ *       past that, the scan goes on a byte at a time
+ * @cls: the class of bytes to find
+ *
+ * Returns the position of the first byte at or after pos that is in
+ * the class, or of the '\0' ending doc if there is none.
+ */
+static size_t
+ScanFrom(const char *doc, const size_t pos, const size_t len,
+         const scanclass_t cls)
+{
+  return pos + scan(doc + pos, pos < len ? len - pos : 0, cls);
+}
+
+/* ***************************************************************** */
+/*
+ * InClass - whether a byte is in a class. Letters are those isalpha()
+ * takes in the "C" locale, which is all the TSE ever runs in.
+ */
+static inline bool
+InClass(const unsigned char c, const scanclass_t cls)
+{
+  switch (cls) {
+  case SCAN_WORD_OR_TAG: return c == '\0' || c == '<' || isalpha(c);
+  case SCAN_TAG_START:   return c == '\0' || c == '<';
+  case SCAN_TAG_END:     return c == '\0' || c == '>';
+  default:               return !isalpha(c);
+  }
+}
+
+/* ***************************************************************** */
+/*
+ * ScanScalar - the byte-at-a-time scan: see ScanFrom; len is ignored,
+ * and returns the offset from str of the byte found
+ */
+static size_t
+ScanScalar(const char *str, const size_t len, const scanclass_t cls)
+{
+  size_t i = 0;
+  while (!InClass(str[i], cls)) {
+    i++;
+  }
+  return i;
+}
+
+#ifdef HAVE_X86_SCANNERS
+/* ***************************************************************** */
+/*
+ * MaskSSE2 - the bits of the 16 bytes at str that are in the class
+ * ScanSSE2, ScanAVX2 - the vector scans: see ScanFrom. A byte is a letter
+ * if, with bit 0x20 set (lowercasing it), it is in 'a'..'z', which is
+ * checked for 16 (or 32) bytes with a signed compare by moving 'a' to -128.
+ * The first len bytes are classified a block at a time, and the rest,
+ * fewer than a block, by ScanScalar, so no block is read past len.
+ */
+__attribute__((target("sse2")))
+static inline unsigned int
+MaskSSE2(const char *str, const scanclass_t cls)
+{
+  const __m128i bytes = _mm_loadu_si128((const __m128i *) str);
+  const __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_setzero_si128()),
+                                   _mm_cmpeq_epi8(bytes, _mm_set1_epi8(cls == SCAN_TAG_END ? '>' : '<')));
+  if (cls == SCAN_TAG_START || cls == SCAN_TAG_END) {
+    return _mm_movemask_epi8(hit);
+  }
+  const __m128i alpha = _mm_cmplt_epi8(_mm_add_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)),
+                                                    _mm_set1_epi8((char) (128 - 'a'))),
+                                       _mm_set1_epi8((char) (-128 + 26)));
+  if (cls == SCAN_NOT_ALPHA) {
+    return ~_mm_movemask_epi8(alpha) & 0xFFFF;
+  }
+  return _mm_movemask_epi8(_mm_or_si128(hit, alpha));
+}
+
+__attribute__((target("sse2")))
+static size_t
+ScanSSE2(const char *str, const size_t len, const scanclass_t cls)
+{
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    unsigned int mask = MaskSSE2(str + i, cls);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + ScanScalar(str + i, 0, cls);
+}
+
+__attribute__((target("avx2")))
+static size_t
+ScanAVX2(const char *str, const size_t len, const scanclass_t cls)
+{
+  // most words and the gaps between them end within 16 bytes, so try
+  // those first, without paying for a 32-byte block
+  size_t i = 0;
+  if (len >= 16) {
+    unsigned int mask = MaskSSE2(str, cls);
+    if (mask != 0) {
+      return __builtin_ctz(mask);
+    }
+    i = 16;
+  }
+
+  const __m256i caseBit = _mm256_set1_epi8(0x20);
+  const __m256i toMin = _mm256_set1_epi8((char) (128 - 'a'));
+  const __m256i below = _mm256_set1_epi8((char) (-128 + 26));
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i delim = _mm256_set1_epi8(cls == SCAN_TAG_END ? '>' : '<');
+  for (; i + 32 <= len; i += 32) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *) (str + i));
+    __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, zero), _mm256_cmpeq_epi8(bytes, delim));
+    unsigned int mask;
+    if (cls == SCAN_TAG_START || cls == SCAN_TAG_END) {
+      mask = _mm256_movemask_epi8(hit);
+    } else {
+      __m256i alpha = _mm256_cmpgt_epi8(below, _mm256_add_epi8(_mm256_or_si256(bytes, caseBit), toMin));
+      if (cls == SCAN_NOT_ALPHA) {
+        mask = ~(unsigned int) _mm256_movemask_epi8(alpha);
+      } else {
+        mask = _mm256_movemask_epi8(_mm256_or_si256(hit, alpha));
+      }
+    }
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  // finish with 16 bytes at a time, then one
+  return i + ScanSSE2(str + i, len - i, cls);
+}
+#endif // HAVE_X86_SCANNERS
@@ -0,0 +1,140 @@
+/*
+ * html - a single-pass lexer for the html of web pages
+ *
+ * The lexer walks the html once, from left to right, and hands back one
+ * event at a time: a tag (its name), each attribute of that tag (its name
+ * and value), and the text between tags, either as runs of text or as the
+ * words in them. Events are positions in the html, so nothing is copied.
+ * Text and tags are found 16 or 32 bytes at a time where the CPU can.
+ *
+ * It follows the same simple rules the TSE always has: a tag runs from a
+ * '<' to the next '>', whatever is in between (so comments and quoted '>'s
+ * are not special), and a word is a run of letters outside tags.
+ *
+ * The html may also be lexed as it arrives: start the lexer with the bytes
+ * so far and HTML_STREAMING, and add the rest with html_feed(). An event
+ * that might go on past the bytes so far waits for more (HTML_MORE).
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __HTML_H
+#define __HTML_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/***********************************************************************/
+/* html_event_t: what html_next() found */
+typedef enum html_event {
+  HTML_END,                // the end of the html
+  HTML_MORE,               // nothing more until html_feed() adds bytes
+  HTML_TEXT,               // a run of text between tags
+  HTML_WORD,               // a word of text (with HTML_WORDS)
+  HTML_TAG,                // a tag, <name ...> or </name ...>
+  HTML_ATTRIBUTE           // an attribute of the last tag
+} html_event_t;
+
+/* html_token_t: where in the html an event is */
+typedef struct html_token {
+  size_t start;            // the text or word, or the tag's or attribute's name
+  size_t length;
+  size_t value;            // the attribute's value, without its quotes
+  size_t valueLength;      // 0 if it has none
+  bool closing;            // the tag is </name ...>
+} html_token_t;
+
+/* html_lexer_t: the lexer's place in the html; create one on the stack
+ * with html_init(), and leave its fields alone (except to read pos).
+ */
+typedef struct html_lexer {
+  const char *doc;         // the html so far, with a '\0' at doc[len]
+  size_t len;              // bytes of html so far
+  size_t pos;              // where the next event starts
+  bool final;              // there is no more html than len
+  bool words;              // report text as words
+  bool skipTags;           // skip tags rather than report them
+  bool inTag;              // the last event was in the tag at pos
+  size_t tagEnd;           // in a tag, where its '>' is
+  size_t attribute;        // in a tag, where its next attribute may start
+} html_lexer_t;
+
+/* flags for html_init() */
+#define HTML_WORDS     1   // report text as HTML_WORD events rather than HTML_TEXT
+#define HTML_STREAMING 2   // more html will come through html_feed()
+#define HTML_NO_TAGS   4   // skip tags, without reporting them or their attributes
+
+/* html_scanner_t: how the lexer looks for the bytes that end text,
+ * words and tags, from the slowest to the fastest.
+ */
+typedef enum html_scanner {
+  HTML_SCAN_SCALAR,        // a byte at a time
+  HTML_SCAN_SSE2,          // 16 bytes at a time
+  HTML_SCAN_AVX2           // 32 bytes at a time
+} html_scanner_t;
+
+/**************** html_init ****************/
+/* Start lexing the len bytes of html at doc from pos, which must not be
+ * inside a tag (0, or a position the lexer has reached), with the given
+ * flags. doc[len] must be '\0'; a '\0' before it ends the html too.
+ * Allocates nothing, so there is nothing to free.
+ */
+void html_init(html_lexer_t *lexer, const char *doc, const size_t len,
+               const size_t pos, const int flags);
+
+/**************** html_feed ****************/
+/* Tell a streaming lexer the html now has len bytes, at doc (which may
+ * have moved, e.g. by realloc, but must still hold the same bytes
+ * before len), and whether that is all of it.
+ */
+void html_feed(html_lexer_t *lexer, const char *doc, const size_t len,
+               const bool final);
+
+/**************** html_next ****************/
+/* Find the next event in the html, and fill in *token with where it is.
+ *
+ * After a tag come its attributes, in order, unless html_skipTag() skips
+ * them; then the html after the tag. With HTML_NO_TAGS, tags are skipped
+ * without being reported, as when only words matter. A tag, attribute or
+ * word always comes whole; when streaming, a run of text may come in pieces.
+ * Returns HTML_END at the end of the html; when streaming, HTML_MORE if
+ * the next event may not be complete yet, and then the same event again
+ * once html_feed() has added to the html.
+ *
+ * Usage example: (print the name of every tag)
+ * html_lexer_t lexer;
+ * html_token_t token;
+ * html_event_t event;
+ *
+ * html_init(&lexer, html, strlen(html), 0, 0);
+ * while ((event = html_next(&lexer, &token)) != HTML_END) {
+ *   if (event == HTML_TAG) {
+ *     printf("<%s%.*s>\n", token.closing ? "/" : "", (int) token.length, html + token.start);
+ *     html_skipTag(&lexer);
+ *   }
+ * }
+ */
+html_event_t html_next(html_lexer_t *lexer, html_token_t *token);
+
+/**************** html_skipTag ****************/
+/* Skip the rest of the attributes of the last tag, if any, going on with
+ * the html after it, without parsing the attributes skipped.
+ */
+void html_skipTag(html_lexer_t *lexer);
+
+/**************** html_isName ****************/
+/* Return true if a tag or attribute name of length bytes at str is
+ * name, ignoring case.
+ */
+bool html_isName(const char *str, const size_t length, const char *name);
+
+/**************** html_setScanner ****************/
+/* Make the lexer scan with the given scanner, or the fastest one this
+ * CPU has that is no faster. By default it uses the fastest one the CPU
+ * has. All of them find exactly the same events; this is for testing and
+ * benchmarking them. Returns the scanner now in use.
+ * Not thread-safe: call it before lexing from several threads.
+ */
+html_scanner_t html_setScanner(const html_scanner_t scanner);
+
+#endif // __HTML_H
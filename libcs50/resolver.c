@@ -0,0 +1,172 @@
+/*
+ * resolver - a thread-safe cache of host-name lookups.
+ *            See resolver.h for usage.
+ *
+ * Ethan Chen, October 2021
+ */
+
+#define _POSIX_C_SOURCE 200809L  // getaddrinfo, clock_gettime
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <netdb.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "resolver.h"
+#include "hashtable.h"
+
+/* ***************************************** */
+/* Private types */
+
+/* cachedHost_t: the answer to one lookup, good until it expires.
+ */
+typedef struct cachedHost {
+  bool found;                              // the host has an address
+  struct in_addr address;                  // its address, if found
+  long long expires;                       // monotonic nanoseconds
+} cachedHost_t;
+
+/* *********************************************************************** */
+/* Private function prototypes */
+static long long Now(void);
+
+/* *********************************************************************** */
+/* Private global variables */
+static const int CACHE_SLOTS = 64;         // a crawl visits few hosts
+static long long positiveTTL = 300 * 1000000000LL; // nanoseconds
+static long long negativeTTL = 30 * 1000000000LL;  // nanoseconds
+static hashtable_t *cache = NULL;          // host name -> cachedHost_t
+static int cacheHits = 0;                  // lookups answered from the cache
+static int cacheMisses = 0;                // lookups that called getaddrinfo
+static long long resolveTime = 0;          // nanoseconds spent in getaddrinfo
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER; // guards all of the above
+
+/**************** resolver_lookup ****************/
+/* see resolver.h for documentation */
+bool
+resolver_lookup(const char *hostname, const int port,
+                struct sockaddr_in *address)
+{
+  if (hostname == NULL || address == NULL) {
+    return false;
+  }
+  memset(address, 0, sizeof(*address));
+  address->sin_family = AF_INET;
+  address->sin_port = htons(port);
+
+  // answer from the cache if the entry hasn't expired
+  long long start = Now();
+  pthread_mutex_lock(&cacheLock);
+  cachedHost_t *entry = hashtable_find(cache, hostname);
+  if (entry != NULL && entry->expires > start) {
+    bool found = entry->found;
+    address->sin_addr = entry->address;
+    cacheHits++;
+    pthread_mutex_unlock(&cacheLock);
+    return found;
+  }
+  pthread_mutex_unlock(&cacheLock);
+
+  // look the name up without the lock, so other hosts aren't held up;
+  // two threads missing on the same host at once both look it up
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result = NULL;
+  int error = getaddrinfo(hostname, NULL, &hints, &result);
+  bool found = error == 0 && result != NULL;
+  if (found) {
+    address->sin_addr = ((struct sockaddr_in *) result->ai_addr)->sin_addr;
+  }
+  if (result != NULL) {
+    freeaddrinfo(result);
+  }
+  // a temporary failure says nothing about the name, so don't remember it
+  bool cacheable = found || error == EAI_NONAME || error == EAI_FAIL;
+
+  long long end = Now();
+  pthread_mutex_lock(&cacheLock);
+  cacheMisses++;
+  resolveTime += end - start;
+  long long ttl = found ? positiveTTL : negativeTTL;
+  if (cacheable && ttl > 0) {
+    if (cache == NULL) {
+      cache = hashtable_new(CACHE_SLOTS);
+    }
+    // the entry may have changed while the lock was released
+    entry = hashtable_find(cache, hostname);
+    if (entry == NULL) {
+      entry = malloc(sizeof(cachedHost_t));
+      if (entry != NULL && !hashtable_insert(cache, hostname, entry)) {
+        free(entry);
+        entry = NULL;
+      }
+    }
+    if (entry != NULL) {
+      // an expired entry is refreshed in place
+      entry->found = found;
+      entry->address = address->sin_addr;
+      entry->expires = end + ttl;
+    }
+  }
+  pthread_mutex_unlock(&cacheLock);
+  return found;
+}
+
+/**************** resolver_setTTL ****************/
+/* see resolver.h for documentation */
+void
+resolver_setTTL(const int seconds, const int negativeSeconds)
+{
+  pthread_mutex_lock(&cacheLock);
+  positiveTTL = (seconds > 0 ? seconds : 0) * 1000000000LL;
+  negativeTTL = (negativeSeconds > 0 ? negativeSeconds : 0) * 1000000000LL;
+  pthread_mutex_unlock(&cacheLock);
+}
+
+/**************** resolver_getStats ****************/
+/* see resolver.h for documentation */
+void
+resolver_getStats(int *hits, int *misses, double *seconds)
+{
+  pthread_mutex_lock(&cacheLock);
+  if (hits != NULL) {
+    *hits = cacheHits;
+  }
+  if (misses != NULL) {
+    *misses = cacheMisses;
+  }
+  if (seconds != NULL) {
+    *seconds = resolveTime / 1e9;
+  }
+  pthread_mutex_unlock(&cacheLock);
+}
+
+/**************** resolver_clear ****************/
+/* see resolver.h for documentation */
+void
+resolver_clear(void)
+{
+  pthread_mutex_lock(&cacheLock);
+  if (cache != NULL) {
+    hashtable_delete(cache, free);
+    cache = NULL;
+  }
+  pthread_mutex_unlock(&cacheLock);
+}
+
+/* ********************* Now ************************** */
+/* Return the current monotonic time in nanoseconds.
+ */
+static long long
+Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
@@ -0,0 +1,53 @@
+/*
+ * resolver - a thread-safe cache of host-name lookups
+ *
+ * Every fetch needs the address of its host, and a crawl fetches many pages
+ * from few hosts. The resolver looks each host name up with getaddrinfo()
+ * once, then answers from its cache until the entry expires. Names that
+ * don't exist are cached too (for a shorter time), so a crawl full of links
+ * to a dead host doesn't ask the resolver about it again and again.
+ * The cache is shared by every thread, and by webpage_fetch().
+ *
+ * Ethan Chen, October 2021
+ */
+
+#ifndef __RESOLVER_H
+#define __RESOLVER_H
+
+#include <stdbool.h>
+#include <netinet/in.h>
+
+/**************** resolver_lookup ****************/
+/* Find the IPv4 address of hostname, and fill in *address with it
+ * and the given port.
+ * Answers from the cache if the host was looked up recently, and
+ * otherwise calls getaddrinfo() (without holding any lock) and caches
+ * the answer, whether the host was found or not. A temporary failure
+ * of the lookup is not cached.
+ * Returns true if the host has an address; otherwise, false.
+ */
+bool resolver_lookup(const char *hostname, const int port,
+                     struct sockaddr_in *address);
+
+/**************** resolver_setTTL ****************/
+/* Set how many seconds an address stays in the cache, 300 by default,
+ * and how many seconds a name that was not found stays, 30 by default.
+ * Setting both to 0 turns the cache off; every lookup calls getaddrinfo().
+ * Negative values are treated as 0. Entries already cached keep their
+ * old expiry time.
+ */
+void resolver_setTTL(const int seconds, const int negativeSeconds);
+
+/**************** resolver_getStats ****************/
+/* Set *hits to the number of lookups answered from the cache, *misses
+ * to the number that called getaddrinfo(), and *seconds to the total
+ * time spent in getaddrinfo(). Any pointer may be NULL.
+ */
+void resolver_getStats(int *hits, int *misses, double *seconds);
+
+/**************** resolver_clear ****************/
+/* Empty the cache and free its memory; it starts again on the next lookup.
+ */
+void resolver_clear(void);
+
+#endif // __RESOLVER_H
@@ -12,7 +12,7 @@
 /* students shouldn't take advantage of the gnu extensions, 
  * but parsing html without them is a pain.
  */
-#define _GNU_SOURCE       // strncasecmp, strdup
+#define _GNU_SOURCE       // strncasecmp, strcasestr, strdup
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -20,9 +20,18 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
-#include <netdb.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include "file.h"
 #include "webpage.h"
+#include "html.h"
+#include "resolver.h"
 #include "memory.h"
 
 /* ***************************************** */
@@ -46,13 +55,84 @@ typedef struct webpage {
   int depth;                               // depth of crawl
 } webpage_t;
 
+#define CONN_BUFFER 16384                  // bytes of a response a connection buffers
+
+/* httpConn_t: an open connection to a web server, with the bytes read
+ * from its socket but not used yet. Reads wait with poll() for no longer
+ * than the deadlines of the fetch allow (see Receive), so a server sending
+ * a byte at a time can't keep a fetch going past them, as it could when
+ * reads went through stdio, whose every read() got the whole time left.
+ */
+typedef struct httpConn {
+  int sock;                                // the socket
+  size_t start;                            // first unused byte in buf
+  size_t end;                              // end of the bytes read into buf
+  char buf[CONN_BUFFER];
+} httpConn_t;
+
+/* pooledConn_t: a connection left open after a keep-alive response,
+ * waiting to be reused by the next fetch from the same host and port.
+ */
+typedef struct pooledConn {
+  httpConn_t *conn;                        // the connection
+  char *hostname;                          // host it is connected to
+  int port;                                // port it is connected to
+  struct pooledConn *next;                 // next idle connection
+} pooledConn_t;
+
+/* fetchClock_t: the deadlines of one attempt to fetch a page,
+ * in nanoseconds of the monotonic clock (0 for no deadline).
+ */
+typedef struct fetchClock {
+  long long firstByte;                     // the status line must arrive by then
+  long long total;                         // the whole response must arrive by then
+  bool answered;                           // the status line has arrived
+  bool timedOut;                           // a connect or read ran out of time
+} fetchClock_t;
+
+/* fetchBody_t: the body of a response, as it is read.
+ */
+typedef struct fetchBody {
+  char *html;                              // the body so far, null-terminated
+  size_t length;                           // bytes of it so far
+  size_t capacity;                         // bytes allocated for html
+  size_t limit;                            // most bytes to keep, 0 for no limit
+  bool truncated;                          // there was more, left unread
+  webpage_sink_t sink;                     // passed the body after each block, or NULL
+  void *arg;                               // for the sink
+} fetchBody_t;
+
 /* *********************************************************************** */
 /* Private function prototypes */
 
-static FILE *ConnectToHost(const char *hostname, const int port);
+static httpConn_t *ConnectToHost(const char *hostname, const int port,
+                                 fetchClock_t *clock);
+static void CloseConnection(httpConn_t *conn);
+static bool WaitForConnect(const int sock, fetchClock_t *clock);
+static httpConn_t *TakeConnection(const char *hostname, const int port);
+static void ReturnConnection(httpConn_t *conn, const char *hostname, const int port);
+static bool SendRequest(httpConn_t *conn, const char *pathname, const char *hostname,
+                        const bool keepAlive);
+static bool ReadResponse(httpConn_t *conn, int *code, bool *reusable,
+                         fetchBody_t *body, fetchClock_t *clock);
+static bool ReadChunkedBody(httpConn_t *conn, fetchBody_t *body, fetchClock_t *clock);
+static bool ReadBytes(httpConn_t *conn, fetchBody_t *body, const size_t length,
+                      fetchClock_t *clock);
+static bool ReadUntilClose(httpConn_t *conn, fetchBody_t *body, fetchClock_t *clock);
+static bool ReadBody(httpConn_t *conn, fetchBody_t *body, const size_t length,
+                     bool *ended, fetchClock_t *clock);
+static bool GrowBody(fetchBody_t *body, const size_t more);
+static char *ReadLine(httpConn_t *conn, fetchClock_t *clock);
+static ssize_t ReadSome(httpConn_t *conn, char *buf, const size_t length,
+                        fetchClock_t *clock);
+static ssize_t Receive(httpConn_t *conn, char *buf, const size_t length,
+                       fetchClock_t *clock);
+static void Backoff(const int try);
+static long long Now(void);
 static inline bool isBlankLine(const char *line);
 static char *RemoveDotSegments(char *input);
-static void RemoveWhitespace(char* str);
+static char *LinkInTag(html_lexer_t *lexer, html_token_t *tag, char *base_url);
+static char *MakeLink(char *base_url, const char *href, const size_t len);
 static char *FixupRelativeURL(char *base, char *rel, size_t len);
 static bool ParseURL(char* str, struct URL* url);
 static void FreeURL(struct URL url);
@@ -67,6 +147,32 @@ static void PrintURL(struct URL url);
 
 static const int MAX_TRY = 3;    // maximum attempts to fetch
 static const int HTTP_PORT = 80; // default web server port
+static const size_t READ_BLOCK = 65536; // most bytes of a body read at once
+static const size_t STREAM_BLOCK = 4096; // most bytes read before a sink sees them
+
+#ifndef NOSLEEP // CS50 students: please don't turn off the sleep!
+static int fetchDelay = 1000;    // milliseconds to sleep after each connect attempt
+#else
+static int fetchDelay = 0;
+#endif
+
+// the pool of idle keep-alive connections, shared by all fetching threads
+static int poolSize = 0;                   // idle connections kept per host; 0 disables keep-alive
+static pooledConn_t *idleConns = NULL;     // most recently returned first
+static int connsOpened = 0;                // connections opened by webpage_fetch
+static int connsReused = 0;                // fetches that reused an idle connection
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER; // guards the pool and counts
+
+// how long a fetch may take, in milliseconds; 0 for no limit
+static int connectTimeout = 5000;          // for each attempt to connect
+static int firstByteTimeout = 10000;       // from sending the request to the status line
+static int totalTimeout = 30000;           // from sending the request to the end of the body
+static int backoffBase = 250;              // milliseconds before the first retry of a connect
+static int backoffMax = 4000;              // most milliseconds before any retry
+static size_t maxPageSize = 0;             // most bytes of a page kept, 0 for no limit
+static _Thread_local bool lastTimedOut = false;  // this thread's last fetch timed out
+static _Thread_local bool lastTruncated = false; // this thread's last page was cut off
+static _Thread_local unsigned int jitterSeed = 0; // this thread's random backoff state
 
 static const char* EXTS[] = {  // valid extensions
   "html",
@@ -92,6 +198,101 @@ char *webpage_getURL(const webpage_t *page)   {
   return page ? page->url   : NULL; 
 }
 
+/**************** webpage_setFetchDelay ****************/
+/* see webpage.h for documentation */
+void
+webpage_setFetchDelay(const int milliseconds)
+{
+  fetchDelay = milliseconds > 0 ? milliseconds : 0;
+}
+
+/**************** webpage_setConnectionPool ****************/
+/* see webpage.h for documentation */
+void
+webpage_setConnectionPool(const int idlePerHost)
+{
+  pthread_mutex_lock(&poolLock);
+  poolSize = idlePerHost > 0 ? idlePerHost : 0;
+  pthread_mutex_unlock(&poolLock);
+  if (idlePerHost <= 0) {
+    webpage_closeConnections();
+  }
+}
+
+/**************** webpage_closeConnections ****************/
+/* see webpage.h for documentation */
+void
+webpage_closeConnections(void)
+{
+  pthread_mutex_lock(&poolLock);
+  pooledConn_t *pooled = idleConns;
+  idleConns = NULL;
+  pthread_mutex_unlock(&poolLock);
+
+  while (pooled != NULL) {
+    pooledConn_t *next = pooled->next;
+    CloseConnection(pooled->conn);
+    free(pooled->hostname);
+    free(pooled);
+    pooled = next;
+  }
+}
+
+/**************** webpage_getConnectionStats ****************/
+/* see webpage.h for documentation */
+void
+webpage_getConnectionStats(int *opened, int *reused)
+{
+  pthread_mutex_lock(&poolLock);
+  if (opened != NULL) *opened = connsOpened;
+  if (reused != NULL) *reused = connsReused;
+  pthread_mutex_unlock(&poolLock);
+}
+
+/**************** webpage_setTimeouts ****************/
+/* see webpage.h for documentation */
+void
+webpage_setTimeouts(const int connectMs, const int firstByteMs,
+                    const int totalMs)
+{
+  connectTimeout = connectMs > 0 ? connectMs : 0;
+  firstByteTimeout = firstByteMs > 0 ? firstByteMs : 0;
+  totalTimeout = totalMs > 0 ? totalMs : 0;
+}
+
+/**************** webpage_setRetryBackoff ****************/
+/* see webpage.h for documentation */
+void
+webpage_setRetryBackoff(const int baseMs, const int maxMs)
+{
+  backoffBase = baseMs > 0 ? baseMs : 0;
+  backoffMax = maxMs > backoffBase ? maxMs : backoffBase;
+}
+
+/**************** webpage_fetchTimedOut ****************/
+/* see webpage.h for documentation */
+bool
+webpage_fetchTimedOut(void)
+{
+  return lastTimedOut;
+}
+
+/**************** webpage_setMaxPageSize ****************/
+/* see webpage.h for documentation */
+void
+webpage_setMaxPageSize(const size_t bytes)
+{
+  maxPageSize = bytes;
+}
+
+/**************** webpage_fetchTruncated ****************/
+/* see webpage.h for documentation */
+bool
+webpage_fetchTruncated(void)
+{
+  return lastTruncated;
+}
+
 /**************** webpage_new ****************/
 /* see webpage.h for documentation */
 webpage_t *
@@ -136,13 +337,29 @@ webpage_delete(void *data)
  * Pseudocode:
  *     1. check for valid page 
  *     2. parse url into hostname, port, and filename
- *     3. open a connection to the given host
+ *     3. take an idle connection to the host from the pool,
+ *        or open a new connection to the given host
  *     4. send http request
- *     5. fetch html response
- *     6. cleanup
+ *     5. fetch the response, framed by Content-Length, chunked 
+ *        encoding, or the end of the connection, and cut off at the
+ *        largest page size; pass the body so far to the sink, if any,
+ *        after each block of a 200 response
+ *     6. return the connection to the pool if the server keeps it open
+ *        and the whole response was read, otherwise close it
+ *     7. if a reused connection was closed by the server before it answered,
+ *        try once more on a new connection
+ *     8. cleanup
  */
 bool 
 webpage_fetch(webpage_t *page)
+{
+  return webpage_fetchStreaming(page, NULL, NULL);
+}
+
+/* ************* webpage_fetchStreaming ******************** */
+/* see webpage.h for usage documentation, and webpage_fetch above */
+bool
+webpage_fetchStreaming(webpage_t *page, webpage_sink_t sink, void *arg)
 {
   // check webpage structure - must have URL and not yet have HTML
   if (page == NULL || page->url == NULL || page->html != NULL) {
@@ -158,149 +375,150 @@ webpage_fetch(webpage_t *page)
     return false;
   }
 
-  // attempt to connect to server 
-  FILE *http_fp = NULL; 
-  for (int try = 0;  http_fp == NULL && try < MAX_TRY; try++) {
-    // open connection - exit on error
-    http_fp = ConnectToHost(hostname, port);
-
-#ifndef NOSLEEP // CS50 students: please don't turn off the sleep!
-    sleep(1);   // sleep one second between fetches, to lighten load on server
-#endif
-  }
+  pthread_mutex_lock(&poolLock);
+  bool keepAlive = poolSize > 0;
+  pthread_mutex_unlock(&poolLock);
 
-  // failed to connect?
-  if (http_fp == NULL) {
-    return false;
-  }
+  bool success = false;
+  bool retry = true;
+  lastTimedOut = false;
+  lastTruncated = false;
+  for (int attempt = 0; attempt < 2 && retry; attempt++) {
+    retry = false;
+    fetchClock_t clock = { 0, 0, false, false };
+
+    // reuse an idle connection to the host if there is one
+    httpConn_t *http_conn = keepAlive ? TakeConnection(hostname, port) : NULL;
+    bool reused = http_conn != NULL;
+
+    // otherwise attempt to connect to server, backing off between attempts
+    for (int try = 0;  http_conn == NULL && try < MAX_TRY; try++) {
+      if (try > 0) {
+        Backoff(try);
+      }
 
-  // prepare and send HTTP request; receive response
-  char *httpResponse = NULL;
-  const char *httpFormat =
-    "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n";
-  if (fprintf(http_fp, httpFormat, pathname, hostname) >= 0) {
-    // ensure stdio buffer is flushed to socket
-    fflush(http_fp);
-    // read the server's response
-    httpResponse = freadlinep(http_fp);
-  }
+      // open connection - exit on error
+      http_conn = ConnectToHost(hostname, port, &clock);
 
-  free(hostname);
-  free(pathname);
+      // sleep between fetches, to lighten load on server
+      if (fetchDelay > 0) {
+        struct timespec delay = { fetchDelay / 1000, (fetchDelay % 1000) * 1000000L };
+        nanosleep(&delay, NULL);
+      }
+    }
 
-  // did we succeed? check the response
-  bool success = false;
+    // failed to connect?
+    if (http_conn == NULL) {
+      lastTimedOut = clock.timedOut;
+      break;
+    }
 
-  if (httpResponse != NULL) {
-    // check response code to see whether we succeeded
+    // send HTTP request; receive response before the deadlines
     int httpResponseCode = 0;
-    if (sscanf(httpResponse, "HTTP/1.1 %d", &httpResponseCode) == 1
-        && httpResponseCode == 200) {
-      // success! ignore the rest of the header, then grab the page
-      // read lines until we read a blank line or fail to read a line
-      char *line = freadlinep(http_fp);
-      while (line != NULL && !isBlankLine(line)) {
-        free(line);
-        line = freadlinep(http_fp);
-      }
-      // did we exit the loop because we read an empty line?
-      if (line != NULL) {
-        free(line); // the blank line
-
-        // then grab everything else - that should be the page content
-        char *html = freadfilep(http_fp);
-        if (html != NULL) {
-          page->html = html;
-          success = true;
-        } 
-      }
+    bool reusable = false;
+    bool read = false;
+    fetchBody_t body = { NULL, 0, 0, maxPageSize, false, sink, arg };
+    if (SendRequest(http_conn, pathname, hostname, keepAlive)) {
+      long long sent = Now();
+      clock.firstByte = firstByteTimeout > 0 ? sent + firstByteTimeout * 1000000LL : 0;
+      clock.total = totalTimeout > 0 ? sent + totalTimeout * 1000000LL : 0;
+      read = ReadResponse(http_conn, &httpResponseCode, &reusable, &body, &clock);
+    }
+
+    // keep the connection for the next fetch if the server will
+    if (keepAlive && reusable) {
+      ReturnConnection(http_conn, hostname, port);
+    } else {
+      CloseConnection(http_conn);
+    }
+
+    if (read && httpResponseCode == 200) {
+      // success!
+      page->html = body.html;
+      page->html_len = strlen(body.html);
+      lastTruncated = body.truncated;
+      success = true;
+    } else {
+      free(body.html);
+      lastTimedOut = clock.timedOut;
+      // an idle connection the server already closed gets no answer at all
+      retry = reused && !clock.answered && !clock.timedOut;
     }
-    free(httpResponse);
   }
 
-  // clean up
-  fclose(http_fp);
+  free(hostname);
+  free(pathname);
 
   return success;
 }
 
-/**************** webpage_getNextWord ****************/
+/**************** webpage_getNextWordSpan ****************/
 /* see webpage.h for usage documentation.
  *
  * Code is courtesy of Ray Jenkins and/or Charles Palmer, 
  *   cleaned by David Kotz in April 2016, 2017; updated April 2019.
  *
  * Pseudocode:
- *     1. skip any leading non-alphabetic characters
- *     2. if we find a tag, i.e., <...tag...>, skip that tag
- *     3. save beginning of the word
- *     4. find the end, i.e., first non-alphabetic character
- *     5. create a new word buffer
- *     6. copy the word into the new buffer
- *     7. update *pos to first position past end of word
- *     8. return pointer to the word
- * 
+ *     1. start the html lexer at *pos, reporting text as words, and
+ *        skipping tags, i.e., <...tag...>, without parsing them
+ *     2. at the first word, update *pos to first position past end of word
+ *     3. return the beginning and length of the word
+ *
  * Assumptions:
  *     1. webpage has html
  *     2. don't care about opening/closing tags: ignore anything between <...>
  *     3. if the html is malformed, we don't care: match '<' with next '>'
  */
-char *
-webpage_getNextWord(webpage_t *page, int *pos)
+bool
+webpage_getNextWordSpan(const webpage_t *page, int *pos, int *start, int *length)
 {
   // make sure we have something to search, and a place for the result
-  if (page == NULL || page->html == NULL || pos == NULL) {
-    return NULL;
+  if (page == NULL || page->html == NULL || pos == NULL || start == NULL || length == NULL
+      || *pos < 0 || (size_t) *pos > page->html_len) {
+    return false;
   }
 
-  const char *doc = page->html;            // the html document
-  const char *beg;                         // beginning of word
-  const char *end;                         // end of word
-
-  // consume any non-alphabetic characters
-  while (doc[*pos] != '\0' && !isalpha(doc[*pos])) {
-    // if we find a tag, i.e., <...tag...>, skip it
-    if (doc[*pos] == '<') {
-      end = strchr(&doc[*pos], '>');          // find the close
-      
-      if (end == NULL || *(++end) == '\0') { // ran out of html
-        return NULL;
-      }
-
-      *pos = end - doc;	      // skip over the <...tag...>
-    } else {
-      (*pos)++;		      // just move forward
-    }
-  }
+  html_lexer_t lexer;                      // the lexer, starting at *pos
+  html_token_t token;                      // where the word is
+  html_event_t event;                      // what the lexer found
+  html_init(&lexer, page->html, page->html_len, *pos, HTML_WORDS | HTML_NO_TAGS);
+  event = html_next(&lexer, &token);
+  *pos = lexer.pos;
 
   // ran out of html
-  if (doc[*pos] == '\0') {
-    return NULL;
+  if (event != HTML_WORD) {
+    return false;
   }
 
-  // doc[*pos] is the first character of a word
-  beg = &(doc[*pos]);
+  *start = token.start;
+  *length = token.length;
+  return true;
+}
 
-  // consume word
-  while (doc[*pos] != '\0' && isalpha(doc[*pos])) {
-    (*pos)++;
+/**************** webpage_getNextWord ****************/
+/* see webpage.h for usage documentation.
+ *
+ * Pseudocode:
+ *     1. find the next word with webpage_getNextWordSpan
+ *     2. create a new word buffer
+ *     3. copy the word into the new buffer
+ *     4. return pointer to the word
+ */
+char *
+webpage_getNextWord(webpage_t *page, int *pos)
+{
+  int start, wordlen;
+  if (!webpage_getNextWordSpan(page, pos, &start, &wordlen)) {
+    return NULL;
   }
 
-  // at this point, doc[*pos] is the first character *after* the word.
-  // so doc[*pos-1] is the last character of the word.
-  end = &(doc[*pos-1]);
-
-  // 'beg' points to first character of the word
-  // 'end' points to last character of the word
-  int wordlen = end - beg + 1;
-
   // allocate space for length of new word + '\0'
   char *word = calloc(wordlen + 1, sizeof(char));
   if (word == NULL) {        // out of memory!
     return NULL;
   } else {
     // copy the new word
-    strncpy(word, beg, wordlen);
+    strncpy(word, &page->html[start], wordlen);
     return word;
   }
 }
@@ -314,127 +532,55 @@ webpage_getNextWord(webpage_t *page, int *pos)
  *
  * Pseudocode:
  *     1. check arguments
- *     2. if *pos = 0 (first call for this page): remove whitespace from html
- *     3. find hyperlink starting tags "<a" or "<A"
- *     4. find next href attribute "href="
- *     5. find next end tag ">"
- *     6. check that href comes before end tag
- *     7. deal with quoted and unquoted urls
- *     8. determine if url is absolute
- *     9. fixup relative links
- *    10. update *pos to position after the URL
- *    11. create new character buffer for result and return it
+ *     2. start the html lexer at *pos
+ *     3. skip text, and tags other than hyperlink tags "<a" or "<A"
+ *     4. find the hyperlink tag's href attribute (see LinkInTag)
+ *     5. make it a url, or skip it if it isn't a link to a page
+ *     6. update *pos to position after the hyperlink tag
+ *     7. return the url
+ *
+ * The lexer looks at each byte of the html once; only the attributes of
+ * hyperlink tags are looked at again.
  */
 char *
 webpage_getNextURL(webpage_t *page, int *pos)
 {
   // make sure we have text and base url, and valid arg
-  if (page == NULL || page->html == NULL || page->url == NULL || pos == NULL) {
+  if (page == NULL || page->html == NULL || page->url == NULL || pos == NULL
+      || *pos < 0 || (size_t) *pos > page->html_len) {
     return NULL;
   }
 
-  char *html = page->html;                 // the html document
-  char *base_url = page->url;              // the base URL for this html
-  int bad_link;                            // is this link ill formatted?
-  int relative;                            // is this link relative?
-  char delim;                              // url delimiter: ' ', ''', '"'
-  char *lnk;                               // hyperlink tags
-  char *href;                              // href in a tag
-  char *end;                               // end of hyperlink tag or url
-  char *ptr;                               // absolute vs. relative
-  char *hash;                              // hash mark character
-
-  // condense html, makes parsing easier
-  if (*pos == 0) {
-    RemoveWhitespace(html);
-  }
-
-  // parse for hyperlinks
-  do {
-    relative = 0;                        // assume absolute link
-    bad_link = 0;                        // assume valid link
-
-    // find tag "<a" or "<A""
-    lnk = strcasestr(&html[*pos], "<a");
+  html_lexer_t lexer;                      // the lexer, starting at *pos
+  html_init(&lexer, page->html, page->html_len, *pos, 0);
 
-    // no more links on this page
-    if (!lnk) { return NULL; }
+  // parse for the next hyperlink
+  char *result = webpage_nextLink(&lexer, page->url);
 
-    // find next href after hyperlink tag
-    href = strcasestr(lnk, "href=");
-
-    // no more links on this page
-    if (!href) { return NULL; }
-
-    // find end of hyperlink tag
-    end = strchr(lnk, '>');
-
-    // if the href we have is outside the current tag, continue
-    if (end && (end < href)) {
-      bad_link = 1; (*pos) += 2; continue;
-    }
-
-    // move href to beginning of url
-    href+=5;
-
-    // something went wrong, just continue
-    if (!href) { bad_link=1; (*pos) += 2; continue; }
-
-    // is the url quoted?
-    if (*href == '\'' || *href == '"') {  // yes, href="url" or href='url'
-      delim = *(href++);               // remember delimiter
-      end = strchr(href, delim);       // find next of same delimiter
-    } else {             // no, href=url
-      end = strchr(href, '>');         // hope: <a ... href=url>
-      // since we've stripped whitespace
-      // this could mangle things like:
-      // <a ... href=url name=val>
-    }
-
-    // if there is a # before the end of the url, exclude the #fragment
-    hash = strchr(href, '#');
-    if (hash && hash < end) {
-      end = hash;
-    }
-
-    // if we don't know where to end the url, continue
-    if (!end) {
-      bad_link = 1; (*pos) += 2; continue;
-    }
-
-    // have a link now
-    if (*href == '#') {                   // internal reference
-      bad_link = 1; (*pos) += 2; continue;
-    }
-
-    // is the url absolute, i.e, ':' must precede any '/', '?', or '#'
-    ptr = strpbrk(href, ":/?#");
-    if (!ptr || *ptr != ':') { 
-      relative = 1; 
-    } else if (strncasecmp(href, "http", 4)) { // absolute, but not http(s)
-      bad_link = 1; (*pos) += 2; continue;
-    }
-  } while (bad_link);                       // keep parsing
+  // update position after the end of the hyperlink tag
+  *pos = lexer.pos;
+  return result;
+}
 
-  // update position after the end of the url
-  *pos = end - html;
+/**************** webpage_nextLink ****************/
+/* see webpage.h for documentation */
+char *
+webpage_nextLink(html_lexer_t *lexer, char *base_url)
+{
+  html_token_t token;                      // where a tag is
+  html_event_t event;                      // what the lexer found
+  char *result = NULL;                     // the next url
 
-  // have a good link now
-  if (relative) {                           // need to fixup relative links
-    char *result = FixupRelativeURL(base_url, href, end - href);
-    return result; // may be NULL if Fixup failed.
-  } else {
-    // create new buffer
-    char *result = calloc(end-href+1, sizeof(char));
-    if (result == NULL) {
-      // out of memory
-      return NULL;
-    } else {
-      // copy over absolute url
-      strncpy(result, href, end - href);
-      return result;
+  if (lexer == NULL || base_url == NULL) {
+    return NULL;
+  }
+  while (result == NULL && (event = html_next(lexer, &token)) != HTML_END
+         && event != HTML_MORE) {
+    if (event == HTML_TAG) {
+      result = LinkInTag(lexer, &token, base_url);
     }
   }
+  return result;
 }
 
 /******************** NormalizeURL *******************************/
@@ -857,43 +1003,589 @@ BurstURL(const char *url, char **hostname, int *port, char **pathname)
 
 
 /* ********************* ConnectToHost ************************** */
-/* Connect to the given hostname and port, 
- * returning an open FILE* for the socket,
- * or NULL on failure.
+/* Connect to the given hostname and port, giving up after connectTimeout
+ * milliseconds, and returning the open connection, or NULL on failure.
+ * Requests are written with SendRequest, and responses read with Receive.
  */
-static FILE *
-ConnectToHost(const char *hostname, const int port)
+static httpConn_t *
+ConnectToHost(const char *hostname, const int port, fetchClock_t *clock)
 {
-  // Look up the hostname specified on command line
-  struct hostent *hostp = gethostbyname(hostname);
-  if (hostp == NULL) {
+  // Look up the hostname specified on command line; the resolver
+  // caches the answer for every later fetch from this host
+  struct sockaddr_in server;  // address of the server
+  if (!resolver_lookup(hostname, port, &server)) {
     return NULL;
   }
 
-  // Initialize fields of the server address
-  struct sockaddr_in server;  // address of the server
-  server.sin_family = AF_INET;
-  bcopy(hostp->h_addr_list[0], &server.sin_addr, hostp->h_length);
-  server.sin_port = htons(port);
-
   // Create socket (a file descriptor)
   int comm_sock = socket(AF_INET, SOCK_STREAM, 0);
   if (comm_sock < 0) {
     return NULL;
   }
 
-  // And connect that socket to that server   
-  if (connect(comm_sock, (struct sockaddr *) &server, sizeof(server)) < 0) {
+  // And connect that socket to that server, without blocking
+  // so that the wait for the connection can be limited
+  int flags = fcntl(comm_sock, F_GETFL);
+  if (flags < 0 || fcntl(comm_sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+    close(comm_sock);
+    return NULL;
+  }
+  if (connect(comm_sock, (struct sockaddr *) &server, sizeof(server)) < 0
+      && (errno != EINPROGRESS || !WaitForConnect(comm_sock, clock))) {
+    close(comm_sock);
+    return NULL;
+  }
+  if (fcntl(comm_sock, F_SETFL, flags) < 0) {
+    close(comm_sock);
     return NULL;
   }
 
-  // to make it easier to work with, switch to stdio
-  FILE *http_fp = fdopen(comm_sock, "r+");
-  if (http_fp == NULL) {
+  // responses are read through the connection's own buffer
+  httpConn_t *http_conn = malloc(sizeof(httpConn_t));
+  if (http_conn == NULL) {
+    close(comm_sock);
     return NULL;
   }
+  http_conn->sock = comm_sock;
+  http_conn->start = http_conn->end = 0;
+
+  pthread_mutex_lock(&poolLock);
+  connsOpened++;
+  pthread_mutex_unlock(&poolLock);
+  return http_conn;
+}
+
+/* ********************* WaitForConnect ************************** */
+/* Wait up to connectTimeout milliseconds for a non-blocking connect
+ * to finish, setting clock->timedOut if it doesn't.
+ * Return true if the socket is connected.
+ */
+static bool
+WaitForConnect(const int sock, fetchClock_t *clock)
+{
+  struct pollfd waiting = { sock, POLLOUT, 0 };
+  int ready;
+  do {
+    ready = poll(&waiting, 1, connectTimeout > 0 ? connectTimeout : -1);
+  } while (ready < 0 && errno == EINTR);
+  if (ready == 0) {
+    clock->timedOut = true;
+  }
+  if (ready <= 0) {
+    return false;
+  }
+
+  int error = 0;
+  socklen_t size = sizeof(error);
+  return getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &size) == 0 && error == 0;
+}
+
+/* ********************* TakeConnection ************************** */
+/* Remove an idle connection to the given hostname and port from the pool
+ * and return it, or return NULL if there is none.
+ */
+static httpConn_t *
+TakeConnection(const char *hostname, const int port)
+{
+  httpConn_t *conn = NULL;
+  pooledConn_t *found = NULL;
+
+  pthread_mutex_lock(&poolLock);
+  for (pooledConn_t **link = &idleConns; *link != NULL; link = &(*link)->next) {
+    if ((*link)->port == port && strcmp((*link)->hostname, hostname) == 0) {
+      found = *link;
+      *link = found->next;
+      conn = found->conn;
+      connsReused++;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&poolLock);
+
+  if (found != NULL) {
+    free(found->hostname);
+    free(found);
+  }
+  return conn;
+}
+
+/* ********************* ReturnConnection ************************** */
+/* Put a connection whose response has been read completely back into
+ * the pool, or close it if the host already has poolSize idle connections.
+ */
+static void
+ReturnConnection(httpConn_t *conn, const char *hostname, const int port)
+{
+  pooledConn_t *pooled = malloc(sizeof(pooledConn_t));
+  char *copy = strdup(hostname);
+  if (pooled == NULL || copy == NULL) {
+    free(pooled);
+    free(copy);
+    CloseConnection(conn);
+    return;
+  }
+  pooled->conn = conn;
+  pooled->hostname = copy;
+  pooled->port = port;
+
+  pthread_mutex_lock(&poolLock);
+  int idle = 0;
+  for (pooledConn_t *other = idleConns; other != NULL; other = other->next) {
+    if (other->port == port && strcmp(other->hostname, hostname) == 0) {
+      idle++;
+    }
+  }
+  bool kept = idle < poolSize;
+  if (kept) {
+    pooled->next = idleConns;
+    idleConns = pooled;
+  }
+  pthread_mutex_unlock(&poolLock);
+
+  if (!kept) {
+    CloseConnection(conn);
+    free(copy);
+    free(pooled);
+  }
+}
+
+/* ********************* SendRequest ************************** */
+/* Write an HTTP/1.1 GET request for pathname to the connection, asking the
+ * server to keep the connection open or to close it after the response.
+ * Writes go straight to the socket, without SIGPIPE if the server hung up.
+ * Return true if the whole request was sent.
+ */
+static bool
+SendRequest(httpConn_t *conn, const char *pathname, const char *hostname,
+            const bool keepAlive)
+{
+  const char *httpFormat = "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n";
+  const char *connection = keepAlive ? "keep-alive" : "close";
+  int length = snprintf(NULL, 0, httpFormat, pathname, hostname, connection);
+  char *request = malloc(length + 1);
+  if (length < 0 || request == NULL) {
+    free(request);
+    return false;
+  }
+  snprintf(request, length + 1, httpFormat, pathname, hostname, connection);
+
+  int sock = conn->sock;
+  int sent = 0;
+  while (sent < length) {
+    ssize_t n = send(sock, request + sent, length - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      break;
+    }
+    sent += n;
+  }
+  free(request);
+  return sent == length;
+}
+
+/* ********************* ReadResponse ************************** */
+/* Read one HTTP response from the connection: the status line, the headers,
+ * and a body framed by chunked encoding, by Content-Length, or else by the
+ * server closing the connection, all before the deadlines of the clock.
+ * Sets *code to the response code, clock->answered to whether any response
+ * arrived, clock->timedOut to whether a deadline passed, and *reusable to
+ * whether the connection may carry another request.
+ * Reads the body into body, which the caller must free either way; only
+ * the body of a 200 response is passed to its sink.
+ * Return false on error.
+ */
+static bool
+ReadResponse(httpConn_t *conn, int *code, bool *reusable, fetchBody_t *body,
+             fetchClock_t *clock)
+{
+  *code = 0;
+  *reusable = false;
+
+  // the status line, e.g., "HTTP/1.1 200 OK"
+  char *status = ReadLine(conn, clock);
+  if (status == NULL) {
+    return false;
+  }
+  clock->answered = true;
+  int minor = 0;
+  bool valid = sscanf(status, "HTTP/1.%d %d", &minor, code) == 2;
+  free(status);
+  if (!valid) {
+    return false;
+  }
+
+  // read headers until we read a blank line or fail to read a line;
+  // HTTP/1.1 connections stay open unless the server says otherwise
+  bool keepAlive = minor >= 1;
+  bool chunked = false;
+  long long contentLength = -1;
+  char *line = ReadLine(conn, clock);
+  while (line != NULL && !isBlankLine(line)) {
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      contentLength = strtoll(line + 15, NULL, 10);
+    } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+      chunked = strcasestr(line + 18, "chunked") != NULL;
+    } else if (strncasecmp(line, "Connection:", 11) == 0) {
+      if (strcasestr(line + 11, "close") != NULL) {
+        keepAlive = false;
+      } else if (strcasestr(line + 11, "keep-alive") != NULL) {
+        keepAlive = true;
+      }
+    }
+    free(line);
+    line = ReadLine(conn, clock);
+  }
+  // did we exit the loop because we read an empty line?
+  if (line == NULL) {
+    return false;
+  }
+  free(line); // the blank line
+
+  // then grab the body - that should be the page content,
+  // which the sink may look at as it arrives
+  if (*code != 200) {
+    body->sink = NULL;
+  }
+  bool read;
+  if (chunked) {
+    read = ReadChunkedBody(conn, body, clock);
+  } else if (contentLength >= 0) {
+    read = ReadBytes(conn, body, contentLength, clock);
+  } else {
+    // unframed: the body ends when the server closes the connection
+    read = ReadUntilClose(conn, body, clock);
+    keepAlive = false;
+  }
+
+  // the rest of a body cut off at its limit is still waiting to be read
+  *reusable = keepAlive && read && !body->truncated;
+  return read;
+}
+
+/* ********************* ReadChunkedBody ************************** */
+/* Read a body sent with "Transfer-Encoding: chunked": a series of chunks,
+ * each a hexadecimal size line followed by that many bytes and a CRLF,
+ * ending with a chunk of size zero and optional trailer headers.
+ * Append the joined chunks to the body, leaving the rest unread once it
+ * is cut off at its limit. Return false on error.
+ */
+static bool
+ReadChunkedBody(httpConn_t *conn, fetchBody_t *body, fetchClock_t *clock)
+{
+  if (!GrowBody(body, 0)) {
+    return false;
+  }
+
+  while (true) {
+    // the chunk size, possibly followed by ";extensions"
+    char *sizeLine = ReadLine(conn, clock);
+    if (sizeLine == NULL) {
+      return false;
+    }
+    char *end;
+    unsigned long long size = strtoull(sizeLine, &end, 16);
+    bool valid = end != sizeLine && size < SIZE_MAX / 2 - body->length;
+    free(sizeLine);
+    if (!valid) {
+      return false;
+    }
+
+    if (size == 0) {
+      // skip any trailer headers, up to the final blank line
+      char *line = ReadLine(conn, clock);
+      while (line != NULL && !isBlankLine(line)) {
+        free(line);
+        line = ReadLine(conn, clock);
+      }
+      if (line == NULL) {
+        return false;
+      }
+      free(line);
+      return true;
+    }
+
+    // the chunk itself, or as much of it as fits under the limit
+    bool ended;
+    if (!ReadBody(conn, body, size, &ended, clock) || ended) {
+      return false;
+    }
+    if (body->truncated) {
+      return true;
+    }
+
+    // each chunk ends with a CRLF
+    char *crlf = ReadLine(conn, clock);
+    if (crlf == NULL || !isBlankLine(crlf)) {
+      free(crlf);
+      return false;
+    }
+    free(crlf);
+  }
+}
+
+/* ********************* ReadBytes ************************** */
+/* Read exactly length bytes from the connection, or as many as fit
+ * under the body's limit, and append them to the body.
+ * Return false on error or if the connection ended first.
+ */
+static bool
+ReadBytes(httpConn_t *conn, fetchBody_t *body, const size_t length, fetchClock_t *clock)
+{
+  // room for the whole body at once, since we know how long it is
+  size_t room = body->limit > 0 && length > body->limit ? body->limit : length;
+  bool ended;
+  return GrowBody(body, room) && ReadBody(conn, body, length, &ended, clock) && !ended;
+}
+
+/* ********************* ReadUntilClose ************************** */
+/* Read until the server closes the connection, or the body reaches
+ * its limit, appending what was read to the body.
+ * Return false on error or if nothing was read.
+ */
+static bool
+ReadUntilClose(httpConn_t *conn, fetchBody_t *body, fetchClock_t *clock)
+{
+  bool ended;
+  return ReadBody(conn, body, SIZE_MAX, &ended, clock) && body->length > 0;
+}
+
+/* ********************* ReadBody ************************** */
+/* Read up to length bytes of the body before the clock's deadline, as
+ * they arrive, appending them to the body and passing the body so far
+ * to its sink, if any, after each read.
+ * Stops early, setting body->truncated, where the body reaches its limit.
+ * Return false on error, or if the deadline passed (then clock->timedOut
+ * is set); set *ended if the connection ended before length bytes.
+ */
+static bool
+ReadBody(httpConn_t *conn, fetchBody_t *body, const size_t length, bool *ended,
+         fetchClock_t *clock)
+{
+  // a sink gets smaller blocks, so it sees the start of the body sooner
+  size_t block = body->sink != NULL ? STREAM_BLOCK : READ_BLOCK;
+  size_t done = 0;
+
+  *ended = false;
+  while (done < length) {
+    size_t want = length - done < block ? length - done : block;
+    if (body->limit > 0 && want > body->limit - body->length) {
+      want = body->limit - body->length;
+      if (want == 0) {
+        body->truncated = true;
+        return true;
+      }
+    }
+    if (!GrowBody(body, want)) {
+      return false;
+    }
+    ssize_t n = ReadSome(conn, body->html + body->length, want, clock);
+    if (n < 0) {
+      return false;
+    }
+    if (n == 0) {
+      *ended = true;                       // the server closed the connection
+      return true;
+    }
+    body->length += n;
+    body->html[body->length] = '\0';
+    done += n;
+    if (body->sink != NULL) {
+      body->sink(body->arg, body->html, body->length);
+    }
+  }
+  return true;
+}
+
+/* ********************* GrowBody ************************** */
+/* Make room in the body for more bytes and a '\0' after them,
+ * doubling it to keep appends cheap. Return false if out of memory.
+ */
+static bool
+GrowBody(fetchBody_t *body, const size_t more)
+{
+  if (more >= SIZE_MAX / 2 - body->length) {
+    return false;
+  }
+  if (body->capacity - body->length > more) {
+    return true;
+  }
+  size_t capacity = body->capacity > 0 ? body->capacity * 2 : 1024;
+  if (capacity < body->length + more + 1) {
+    capacity = body->length + more + 1;
+  }
+  char *bigger = realloc(body->html, capacity);
+  if (bigger == NULL) {
+    return false;
+  }
+  body->html = bigger;
+  body->capacity = capacity;
+  body->html[body->length] = '\0';
+  return true;
+}
+
+/* ********************* ReadLine ************************** */
+/* Read one line before the clock's deadline, like freadlinep: without
+ * its newline, and cut short by the end of the connection.
+ * Return it as a new string, or NULL at end of file, on error, or
+ * if the deadline passed (then clock->timedOut is set).
+ */
+static char *
+ReadLine(httpConn_t *conn, fetchClock_t *clock)
+{
+  char *line = NULL;
+  size_t length = 0;
+  while (true) {
+    // take what is buffered, up to and including a newline
+    if (conn->start == conn->end) {
+      ssize_t n = Receive(conn, conn->buf, CONN_BUFFER, clock);
+      if (n < 0 || (n == 0 && length == 0)) {
+        free(line);                        // a line cut off by an error is no good
+        return NULL;
+      }
+      if (n == 0) {
+        return line;                       // the last line had no newline
+      }
+      conn->start = 0;
+      conn->end = n;
+    }
+    char *from = conn->buf + conn->start;
+    char *newline = memchr(from, '\n', conn->end - conn->start);
+    size_t take = newline != NULL ? newline - from + 1 : conn->end - conn->start;
+    char *longer = realloc(line, length + take + 1);
+    if (longer == NULL) {
+      free(line);
+      return NULL;
+    }
+    line = longer;
+    memcpy(line + length, from, take);
+    length += take;
+    line[length] = '\0';
+    conn->start += take;
+    if (newline != NULL) {
+      line[length - 1] = '\0';
+      return line;
+    }
+  }
+}
+
+/* ********************* ReadSome ************************** */
+/* Read between 1 and length bytes of the response into buf before the
+ * clock's deadline: those already buffered, or else what arrives next,
+ * straight into buf if it is at least as big as the connection's buffer.
+ * Return how many were read, 0 at end of file, or -1 on error or if the
+ * deadline passed (then clock->timedOut is set).
+ */
+static ssize_t
+ReadSome(httpConn_t *conn, char *buf, const size_t length, fetchClock_t *clock)
+{
+  if (conn->start == conn->end) {
+    if (length >= CONN_BUFFER) {
+      return Receive(conn, buf, length, clock);
+    }
+    ssize_t n = Receive(conn, conn->buf, CONN_BUFFER, clock);
+    if (n <= 0) {
+      return n;
+    }
+    conn->start = 0;
+    conn->end = n;
+  }
+  size_t take = conn->end - conn->start < length ? conn->end - conn->start : length;
+  memcpy(buf, conn->buf + conn->start, take);
+  conn->start += take;
+  return take;
+}
+
+/* ********************* Receive ************************** */
+/* Receive whatever arrives next on the connection's socket, up to length
+ * bytes, into buf, waiting no longer than the time left before the clock's
+ * deadline: the first-byte deadline until the status line has arrived,
+ * and the total deadline throughout. The time left is worked out again
+ * before every wait, so a server trickling bytes runs out of it too.
+ * Return how many bytes arrived, 0 at end of file, or -1 on error or if
+ * the deadline passed (then clock->timedOut is set).
+ */
+static ssize_t
+Receive(httpConn_t *conn, char *buf, const size_t length, fetchClock_t *clock)
+{
+  long long deadline = clock->total;
+  if (!clock->answered && clock->firstByte > 0
+      && (deadline == 0 || clock->firstByte < deadline)) {
+    deadline = clock->firstByte;
+  }
 
-  return http_fp;
+  while (true) {
+    int wait = -1;                         // no limit
+    if (deadline > 0) {
+      long long left = deadline - Now();
+      if (left <= 0) {
+        clock->timedOut = true;
+        return -1;
+      }
+      wait = (int) ((left + 999999) / 1000000); // rounded up to a millisecond
+    }
+    struct pollfd waiting = { conn->sock, POLLIN, 0 };
+    int ready = poll(&waiting, 1, wait);
+    if (ready < 0 && errno != EINTR) {
+      return -1;
+    }
+    if (ready <= 0) {
+      continue;                            // check the deadline again
+    }
+
+    // never block here: the wait above is all the time there is
+    ssize_t n = recv(conn->sock, buf, length, MSG_DONTWAIT);
+    if (n >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return n;
+    }
+  }
+}
+
+/* ********************* CloseConnection ************************** */
+/* Close the connection's socket and free it.
+ */
+static void
+CloseConnection(httpConn_t *conn)
+{
+  close(conn->sock);
+  free(conn);
+}
+
+/* ********************* Backoff ************************** */
+/* Sleep before retry number try (1 for the first retry): backoffBase
+ * milliseconds, doubled for each retry after the first, up to backoffMax,
+ * with a random half of that taken off so that fetches failing together
+ * don't all retry together.
+ */
+static void
+Backoff(const int try)
+{
+  long long delay = backoffBase;
+  for (int i = 1; i < try && delay < backoffMax; i++) {
+    delay *= 2;
+  }
+  if (delay > backoffMax) {
+    delay = backoffMax;
+  }
+  if (delay <= 0) {
+    return;
+  }
+
+  if (jitterSeed == 0) {
+    jitterSeed = (unsigned int) Now() ^ (unsigned int) (uintptr_t) &jitterSeed;
+  }
+  long long milliseconds = delay - rand_r(&jitterSeed) % (delay / 2 + 1);
+  struct timespec pause = { milliseconds / 1000, (milliseconds % 1000) * 1000000L };
+  nanosleep(&pause, NULL);
+}
+
+/* ********************* Now ************************** */
+/* Return the current monotonic time in nanoseconds.
+ */
+static long long
+Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
 
@@ -1040,6 +1732,89 @@ RemoveDotSegments(char *input)
   return out;
 }
 
+/* ***************************************************************** */
+/*
+ * LinkInTag - the url a tag links to, if any
+ * @lexer: the lexer, whose last event was the tag
+ * @tag: the tag
+ * @base_url: the url of the page, for relative links
+ *
+ * Returns the newly allocated url of the tag's first href attribute,
+ * if it is a hyperlink tag <a ...> with a usable link (see MakeLink);
+ * otherwise, NULL. Either way, leaves the lexer after the tag, without
+ * parsing the attributes of any other tag.
+ */
+static char *
+LinkInTag(html_lexer_t *lexer, html_token_t *tag, char *base_url)
+{
+  html_token_t attribute;                  // an attribute of the tag
+  char *result = NULL;                     // the url
+
+  if (!tag->closing && html_isName(lexer->doc + tag->start, tag->length, "a")) {
+    while (html_next(lexer, &attribute) == HTML_ATTRIBUTE) {
+      if (html_isName(lexer->doc + attribute.start, attribute.length, "href")) {
+        result = MakeLink(base_url, lexer->doc + attribute.value, attribute.valueLength);
+        break;
+      }
+    }
+  }
+  html_skipTag(lexer);
+  return result;
+}
+
+/* ***************************************************************** */
+/*
+ * MakeLink - make a url of the value of an href attribute
+ * @base_url: the url of the page it is in, for relative links
+ * @href: the value, which need not end in '\0'
+ * @len: its length
+ *
+ * Drops any whitespace from the value, as the html may break a long
+ * url over several lines, and any #fragment. Returns NULL if nothing is
+ * left, i.e., the link is to a part of the same page, or if it is an
+ * absolute url that isn't http(s); otherwise, the absolute url, newly
+ * allocated (or NULL if out of memory).
+ */
+static char *
+MakeLink(char *base_url, const char *href, const size_t len)
+{
+  char *link;                              // the url, condensed
+  size_t link_len = 0;                     // its length
+  char *ptr;                               // absolute vs. relative
+
+  link = malloc(len + 1);
+  if (link == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < len && href[i] != '#'; i++) {
+    if (!isspace((unsigned char) href[i])) {
+      link[link_len++] = href[i];
+    }
+  }
+  link[link_len] = '\0';
+
+  // an internal reference, or no link at all
+  if (link_len == 0) {
+    free(link);
+    return NULL;
+  }
+
+  // is the url absolute, i.e, ':' must precede any '/' or '?'
+  ptr = strpbrk(link, ":/?");
+  if (ptr && *ptr == ':') {
+    if (strncasecmp(link, "http", 4)) {    // absolute, but not http(s)
+      free(link);
+      return NULL;
+    }
+    return link;
+  }
+
+  // need to fixup relative links
+  char *result = FixupRelativeURL(base_url, link, link_len);
+  free(link);
+  return result; // may be NULL if Fixup failed.
+}
+
 /* ***************************************************************** */
 /*
  * FixupRelativeURL - resolves a relative url to an absolute url
@@ -1131,31 +1906,6 @@ FixupRelativeURL(char *base, char *rel, size_t len)
 }
 
 
-/* ***************************************************************** */
-/*
- * RemoveWhitespace - removes whitespace from str
- * @str: char buffer to modify
- *
- * Eliminates whitespace by shifting and condensing all the non-whitespace
- * toward the beginning of the buffer. This does not alter the size of the
- * buffer.
- *
- * Should have no use outside of this file, thus declared static.
- */
-static void
-RemoveWhitespace(char* str)
-{
-  char *prev;                              // previous whitespace
-  char *cur;                               // current non-whitespace
-
-  // start at beginning of str
-  cur = prev = str;
-
-  do {
-    while (isspace(*cur)) cur++;           // consume any whitespace
-  } while ((*prev++ = *cur++));            // condense to front of str
-}
-
 /* **************** isBlankLine ******************/
 /* Input: line, a non-NULL pointer to a string.
  * Return true if the string is pointing to a blank line, that is, 
@@ -13,12 +13,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include "html.h"
 
 /***********************************************************************/
 /* webpage_t: opaque struct to represent a web page, and its contents.
  */
 typedef struct webpage webpage_t;
 
+/* webpage_sink_t: a function that looks at the html of a page as it
+ * arrives, see webpage_fetchStreaming() */
+typedef void (*webpage_sink_t)(void *arg, const char *html, const size_t length);
+
 /* getter methods */
 int   webpage_getDepth(const webpage_t *page);
 char *webpage_getURL(const webpage_t *page);
@@ -39,6 +44,85 @@ char *webpage_getHTML(const webpage_t *page);
  */
 webpage_t *webpage_new(char *url, const int depth, char *html);
 
+/**************** webpage_setFetchDelay ****************/
+/* Set how many milliseconds webpage_fetch() sleeps after each attempt
+ * to connect, to lighten the load on the server.
+ * The default is 1000 (0 if compiled with -DNOSLEEP).
+ * A caller that rate-limits its own fetches, like the crawler's per-host
+ * politeness scheduler, may set it to 0. Negative values are treated as 0.
+ * Not thread-safe: call it before fetching from several threads.
+ */
+void webpage_setFetchDelay(const int milliseconds);
+
+/**************** webpage_setConnectionPool ****************/
+/* Keep up to idlePerHost connections to each host open between fetches,
+ * so consecutive fetches from the same host reuse a socket instead of
+ * connecting again (HTTP/1.1 keep-alive). The default is 0, which sends
+ * "Connection: close" and opens a new connection for every fetch;
+ * setting 0 also closes any idle connections.
+ * The pool is shared by all threads calling webpage_fetch().
+ */
+void webpage_setConnectionPool(const int idlePerHost);
+
+/**************** webpage_closeConnections ****************/
+/* Close every idle connection in the pool, e.g., at the end of a crawl.
+ * Fetches may still run afterwards; they just open new connections.
+ */
+void webpage_closeConnections(void);
+
+/**************** webpage_getConnectionStats ****************/
+/* Set *opened to the number of connections webpage_fetch() has opened,
+ * and *reused to the number of fetches that reused an idle connection.
+ * Either pointer may be NULL.
+ */
+void webpage_getConnectionStats(int *opened, int *reused);
+
+/**************** webpage_setTimeouts ****************/
+/* Limit how long webpage_fetch() may take, in milliseconds; 0 means no limit.
+ *   connectMs   for each attempt to connect (default 5000)
+ *   firstByteMs from sending the request to the first line of the response
+ *               (default 10000)
+ *   totalMs     from sending the request to the end of the response
+ *               (default 30000)
+ * Every read from the socket waits only for the time left, so a server that
+ * stops sending, or sends a byte at a time, costs at most these times.
+ * Not thread-safe: call it before fetching from several threads.
+ */
+void webpage_setTimeouts(const int connectMs, const int firstByteMs,
+                         const int totalMs);
+
+/**************** webpage_setRetryBackoff ****************/
+/* Set how long webpage_fetch() waits before retrying a failed connect:
+ * baseMs before the first retry (default 250), doubling for each retry
+ * after it up to maxMs (default 4000). Each wait is shortened by a random
+ * amount of up to half, so fetches that fail together don't retry together.
+ * Not thread-safe: call it before fetching from several threads.
+ */
+void webpage_setRetryBackoff(const int baseMs, const int maxMs);
+
+/**************** webpage_setMaxPageSize ****************/
+/* Keep at most bytes of the html of each page webpage_fetch() gets;
+ * 0, the default, means no limit. A longer page is cut off there, and the
+ * fetch still succeeds (see webpage_fetchTruncated), but the rest of it is
+ * never read, so the connection is closed rather than reused.
+ * Not thread-safe: call it before fetching from several threads.
+ */
+void webpage_setMaxPageSize(const size_t bytes);
+
+/**************** webpage_fetchTruncated ****************/
+/* Return true if the page the last successful call to webpage_fetch() on
+ * this thread got was cut off at the largest page size.
+ */
+bool webpage_fetchTruncated(void);
+
+/**************** webpage_fetchTimedOut ****************/
+/* Return true if the last call to webpage_fetch() on this thread failed
+ * because a connect or read ran out of time (see webpage_setTimeouts),
+ * rather than because the page doesn't exist or the server refused it.
+ * Such a page may well be fetched by trying again later.
+ */
+bool webpage_fetchTimedOut(void);
+
 /**************** webpage_delete ****************/
 /* Delete a webpage_t structure created by webpage_new().
  * This function may be called from something like bag_delete().
@@ -75,6 +159,11 @@ void webpage_delete(void *data);
  *     True: success; caller must later free html via webpage_delete(page).
  *     False: some error fetching page.
  * 
+ * Responses may be framed by Content-Length, chunked transfer encoding,
+ * or the server closing the connection. With a connection pool (see
+ * webpage_setConnectionPool), the connection is kept for the next fetch
+ * from the same host whenever the server allows it.
+ *
  * Limitations:
  *   * can only handle http (not https or other schemes)
  *   * can only handle URLs of form http://host[:port][/pathname]
@@ -82,6 +171,54 @@ void webpage_delete(void *data);
  */
 bool webpage_fetch(webpage_t *page);
 
+/***************** webpage_fetchStreaming ******************************/
+/* retrieve HTML from page->url, like webpage_fetch(), but let sink look
+ * at the html as it arrives, rather than only once it is all in.
+ * @page: the webpage struct containing the url to fetch
+ * @sink: called with arg after each read of the html (at most a few KB),
+ *        with the html so far and its length; html[length] is '\0'.
+ *        The html may move between calls, but keeps the bytes it had.
+ * @arg: passed to the sink
+ *
+ * Only the html of a 200 response goes to the sink. If the fetch then
+ * succeeds, page->html holds all of it, as after webpage_fetch(); the
+ * sink isn't called for the end of the html, so the caller may look at
+ * page->html once more knowing it is complete. If the fetch fails part
+ * way through, the sink may have seen some of the html first.
+ *
+ * Usage example: (find links while the page arrives)
+ *  html_lexer_t lexer;
+ *  ... a sink that starts the lexer with HTML_STREAMING on the first call,
+ *      feeds it the html so far with html_feed() on each later call,
+ *      and takes links with webpage_nextLink() until it returns NULL ...
+ *  if (webpage_fetchStreaming(page, sink, &lexer)) {
+ *    html_feed(&lexer, webpage_getHTML(page), strlen(webpage_getHTML(page)), true);
+ *    ... take the rest of the links with webpage_nextLink() ...
+ *  }
+ */
+bool webpage_fetchStreaming(webpage_t *page, webpage_sink_t sink, void *arg);
+
+
+/**************** webpage_getNextWordSpan *******************************/
+/* find the next word from html[pos], without copying it
+ * @page: pointer to the webpage info
+ * @pos: current position in html buffer; updated to first pos after the word.
+ * @start: set to the position in the html of the word's first character.
+ * @length: set to the number of characters in the word.
+ *
+ * Returns true if there is a next word; otherwise, returns false.
+ * Finds the same words as webpage_getNextWord, which copies each one,
+ * so callers that only look at a word (or copy it somewhere of their
+ * own) need not allocate anything per word.
+ *
+ * Usage example: (print all words in a page)
+ * int pos = 0, start, length;
+ *
+ * while (webpage_getNextWordSpan(page, &pos, &start, &length)) {
+ *     printf("Found word: %.*s\n", length, webpage_getHTML(page) + start);
+ * }
+ */
+bool webpage_getNextWordSpan(const webpage_t *page, int *pos, int *start, int *length);
 
 /**************** webpage_getNextWord ***********************************/
 /* return the next word from html[pos]
@@ -97,8 +234,6 @@ bool webpage_fetch(webpage_t *page);
  * buffer; may be NULL on failed return. The caller is responsible for free'ing
  * this memory.
  *
- * Side effect: the page's html will be compressed to remove white space.
- *
  * Usage example: (retrieve all words in a page)
  * int pos = 0;
  * char *result;
@@ -119,18 +254,22 @@ char *webpage_getNextWord(webpage_t *page, int *pos);
 /****************** webpage_getNextURL ***********************************/
 /* return the next url from html[pos]
  * @page: pointer to the webpage info
- * @pos: current position in html buffer; updated to first pos after the URL.
+ * @pos: current position in html buffer; updated to first pos after the
+ *    hyperlink tag <a href=...> the URL is in.
  *
  * Returns pointer to the next URL, if any; otherwise, returns NULL.
  * The page should already exist (not NULL), and contain non-NULL html.
  * The *pos argument should be 0 on the initial call; it will be updated to
- *    the position after the URL returned.
+ *    the position after the tag of the URL returned.
+ * Links to a part of the same page (#fragment) and absolute URLs that
+ *    aren't http(s) are skipped; a relative URL is made absolute, using
+ *    the page's URL as its base. Whitespace in the URL is dropped.
+ * The html is read in one pass by the html lexer (see html.h), and is
+ *    not changed.
  * On successful parse of html, return value will point to a newly allocated
  * buffer; may be NULL on failed return. The caller is responsible for free'ing
  * this memory.
  *
- * Side effect: the page's html will be compressed to remove white space.
- *
  * Usage example: (retrieve all urls in a page)
  * int pos = 0;
  * char *result;
@@ -148,6 +287,21 @@ char *webpage_getNextWord(webpage_t *page, int *pos);
 
 char *webpage_getNextURL(webpage_t *page, int *pos);
 
+/****************** webpage_nextLink ***********************************/
+/* return the next url the lexer finds, like webpage_getNextURL()
+ * @lexer: a lexer over the html of a page, started by the caller with
+ *    html_init(), with no flags or HTML_STREAMING
+ * @base_url: the page's URL, the base of relative URLs
+ *
+ * Returns the url as a newly allocated string, which the caller must
+ * free; NULL at the end of the html or, when streaming, once the rest
+ * of the html has to arrive first (see html_feed). The lexer is left
+ * after the hyperlink tag, so the next call goes on from there.
+ * This is how links are found in html that is still arriving, e.g., in
+ * the sink of webpage_fetchStreaming().
+ */
+char *webpage_nextLink(html_lexer_t *lexer, char *base_url);
+
 /***********************************************************************
  * NormalizeURL - attempts to normalize the url
  * @url: absolute url to normalize
@@ -4,7 +4,8 @@
  * given a directory previously accessed and filled by the crawler and a file filled 
  * by the indexer, the query takes "queries" from the user through stdin and returns
  * a list of URLs that best match that query by a score calculated as the number of
- * occurrences of the given word conditions in those webpages according to the query.
+ * occurrences of the given word conditions in those webpages according to the query,
+ * or optionally by TF-IDF or BM25 relevance.
  * This list will be ranked, starting with the URL with the highest score
  *
  * Ethan Chen, Oct. 2021
@@ -15,54 +16,77 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h>
 #include "index.h"
+#include "doctable.h"
+#include "arena.h"
 #include "word.h"
 #include "pagedir.h"
+#include "pagestore.h"
 #include "file.h"
 #include "counters.h"
 #include "memory.h"
 
 /***************** local types ********************/
 
-typedef struct countersTuple { // stores two counters to be passed to counters_iterate
-    counters_t* counters1;
-    counters_t* counters2;
-} countersTuple_t;
-
-typedef struct scoreID { // stores two ints, an id and its score for a query
+typedef struct scoreID { // stores an id and its score for a query
     int docID;
-    int score;
+    double score;
 } scoreID_t;
 
-typedef struct scoreIDArr { // stores an array of scoreIDs and keeps track of how much of the array has been filled
-    scoreID_t** arr;
-    int slotsFilled;
-} scoreIDArr_t;
+typedef struct scoreList { // a docID-sorted array of document scores owned by the querier
+    scoreID_t* scores;
+    int numScores;
+} scoreList_t;
+
+typedef enum rankMode { // how the documents matching a query are scored
+    RANK_COUNT,     // the raw number of occurrences (min for and, sum for or)
+    RANK_TFIDF,     // term frequency over document length, times inverse document frequency
+    RANK_BM25       // Okapi BM25
+} rankMode_t;
+
+typedef struct ranker { // per-document statistics, computed once when the querier starts
+    rankMode_t mode;
+    int numDocs;        // the number of documents in the index, N
+    int maxDocID;       // the largest docID with an entry in docNorms
+    double* docNorms;   // indexed by docID: 1 / length for TF-IDF, or
+                        // k1 * (1 - b + b * length / average length) for BM25
+} ranker_t;
+
+/************* global variables ****************/
+
+static const double BM25_K1 = 1.2;  // how quickly repeated occurrences stop adding to a score
+static const double BM25_B = 0.75;  // how strongly scores are normalized by document length
+static const size_t QUERY_ARENA_BLOCK = 64 * 1024; // bytes per block of a query's arena
 
 /************* function prototypes ********************/
 
 // query methods
-bool query(char* pageDirectory, char* indexFilename);
-void processQuery(char* search, index_t* index, char* pageDirectory);
+bool query(char* pageDirectory, char* indexFilename, int topK, rankMode_t mode);
+void processQuery(char* search, index_t* index, docTable_t* docs, ranker_t* ranker, arena_t* arena, char* pageDirectory, int topK);
 int countWordsInQuery(char* query);
-char** parseQuery(char* query, int numWords);
+char** parseQuery(char* query, int numWords, arena_t* arena);
 void normalizeQuery(char** words, int numWords);
 
 // scoring methods
-counters_t* getIDScores(char** words, int numWords, index_t* index, char* pageDirectory);
-bool orSequence(counters_t* prod, counters_t* scores);
-counters_t* andSequence(counters_t* prod, counters_t* wordCount);
-void countersUnionHelper(void* arg, const int key, const int count);
-void countersIntersectionHelper(void* arg, const int key, const int count);
+scoreList_t* getIDScores(char** words, int numWords, index_t* index, ranker_t* ranker, arena_t* arena, char* pageDirectory);
+bool orSequence(scoreList_t* prod, scoreList_t* scores, arena_t* arena);
+bool andSequence(const posting_t** lists, int* lengths, int numLists, ranker_t* ranker, arena_t* arena, scoreList_t* prod);
+int gallopTo(const posting_t* list, int length, int start, int docID);
+ranker_t* newRanker(docTable_t* docs, rankMode_t mode);
+double termIDF(ranker_t* ranker, int docFrequency);
+double termScore(ranker_t* ranker, double idf, int count, int docID);
 
 // ranking and printing methods
-bool rankAndPrint(counters_t* idScores, char* pageDirectory);
-void countFunc(void* arg, const int key, const int count);
-void sortFunc(void* arg, const int key, const int count);
+bool rankAndPrint(scoreList_t* idScores, docTable_t* docs, ranker_t* ranker, arena_t* arena, char* pageDirectory, int topK);
+char* readURLFromCrawlerFile(char* pageDirectory, int docID);
+scoreID_t* selectTopScores(scoreList_t* idScores, int topK, int* numSelected, arena_t* arena);
+bool rankedBefore(scoreID_t* a, scoreID_t* b);
+void siftDown(scoreID_t* heap, int size, int i);
 
 // struct deletion
-void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize);
+void deleteRanker(ranker_t* ranker);
 
 // Prompting
 int fileno(FILE *stream);
@@ -76,10 +100,12 @@ void prompt(void);
 /************** main() ******************/
 /* the "testing" function/main function, which takes two arguments 
  * as inputs (other than the executable call), the directory containing the
- * crawler directory and the name of the index file 
+ * crawler directory and the name of the index file. They may be preceded by
+ * --top [K] to only print the K best documents of each query, and by
+ * --rank [count|tfidf|bm25] to choose how documents are scored
  * 
  * Pseudocode:
- *      1. Make sure there are exactly 2 arguments
+ *      1. parse the flags, then make sure there are exactly 2 arguments left
  *      2. copy the pageDirectory and indexFilename into malloc'd strings
  *      3. validate the directory and indexFile
  *      4. call the querier method
@@ -96,14 +122,35 @@ int main(const int argc, char* argv[])
     #else
 
     char* program = argv[0];
+    // parse the flags that come before the positional arguments
+    int topK = 0; // 0 prints every matching document
+    rankMode_t mode = RANK_COUNT;
+    int argIndex = 1;
+    while (argIndex < argc && argv[argIndex][0] == '-') {
+        char ignore;
+        if (strcmp(argv[argIndex], "--top") == 0 && argIndex + 1 < argc
+            && sscanf(argv[argIndex + 1], "%d%c", &topK, &ignore) == 1 && topK > 0) {
+            argIndex += 2;
+        } else if (strcmp(argv[argIndex], "--rank") == 0 && argIndex + 1 < argc
+                   && (strcmp(argv[argIndex + 1], "count") == 0 || strcmp(argv[argIndex + 1], "tfidf") == 0
+                       || strcmp(argv[argIndex + 1], "bm25") == 0)) {
+            const char* name = argv[argIndex + 1];
+            mode = strcmp(name, "bm25") == 0 ? RANK_BM25 : strcmp(name, "tfidf") == 0 ? RANK_TFIDF : RANK_COUNT;
+            argIndex += 2;
+        } else {
+            fprintf(stderr, "Usage: %s [--top K] [--rank count|tfidf|bm25] [pageDirectory] [indexFilename]\n", program);
+            return 1;
+        }
+    }
+
     // check for the appropriate number of arguments
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s [pageDirectory] [indexFilename]\n", program);
+    if (argc - argIndex != 2) {
+        fprintf(stderr, "Usage: %s [--top K] [--rank count|tfidf|bm25] [pageDirectory] [indexFilename]\n", program);
         return 1;
     }
 
     // allocate memory and copy string for pageDir
-    char* pageDirArg = argv[1];
+    char* pageDirArg = argv[argIndex];
     char* pageDir = count_malloc(strlen(pageDirArg) + 1);
     if (pageDir == NULL) {
         fprintf(stderr, "Error: out of memory\n");
@@ -112,7 +159,7 @@ int main(const int argc, char* argv[])
     strcpy(pageDir, pageDirArg);
 
     // allocate memory and copy string for indexFilename
-    char* indexFnameArg = argv[2];
+    char* indexFnameArg = argv[argIndex + 1];
     char* indexFilename = count_malloc(strlen(indexFnameArg) + 1);
     if (indexFilename == NULL) {
         fprintf(stderr, "Error: out of memory\n");
@@ -142,7 +189,7 @@ int main(const int argc, char* argv[])
     count_free(trueFilename);
 
     // run the querier
-    if (query(pageDir, indexFilename)) {
+    if (query(pageDir, indexFilename, topK, mode)) {
         #ifdef DEBUG
             printf("SUCCESS!\n\n");
         #endif
@@ -162,16 +209,18 @@ int main(const int argc, char* argv[])
  * reads from stdin with queries, and processes them
  * 
  * Pseudocode:
- *      1. load the index
- *      2. keep on taking from stdin while the query is active
- *      3. process those queries
- *      4. continue until freadlinep notices EOF
+ *      1. load the index, and map the document table written next to it if there is one
+ *      2. build the ranker's per-document statistics from the document table
+ *      3. create the arena that every query's temporary structures come from
+ *      4. keep on taking from stdin while the query is active
+ *      5. process those queries, resetting the arena after each one
+ *      6. continue until freadlinep notices EOF
  * 
  * Assumptions:
  *      1. the arguments are valid, otherwise throws errors
  *      2. assumes that the file at the indexFilename is in the valid format for loadIndexFromFile
 */
-bool query(char* pageDirectory, char* indexFilename)
+bool query(char* pageDirectory, char* indexFilename, int topK, rankMode_t mode)
 {
     // validate arguments
     if (pageDirectory == NULL || indexFilename == NULL) {
@@ -184,21 +233,51 @@ bool query(char* pageDirectory, char* indexFilename)
     // load in the hashtable from the index file
     index_t* index = loadIndexFromFile(indexFilename);
 
+    // the URLs of the documents are in [indexFilename].docs; without it they are read
+    // from the crawler files instead
+    docTable_t* docs = NULL;
+    char* docsFilename = count_malloc(strlen(indexFilename) + strlen(".docs") + 1);
+    if (docsFilename != NULL) {
+        sprintf(docsFilename, "%s.docs", indexFilename);
+        docs = loadDocTable(docsFilename);
+        count_free(docsFilename);
+    }
+
+    // TF-IDF and BM25 need the document lengths, which only the table has
+    ranker_t* ranker = NULL;
     if (index != NULL) {
+        if (mode != RANK_COUNT && docs == NULL) {
+            fprintf(stderr, "Error: ranking by %s needs the document table %s.docs\n",
+                    mode == RANK_BM25 ? "bm25" : "tfidf", indexFilename);
+        } else {
+            ranker = newRanker(docs, mode);
+        }
+    }
+
+    arena_t* arena = (index != NULL && ranker != NULL) ? newArena(QUERY_ARENA_BLOCK) : NULL;
+
+    if (arena != NULL) {
         // prompt for user input
         prompt();
         char* query = freadlinep(fp);
         while(query != NULL) {
             // process the queries and ask again until EOF
-            processQuery(query, index, pageDirectory);
+            processQuery(query, index, docs, ranker, arena, pageDirectory, topK);
             prompt();
             query = freadlinep(fp);
         }
         deleteIndex(index);
+        deleteDocTable(docs);
+        deleteRanker(ranker);
+        deleteArena(arena);
+        pageDirCloseStore();
         count_free(pageDirectory);
         count_free(indexFilename);
         return true;
     } else {
+        if (index != NULL) deleteIndex(index);
+        deleteDocTable(docs);
+        deleteRanker(ranker);
         count_free(pageDirectory);
         count_free(indexFilename);
         return false;
@@ -212,17 +291,18 @@ bool query(char* pageDirectory, char* indexFilename)
  * Pseudocode:
  *      1. count the number of words in the query
  *      2. parse the query into its words and make them all lowercase
- *      3. calculate the id scores based on the query words
- *      4. sort the final scores and print out the best queries
+ *      3. calculate the id scores based on the query words, as the ranker's mode says
+ *      4. sort the final scores and print out the best documents (only topK of them if topK > 0)
+ *      5. reset the arena, which frees everything the query allocated at once
  * 
  * Assumptions:
  *      1. the arguments are valid, otherwise throws errors
  *      2. the page directory is a valid crawler directory
 */
-void processQuery(char* query, index_t* index, char* pageDirectory) 
+void processQuery(char* query, index_t* index, docTable_t* docs, ranker_t* ranker, arena_t* arena, char* pageDirectory, int topK) 
 {
     // validate arguments
-    if (query == NULL || index == NULL || pageDirectory == NULL) {
+    if (query == NULL || index == NULL || ranker == NULL || arena == NULL || pageDirectory == NULL) {
         fprintf(stderr, "Error: query failed");
         return;
     }
@@ -235,8 +315,11 @@ void processQuery(char* query, index_t* index, char* pageDirectory)
     #endif
 
     // break that string into an array of words and make them lowercase
-    char** words = parseQuery(query, numWords);
-    if (words == NULL) return;
+    char** words = parseQuery(query, numWords, arena);
+    if (words == NULL) {
+        arenaReset(arena);
+        return;
+    }
     normalizeQuery(words, numWords);
 
     #ifdef DEBUG // print all of the words
@@ -249,13 +332,14 @@ void processQuery(char* query, index_t* index, char* pageDirectory)
     #endif
 
     // calculate the stores
-    counters_t* idScores = getIDScores(words, numWords, index, pageDirectory);
+    scoreList_t* idScores = getIDScores(words, numWords, index, ranker, arena, pageDirectory);
     count_free(query);
-    count_free(words);
-    if (idScores == NULL) return;
     
     // rank order the document ids by score and print them
-    if (!rankAndPrint(idScores, pageDirectory)) return;
+    if (idScores != NULL) rankAndPrint(idScores, docs, ranker, arena, pageDirectory, topK);
+
+    // everything the query allocated came from the arena
+    arenaReset(arena);
 }
 
 /************** countWordsInQuery() ******************/
@@ -287,7 +371,7 @@ int countWordsInQuery(char* query)
  * return
  *
  * Pseudocode: 
- *      1. allocate space for the word array
+ *      1. allocate space for the word array from the arena
  *      2. iterate through the characters in the query
  *      3. for each, check if it is a letter, and if it was preceded
  *          by a space, make that pointer a pointer in the word array
@@ -300,7 +384,7 @@ int countWordsInQuery(char* query)
  *      1. The arguments are valid, otherwise throw error
  *      2. all of the characters in the query are understandable by ctype.h
 */
-char** parseQuery(char* query, int numWords)
+char** parseQuery(char* query, int numWords, arena_t* arena)
 {
     // validate arguments
     if (query == NULL || numWords == 0) {
@@ -308,7 +392,7 @@ char** parseQuery(char* query, int numWords)
         return NULL;
     }
    
-    char** words = count_calloc(numWords, sizeof(char*));
+    char** words = arenaCalloc(arena, numWords, sizeof(char*));
     if (words == NULL) {
         fprintf(stderr, "Error: out of memory\n");
         count_free(query);
@@ -338,7 +422,6 @@ char** parseQuery(char* query, int numWords)
         // throw an error if a bad char is read.
         } else {
             fprintf(stderr, "Error: bad character '%c' in query\n", *i);
-            count_free(words);
             count_free(query);
             return NULL;
         }
@@ -374,399 +457,489 @@ void normalizeQuery(char** words, int numWords)
  *      2. loop through all of the words in the query
  *      3. check if the word is an operator or a query word
  *      4. if it is an 'and', check for errors and then ignore
- *      5. if it is an 'or', check for errors and then run an orsequence to merge the running product
- *          with the scores
- *      6. if it is a word, and first in the sequence merge the product with the current word's counters, 
- *          otherwise treat it as an and and intersect the countersets with an andsequence
- *      7. At the end of the words, perform a final merge
+ *      5. if it is an 'or', check for errors, intersect the postings of the words collected
+ *          so far with an andsequence, and merge that product with the scores in an orsequence
+ *      6. if it is a word, look up its sorted postings and add them to the current and sequence
+ *      7. At the end of the words, perform a final intersection and merge
  * 
  * Assumptions:
  *      1. The arguments are valid, otherwise throw errors
 */
-counters_t* getIDScores(char** words, int numWords, index_t* index, char* pageDirectory) 
+scoreList_t* getIDScores(char** words, int numWords, index_t* index, ranker_t* ranker, arena_t* arena, char* pageDirectory) 
 {
     // validate args
     if (words == NULL || index == NULL || pageDirectory == NULL) {
         return NULL;
     }
 
-    // initialize structs
-    counters_t* prod = counters_new();
-    counters_t* scores = counters_new();
-    hashtable_t* indexTable = getHashtable(index);
+    // initialize structs from the arena; the postings of the current and sequence are only
+    // borrowed from the index
+    scoreList_t* scores = arenaCalloc(arena, 1, sizeof(scoreList_t));
+    const posting_t** lists = arenaCalloc(arena, numWords, sizeof(posting_t*));
+    int* lengths = arenaCalloc(arena, numWords, sizeof(int));
+    if (scores == NULL || lists == NULL || lengths == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return NULL;
+    }
+    int numLists = 0; // the number of words in the current and sequence
+    bool valid = true;
 
-    bool firstInSequence = true; // if the next word is the first in an and sequence
     char* lastWord = ""; // initialized so we know it is the beginning of the query
     char** wordTraverse = words;
     // traverse through all of the words in the query
-    for (int i = 0; i < numWords; i++) {
+    for (int i = 0; i < numWords && valid; i++) {
         char* word = *wordTraverse;
         wordTraverse++;
 
-        // if and, edge cases throw errors, otherwise continue to next word
-        if (strcmp(word, "and") == 0) {
+        // if and or or, edge cases throw errors
+        bool isAnd = strcmp(word, "and") == 0;
+        if (isAnd || strcmp(word, "or") == 0) {
             #ifdef DEBUG
-                printf("AND SEQUENCE\n---------------\n");
+                printf("%s SEQUENCE\n---------------\n", isAnd ? "AND" : "OR");
             #endif
-            if (strcmp(lastWord, "") == 0 || strcmp(lastWord, "or") == 0 || strcmp(lastWord, "and") == 0) {
-                if (strcmp(lastWord, "") == 0) {
-                    fprintf(stderr, "Error: 'and' cannot be first\n");
-                    counters_delete(prod);
-                    counters_delete(scores);
-                    return NULL;
-                } else {
-                    fprintf(stderr, "Error: '%s' and 'and' cannot be adjacent\n", lastWord);
-                    counters_delete(prod);
-                    counters_delete(scores);
-                    return NULL;
-                }
-            }
-            lastWord = word;
-            continue;
-
-        // if or, edge cases throw errors, otherwise run an or sequence and reset the running product
-        } else if (strcmp(word, "or") == 0) {
-            #ifdef DEBUG
-                printf("OR SEQUENCE\n--------------\n");
-            #endif
-            if (strcmp(lastWord, "") == 0 || strcmp(lastWord, "or") == 0 || strcmp(lastWord, "and") == 0) {
-                if (strcmp(lastWord, "") == 0) {
-                    fprintf(stderr, "Error: 'or' cannot be first\n");
-                    counters_delete(prod);
-                    counters_delete(scores);
-                    return NULL;
-                } else {
-                    fprintf(stderr, "Error: '%s' and 'or' cannot be adjacent\n", lastWord);
-                    counters_delete(prod);
-                    counters_delete(scores);
-                    return NULL;
-                }
+            if (strcmp(lastWord, "") == 0) {
+                fprintf(stderr, "Error: '%s' cannot be first\n", word);
+                valid = false;
+            } else if (strcmp(lastWord, "or") == 0 || strcmp(lastWord, "and") == 0) {
+                fprintf(stderr, "Error: '%s' and '%s' cannot be adjacent\n", lastWord, word);
+                valid = false;
+            } else if (!isAnd) {
+                // intersect the sequence so far and merge it with the scores, then start a new one
+                scoreList_t prod = { NULL, 0 };
+                valid = andSequence(lists, lengths, numLists, ranker, arena, &prod)
+                        && orSequence(&prod, scores, arena);
+                numLists = 0;
             }
-            orSequence(prod, scores); // run the or
-            counters_delete(prod);
-            prod = counters_new(); // reset the prod
-            firstInSequence = true;
 
-        // if an actual word is read, merge the prod with the word's counter if the first in the sequence
-        // otherwise run an and sequence
+        // if an actual word is read, add its postings to the current and sequence
         } else {
-            counters_t* indexCounter = hashtable_find(indexTable, word);
+            lists[numLists] = findWordPostings(index, word, &lengths[numLists]);
             #ifdef DEBUG 
-                printf("\nFOUND WORD %s\n\n", word); 
+                printf("\nFOUND WORD %s in %d documents\n\n", word, lengths[numLists]); 
             #endif
-            if (firstInSequence) {
-                #ifdef DEBUG
-                    printf("OR SEQUENCE\n---------------\n");
-                #endif
-                orSequence(indexCounter, prod);
-            } else {
-                #ifdef DEBUG
-                    printf("AND SEQUENCE\n---------------\n");
-                #endif
-                prod = andSequence(prod, indexCounter);
-            }
-            firstInSequence = false;
+            numLists++;
         }
         lastWord = word; // increment the last word
     }
+
     // check for edge cases
-    if (strcmp(lastWord, "or") == 0 || strcmp(lastWord, "and") == 0) {
+    if (valid && (strcmp(lastWord, "or") == 0 || strcmp(lastWord, "and") == 0)) {
         fprintf(stderr, "Error: '%s' cannot be last\n", lastWord);
-        counters_delete(prod);
-        counters_delete(scores);
-        return NULL;
+        valid = false;
     } else if (strcmp(lastWord, "") == 0) {
-        counters_delete(prod);
-        counters_delete(scores);
-        return NULL;
-    } else {
-        // merge the final product with the scores
-        orSequence(prod, scores);
-        counters_delete(prod);
-        return scores;
+        valid = false;
     }
+    if (valid) {
+        // intersect the final sequence and merge it with the scores
+        scoreList_t prod = { NULL, 0 };
+        valid = andSequence(lists, lengths, numLists, ranker, arena, &prod)
+                && orSequence(&prod, scores, arena);
+    }
+    return valid ? scores : NULL;
 }
 
 /************** orSequence() ******************/
-/* runs an orSequence, which merges prod into scores */
-bool orSequence(counters_t* prod, counters_t* scores) 
+/* runs an orSequence, which merges prod into scores by adding the scores
+ * of the documents in both. Both arrays are sorted by docID, so this is a single
+ * linear merge into a new array from the arena that replaces the scores' array
+ */
+bool orSequence(scoreList_t* prod, scoreList_t* scores, arena_t* arena) 
 {
     if (prod == NULL || scores == NULL) return false;
-    #ifdef DEBUG
-        printf("Last prod: ");
-        counters_print(prod, stdout);
-        printf("\n");
-        printf("Current score: ");
-        counters_print(scores, stdout);
-        printf("\n\n");
-    #endif
+    if (prod->numScores == 0) return true;
 
-    // iterate through prod and add to scores
-    counters_iterate(prod, scores, countersUnionHelper);
+    scoreID_t* merged = arenaAlloc(arena, (prod->numScores + scores->numScores) * sizeof(scoreID_t));
+    if (merged == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return false;
+    }
+    // walk both arrays in docID order, adding the scores of shared documents
+    int i = 0, j = 0, k = 0;
+    while (i < prod->numScores || j < scores->numScores) {
+        if (j == scores->numScores || (i < prod->numScores && prod->scores[i].docID < scores->scores[j].docID)) {
+            merged[k++] = prod->scores[i++];
+        } else if (i == prod->numScores || scores->scores[j].docID < prod->scores[i].docID) {
+            merged[k++] = scores->scores[j++];
+        } else {
+            merged[k].docID = prod->scores[i].docID;
+            merged[k++].score = prod->scores[i++].score + scores->scores[j++].score;
+        }
+    }
 
     #ifdef DEBUG
-        printf("Scores after union: ");
-        counters_print(scores, stdout);
-        printf("\n");
+        printf("Scores after union: %d documents\n", k);
     #endif
 
+    // the old array is given back when the arena is reset
+    scores->scores = merged;
+    scores->numScores = k;
     return true;
 }
 
 /************** andSequence() ******************/
-/* runs an andSequence, which finds the intersection between countersets.
- * In the process, it creates a third temporary counterset to store the intersection
- * before it sets the new one equal to the prod
+/* runs an andSequence, which finds the intersection of the docID-sorted postings
+ * of every word in the sequence. With raw counts (or a NULL ranker) each document
+ * scores its smallest count; with TF-IDF or BM25 it scores the sum of its term scores,
+ * which are computed as the postings are walked, so no list is ever scored twice
  *
  * Pseudocode:
- *      1. create a new counters
- *      2. add that and the prod counters to the tuple
- *      3. iterate through wordcount, checking for intersecting words in prod and add
- *          them to intersection
+ *      1. order the lists from shortest to longest
+ *      2. score the shortest list into prod, since no intersection can be longer
+ *      3. for each other list, gallop forward to each docID still in prod,
+ *          keeping the document (and combining its scores) only if the list has it too
+ *      4. stop early once prod is empty
  * 
  *  Assumptions:
  *      1. The arguments are valid, otherwise throw errors
+ *      2. prod starts out empty, and the lists belong to the index so they are never freed here
+ *      3. prod's array comes from the arena
 */
-counters_t* andSequence(counters_t* prod, counters_t* wordCount)
+bool andSequence(const posting_t** lists, int* lengths, int numLists, ranker_t* ranker, arena_t* arena, scoreList_t* prod)
 {
     // validate arguments
-    if (prod == NULL || wordCount == NULL) {
-        if (prod != NULL) counters_delete(prod);
-        if (wordCount != NULL) counters_delete(wordCount);
-        return NULL;
+    if (lists == NULL || lengths == NULL || prod == NULL || numLists < 1) return false;
+
+    // sort the lists by length with an insertion sort, since there are only a few
+    for (int i = 1; i < numLists; i++) {
+        const posting_t* list = lists[i];
+        int length = lengths[i];
+        int j = i - 1;
+        for (; j >= 0 && lengths[j] > length; j--) {
+            lists[j + 1] = lists[j];
+            lengths[j + 1] = lengths[j];
+        }
+        lists[j + 1] = list;
+        lengths[j + 1] = length;
+    }
+
+    // a word in no document means no document matches
+    prod->numScores = 0;
+    if (lengths[0] == 0) return true;
+    prod->scores = arenaAlloc(arena, lengths[0] * sizeof(scoreID_t));
+    if (prod->scores == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return false;
+    }
+    bool takeMin = ranker == NULL || ranker->mode == RANK_COUNT;
+    double idf = termIDF(ranker, lengths[0]); // a word's document frequency is the length of its list
+    for (int j = 0; j < lengths[0]; j++) {
+        prod->scores[j].docID = lists[0][j].docID;
+        prod->scores[j].score = termScore(ranker, idf, lists[0][j].count, lists[0][j].docID);
+    }
+    prod->numScores = lengths[0];
+
+    // narrow prod down with each longer list in turn
+    for (int i = 1; i < numLists && prod->numScores > 0; i++) {
+        idf = termIDF(ranker, lengths[i]);
+        int kept = 0;
+        int pos = 0;
+        for (int j = 0; j < prod->numScores && pos < lengths[i]; j++) {
+            pos = gallopTo(lists[i], lengths[i], pos, prod->scores[j].docID);
+            if (pos < lengths[i] && lists[i][pos].docID == prod->scores[j].docID) {
+                double score = termScore(ranker, idf, lists[i][pos].count, lists[i][pos].docID);
+                prod->scores[kept].docID = prod->scores[j].docID;
+                if (takeMin) {
+                    prod->scores[kept].score = prod->scores[j].score < score ? prod->scores[j].score : score;
+                } else {
+                    prod->scores[kept].score = prod->scores[j].score + score;
+                }
+                kept++;
+            }
+        }
+        prod->numScores = kept;
     }
 
     #ifdef DEBUG
-        printf("New word: ");
-        counters_print(wordCount, stdout);
-        printf("\n");
-        printf("Current prod: ");
-        counters_print(prod, stdout);
-        printf("\n\n");
-    #endif
+        printf("Prod after intersection: %d documents\n", prod->numScores);
+    #endif 
+    return true;
+}
 
-    // create a new counterset
-    counters_t* intersection = counters_new();
-    if (intersection == NULL) return false;
+/************** gallopTo() ******************/
+/* returns the first position at or after start whose docID is at least docID,
+ * or length if there is none. It doubles its step until it passes docID and then
+ * binary searches the last step, so skipping k postings takes O(log k) comparisons
+*/
+int gallopTo(const posting_t* list, int length, int start, int docID)
+{
+    if (list == NULL || start >= length) return length;
+    if (list[start].docID >= docID) return start;
+
+    // gallop: list[low] is always below docID
+    int low = start;
+    int step = 1;
+    while (low + step < length && list[low + step].docID < docID) {
+        low += step;
+        step *= 2;
+    }
+    int high = low + step < length ? low + step : length;
 
-    // create a new tuple
-    countersTuple_t* tuple = count_malloc(sizeof(countersTuple_t));
-    if (tuple == NULL) return false;
-    tuple->counters1 = prod;
-    tuple->counters2 = intersection;
+    // binary search for the first docID not below it in (low, high]
+    while (low + 1 < high) {
+        int mid = low + (high - low) / 2;
+        if (list[mid].docID < docID) low = mid;
+        else high = mid;
+    }
+    return high;
+}
 
-    // pass the tuple and the other set to the iterate method
-    counters_iterate(wordCount, tuple, countersIntersectionHelper);
+/************** newRanker() ******************/
+/* creates the ranker of a scoring mode. For TF-IDF and BM25 it reads the length
+ * (number of words) of every document in the table once, into a dense array indexed
+ * by docID, so scoring a posting is a single array lookup
+ *
+ * Pseudocode:
+ *      1. allocate the ranker; raw counts need nothing else
+ *      2. count the documents in the table and their average length
+ *      3. store each document's length normalization in docNorms, with the
+ *          normalization of an average-length document in docNorms[0] for docIDs
+ *          the table has no entry for
+ *
+ * returns NULL if out of memory
+*/
+ranker_t* newRanker(docTable_t* docs, rankMode_t mode)
+{
+    ranker_t* ranker = count_calloc(1, sizeof(ranker_t));
+    if (ranker == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return NULL;
+    }
+    ranker->mode = mode;
+    if (mode == RANK_COUNT || docs == NULL) return ranker;
 
-    #ifdef DEBUG
-        printf("Prod after intersection: ");
-        counters_print(intersection, stdout);
-        printf("\n");
-    #endif 
+    ranker->maxDocID = docTableSize(docs);
+    ranker->docNorms = count_calloc(ranker->maxDocID + 1, sizeof(double));
+    if (ranker->docNorms == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        count_free(ranker);
+        return NULL;
+    }
 
-    counters_delete(prod);
-    count_free(tuple);
-    return intersection;
+    // read the lengths into docNorms, then turn them into normalizations in place
+    double totalLength = 0;
+    for (int docID = 1; docID <= ranker->maxDocID; docID++) {
+        int numWords;
+        if (docTableGetStats(docs, docID, NULL, NULL, &numWords)) {
+            ranker->docNorms[docID] = numWords;
+            totalLength += numWords;
+            ranker->numDocs++;
+        } else {
+            ranker->docNorms[docID] = -1; // no entry
+        }
+    }
+    double averageLength = ranker->numDocs > 0 ? totalLength / ranker->numDocs : 0;
+    for (int docID = 0; docID <= ranker->maxDocID; docID++) {
+        double length = (docID == 0 || ranker->docNorms[docID] < 0) ? averageLength : ranker->docNorms[docID];
+        if (mode == RANK_TFIDF) {
+            ranker->docNorms[docID] = length > 0 ? 1 / length : 0;
+        } else {
+            ranker->docNorms[docID] = BM25_K1 * (1 - BM25_B + (averageLength > 0 ? BM25_B * length / averageLength : BM25_B));
+        }
+    }
+    return ranker;
 }
 
-/************** countersUnionHelper() ******************/
-/* merges two counters together by adding their counts together and setting the key 
- * to the value
- */
-void countersUnionHelper(void* arg, const int key, const int count) 
-{  
-    // validate arguments
-    if (arg == NULL) return;
-    // get the counter, find the count in the other counterset, and add 
-    // to that counterset the count of the counterset being iterated through
-    counters_t* ctr1 = arg;
-    int count1 = counters_get(ctr1, key);
-    counters_set(ctr1, key, count1 + count);
+/************** termIDF() ******************/
+/* returns the inverse document frequency of a word found in docFrequency of the
+ * ranker's documents, which is the same for all of its postings
+*/
+double termIDF(ranker_t* ranker, int docFrequency)
+{
+    if (ranker == NULL || ranker->numDocs == 0 || docFrequency <= 0) return 0;
+    double numDocs = ranker->numDocs;
+    if (ranker->mode == RANK_TFIDF) {
+        return log(1 + numDocs / docFrequency);
+    } else if (ranker->mode == RANK_BM25) {
+        return log(1 + (numDocs - docFrequency + 0.5) / (docFrequency + 0.5));
+    }
+    return 0;
 }
 
-/************** countersIntersectionHelper() ******************/
-/* Finds the intersection between two countersets by finding the minimum of both
- * of their counts for a key and adding the min to the other counterset given in the tuple
+/************** termScore() ******************/
+/* returns the score a word with the given inverse document frequency earns in a
+ * document it occurs count times in: the count itself for raw counts (or a NULL ranker),
+ * count / length * idf for TF-IDF, or idf * count * (k1 + 1) / (count + norm) for BM25
 */
-void countersIntersectionHelper(void* arg, const int key, const int count) 
+double termScore(ranker_t* ranker, double idf, int count, int docID)
 {
-    // validate arguments
-    if (arg == NULL) return;
-    countersTuple_t* tuple = arg;
-    // find the count of the key in the other counters
-    int count1 = counters_get(tuple->counters1, key);
-    int intersectionScore;
-    // get the min score
-    if (count1 < count) intersectionScore = count1;
-    else intersectionScore = count;
-    // as long as it isn't zero, add it to the intersection set
-    if (intersectionScore != 0) counters_set(tuple->counters2, key, intersectionScore);
+    if (ranker == NULL || ranker->mode == RANK_COUNT || ranker->docNorms == NULL) return count;
+    double norm = (docID >= 1 && docID <= ranker->maxDocID) ? ranker->docNorms[docID] : ranker->docNorms[0];
+    if (ranker->mode == RANK_TFIDF) {
+        return count * norm * idf;
+    }
+    return idf * count * (BM25_K1 + 1) / (count + norm);
 }
 
 /************** rankAndPrint() ******************/
-/* given the scores in a counterset, sort them by score and print the corresponding
- * ID numbers, scores, and URLs
+/* given the scores of the matching documents, select the best ones by score and
+ * print the corresponding ID numbers, scores, and URLs
  *
  * Pseudocode:
- *      1. iterate to count how many scores are in idScores
- *      2. allocate enough memory in an array for pointers to a score and ID struct
- *      3. iterate through and populate the array with the correctly sorted ID-score structs
- *      4. open the crawler file of each ID and grab the URL
- *      4. print out the score, doc ID, and HTML
+ *      1. select the topK best documents in ranked order (all of them if topK <= 0)
+ *      2. look up the URL of each ID in the document table, or if it isn't
+ *          there, open the crawler file of the ID and grab the URL
+ *      3. print out the score, doc ID, and URL
  * 
  * Assumptions:
  *      1. The arguments are valid, otherwise throw errors
  *      2. the pageDirectory is a valid crawler directory
 */
-bool rankAndPrint(counters_t* idScores, char* pageDirectory)
+bool rankAndPrint(scoreList_t* idScores, docTable_t* docs, ranker_t* ranker, arena_t* arena, char* pageDirectory, int topK)
 {
     // validate arguments
     if (idScores == NULL || pageDirectory == NULL) return false;
 
-    // count the number of ids that satisfied the query
-    int count = 0;
-    counters_iterate(idScores, &count, countFunc);
     #ifdef DEBUG
-        printf("there are %d valid options\n", count);
+        printf("there are %d valid options\n", idScores->numScores);
     #endif
 
-    if (count == 0) {
+    if (idScores->numScores == 0) {
         printf("No documents match.\n");
-        counters_delete(idScores);
         return true;
-    } else {
-        // allocate enough space for the array of structs
-        scoreID_t** arr = count_calloc(count, sizeof(scoreID_t*));
-        if (arr == NULL) {
-            fprintf(stderr, "Error: out of memory\n");
-            return false;
-        }
-        // create the struct that stores the array
-        scoreIDArr_t* scoreIDArr = count_malloc(sizeof(scoreIDArr_t));
-        if (scoreIDArr == NULL) {
-            fprintf(stderr, "Error: out of memory\n");
-            count_free(arr);
-            return false;
-        }
-        scoreIDArr->arr = arr;
-        scoreIDArr->slotsFilled = 0;
-        // sort the id-scores into the array
-        counters_iterate(idScores, scoreIDArr, sortFunc);
-        counters_delete(idScores);
+    }
 
-        #ifdef DEBUG
-            for(int i = 0; i<count; i++) {
-                printf("Index %d: docID - %d, score - %d\n", i, arr[i]->docID, arr[i]->score);
-            }
-        #endif
+    // rank the documents
+    int count;
+    scoreID_t* ranked = selectTopScores(idScores, topK, &count, arena);
+    if (ranked == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        return false;
+    }
 
-        // loop through all of the items in the array
-        for (int i = 0; i<count; i++) {
-            int id = arr[i]->docID;
-            int score = arr[i]->score;
-            char* idString = intToString(id); // build the filepath
-            if (idString == NULL) continue;
-
-            // open the filepath to retrieve the URL
-            char* filepath = stringBuilder2(pageDirectory, idString);
-            count_free(idString);
-            if (filepath == NULL) continue;
-            FILE* fp = fopen(filepath, "r");
-            count_free(filepath);
-            if (fp != NULL) {
-                char* URL = freadlinep(fp);
-                if (URL == NULL) {
-                    fclose(fp);
-                    continue;
-                }
-                // print out the score line
-                printf("score %3d doc %3d: %s\n", score, id, URL);
-                count_free(URL);
-                fclose(fp);
-            }
+    #ifdef DEBUG
+        for(int i = 0; i<count; i++) {
+            printf("Index %d: docID - %d, score - %f\n", i, ranked[i].docID, ranked[i].score);
         }
+    #endif
 
-        deleteScoreIDArr(scoreIDArr, count);
+    // loop through all of the items in the array
+    bool rawCounts = ranker == NULL || ranker->mode == RANK_COUNT;
+    for (int i = 0; i<count; i++) {
+        int id = ranked[i].docID;
+        double score = ranked[i].score;
+        // find the URL in the table if possible, otherwise in the crawler file
+        char* fileURL = NULL;
+        const char* URL = docTableGetURL(docs, id);
+        if (URL == NULL) {
+            if ((fileURL = readURLFromCrawlerFile(pageDirectory, id)) == NULL) continue;
+            URL = fileURL;
+        }
+        // print out the score line; counts are whole numbers
+        if (rawCounts) {
+            printf("score %3d doc %3d: %s\n", (int) score, id, URL);
+        } else {
+            printf("score %7.4f doc %3d: %s\n", score, id, URL);
+        }
+        if (fileURL != NULL) count_free(fileURL);
     }
+
     // print a looooooong bar
     printf("-----------------------------------------------------------------------------\n");
     return true;
 }
 
-/************** countFunc() ******************/
-/* helper that counts the number of items in the counterset */
-void countFunc(void* arg, const int key, const int count)
+/************** readURLFromCrawlerFile() ******************/
+/* reads the URL of a docID from the page store of the page directory, or if
+ * it has none, opens the crawler file of the docID and returns its first line,
+ * as a malloc'd string, or NULL if it can't be read
+*/
+char* readURLFromCrawlerFile(char* pageDirectory, int docID)
 {
-    int* num = arg;
-    (*num)++; // increment the count
+    // the store stays open between calls, so this costs no open per document
+    char* dirPath = stringBuilder2(pageDirectory, "");
+    pageStore_t* store = pageDirStore(dirPath);
+    if (dirPath != NULL) count_free(dirPath);
+    if (store != NULL) return pageStoreGetURL(store, docID);
+
+    char* idString = intToString(docID); // build the filepath
+    if (idString == NULL) return NULL;
+
+    // open the filepath to retrieve the URL
+    char* filepath = stringBuilder2(pageDirectory, idString);
+    count_free(idString);
+    if (filepath == NULL) return NULL;
+    FILE* fp = fopen(filepath, "r");
+    count_free(filepath);
+    if (fp == NULL) return NULL;
+    char* URL = freadlinep(fp);
+    fclose(fp);
+    return URL;
 }
 
-/************** sortFunc() ******************/
-/* implements a modified insertionSort to insert key-count structs into the 
- * array, passed as the void* arg. It finds its location in the array and shifts 
- * everything else one spot to the right until it is completely filled.
+/************** selectTopScores() ******************/
+/* selects the topK best documents of the scores (all of them if topK <= 0) and
+ * returns them in an array from the arena sorted from best to worst, setting numSelected
  *
  * Pseudocode:
- *      1. get our array from the void* arg
- *      2. loop through all of the filled items in the array until the current
- *          item is larger than the item in the array
- *      3. store the currently-stored struct in a temp variable and replace it 
- *          with the new score-id struct
- *      4. until the temp is null aka until all of the items have been shifted, shift
- *          the items one to the right, always saving a second temp to ensure no value is lost
- *      5. if there is never a larger item, it is assumed the smallest and placed at the end at 
- *          the same index as slotsFilled
- *      6. slotsFilled is incremented
- * 
- * Assumptions:
- *      1. The arguments are valid, otherwise throw errors
- *      2. the arg is actually of type scoreIDArr_t*
- *      3. the array has enough spots to hold the next key and count
+ *      1. allocate one contiguous array of min(topK, number of documents) scoreIDs
+ *      2. fill it with the first documents, then turn it into a heap whose root
+ *          is the worst document kept so far
+ *      3. for each remaining document, if it ranks before the root, replace the root
+ *          and sift it down, so the heap always holds the best documents seen
+ *      4. repeatedly swap the root to the end of the heap and shrink it, which
+ *          leaves the array sorted from best to worst
+ *
+ * This costs O(n log K) for n documents, with a single allocation
 */
-void sortFunc(void* arg, const int key, const int count)
+scoreID_t* selectTopScores(scoreList_t* idScores, int topK, int* numSelected, arena_t* arena)
 {
-    // validate arguments
-    if (arg == NULL) return;
-
-    #ifdef DEBUG
-        printf("SORTING ID %d, COUNT %d\n", key, count);
-    #endif
-
-    // get the array from the arg argument
-    scoreIDArr_t* scoreIDArr = arg;
-    scoreID_t** arr = scoreIDArr->arr;
-    int slotsFilled = scoreIDArr->slotsFilled;
+    if (numSelected != NULL) *numSelected = 0;
+    if (idScores == NULL || numSelected == NULL || idScores->numScores == 0) return NULL;
+    int n = idScores->numScores;
+    int size = (topK > 0 && topK < n) ? topK : n;
+    scoreID_t* heap = arenaAlloc(arena, size * sizeof(scoreID_t));
+    if (heap == NULL) return NULL;
+
+    // build a heap out of the first documents
+    memcpy(heap, idScores->scores, size * sizeof(scoreID_t));
+    for (int i = size / 2 - 1; i >= 0; i--) siftDown(heap, size, i);
+
+    // keep only the best documents, replacing the worst one kept when a better one comes
+    for (int i = size; i < n; i++) {
+        if (rankedBefore(&idScores->scores[i], &heap[0])) {
+            heap[0] = idScores->scores[i];
+            siftDown(heap, size, 0);
+        }
+    }
 
-    // create a new struct and initialize its key and count
-    scoreID_t* newScoreID = count_malloc(sizeof(scoreID_t));
-    if (newScoreID == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        return;
+    // move the worst document to the back until the heap is empty
+    for (int last = size - 1; last > 0; last--) {
+        scoreID_t worst = heap[0];
+        heap[0] = heap[last];
+        heap[last] = worst;
+        siftDown(heap, last, 0);
     }
-    newScoreID->docID = key;
-    newScoreID->score = count;
-
-    // loop through all of the existing id-score pairs in the array
-    for (int i = 0; i < slotsFilled; i++) {
-        // once it is larger, shift everything else to the right
-        if (count > arr[i]->score) {
-            int j = 1; // used to shift items further and further away
-            scoreID_t* temp = arr[i]; // a temp variable to not lose the value currently stored
-            arr[i] = newScoreID;
-            while (temp != NULL) {
-                scoreID_t* temp2 = arr[i + j]; // a temp variable to not lose the value stored
-                arr[i + j] = temp;
-                temp = temp2;
-                j++; // move ahead
-            }
+    *numSelected = size;
+    return heap;
+}
 
-            scoreIDArr->slotsFilled++;
-            return; // exit once everything has shifted - no need to check anything else
-        }
+/************** rankedBefore() ******************/
+/* returns true if document a should be printed before document b:
+ * it has the higher score, or the same score and the lower docID
+*/
+bool rankedBefore(scoreID_t* a, scoreID_t* b)
+{
+    return a->score > b->score || (a->score == b->score && a->docID < b->docID);
+}
+
+/************** siftDown() ******************/
+/* moves the scoreID at position i of the heap down until neither of its children
+ * ranks after it, keeping the worst-ranked document at the root
+*/
+void siftDown(scoreID_t* heap, int size, int i)
+{
+    while (true) {
+        int worst = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < size && rankedBefore(&heap[worst], &heap[left])) worst = left;
+        if (right < size && rankedBefore(&heap[worst], &heap[right])) worst = right;
+        if (worst == i) return;
+        scoreID_t temp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = temp;
+        i = worst;
     }
-    // case where it is the smallest item, insert it at end and increment slotsFilled
-    arr[slotsFilled] = newScoreID;
-    scoreIDArr->slotsFilled++;
 }
 
 /************** prompt() ******************/
@@ -779,21 +952,13 @@ void prompt(void)
   }
 }
 
-/************** deleteScoreIDArr() ******************/
-/* deletes the scoreIDArr struct */
-void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize) 
+/************** deleteRanker() ******************/
+/* deletes a ranker and its per-document statistics */
+void deleteRanker(ranker_t* ranker)
 {
-    if (scoreIDArr == NULL) return;
-    scoreID_t** arr = scoreIDArr->arr; // get the array
-    if (arr == NULL) {
-        count_free(scoreIDArr);
-        return;
-    }
-    for (int i = 0; i<arrSize; i++) { // loop through items inside and free
-        if (arr[i] != NULL) count_free(arr[i]);
-    }
-    count_free(arr); // free the array
-    count_free(scoreIDArr); // free the wrapper struct
+    if (ranker == NULL) return;
+    if (ranker->docNorms != NULL) count_free(ranker->docNorms);
+    count_free(ranker);
 }
 
 
@@ -838,13 +1003,14 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
         strcpy(query2, q2);
         strcpy(query3, q3);
 
+        arena_t* arena = newArena(64);
         int numWords = countWordsInQuery(query);
-        char** pq = parseQuery(query, numWords);
+        char** pq = parseQuery(query, numWords, arena);
         int numWords2 = countWordsInQuery(query2);
-        char** pq2 = parseQuery(query2, numWords2);
+        char** pq2 = parseQuery(query2, numWords2, arena);
         int numWords3 = countWordsInQuery(query3);
-        char** pq3 = parseQuery(query3, numWords3);
-        char** pq4 = parseQuery(NULL, 0);
+        char** pq3 = parseQuery(query3, numWords3, arena);
+        char** pq4 = parseQuery(NULL, 0, arena);
 
         // check if the words were parsed correctly
         if (strcmp(pq[0], "there") != 0) numFailed++;
@@ -857,8 +1023,7 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
         // frees
         count_free(query);
         count_free(query2);
-        count_free(pq);
-        count_free(pq2);
+        deleteArena(arena);
 
         return numFailed;
     }
@@ -872,8 +1037,9 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
         char* query = malloc(strlen(q) + 1);
         strcpy(query, q);
 
+        arena_t* arena = newArena(64);
         int numWords = countWordsInQuery(query);
-        char** pq = parseQuery(query, numWords);
+        char** pq = parseQuery(query, numWords, arena);
         char** pq2 = NULL;
         normalizeQuery(pq, numWords);
         normalizeQuery(pq2, 0);
@@ -887,7 +1053,7 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
 
         // frees
         count_free(query);
-        count_free(pq);
+        deleteArena(arena);
 
         return numFailed;
     }
@@ -896,38 +1062,32 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
     int test4()
     {
         int numFailed = 0; 
-        counters_t* c1 = counters_new();
-        counters_set(c1, 1, 5);
-        counters_set(c1, 2, 4);
-        counters_t* c2 = counters_new();
-        counters_set(c2, 1, 6);
-        counters_set(c2, 3, 6);
-        counters_t* c3 = counters_new();
-        counters_t* c4 = NULL;
-
-        // check if the sets merged successfully
-        if (!orSequence(c2, c1)) numFailed++;
-        if (counters_get(c1, 1) != 11) numFailed++;
-        if (counters_get(c1, 2) != 4) numFailed++;
-        if (counters_get(c1, 3) != 6) numFailed++;
-        if (counters_get(c2, 1) != 6) numFailed++;
-        if (counters_get(c2, 2) != 0) numFailed++;
-
-        if (!orSequence(c3, c1)) numFailed++;
-        if (counters_get(c3, 1) != 0) numFailed++;
-        if (counters_get(c3, 2) != 0) numFailed++;
-
-        if (!orSequence(c1, c3)) numFailed++;
-        if (counters_get(c3, 1) != 11) numFailed++;
-        if (counters_get(c3, 2) != 4) numFailed++;
-
-        if (orSequence(c4, c3)) numFailed++;
-        if (counters_get(c3, 1) != 11) numFailed++;
+        scoreID_t p1[] = { {1, 5}, {2, 4} };
+        scoreID_t p2[] = { {1, 6}, {3, 6.5} };
+        arena_t* arena = newArena(64);
+        scoreList_t* scores = arenaCalloc(arena, 1, sizeof(scoreList_t));
+        scoreList_t prod1 = { p1, 2 };
+        scoreList_t prod2 = { p2, 2 };
+        scoreList_t empty = { NULL, 0 };
+
+        // check if the sets merged successfully, in docID order
+        if (!orSequence(&prod1, scores, arena)) numFailed++;
+        if (!orSequence(&prod2, scores, arena)) numFailed++;
+        if (scores->numScores != 3) {
+            deleteArena(arena);
+            return numFailed + 1;
+        }
+        if (scores->scores[0].docID != 1 || scores->scores[0].score != 11) numFailed++;
+        if (scores->scores[1].docID != 2 || scores->scores[1].score != 4) numFailed++;
+        if (scores->scores[2].docID != 3 || scores->scores[2].score != 6.5) numFailed++;
+        if (p2[0].score != 6) numFailed++;
+
+        if (!orSequence(&empty, scores, arena)) numFailed++;
+        if (scores->numScores != 3) numFailed++;
+        if (orSequence(NULL, scores, arena)) numFailed++;
 
         // frees
-        counters_delete(c1);
-        counters_delete(c2);
-        counters_delete(c3);
+        deleteArena(arena);
 
         return numFailed;
     }
@@ -936,140 +1096,173 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
     int test5()
     {
         int numFailed = 0; 
-        counters_t* c1 = counters_new();
-        counters_set(c1, 1, 5);
-        counters_set(c1, 2, 4);
-        counters_set(c1, 3, 6);
-        counters_t* c2 = counters_new();
-        counters_set(c2, 2, 6);
-        counters_set(c2, 3, 1);
-        counters_set(c2, 4, 5);
-        counters_t* c3 = counters_new();
-        counters_t* c4 = NULL;
-
-        // check if the sets intersect properly
-        counters_t* temp1 = andSequence(c1, c2);
-        if (counters_get(temp1, 1) != 0) numFailed++;
-        if (counters_get(temp1, 2) != 4) numFailed++;
-        if (counters_get(temp1, 3) != 1) numFailed++;
-        if (counters_get(c2, 2) != 6) numFailed++;
-        if (counters_get(c2, 4) != 5) numFailed++;
-
-        counters_t* temp2 = andSequence(temp1, c3);
-        if (counters_get(temp2, 1) != 0) numFailed++;
-        if (counters_get(temp2, 2) != 0) numFailed++;
-
-        counters_t* temp3 = andSequence(temp2, c4);
-        if (temp3 != NULL) numFailed++;
-
-        // frees
-        counters_delete(temp3);
-        counters_delete(c2);
-        counters_delete(c3);
+        posting_t p1[] = { {1, 5}, {2, 4}, {3, 6}, {9, 2} };
+        posting_t p2[] = { {2, 6}, {3, 1}, {4, 5} };
+        posting_t p3[] = { {3, 2}, {9, 1} };
+        const posting_t* lists[] = { p1, p2, p3 };
+        int lengths[] = { 4, 3, 2 };
+
+        // check if the sets intersect properly, taking the smallest count
+        arena_t* arena = newArena(64);
+        scoreList_t prod = { NULL, 0 };
+        if (!andSequence(lists, lengths, 2, NULL, arena, &prod)) numFailed++;
+        if (prod.numScores != 2) numFailed++;
+        if (prod.scores[0].docID != 2 || prod.scores[0].score != 4) numFailed++;
+        if (prod.scores[1].docID != 3 || prod.scores[1].score != 1) numFailed++;
+
+        // the shortest list goes first, whatever the order of the words
+        lists[0] = p1; lists[1] = p2; lists[2] = p3;
+        lengths[0] = 4; lengths[1] = 3; lengths[2] = 2;
+        prod.scores = NULL;
+        if (!andSequence(lists, lengths, 3, NULL, arena, &prod)) numFailed++;
+        if (lengths[0] != 2 || lists[0] != p3) numFailed++;
+        if (prod.numScores != 1) numFailed++;
+        if (prod.scores[0].docID != 3 || prod.scores[0].score != 1) numFailed++;
+
+        // a word in no documents matches nothing
+        lists[0] = p1; lists[1] = NULL;
+        lengths[0] = 4; lengths[1] = 0;
+        prod.scores = NULL;
+        if (!andSequence(lists, lengths, 2, NULL, arena, &prod)) numFailed++;
+        if (prod.numScores != 0 || prod.scores != NULL) numFailed++;
+        if (andSequence(lists, lengths, 0, NULL, arena, &prod)) numFailed++;
+        deleteArena(arena);
 
         return numFailed;
     }
 
-    // unit testing for the countFunc function
+    // unit testing for the gallopTo function
     int test6()
     {
         int numFailed = 0;
-        counters_t* counters = counters_new();
-        for (int i = 0; i < 10; i++) {
-            counters_add(counters, i);
+        posting_t list[100];
+        for (int i = 0; i < 100; i++) {
+            list[i].docID = 2 * i; // the even numbers 0 to 198
+            list[i].count = 1;
         }
-        int count = 0;
-        counters_iterate(counters, &count, countFunc);
-
-        counters_t* counters2 = counters_new();
-        int count2 = 0;
-        counters_iterate(counters2, &count2, countFunc);
 
-        // check if the function counts properly
-        if (count != 10) numFailed++;
-        if (count2 != 0) numFailed++;
-
-        // frees
-        counters_delete(counters);
-        counters_delete(counters2);
+        // check if it finds the first docID at or above the target
+        if (gallopTo(list, 100, 0, 0) != 0) numFailed++;
+        if (gallopTo(list, 100, 0, 1) != 1) numFailed++;
+        if (gallopTo(list, 100, 0, 64) != 32) numFailed++;
+        if (gallopTo(list, 100, 10, 150) != 75) numFailed++;
+        if (gallopTo(list, 100, 50, 10) != 50) numFailed++;
+        if (gallopTo(list, 100, 0, 198) != 99) numFailed++;
+        if (gallopTo(list, 100, 0, 199) != 100) numFailed++;
+        if (gallopTo(list, 100, 100, 0) != 100) numFailed++;
+        if (gallopTo(NULL, 0, 0, 5) != 0) numFailed++;
 
         return numFailed;
     }
 
-    // unit testing for the countFunc function
+    // unit testing for the selectTopScores function
     int test7()
     {
         int numFailed = 0;
+        int numSelected;
+        arena_t* arena = newArena(64);
 
-        // ascending order test
-        scoreIDArr_t* arrObj = count_malloc(sizeof(scoreIDArr_t));
-        scoreID_t** arr = count_calloc(10, sizeof(scoreID_t*));
-        arrObj->arr = arr;
-        arrObj->slotsFilled = 0;
-        counters_t* counters = counters_new();
-        for (int i = 1; i <= 10; i++) {
-            counters_set(counters, i, i);
-        }
-        counters_iterate(counters, arrObj, sortFunc);
-
-        // descending order test
-        scoreIDArr_t* arrObj2 = count_malloc(sizeof(scoreIDArr_t));
-        scoreID_t** arr2 = count_calloc(10, sizeof(scoreID_t*));
-        arrObj2->arr = arr2;
-        arrObj2->slotsFilled = 0;
-        counters_t* counters2 = counters_new();
-        for (int i = 10; i > 0; i--) {
-            counters_set(counters2, i, i);
-        }
-        counters_iterate(counters2, arrObj2, sortFunc);
-
-        // non-sorted order test
-        scoreIDArr_t* arrObj3 = count_malloc(sizeof(scoreIDArr_t));
-        scoreID_t** arr3 = count_calloc(10, sizeof(scoreID_t*));
-        arrObj3->arr = arr3;
-        arrObj3->slotsFilled = 0;
-        counters_t* counters3 = counters_new();
-        for (int i = 1; i <= 10; i++) {
-            counters_set(counters3, i, (i*i)%10);
+        // ascending, descending, and non-sorted scores over docIDs 1 to 10
+        scoreID_t ascending[10], descending[10], mixed[10];
+        for (int i = 0; i < 10; i++) {
+            ascending[i].docID = descending[i].docID = mixed[i].docID = i + 1;
+            ascending[i].score = i + 1;
+            descending[i].score = 10 - i;
+            mixed[i].score = ((i + 1) * (i + 1)) % 10;
         }
-        counters_iterate(counters3, arrObj3, sortFunc);
+        scoreList_t list = { ascending, 10 };
+        scoreList_t list2 = { descending, 10 };
+        scoreList_t list3 = { mixed, 10 };
 
         // check if the arrays are sorted properly
+        scoreID_t* arr = selectTopScores(&list, 0, &numSelected, arena);
+        if (numSelected != 10) numFailed++;
         for (int i = 0; i < 10; i++) {
-            if (arr[i]->docID != (10 - i)) {
-                numFailed++;
-            }
+            if (arr[i].docID != (10 - i)) numFailed++;
         }
+        scoreID_t* arr2 = selectTopScores(&list2, 0, &numSelected, arena);
         for (int i = 0; i < 10; i++) {
-            if (arr2[i]->docID != (10 - i)) {
-                numFailed++;
-            }
+            if (arr2[i].docID != (i + 1)) numFailed++;
         }
 
-        // check if the average-case works (I figured)
-        // these out by hand
-        if (arr3[9]->docID != 10) numFailed++;
-        if (arr3[4]->docID != 5) numFailed++;
-        if (arr3[3]->docID != 6) numFailed++;
+        // scores 1 4 9 6 5 6 9 4 1 0: ties go to the lower docID
+        scoreID_t* arr3 = selectTopScores(&list3, 0, &numSelected, arena);
+        if (arr3[0].docID != 3 || arr3[1].docID != 7) numFailed++;
+        if (arr3[2].docID != 4 || arr3[3].docID != 6) numFailed++;
+        if (arr3[9].docID != 10) numFailed++;
+
+        // only the best K are kept, still in order
+        scoreID_t* arr4 = selectTopScores(&list3, 3, &numSelected, arena);
+        if (numSelected != 3) numFailed++;
+        else if (arr4[0].docID != 3 || arr4[1].docID != 7 || arr4[2].docID != 4) numFailed++;
+        scoreID_t* arr5 = selectTopScores(&list, 20, &numSelected, arena);
+        if (numSelected != 10 || arr5[0].docID != 10) numFailed++;
 
         // frees
-        for (int i = 0; i < 10; i++) {
-            count_free(arr[i]);
-            count_free(arr2[i]);
-            count_free(arr3[i]);
-        }
-        count_free(arr);
-        count_free(arr2);
-        count_free(arr3);
-        count_free(arrObj);
-        count_free(arrObj2);
-        count_free(arrObj3);
-        counters_delete(counters);
-        counters_delete(counters2);
-        counters_delete(counters3);
+        deleteArena(arena);
         
         return numFailed;
     }
+
+    // unit testing for the TF-IDF and BM25 rankers
+    int test8()
+    {
+        int numFailed = 0;
+        // four documents: 1 and 2 are short, 3 is long, and 4 is average
+        docTable_t* docs = newDocTable();
+        docTableSet(docs, 1, "http://a/", 0, 100, 10);
+        docTableSet(docs, 2, "http://b/", 1, 100, 10);
+        docTableSet(docs, 3, "http://c/", 1, 100, 55);
+        docTableSet(docs, 4, "http://d/", 1, 100, 25);
+        ranker_t* bm25 = newRanker(docs, RANK_BM25);
+        ranker_t* tfidf = newRanker(docs, RANK_TFIDF);
+        ranker_t* counts = newRanker(docs, RANK_COUNT);
+        if (bm25 == NULL || tfidf == NULL || counts == NULL) return 1;
+        if (bm25->numDocs != 4 || bm25->maxDocID != 4) numFailed++;
+
+        // rarer words and shorter documents score higher, more occurrences add less and less
+        double rare = termIDF(bm25, 1);
+        double common = termIDF(bm25, 4);
+        if (!(rare > common && common > 0)) numFailed++;
+        if (!(termScore(bm25, rare, 2, 1) > termScore(bm25, rare, 2, 3))) numFailed++;
+        double once = termScore(bm25, rare, 1, 4);
+        double twice = termScore(bm25, rare, 2, 4);
+        if (!(twice > once && twice < 2 * once)) numFailed++;
+        if (fabs(once - rare * (BM25_K1 + 1) / (1 + BM25_K1)) > 1e-9) numFailed++; // average length
+        if (termScore(bm25, rare, 1, 99) != once) numFailed++; // no entry: average length
+        if (fabs(termScore(tfidf, termIDF(tfidf, 1), 5, 3) - 5.0 / 55 * log(5)) > 1e-9) numFailed++;
+        if (termScore(counts, termIDF(counts, 1), 5, 3) != 5) numFailed++;
+
+        // with BM25 an and sequence sums its words' scores in one pass, and the
+        // document where both words are denser wins
+        posting_t w1[] = { {1, 2}, {2, 1}, {3, 2} };
+        posting_t w2[] = { {1, 1}, {3, 1} };
+        const posting_t* lists[] = { w1, w2 };
+        int lengths[] = { 3, 2 };
+        arena_t* arena = newArena(64);
+        scoreList_t prod = { NULL, 0 };
+        if (!andSequence(lists, lengths, 2, bm25, arena, &prod)) numFailed++;
+        if (prod.numScores != 2) numFailed++;
+        else {
+            double expected = termScore(bm25, termIDF(bm25, 3), 2, 1) + termScore(bm25, termIDF(bm25, 2), 1, 1);
+            if (fabs(prod.scores[0].score - expected) > 1e-9) numFailed++;
+            if (!(prod.scores[0].score > prod.scores[1].score)) numFailed++;
+        }
+        deleteArena(arena);
+
+        // a ranker without a document table only counts
+        ranker_t* noTable = newRanker(NULL, RANK_BM25);
+        if (noTable == NULL || termScore(noTable, 1, 3, 1) != 3) numFailed++;
+
+        // frees
+        deleteRanker(bm25);
+        deleteRanker(tfidf);
+        deleteRanker(counts);
+        deleteRanker(noTable);
+        deleteDocTable(docs);
+
+        return numFailed;
+    }
     
     // runs the unit testing, called in main above
     void unittest() 
@@ -1127,7 +1320,7 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
             totalFailed++;
         }
 
-        // test 6: countFunc
+        // test 6: gallopTo
         failed = 0;
         failed += test6();
         if (failed == 0) {
@@ -1137,7 +1330,7 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
             totalFailed++;
         }
 
-        // test 7: sortFunc
+        // test 7: selectTopScores
         failed = 0;
         failed += test7();
         if (failed == 0) {
@@ -1146,6 +1339,16 @@ void deleteScoreIDArr(scoreIDArr_t* scoreIDArr, int arrSize)
             printf("Test 7 failed!\n");
             totalFailed++;
         }
+
+        // test 8: newRanker, termIDF, and termScore
+        failed = 0;
+        failed += test8();
+        if (failed == 0) {
+            printf("Test 8 passed\n");
+        } else {
+            printf("Test 8 failed!\n");
+            totalFailed++;
+        }
     }
 
 #endif
\ No newline at end of file
@@ -30,6 +30,18 @@
 
 ./querier ../data/letters-depth-6 ../data/letters-index-6 < tests/fqLetters.txt
 
+# TOP K TESTS
+
+./querier --top 3 ../data/toscrape-depth-1 ../data/toscrape-index-1 < tests/testQueries.txt
+
+./querier --top 1 ../data/wikipedia-depth-1 ../data/wikipedia-index-1 < tests/fqWiki.txt
+
+# RANKING MODE TESTS
+
+./querier --rank bm25 --top 5 ../data/toscrape-depth-1 ../data/toscrape-index-1 < tests/testQueries.txt
+
+./querier --rank tfidf --top 5 ../data/wikipedia-depth-1 ../data/wikipedia-index-1 < tests/fqWiki.txt
+
 
 # EDGE CASES
 # ----------
@@ -37,6 +49,12 @@
 # WRONG NUMBER OF ARGUMENTS
 ./querier sdjflkjdslk sdfjkldslj sdfjklsdj sdfjlkj sdjfklj ejflkdjs < tests/testQueries.txt
 
+# INVALID TOP K
+./querier --top 0 ../data/toscrape-depth-1 ../data/toscrape-index-1 < tests/testQueries.txt
+
+# INVALID RANKING MODE
+./querier --rank pagerank ../data/toscrape-depth-1 ../data/toscrape-index-1 < tests/testQueries.txt
+
 # NONEXISTENT DIRECTORY
 ./querier invalidDirectory ../data/toscrape-index-0 < tests/testQueries.txt
 